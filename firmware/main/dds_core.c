@@ -0,0 +1,94 @@
+// Portable DDS core (see dds_core.h). Built with -ffp-contract=off (main/CMakeLists.txt)
+// so every float operation rounds on its own and the host model can reproduce it exactly.
+#include "dds_core.h"
+
+void dds_build_quarter_table(uint8_t *quarter_table) {
+    int quarter = DDS_TABLE_SIZE / 4;
+    for (int i = 0; i < quarter; i++) {
+        float phase_val = (M_PI_2 * i) / (float)quarter; // 0 to pi/2
+        float val = sinf(phase_val);
+        uint8_t value = (uint8_t)((val * 127.5f) + 127.5f); // 0-255 range
+        quarter_table[i] = value;
+    }
+}
+
+uint8_t dds_table_value(const uint8_t *quarter_table, uint32_t idx) {
+    uint32_t quarter = DDS_TABLE_SIZE / 4;
+    idx = idx % DDS_TABLE_SIZE;
+    if (idx < quarter) {
+        // 0 to pi/2: +sin
+        return quarter_table[idx];
+    } else if (idx < 2 * quarter) {
+        // pi/2 to pi: +sin (mirrored, inverted)
+        return quarter_table[quarter - 1 - (idx - quarter)];
+    } else if (idx < 3 * quarter) {
+        // pi to 3pi/2: -sin
+        return 255 - quarter_table[idx - 2 * quarter];
+    } else {
+        // 3pi/2 to 2pi: -sin (mirrored, inverted)
+        return 255 - quarter_table[quarter - 1 - (idx - 3 * quarter)];
+    }
+}
+
+uint32_t dds_compute_step(float frequency, float period_us) {
+    return (DDS_TABLE_SIZE * frequency * period_us / 1000000);
+}
+
+float dds_degrees_to_radians(float degrees) {
+    return degrees * (M_PI / 180.0f);
+}
+
+void dds_set_harmonic(volatile dds_harmonic_t *h, int order, float percent, float phase_deg) {
+    h->order = order;
+    h->percent = percent / 100.0f;
+    h->phase = dds_degrees_to_radians(phase_deg);
+    h->phase_offset_int = (int)(h->phase * DDS_PHASE_SCALE);
+}
+
+uint32_t dds_compute_phase_offset(float phase) {
+    // A negative offset is 0: the ESP32's float-to-unsigned conversion saturates, so the
+    // device has always played negative channel phases as 0. Spelled out because that
+    // conversion is undefined in C and wraps on other targets (the host check build).
+    float offset = phase * DDS_PHASE_SCALE;
+    return offset > 0.0f ? (uint32_t)offset : 0;
+}
+
+uint8_t dds_sample(const uint8_t *quarter_table, uint32_t acc, uint32_t phase_offset,
+                   const volatile dds_harmonic_t *harmonics, int harmonic_count,
+                   float amplitude, float output_scale) {
+    // Phase accumulator for this sample
+    uint32_t phase_acc = (acc + phase_offset) % DDS_TABLE_SIZE;
+    // Use helper to get base waveform value
+    float fundamental_val = ((float)dds_table_value(quarter_table, phase_acc) - 127.5f) / 127.5f; // -1.0 to 1.0
+    float harmonics_sum = 0.0f;
+
+    // Sum all harmonics
+    for (int i = 0; i < harmonic_count; ++i) {
+        if (harmonics[i].order >= 3 && (harmonics[i].order % 2) == 1 && harmonics[i].percent > 0.0f) {
+            int harmonic_order_val = harmonics[i].order;
+            int harmonic_phase_offset_int = harmonics[i].phase_offset_int;
+            int harmonic_phase_acc_int = (harmonic_order_val * (int)phase_acc + harmonic_phase_offset_int) % DDS_TABLE_SIZE;
+            float harmonic_val = ((float)dds_table_value(quarter_table, harmonic_phase_acc_int) - 127.5f) / 127.5f; // -1.0 to 1.0
+            float harmonic_scale = harmonics[i].percent;
+            harmonics_sum += harmonic_val * harmonic_scale;
+        }
+    }
+
+    // Final value: fundamental + sum of harmonics (no normalization)
+    float val = fundamental_val + harmonics_sum;
+
+    // Apply amplitude scaling first
+    val *= amplitude;
+
+    // Apply output enable/disable scaling
+    val *= output_scale;
+
+    // Convert to 0-255 range
+    float dac_val = (val * 127.5f) + 127.5f;
+
+    // Clamp to DAC range (0-255)
+    if (dac_val > 255.0f) dac_val = 255.0f;
+    if (dac_val < 0.0f) dac_val = 0.0f;
+
+    return (uint8_t)dac_val;
+}
@@ -0,0 +1,53 @@
+// Portable DDS core: waveform table, step, phase offset and the per-sample DAC value
+// of one channel. No ESP-IDF dependencies, so the same code builds on the host
+// (tools/check_dds_model.py compiles it to check host/utils/dds_model.py against it).
+#ifndef DDS_CORE_H
+#define DDS_CORE_H
+
+#include <stdint.h>
+#include <math.h>
+
+// POSIX, not ISO C: a strict -std=c11 build does not define them
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#ifndef M_PI_2
+#define M_PI_2 1.57079632679489661923
+#endif
+
+#define DDS_TABLE_SIZE (1 << 16)
+#define DDS_PHASE_SCALE (int)(DDS_TABLE_SIZE / (2.0 * M_PI))
+
+// One harmonic of a channel; active when order is odd, >= 3 and percent > 0
+typedef struct {
+    int order;
+    float percent; // 0-1 (command value / 100)
+    float phase;   // radians
+    int phase_offset_int; // cached phase offset for DDS
+} dds_harmonic_t;
+
+// Fill the DDS_TABLE_SIZE / 4 entry quarter sine table (0-255, centered on 127.5)
+void dds_build_quarter_table(uint8_t *quarter_table);
+
+// Full-cycle table value at idx (any value, taken modulo DDS_TABLE_SIZE) by quarter-wave symmetry
+uint8_t dds_table_value(const uint8_t *quarter_table, uint32_t idx);
+
+// Accumulator step per tick for a frequency in Hz at a tick period in microseconds (truncated)
+uint32_t dds_compute_step(float frequency, float period_us);
+
+// Radians of a phase command in degrees (the float is promoted to double for the product)
+float dds_degrees_to_radians(float degrees);
+
+// Set a harmonic from its command values: odd order >= 3, percent 0-100, phase in degrees
+void dds_set_harmonic(volatile dds_harmonic_t *h, int order, float percent, float phase_deg);
+
+// Table offset of a phase in radians; negative phases wrap modulo 2^32 (and so modulo the table)
+uint32_t dds_compute_phase_offset(float phase);
+
+// DAC value for accumulator acc: fundamental plus harmonics, scaled by amplitude and the
+// output enable ramp, clamped to 0-255 and truncated
+uint8_t dds_sample(const uint8_t *quarter_table, uint32_t acc, uint32_t phase_offset,
+                   const volatile dds_harmonic_t *harmonics, int harmonic_count,
+                   float amplitude, float output_scale);
+
+#endif // DDS_CORE_H
@@ -10,31 +10,30 @@
 #include "driver/gpio.h"
 #include "esp_task_wdt.h"
 #include "driver/dac_oneshot.h"
+#include "dds_core.h"
 
 // Macros and Constants
-#define TABLE_SIZE (1 << 16)
+#define TABLE_SIZE DDS_TABLE_SIZE
 #define MIN_FREQ 20
 #define MAX_FREQ 8000
 #define UART_NUM UART_NUM_0
 #define UART_RX_BUF_SIZE 256
+#define CMD_BUF_SIZE 160   // Longest line is a whm multi-harmonic update
 #define SQUARE_WAVE_OUTPUT 18  // GPIO for square wave output
 #define SQUARE_WAVE_INPUT 19
 #define SQUARE_WAVE_HZ 50
 #define PERIOD_US 50         // period in microseconds for DDS output
 #define AMPL_RAMP_STEP 1e-3 // Adjust for ramp speed (smaller = slower)
 #define MAX_HARMONICS 8 // Maximum harmonics across both channels
-#define PHASE_SCALE (int)(TABLE_SIZE / (2.0 * M_PI))
-#define M_PI_180 (M_PI / 180.0f)
+#define PHASE_SCALE DDS_PHASE_SCALE
 
 // Per-channel harmonics (arrays for multiple harmonics)
-typedef struct {
-    int order;
-    float percent; // 0-100
-    float phase;   // radians
-    int phase_offset_int; // cached phase offset for DDS
-} harmonic_t;
+typedef dds_harmonic_t harmonic_t;
 
 static volatile harmonic_t harmonics[2][MAX_HARMONICS] = {{{0}}};
+// Guards every write to the harmonic tables; dds_output() copies them under it once per
+// tick, so a sample never mixes entries from before and after an update
+static portMUX_TYPE harmonics_mux = portMUX_INITIALIZER_UNLOCKED;
 
 // Static Variables
 static const char *TAG = "dac_oneshot_test";
@@ -56,6 +55,19 @@ static volatile int sqw_output_state = 0;
 static volatile int sqw_period_ticks = 0;
 static volatile bool sqw_initialized = false;
 
+// Staged frequency/phase changes (wsf/wsp) applied together by a commit (wcs/wcn), so
+// every synth of a rig can switch at the same sync edge. Guarded by commit_mux.
+#define STAGED_FREQ(ch) (1u << (ch))
+#define STAGED_PHASE(ch) (1u << (2 + (ch)))
+static float staged_freq[2] = {0, 0};
+static float staged_phase[2] = {0, 0}; // radians
+static uint32_t staged_mask = 0;
+static uint32_t armed_version = 0;
+static volatile bool commit_armed = false;      // apply at the next sync edge
+static volatile bool sync_edge_pending = false; // edge seen (or wcn) while armed: apply on the next DDS tick
+static volatile uint32_t commit_version = 0;    // version of the last applied commit
+static portMUX_TYPE commit_mux = portMUX_INITIALIZER_UNLOCKED;
+
 // High-resolution timer handle
 typedef struct {
     esp_timer_handle_t handle;
@@ -97,8 +109,8 @@ static gpio_config_t input_gpio_conf = {
 };
 
 // Function Declarations
-static void generate_waveform(int table_size);
 static void update_dds_step(int ch, float frequency, float period_us);
+static void apply_staged_commit(void);
 static void uart_cmd_task(void *arg);
 static void dds_output(void);
 static void dds_timer_callback(void* arg);
@@ -108,41 +120,32 @@ static void global_gpio_init(void);
 // static void resume_dds_timer(void);
 
 // Function Definitions
-static void generate_waveform(int table_size) {
-    int quarter = table_size / 4;
-    for (int i = 0; i < quarter; i++) {
-        float phase_val = (M_PI_2 * i) / (float)quarter; // 0 to pi/2
-        float val = sinf(phase_val);
-        uint8_t value = (uint8_t)((val * 127.5f) + 127.5f); // 0-255 range
-        waveform_quarter_table[i] = value;
-    }
-}
-// Helper to reconstruct full sine using quarter table and symmetry
-static uint8_t get_waveform_value(uint32_t idx) {
-    uint32_t quarter = TABLE_SIZE / 4;
-    idx = idx % TABLE_SIZE;
-    if (idx < quarter) {
-        // 0 to pi/2: +sin
-        return waveform_quarter_table[idx];
-    } else if (idx < 2 * quarter) {
-        // pi/2 to pi: +sin (mirrored, inverted)
-        return waveform_quarter_table[quarter - 1 - (idx - quarter)];
-    } else if (idx < 3 * quarter) {
-        // pi to 3pi/2: -sin
-        return 255 - waveform_quarter_table[idx - 2 * quarter];
-    } else {
-        // 3pi/2 to 2pi: -sin (mirrored, inverted)
-        return 255 - waveform_quarter_table[quarter - 1 - (idx - 3 * quarter)];
-    }
-}
-
 static void update_dds_step(int ch, float frequency, float period_us) {
-    dds_step[ch] = (TABLE_SIZE * frequency * period_us / 1000000);
-    dds_phase_offset[ch] = (uint32_t)(current_phase[ch] * PHASE_SCALE);
+    dds_step[ch] = dds_compute_step(frequency, period_us);
+    dds_phase_offset[ch] = dds_compute_phase_offset(current_phase[ch]);
     // ESP_LOGI(TAG, "DDS step and phase offset updated for channel %d: step %lu, phase offset %lu for frequency %.1f Hz", 
     //          ch, dds_step[ch], dds_phase_offset[ch], frequency);
 }
 
+// Apply the armed commit and realign both accumulators as a sync edge does. Runs in the
+// DDS timer task rather than the sync ISR, which must not use the FPU.
+static void apply_staged_commit(void) {
+    taskENTER_CRITICAL(&commit_mux);
+    if (commit_armed) {
+        for (int ch = 0; ch < 2; ++ch) {
+            if (staged_mask & STAGED_FREQ(ch)) current_freq[ch] = staged_freq[ch];
+            if (staged_mask & STAGED_PHASE(ch)) current_phase[ch] = staged_phase[ch];
+            update_dds_step(ch, current_freq[ch], PERIOD_US);
+            dds_acc[ch] = (dds_phase_offset[ch] + TABLE_SIZE / 4) % TABLE_SIZE;
+        }
+        staged_mask = 0;
+        commit_version = armed_version;
+        commit_armed = false;
+    }
+    sync_edge_pending = false;
+    taskEXIT_CRITICAL(&commit_mux);
+}
+
 static void uart_cmd_task(void *arg) {
     uart_config_t uart_config = {
         .baud_rate = 115200,
@@ -159,7 +162,7 @@ static void uart_cmd_task(void *arg) {
     uart_param_config(UART_NUM, &uart_config);
     uart_set_pin(UART_NUM, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
     // ESP_LOGI(TAG, "UART command task started. Type 'help' for usage.");
-    char cmd_buf[32];
+    char cmd_buf[CMD_BUF_SIZE];
     int cmd_pos = 0;
     while (1) {
         uint8_t ch;
@@ -204,7 +207,7 @@ static void uart_cmd_task(void *arg) {
                     }
                     if (phase < -360.0f) phase = -360.0f;
                     if (phase > 360.0f) phase = 360.0f;
-                    current_phase[ch_idx] = phase * M_PI_180;
+                    current_phase[ch_idx] = dds_degrees_to_radians(phase);
                     // ESP_LOGI(TAG, "UART: Set channel %c phase to %f degrees (%.2f radians)", ch_idx == 0 ? 'A' : 'B', phase, current_phase[ch_idx]);
                 
                 // Unified amplitude read command: raa / rab
@@ -243,13 +246,151 @@ static void uart_cmd_task(void *arg) {
                 } else if ((strncmp(cmd_buf, "whcl", 4) == 0 && cmd_buf[4] == 'a') ||
                            (strncmp(cmd_buf, "whcl", 4) == 0 && cmd_buf[4] == 'b')) {
                     int ch_idx = (cmd_buf[4] == 'a') ? 0 : 1;
+                    taskENTER_CRITICAL(&harmonics_mux);
                     for (int i = 0; i < MAX_HARMONICS; ++i) {
                         harmonics[ch_idx][i].order = 0;
                         harmonics[ch_idx][i].percent = 0.0f;
                         harmonics[ch_idx][i].phase = 0.0f;
                     }
+                    taskEXIT_CRITICAL(&harmonics_mux);
                     // ESP_LOGI(TAG, "UART: Cleared all harmonics for channel %c", ch_idx == 0 ? 'A' : 'B');
 
+                // Multi-harmonic write: whm<ch><n>,<percent>[,<phase_deg>];<ch>...;
+                // Every channel named in the line has its harmonics replaced as one
+                // transaction (a bare channel letter clears it); any invalid entry, or
+                // an order listed twice for one channel, rejects the whole line and
+                // leaves the running tables untouched.
+                } else if (strncmp(cmd_buf, "whm", 3) == 0) {
+                    harmonic_t staged[2][MAX_HARMONICS];
+                    int staged_count[2] = {0, 0};
+                    bool replace[2] = {false, false};
+                    bool valid = true;
+                    memset(staged, 0, sizeof(staged));
+                    char *seg = cmd_buf + 3;
+                    while (valid && *seg) {
+                        char *end = strchr(seg, ';');
+                        if (end) *end = '\0';
+                        if (*seg == 'a' || *seg == 'b') {
+                            int ch_idx = (*seg == 'a') ? 0 : 1;
+                            replace[ch_idx] = true;
+                            if (seg[1] != '\0') {
+                                char *comma = strchr(seg + 1, ',');
+                                int order = strtol(seg + 1, NULL, 10);
+                                float percent = comma ? strtof(comma + 1, NULL) : -1.0f;
+                                char *comma2 = comma ? strchr(comma + 1, ',') : NULL;
+                                float phase_deg = comma2 ? strtof(comma2 + 1, NULL) : 0.0f;
+                                if (!comma || order < 3 || (order % 2) == 0 || percent < 0.0f || percent > 100.0f) {
+                                    ESP_LOGW(TAG, "UART: Invalid whm entry '%s'", seg);
+                                    valid = false;
+                                } else {
+                                    // 0 % entries are staged too, so they take part in the duplicate check
+                                    for (int i = 0; i < staged_count[ch_idx]; ++i) {
+                                        if (staged[ch_idx][i].order == order) {
+                                            ESP_LOGW(TAG, "UART: Duplicate whm order %d for channel %c", order, *seg);
+                                            valid = false;
+                                            break;
+                                        }
+                                    }
+                                    if (!valid || staged_count[ch_idx] >= MAX_HARMONICS) {
+                                        valid = false;
+                                    } else {
+                                        dds_set_harmonic(&staged[ch_idx][staged_count[ch_idx]++], order, percent, phase_deg);
+                                    }
+                                }
+                            }
+                        } else if (*seg != '\0') {
+                            ESP_LOGW(TAG, "UART: Invalid whm channel in '%s'", seg);
+                            valid = false;
+                        }
+                        seg = end ? end + 1 : seg + strlen(seg);
+                    }
+                    if (valid) {
+                        // Channels not named in the line keep their harmonics and still count
+                        int total_harmonics = 0;
+                        for (int c = 0; c < 2; ++c) {
+                            if (replace[c]) {
+                                for (int i = 0; i < staged_count[c]; ++i) {
+                                    if (staged[c][i].percent > 0.0f) {
+                                        total_harmonics++;
+                                    }
+                                }
+                                continue;
+                            }
+                            for (int i = 0; i < MAX_HARMONICS; ++i) {
+                                if (harmonics[c][i].order >= 3 && harmonics[c][i].percent > 0.0f) {
+                                    total_harmonics++;
+                                }
+                            }
+                        }
+                        if (total_harmonics > MAX_HARMONICS) {
+                            valid = false;
+                        }
+                    }
+                    if (!valid) {
+                        ESP_LOGW(TAG, "UART: whm rejected (invalid entry or more than %d harmonics)", MAX_HARMONICS);
+                    } else {
+                        taskENTER_CRITICAL(&harmonics_mux);
+                        for (int c = 0; c < 2; ++c) {
+                            if (!replace[c]) continue;
+                            for (int i = 0; i < MAX_HARMONICS; ++i) {
+                                harmonics[c][i].order = staged[c][i].order;
+                                harmonics[c][i].percent = staged[c][i].percent;
+                                harmonics[c][i].phase = staged[c][i].phase;
+                                harmonics[c][i].phase_offset_int = staged[c][i].phase_offset_int;
+                            }
+                        }
+                        taskEXIT_CRITICAL(&harmonics_mux);
+                    }
+
+                // Staged writes: wsfa / wsfb <Hz>, wspa / wspb <deg>; held until a commit
+                } else if (strncmp(cmd_buf, "ws", 2) == 0 && (cmd_buf[2] == 'f' || cmd_buf[2] == 'p') &&
+                           (cmd_buf[3] == 'a' || cmd_buf[3] == 'b')) {
+                    int ch_idx = (cmd_buf[3] == 'a') ? 0 : 1;
+                    float value = strtof(cmd_buf + 4, NULL);
+                    if (commit_armed) {
+                        ESP_LOGW(TAG, "UART: Commit %lu pending, staged write rejected", (unsigned long)armed_version);
+                    } else if (cmd_buf[2] == 'f') {
+                        if (value >= MIN_FREQ && value <= MAX_FREQ) {
+                            taskENTER_CRITICAL(&commit_mux);
+                            staged_freq[ch_idx] = value;
+                            staged_mask |= STAGED_FREQ(ch_idx);
+                            taskEXIT_CRITICAL(&commit_mux);
+                        } else {
+                            ESP_LOGW(TAG, "UART: Invalid channel %c frequency: %.1f (Allowed: %d-%d)", ch_idx == 0 ? 'A' : 'B', value, MIN_FREQ, MAX_FREQ);
+                        }
+                    } else {
+                        if (value < -360.0f || value > 360.0f) {
+                            ESP_LOGW(TAG, "UART: Invalid channel %c phase: %f (Allowed: -360 to +360)", ch_idx == 0 ? 'A' : 'B', value);
+                        }
+                        if (value < -360.0f) value = -360.0f;
+                        if (value > 360.0f) value = 360.0f;
+                        taskENTER_CRITICAL(&commit_mux);
+                        staged_phase[ch_idx] = dds_degrees_to_radians(value);
+                        staged_mask |= STAGED_PHASE(ch_idx);
+                        taskEXIT_CRITICAL(&commit_mux);
+                    }
+
+                // Commit: wcs<version> applies the staged writes at the next sync edge,
+                // wcn<version> on the next DDS tick; wcx discards them
+                } else if (strncmp(cmd_buf, "wc", 2) == 0 && (cmd_buf[2] == 's' || cmd_buf[2] == 'n' || cmd_buf[2] == 'x')) {
+                    taskENTER_CRITICAL(&commit_mux);
+                    if (cmd_buf[2] == 'x') {
+                        staged_mask = 0;
+                        commit_armed = false;
+                    } else {
+                        armed_version = strtoul(cmd_buf + 3, NULL, 10);
+                        commit_armed = true;
+                        sync_edge_pending = (cmd_buf[2] == 'n');
+                    }
+                    taskEXIT_CRITICAL(&commit_mux);
+
+                // Commit read: rc (ex. response rc42,0 = commit 42 applied; state 1 = writes staged, 2 = commit armed)
+                } else if (strcmp(cmd_buf, "rc") == 0) {
+                    char response[32];
+                    int commit_state = commit_armed ? 2 : (staged_mask ? 1 : 0);
+                    snprintf(response, sizeof(response), "rc%lu,%d\r\n", (unsigned long)commit_version, commit_state);
+                    uart_write_bytes(UART_NUM, response, strlen(response));
+
                 // Unified harmonic read command: rha / rhb
                 } else if (strncmp(cmd_buf, "rh", 2) == 0 && (cmd_buf[2] == 'a' || cmd_buf[2] == 'b')) {
                     int ch_idx = (cmd_buf[2] == 'a') ? 0 : 1;
@@ -295,12 +436,11 @@ static void uart_cmd_task(void *arg) {
                                 }
                             }
                             // Add or update harmonic for this channel
+                            taskENTER_CRITICAL(&harmonics_mux);
                             int found = 0;
                             for (int i = 0; i < MAX_HARMONICS; ++i) {
                                 if (harmonics[ch_idx][i].order == order) {
-                                    harmonics[ch_idx][i].percent = percent / 100.0f;
-                                    harmonics[ch_idx][i].phase = phase_deg * M_PI_180;
-                                    harmonics[ch_idx][i].phase_offset_int = (int)(harmonics[ch_idx][i].phase * PHASE_SCALE);
+                                    dds_set_harmonic(&harmonics[ch_idx][i], order, percent, phase_deg);
                                     found = 1;
                                     break;
                                 }
@@ -309,18 +449,17 @@ static void uart_cmd_task(void *arg) {
                                 if (total_harmonics < MAX_HARMONICS) {
                                     for (int i = 0; i < MAX_HARMONICS; ++i) {
                                         if (harmonics[ch_idx][i].order == 0 || harmonics[ch_idx][i].percent == 0.0f) {
-                                            harmonics[ch_idx][i].order = order;
-                                            harmonics[ch_idx][i].percent = percent / 100.0f;
-                                            harmonics[ch_idx][i].phase = phase_deg * M_PI_180;
-                                            harmonics[ch_idx][i].phase_offset_int = (int)(harmonics[ch_idx][i].phase * PHASE_SCALE);
+                                            dds_set_harmonic(&harmonics[ch_idx][i], order, percent, phase_deg);
                                             found = 1;
                                             break;
                                         }
                                     }
-                                } else {
-                                    ESP_LOGW(TAG, "UART: Max harmonics reached globally");
                                 }
                             }
+                            taskEXIT_CRITICAL(&harmonics_mux);
+                            if (!found && percent > 0.0f) {
+                                ESP_LOGW(TAG, "UART: Max harmonics reached globally");
+                            }
                             // If percent is 0, the harmonic is disabled (kept in list but ignored)
                         }
                     } else {
@@ -336,8 +475,12 @@ static void uart_cmd_task(void *arg) {
                         "  n=odd harmonic (>=3), percent=0-100, phase_deg=deg (optional)\r\n"
                         "Special:\r\n"
                         "  whcl[a|b]   Clear all harmonics for A/B\r\n"
+                        "  whm<ch><n>,<percent>[,<phase_deg>];...  Replace harmonics of every listed channel at once\r\n"
                         "  ren[a|b]    Read output enable state for A/B (0=disabled, 1=enabled)\r\n"
                         "  wen[a|b][0|1] Write output enable state for A/B (0=disable, 1=enable)\r\n"
+                        "  wsf[a|b]<hz>, wsp[a|b]<deg>  Stage frequency/phase until a commit\r\n"
+                        "  wcs<ver>    Commit staged writes at the next sync edge (wcn<ver>: now, wcx: discard)\r\n"
+                        "  rc          Read last commit (ex. response rc42,0; state 1 = staged, 2 = armed)\r\n"
                         "  help        Show this help\r\n"
                         "\r\n"
                         "Examples:\r\n"
@@ -352,7 +495,8 @@ static void uart_cmd_task(void *arg) {
                         "  wenb1       Enable DAC output B\r\n"
                         "  rha         Read harmonics A (ex. response rha3,10.0,0.0;5,20.0,-90.0; = 3rd 10% 0 deg; 5th 20% -90 deg)\r\n"
                         "  wha3,10     Set 3rd harm A to 10%\r\n"
-                        "  whb5,5,-90  Set 5th harm B to 5%, -90 deg\r\n";
+                        "  whb5,5,-90  Set 5th harm B to 5%, -90 deg\r\n"
+                        "  whma3,10;a5,5,-90;b  A = 3rd 10% + 5th 5% -90 deg, B cleared\r\n";
 
                     uart_write_bytes(UART_NUM, help_msg, strlen(help_msg));
                 } else if (cmd_pos > 0) {
@@ -375,6 +519,11 @@ static void dds_output(void) {
         }
     }
 
+    // Armed commit whose edge arrived on the sync input (or wcn)
+    if (sync_edge_pending) {
+        apply_staged_commit();
+    }
+
     // --- Square wave generation using DDS timer ---
     if (!sqw_initialized) {
         // Calculate how many DDS timer periods per half square wave period using channel A frequency
@@ -393,7 +542,9 @@ static void dds_output(void) {
     if (sqw_acc >= sqw_period_ticks) {
         sqw_output_state = !sqw_output_state;
         gpio_set_level(SQUARE_WAVE_OUTPUT, sqw_output_state);
-        if (sqw_output_state == 1) {
+        if (sqw_output_state == 1 && commit_armed) {
+            apply_staged_commit(); // also realigns the accumulators
+        } else if (sqw_output_state == 1) {
             // Reset at waveform peak (quarter-cycle) to minimize glitch
             uint32_t peak_off = TABLE_SIZE / 4;
             dds_acc[0] = (dds_phase_offset[0] + peak_off) % TABLE_SIZE;
@@ -404,6 +555,19 @@ static void dds_output(void) {
     sqw_acc++;
     // --- End square wave generation ---
 
+    // One consistent copy of both harmonic tables for this tick (see harmonics_mux)
+    harmonic_t tick_harmonics[2][MAX_HARMONICS];
+    taskENTER_CRITICAL(&harmonics_mux);
+    for (int ch = 0; ch < 2; ++ch) {
+        for (int i = 0; i < MAX_HARMONICS; ++i) {
+            tick_harmonics[ch][i].order = harmonics[ch][i].order;
+            tick_harmonics[ch][i].percent = harmonics[ch][i].percent;
+            tick_harmonics[ch][i].phase = harmonics[ch][i].phase;
+            tick_harmonics[ch][i].phase_offset_int = harmonics[ch][i].phase_offset_int;
+        }
+    }
+    taskEXIT_CRITICAL(&harmonics_mux);
+
     uint8_t values[2];
     for (int ch = 0; ch < 2; ++ch) {
         // Amplitude ramping. If the current amplitude is significantly different from the target amplitude, adjust it gradually per tick
@@ -427,42 +591,8 @@ static void dds_output(void) {
             output_scale[ch] = target_scale;
         }
 
-        // Phase accumulator for this sample
-        uint32_t phase_acc = (dds_acc[ch] + (uint32_t)(current_phase[ch] * PHASE_SCALE)) % TABLE_SIZE;
-        // Use helper to get base waveform value
-        float fundamental_val = ((float)get_waveform_value(phase_acc) - 127.5f) / 127.5f; // -1.0 to 1.0
-        float harmonics_sum = 0.0f;
-
-        // Sum all harmonics
-        for (int i = 0; i < MAX_HARMONICS; ++i) {
-            if (harmonics[ch][i].order >= 3 && (harmonics[ch][i].order % 2) == 1 && harmonics[ch][i].percent > 0.0f) {
-                int harmonic_order_val = harmonics[ch][i].order;
-                int harmonic_phase_offset_int = harmonics[ch][i].phase_offset_int;
-                int harmonic_phase_acc_int = (harmonic_order_val * (int)phase_acc + harmonic_phase_offset_int) % TABLE_SIZE;
-                float harmonic_val = ((float)get_waveform_value(harmonic_phase_acc_int) - 127.5f) / 127.5f; // -1.0 to 1.0
-                float harmonic_scale = harmonics[ch][i].percent;
-                harmonics_sum += harmonic_val * harmonic_scale;
-            }
-        }
-
-        // Final value: fundamental + sum of harmonics (no normalization)
-        float val = fundamental_val + harmonics_sum;
-        
-        // Apply amplitude scaling first
-        val *= current_ampl[ch];
-        
-        // Apply output enable/disable scaling
-        val *= output_scale[ch];
-        
-        // Convert to 0-255 range
-        float dac_val = (val * 127.5f) + 127.5f;
-        
-        // Clamp to DAC range (0-255)
-        if (dac_val > 255.0f) dac_val = 255.0f;
-        if (dac_val < 0.0f) dac_val = 0.0f;
-        
-        uint8_t value = (uint8_t)dac_val;
-        values[ch] = value;
+        values[ch] = dds_sample(waveform_quarter_table, dds_acc[ch], dds_compute_phase_offset(current_phase[ch]),
+                                tick_harmonics[ch], MAX_HARMONICS, current_ampl[ch], output_scale[ch]);
     }
 
     // Output to DACs immediately one after the other
@@ -508,6 +638,10 @@ static void IRAM_ATTR sqw_isr_handler(void* arg) {
     uint32_t peak_off = TABLE_SIZE / 4;
     dds_acc[0] = (dds_phase_offset[0] + peak_off) % TABLE_SIZE;
     dds_acc[1] = (dds_phase_offset[1] + peak_off) % TABLE_SIZE;
+    // Staged changes are applied by the DDS task on its next tick (no FPU use in the ISR)
+    if (commit_armed) {
+        sync_edge_pending = true;
+    }
 }
 
 static void global_gpio_init(void) {
@@ -531,7 +665,7 @@ static void global_gpio_init(void) {
 // }
 
 void app_main(void) {
-    generate_waveform(TABLE_SIZE);
+    dds_build_quarter_table(waveform_quarter_table);
     update_dds_step(0, current_freq[0], PERIOD_US);
     update_dds_step(1, current_freq[1], PERIOD_US);
     
@@ -6,19 +6,64 @@ I2C rotary encoder amplitude control interface for the ESP32 DDS synthesizer.
 """
 
 import os
+import queue
 import time
 import threading
-import multiprocessing
+import subprocess
 from utils.logger_setup import setup_logger
 from utils.command_queue import process_command_queue
+from utils.rig_sync import RIG_CHANGES
 from utils.synth_poller import poll_synth_states
+from utils.metrics import (COMMAND_QUEUE_DEPTH, COMMAND_RING_BYTES, COMMAND_RING_REJECTED,
+                           MAIN_LOOP_ITERATION, RECONNECTS)
+from utils.command_journal import JOURNAL, recover_state_manager
+from utils.settings_service import SETTINGS
+from utils.startup import StartupPipeline, wait_for_listen
+from utils.batch import BatchResults
+from utils.history import HISTORY
+from utils.shared_memory import ChangeSignal, CommandRing, SeqlockBlock, shm_path
+from utils.shared_state import (COMMAND_RING_BYTES as RING_CAPACITY, STATE_BLOCK_BYTES, STATUS_BLOCK_BYTES,
+                                StatePublisher, decode_command, encode_command)
 from web_dashboard.web_server import create_app
-from synth_control import SynthStateManager, SystemInitializer, Encoder, EncoderManager
+from web_dashboard.web_process import web_process_command
+from synth_control import SynthStateManager, SystemInitializer, Encoder, EncoderManager, EncoderInputThread
 
 logger = setup_logger("DEBUG")
 
+HOST_DIR = os.path.dirname(os.path.abspath(__file__))
 STATE_FILE = os.path.join(os.path.dirname(__file__), 'config', 'synth_state.json')
 DEFAULTS_FILE = os.path.join(os.path.dirname(__file__), 'config', 'defaults.json')
+WEB_PORT = 5000
+# The dashboard runs in its own process by default; NHP_SINGLE_PROCESS=1 serves it from a thread here
+SINGLE_PROCESS = os.environ.get('NHP_SINGLE_PROCESS', '0') == '1'
+# Web commands handled per main loop pass, so a flood from the dashboard cannot delay encoder commands
+RING_COMMANDS_PER_PASS = 256
+# Results of /api/batch requests on their way back to the dashboard
+BATCH_RESULTS_BYTES = 1 << 16
+
+
+def start_encoder_input(encoder_objs, led_colors, state, synths, command_queue, animator=None):
+    """
+    Encoders are read on their own thread; their gestures are handled by control_pass()
+    and join the queue. Returns (EncoderManager, running EncoderInputThread).
+    """
+    encoder_manager = EncoderManager(encoder_objs, led_colors, state, 1, synths,
+                                     command_queue=command_queue, animator=animator)
+    return encoder_manager, EncoderInputThread(encoder_manager).start()
+
+
+def control_pass(encoder_manager, command_queue, synths, state, local_results=None, web_ring=None,
+                 results_ring=None):
+    """
+    One control loop pass up to the hardware poll: knob gestures are handled here, where
+    synth state is written, then the queued commands from the encoders and a bounded batch
+    from the dashboard are sent (process_command_queue also advances RIG_CHANGES).
+    """
+    encoder_manager.handle_events()
+    process_command_queue(command_queue, synths, state, batch_results=local_results)
+    if web_ring is not None:
+        process_command_queue(web_ring, synths, state, max_commands=RING_COMMANDS_PER_PASS,
+                              batch_results=results_ring)
 
 
 def main():
@@ -26,10 +71,66 @@ def main():
 
     # Instantiate SynthStateManager
     state = SynthStateManager(STATE_FILE, DEFAULTS_FILE)
+    journal_enabled = os.environ.get('NHP_JOURNAL', '1') != '0'
+    if journal_enabled:
+        recover_state_manager(state)
+
+    # Commands from the encoder thread (and the dashboard, in single-process mode)
+    command_queue = queue.Queue()
+    COMMAND_QUEUE_DEPTH.set_function(command_queue.qsize)
+
+    # Split mode: the dashboard process reads state from a shared block and sends commands through a ring;
+    # batch results go back through a second ring
+    web_ring = results_ring = state_block = status_block = state_signal = publisher = None
+    web_process = None
+    if not SINGLE_PROCESS:
+        state_block = SeqlockBlock.create('state', STATE_BLOCK_BYTES)
+        status_block = SeqlockBlock.create('status', STATUS_BLOCK_BYTES)
+        web_ring = CommandRing.create('commands', RING_CAPACITY, encode=encode_command, decode=decode_command)
+        results_ring = CommandRing.create('results', BATCH_RESULTS_BYTES, encode=encode_command, decode=decode_command)
+        COMMAND_RING_BYTES.set_function(web_ring.qsize)
+        COMMAND_RING_REJECTED.set_function(lambda: web_ring.rejected)
+        state_signal = ChangeSignal.notifier(shm_path('state_signal'))
+        publisher = StatePublisher(state, state_block, status_block, signal=state_signal).start()
+    # The history store is created once the synth count is known; the web process attaches when it appears
+    shared_paths = None if SINGLE_PROCESS else {
+        'state': state_block.path, 'state_signal': state_signal.path, 'status': status_block.path,
+        'commands': web_ring.path, 'results': results_ring.path, 'history': shm_path('history')}
+    local_results = queue.Queue()
+
+    def spawn_web_process():
+        # A fresh interpreter, so the web process can monkey-patch for its async server before any import
+        return subprocess.Popen(web_process_command(shared_paths, WEB_PORT), cwd=HOST_DIR)
+
+    def start_web_process(inputs):
+        nonlocal web_process
+        web_process = spawn_web_process()
+        if not wait_for_listen(WEB_PORT, timeout=30.0):
+            raise RuntimeError(f"dashboard process not accepting connections on port {WEB_PORT}")
+        logger.info(f"Dashboard web process {web_process.pid} started on port {WEB_PORT}.")
+        return web_process
+
+    def start_web_server(inputs):
+        # The dashboard only needs the queue and state, so it comes up alongside the hardware;
+        # commands sent before the synths are connected wait in the queue.
+        flask_app, socketio = create_app(command_queue, state,
+                                         batch_results=BatchResults(local_results).start(),
+                                         history=lambda: HISTORY if HISTORY.opened else None)
+        def run_socketio():
+            # Use threaded=True and allow_unsafe_werkzeug=True to prevent runtime error
+            socketio.run(flask_app, host='0.0.0.0', port=WEB_PORT, debug=False, use_reloader=False, allow_unsafe_werkzeug=True)
+        flask_thread = threading.Thread(target=run_socketio, daemon=True)
+        flask_thread.start()
+        if not wait_for_listen(WEB_PORT):
+            raise RuntimeError(f"dashboard server not accepting connections on port {WEB_PORT}")
+        logger.info(f"Flask-SocketIO dashboard server started on port {WEB_PORT}.")
+        return flask_thread
 
     try:
-        # Initialize the complete system (hardware only)
-        system = SystemInitializer.initialize_system(state)
+        # Initialize the hardware and the dashboard concurrently
+        pipeline = StartupPipeline().stage(
+            'web_server', start_web_server if SINGLE_PROCESS else start_web_process, critical=False)
+        system = SystemInitializer.initialize_system(state, pipeline)
 
         # Extract hardware device objects and info
         encoders = system['encoders']
@@ -37,34 +138,27 @@ def main():
         pixels = system['pixels']
         synths = system['synths']
         led_colors = system['led_colors']
+        led_animator = system['led_animator']
         num_synths = system['num_synths']
 
         # State management: load the state and assign synths
         state.num_synths = num_synths
-        state.save_state()
+        HISTORY.open(num_synths, path=None if SINGLE_PROCESS else shared_paths['history'])
+        state.request_save()
+        state.start_writer()
+        if journal_enabled:
+            JOURNAL.open(snapshot_fn=lambda: {'num_synths': state.num_synths, 'synths': state.synths})
 
         # Wrap hardware encoders and pixels in Encoder objects
         encoder_objs = {
             func: Encoder(encoders[func], buttons[func], pixels[func])
             for func in encoders
         }
-        encoder_manager = EncoderManager(encoder_objs, led_colors, state, 1, synths)
-
-        # Create a multiprocessing queue for commands
-        command_queue = multiprocessing.Queue()
 
-        # Start Flask-SocketIO app in a background thread
-        flask_app, socketio = create_app(command_queue, state)
-        def run_socketio():
-            # Use threaded=True and allow_unsafe_werkzeug=True to prevent runtime error
-            socketio.run(flask_app, host='0.0.0.0', port=5000, debug=False, use_reloader=False, allow_unsafe_werkzeug=True)
-        flask_thread = threading.Thread(target=run_socketio, daemon=True)
-        flask_thread.start()
-        logger.info("Flask-SocketIO dashboard server started on port 5000.")
+        encoder_manager, encoder_input = start_encoder_input(encoder_objs, led_colors, state, synths,
+                                                             command_queue, animator=led_animator)
 
         try:
-            last_save_time = time.time()
-            save_interval = 5.0  # seconds
             last_poll_time = time.time()
             poll_interval = 2.5  # seconds
             consecutive_full_poll_failures = 0
@@ -75,9 +169,9 @@ def main():
             last_reconnect_attempt = 0.0
             while True:
                 try:
-                    # Process queued commands from the dashboard
-                    process_command_queue(command_queue, synths, state)
-                    encoder_manager.update()
+                    iteration_started = time.perf_counter()
+                    control_pass(encoder_manager, command_queue, synths, state, local_results=local_results,
+                                 web_ring=web_ring, results_ring=results_ring)
 
                     # Reconcile in-memory state from real hardware so all clients stay in sync.
                     now = time.time()
@@ -107,17 +201,22 @@ def main():
                             )
                             and (now - last_reconnect_attempt) >= reconnect_cooldown_seconds
                         ):
-                            logger.warning(
+                            failed_ids = poll_result.get('failed_ids', [])
+                            # A degraded rig retries its offline slots quietly; a synth that just dropped out is news.
+                            already_offline = all(not synths[i].online for i in failed_ids)
+                            (logger.debug if already_offline else logger.warning)(
                                 "Detected sustained synth communication failure "
                                 f"(full={consecutive_full_poll_failures}, partial={consecutive_partial_poll_failures}, "
-                                f"failed_count={failed_count}/{total_count}). "
+                                f"failed={failed_ids} of {total_count}). "
                                 "Attempting automatic reconnect."
                             )
                             last_reconnect_attempt = now
                             try:
+                                # Only the failing slots are reopened; healthy synths keep running untouched.
                                 recovered_synths, recovered_endpoints = SystemInitializer.reconnect_synths(
                                     state,
                                     existing_synths=synths,
+                                    slots=failed_ids,
                                 )
                                 # Keep original list object so existing references stay valid.
                                 synths[:] = recovered_synths
@@ -125,24 +224,26 @@ def main():
                                 state.num_synths = len(synths)
                                 consecutive_full_poll_failures = 0
                                 consecutive_partial_poll_failures = 0
-                                logger.info(
-                                    "Automatic reconnect successful. "
-                                    f"Recovered {len(synths)} synth(s): "
-                                    f"{[ep.get('device_key') for ep in recovered_endpoints]}"
-                                )
+                                recovered = [i for i in failed_ids if i < len(synths) and synths[i].online]
+                                offline = [i for i, synth in enumerate(synths) if not synth.online]
+                                RECONNECTS.inc(result='success' if not offline else 'partial')
+                                if recovered or not already_offline:
+                                    logger.info(
+                                        f"Automatic reconnect: recovered synth(s) {recovered}, "
+                                        f"offline {offline}: "
+                                        f"{[ep.get('device_key') if ep else None for ep in recovered_endpoints]}"
+                                    )
                             except Exception as reconnect_error:
-                                logger.error(
-                                    "Automatic reconnect failed (strict synth count enforced): "
-                                    f"{reconnect_error}"
-                                )
+                                RECONNECTS.inc(result='failure')
+                                logger.error(f"Automatic reconnect failed: {reconnect_error}")
 
                         last_poll_time = now
 
-                    now = time.time()
-                    if now - last_save_time > save_interval:
-                        state.save_state()
-                        state.save_defaults()
-                        last_save_time = now
+                        if web_process is not None and web_process.poll() is not None:
+                            logger.warning(f"Dashboard web process exited (code {web_process.returncode}); restarting it")
+                            web_process = spawn_web_process()
+
+                    MAIN_LOOP_ITERATION.observe(time.perf_counter() - iteration_started)
                     time.sleep(0.01)  # Small delay to prevent excessive CPU usage
 
                 except KeyboardInterrupt:
@@ -151,19 +252,24 @@ def main():
 
             # Clean shutdown
             logger.info("Shutting down...")
+            encoder_input.stop()
+            encoder_manager.handle_events()
+            led_animator.stop()
             for i, synth in enumerate(synths):
                 if not state.synths[i]['auto_on']:
-                    command_queue.put({'synth_id': i, 'command': 'set_enabled', 'channel': 'a', 'value': False})
-                    command_queue.put({'synth_id': i, 'command': 'set_enabled', 'channel': 'b', 'value': False})
+                    command_queue.put({'synth_id': i, 'command': 'set_enabled', 'channel': 'a', 'value': False, 'source': 'system'})
+                    command_queue.put({'synth_id': i, 'command': 'set_enabled', 'channel': 'b', 'value': False, 'source': 'system'})
                     logger.info(f"Synth {i} output disable commands queued.")
             
-            # Process the shutdown commands
+            # Process the shutdown commands, and let a rig change still waiting for its edge settle
             process_command_queue(command_queue, synths, state)
+            RIG_CHANGES.finish()
 
         finally:
-            # Save final state before exiting
-            state.save_state()
-            state.save_defaults()
+            # Flush the command journal and any pending write-behind state before exiting
+            JOURNAL.close()
+            state.stop_writer()
+            SETTINGS.flush()
             logger.info(f"Final synth state and defaults saved to {STATE_FILE} and {DEFAULTS_FILE}")
             # Close all synthesizer connections
             for synth in synths:
@@ -171,11 +277,25 @@ def main():
                     synth.__exit__(None, None, None)  # Manually exit context manager
                 except:
                     pass
-            # No shutdown needed for Flask-SocketIO thread
+            # No shutdown needed for the Flask-SocketIO thread; a web process is stopped below
 
     except Exception as e:
         logger.error(f"Error: {e}")
 
+    finally:
+        if web_process is not None and web_process.poll() is None:
+            web_process.terminate()
+            try:
+                web_process.wait(timeout=2.0)
+            except subprocess.TimeoutExpired:
+                web_process.kill()
+        if publisher is not None:
+            publisher.stop()
+        for shared in (web_ring, results_ring, state_block, status_block, state_signal):
+            if shared is not None:
+                shared.close()
+        HISTORY.close()
+
     logger.info("Goodbye!")
 
 
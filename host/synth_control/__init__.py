@@ -8,12 +8,13 @@ dual-channel DDS synthesizer.
 __version__ = "1.0.0"
 __author__ = "Daniel Nathanson"
 
-from .synth_interface import SynthInterface
+from .synth_interface import SynthInterface, OfflineSynth
 from .waveform_generator import WaveformGenerator
 from .synth_state import SynthStateManager
 from .synth_discovery import SynthDiscovery
 from .system_initializer import SystemInitializer
 from .encoder_manager import EncoderManager
 from .encoder import Encoder
+from .encoder_input import EncoderInputThread
 
-__all__ = ['SynthInterface', 'WaveformGenerator', 'SynthStateManager', 'SynthDiscovery', 'SystemInitializer', 'EncoderManager', 'Encoder']
+__all__ = ['SynthInterface', 'OfflineSynth', 'WaveformGenerator', 'SynthStateManager', 'SynthDiscovery', 'SystemInitializer', 'EncoderManager', 'Encoder', 'EncoderInputThread']
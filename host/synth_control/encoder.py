@@ -2,6 +2,13 @@
 """
 Encoder abstraction for physical I2C rotary encoder with button and pixel LED.
 """
+import threading
+
+# Serialises seesaw transactions between the encoder input thread and the LED
+# animator: a seesaw read is a register write, a delay and a read, which must not
+# interleave with another transaction to the same board.
+I2C_LOCK = threading.RLock()
+
 
 class Encoder:
     def __init__(self, hardware_encoder, button=None, pixel=None):
@@ -12,6 +19,11 @@ class Encoder:
         self._encoder = hardware_encoder
         self._button = button
         self._pixel = pixel
+        # Direct seesaw access for read(): the board's delta register and a GPIO bulk
+        # read, instead of going through the position/DigitalIO properties.
+        self._seesaw = getattr(hardware_encoder, '_seesaw', None)
+        self._encoder_index = getattr(hardware_encoder, '_encoder', 0)
+        self._button_mask = 1 << getattr(button, '_pin', 24)
         self._last_position = self.position
         self._button_last = self.button_pressed
 
@@ -32,6 +44,37 @@ class Encoder:
     def button_pressed(self):
         return not self._button.value
 
+    def read(self):
+        """
+        Return (delta, button_pressed) for one poll.
+
+        On a seesaw board the delta register is read (and cleared by the read),
+        so ticks between polls accumulate on the board and are never lost; the
+        button comes from one GPIO bulk read. Other encoders use the properties.
+        """
+        if self._seesaw is None or self._button is None:
+            return self.delta, self.button_pressed
+        with I2C_LOCK:
+            # Negated like rotaryio.IncrementalEncoder.position, so both paths turn the same way
+            delta = -self._seesaw.encoder_delta(self._encoder_index)
+            pressed = not (self._seesaw.digital_read_bulk(self._button_mask) & self._button_mask)
+        return delta, pressed
+
+    def enable_interrupts(self):
+        """Raise the seesaw INT line on rotation and button changes. Returns False if unsupported."""
+        if self._seesaw is None or self._button is None:
+            return False
+        with I2C_LOCK:
+            self._seesaw.enable_encoder_interrupt(self._encoder_index)
+            self._seesaw.set_GPIO_interrupts(self._button_mask, True)
+        return True
+
+    def clear_interrupt(self):
+        """Acknowledge a GPIO interrupt (the encoder one is cleared by reading the delta)."""
+        if self._seesaw is not None and hasattr(self._seesaw, 'get_GPIO_interrupt_flag'):
+            with I2C_LOCK:
+                self._seesaw.get_GPIO_interrupt_flag()
+
     def button_was_pressed(self):
         """Return True if the button transitioned from not pressed to pressed since last check."""
         current = self.button_pressed
@@ -39,12 +82,19 @@ class Encoder:
         self._button_last = current
         return was_pressed
 
+    @property
+    def pixel(self):
+        """The pixel LED object (for LedAnimator), or None."""
+        return self._pixel
+
     def set_pixel(self, color):
         """Set the pixel LED to the given color (tuple of RGB)."""
         if self._pixel:
-            self._pixel.fill(color)
+            with I2C_LOCK:
+                self._pixel.fill(color)
 
     def clear_pixel(self):
         """Turn off the pixel LED."""
         if self._pixel:
-            self._pixel.fill((0, 0, 0))
+            with I2C_LOCK:
+                self._pixel.fill((0, 0, 0))
@@ -0,0 +1,122 @@
+"""
+Encoder input thread.
+
+Runs EncoderManager.read_inputs() off the main loop so a knob read never waits on
+serial I/O and serial work never delays a knob read. The thread only reads the
+boards, batches detents and times button holds; the main loop runs the handlers
+for the gestures (EncoderManager.handle_events()), so synth state is only written
+on the thread that also polls the synths and applies batches. The handlers turn
+gestures into command-queue entries (source 'encoder') that the same pass sends.
+
+With NHP_ENCODER_INT_GPIO set to the BCM pin wired to the seesaw INT outputs
+(open drain, shared by all boards), the thread sleeps until a board signals a
+change. Otherwise, or if lgpio is unavailable, it polls at a fixed rate. While
+a button is held or rotation detents are being batched it wakes at the poll
+rate so hold gestures and rotation windows time out.
+"""
+import logging
+import os
+import threading
+import time
+
+from utils.metrics import ENCODER_READ_DURATION
+
+try:
+    import lgpio
+except ImportError:  # not a Raspberry Pi, or lgpio not installed
+    lgpio = None
+
+logger = logging.getLogger("NHP_Synth")
+
+
+class EncoderInputThread:
+    def __init__(self, encoder_manager, poll_interval=0.01, int_gpio=None, idle_timeout=0.25):
+        """
+        :param encoder_manager: EncoderManager whose read_inputs() reads all encoders
+        :param poll_interval: seconds between reads when polling or while a button is held
+        :param int_gpio: BCM pin of the shared seesaw INT line (default: NHP_ENCODER_INT_GPIO)
+        :param idle_timeout: longest interrupt-mode sleep (safety net for a missed edge)
+        """
+        self.encoder_manager = encoder_manager
+        self.poll_interval = poll_interval
+        self.idle_timeout = idle_timeout
+        if int_gpio is None and os.environ.get('NHP_ENCODER_INT_GPIO'):
+            int_gpio = int(os.environ['NHP_ENCODER_INT_GPIO'])
+        self.int_gpio = int_gpio
+        self._wake = threading.Event()
+        self._stop = threading.Event()
+        self._thread = None
+        self._chip = None
+        self._callback = None
+
+    def start(self):
+        if self._thread is None:
+            self._setup_interrupt()
+            self._thread = threading.Thread(target=self._run, name="encoder-input", daemon=True)
+            self._thread.start()
+        return self
+
+    def stop(self):
+        self._stop.set()
+        self._wake.set()
+        if self._thread is not None:
+            self._thread.join(timeout=2.0)
+            self._thread = None
+        if self._callback is not None:
+            self._callback.cancel()
+            self._callback = None
+        if self._chip is not None:
+            lgpio.gpiochip_close(self._chip)
+            self._chip = None
+
+    @property
+    def interrupt_driven(self):
+        return self._chip is not None
+
+    def _setup_interrupt(self):
+        if self.int_gpio is None:
+            logger.info(f"Encoder input polling every {self.poll_interval * 1000:.0f} ms")
+            return
+        if lgpio is None:
+            logger.warning("NHP_ENCODER_INT_GPIO set but lgpio is not available; polling encoders instead")
+            return
+        try:
+            enabled = [encoder.enable_interrupts() for encoder in self.encoder_manager.encoders.values()]
+            if not all(enabled):
+                raise RuntimeError("not every encoder supports seesaw interrupts")
+            self._chip = lgpio.gpiochip_open(0)
+            lgpio.gpio_claim_alert(self._chip, self.int_gpio, lgpio.FALLING_EDGE, lgpio.SET_PULL_UP)
+            self._callback = lgpio.callback(self._chip, self.int_gpio, lgpio.FALLING_EDGE,
+                                            lambda chip, gpio, level, tick: self._wake.set())
+            logger.info(f"Encoder input waiting on seesaw INT (GPIO {self.int_gpio})")
+        except Exception as e:
+            logger.warning(f"Encoder interrupt setup failed ({e}); polling encoders instead")
+            if self._chip is not None:
+                lgpio.gpiochip_close(self._chip)
+                self._chip = None
+
+    def _interrupt_asserted(self):
+        return lgpio.gpio_read(self._chip, self.int_gpio) == 0
+
+    def _run(self):
+        manager = self.encoder_manager
+        while not self._stop.is_set():
+            started = time.perf_counter()
+            try:
+                if self.interrupt_driven:
+                    for encoder in manager.encoders.values():
+                        encoder.clear_interrupt()
+                manager.read_inputs()
+            except Exception as e:
+                logger.error(f"Encoder input failed: {e}")
+                self._stop.wait(1.0)
+            ENCODER_READ_DURATION.observe(time.perf_counter() - started)
+
+            if not self.interrupt_driven:
+                self._stop.wait(max(0.0, self.poll_interval - (time.perf_counter() - started)))
+            elif manager.any_button_held() or manager.has_pending_rotation() or self._interrupt_asserted():
+                # A hold or rotation window is being timed, or a board changed again while we were reading
+                self._stop.wait(self.poll_interval)
+            else:
+                self._wake.wait(self.idle_timeout)
+                self._wake.clear()
@@ -1,20 +1,43 @@
 """
 EncoderManager using Encoder abstraction.
 Handles button press, hold, release, rotation, and LED logic for each encoder.
+
+read_inputs() only reads the encoders, times rotation windows and button holds and
+drives the hold LEDs; the gestures it recognises are queued. handle_events() runs
+the handlers for them, which read and write synth state, so it belongs on the thread
+that owns the state (the main loop). update() does both, for single-threaded callers.
 """
 import time
 import logging
+from collections import deque
+from .led_animator import LedAnimator
+from utils.rig_sync import apply_rig_change
 
 logger = logging.getLogger("NHP_Synth")
 
+# Rotation batching: detents are summed over ROTATION_WINDOW seconds and handled as
+# one step, so a fast spin costs one update per affected parameter per window. The
+# step is scaled up with spin speed: (minimum detents per second, multiplier). Speed
+# is the detent count over the last VELOCITY_SPAN seconds, several windows long, so
+# a detent landing early or late in a window does not change it. Turning one detent
+# per window is 1 / ROTATION_WINDOW = 20/s and stays well below the first threshold.
+ROTATION_WINDOW = 0.05
+VELOCITY_SPAN = 0.25
+VELOCITY_STEPS = ((100.0, 5), (50.0, 2))
+
+
 class EncoderManager:
-    def __init__(self, encoders, led_colors, state=None, hold_threshold=1.0, synth_interface=None):
+    def __init__(self, encoders, led_colors, state=None, hold_threshold=1.0, synth_interface=None,
+                 command_queue=None, animator=None):
         """
         :param encoders: dict mapping function names to Encoder instances
         :param led_colors: dict mapping function names to default LED colors (RGB tuples)
         :param hold_threshold: seconds to consider a button as held
         :param state: SynthStateManager instance to access synth state
         :param synth_interface: SynthInterface instance to control synths
+        :param command_queue: if given, synth commands are queued (source 'encoder') for the
+                              main loop instead of being sent from the calling thread
+        :param animator: LedAnimator driving the encoder pixels (one is created if omitted)
         """
         self.encoders = encoders
         self.led_colors = led_colors
@@ -22,19 +45,35 @@ class EncoderManager:
         self.long_hold_threshold = 3.0  # 3.0s for reset to defaults
         self.state = state
         self.synth_interface = synth_interface
+        self.command_queue = command_queue
         self.button_hold_time = {k: None for k in encoders}
+        self.rotation_window = ROTATION_WINDOW
+        self._pending_delta = {k: 0 for k in encoders}
+        self._pending_since = {k: None for k in encoders}
+        self._detent_times = {k: deque() for k in encoders}  # (time, detents) over VELOCITY_SPAN
         self.was_short_held = {k: False for k in encoders}
         self.was_long_held = {k: False for k in encoders}
         self.selection_mode = {k: {'synth': 'all', 'ch': 'all'} for k in encoders}
         self.state.selection_mode = self.selection_mode  # Share selection mode with state manager
         self.selection_mode_last_changed = {k: time.time() for k in encoders}  # Track last change time for each func
-        # LED flashing for hold indication
-        self.flash_state = {k: False for k in encoders}  # Track LED on/off state during flashing
-        self.last_flash_time = {k: 0 for k in encoders}  # Track last flash toggle time
+        self._events = deque()  # (gesture, func, step) from read_inputs(), for handle_events()
+        # LED feedback runs on the animator's own timer, so it never blocks input handling
+        self.animator = animator or LedAnimator({k: e.pixel for k, e in encoders.items()}).start()
+        for func in encoders:
+            if func in led_colors:
+                self.animator.set_base(func, led_colors[func])
 
     # --- Public interface ---
     def update(self):
-        """Call this in your main loop to process all encoders and handle selection_mode timeout."""
+        """Read all encoders once and handle what they did on the calling thread."""
+        self.read_inputs()
+        self.handle_events()
+
+    def handle_events(self):
+        """
+        Run the handlers for the gestures read_inputs() queued and apply the selection_mode
+        timeout. Call from the thread that owns the synth state. Returns the gestures handled.
+        """
         now = time.time()
         # Timeout logic for selection_mode
         for func in self.selection_mode:
@@ -43,48 +82,108 @@ class EncoderManager:
                 if self.selection_mode[func] != {'synth': 'all', 'ch': 'all'}:
                     self.selection_mode[func] = {'synth': 'all', 'ch': 'all'}
                     self.selection_mode_last_changed[func] = now
+                    self.state.mark_selection_changed()
                     logger.info(f"Selection mode for {func} timed out, reverted to all/all")
+        handlers = {
+            'rotate': self.on_rotate,
+            'press': lambda func, _: self.on_press(func),
+            'short_hold': lambda func, _: self.on_release_after_short_hold(func),
+            'long_hold': lambda func, _: self.on_release_after_long_hold(func),
+        }
+        handled = 0
+        while self._events:
+            gesture, func, step = self._events.popleft()
+            try:
+                handlers[gesture](func, step)
+            except Exception as e:
+                logger.error(f"Encoder {func} {gesture} failed: {e}")
+            handled += 1
+        return handled
+
+    def read_inputs(self):
+        """Read all encoders once and queue the gestures they complete (see EncoderInputThread)."""
+        now = time.time()
         for func, encoder in self.encoders.items():
-            # Handle rotation
-            delta = encoder.delta
+            delta, pressed = encoder.read()
+            # Handle rotation: accumulate detents, apply once per window
             if delta != 0:
-                self.on_rotate(func, delta)
+                if self._pending_since[func] is None:
+                    self._pending_since[func] = now
+                self._pending_delta[func] += delta
+                self._detent_times[func].append((now, abs(delta)))
+            since = self._pending_since[func]
+            if since is not None and now - since >= self.rotation_window:
+                self._flush_rotation(func, now)
                 
-            if encoder.button_pressed:
+            if pressed:
                 if self.button_hold_time[func] is None:
                     self.button_hold_time[func] = now
                     self.was_short_held[func] = False
                     self.was_long_held[func] = False
-                    self.flash_state[func] = False
-                    self.last_flash_time[func] = now
                 elif not self.was_short_held[func] and now - self.button_hold_time[func] > self.short_hold_threshold:
                     self.was_short_held[func] = True
-                    # Start slow flashing for short hold indication
-                    self._handle_led_flashing(func, now, flash_interval=0.1)
+                    # Slow flashing in the function color for short hold indication
+                    self.animator.blink(func, self.led_colors[func], interval=0.1)
                 elif not self.was_long_held[func] and now - self.button_hold_time[func] > self.long_hold_threshold:
                     self.was_long_held[func] = True
-                    # Start fast flashing for long hold indication
-                    self._handle_led_flashing(func, now, flash_interval=0.01)
-                else:
-                    # Handle flashing during hold periods
-                    if self.was_long_held[func]:
-                        self._handle_led_flashing(func, now, flash_interval=0.01)  # Fast flash
-                    elif self.was_short_held[func]:
-                        self._handle_led_flashing(func, now, flash_interval=0.1)  # Slow flash
+                    # Fast white flashing for long hold indication
+                    self.animator.blink(func, (255, 255, 255), interval=0.04)
             else:
                 if self.button_hold_time[func] is not None:
                     if self.was_long_held[func]:
-                        self.on_release_after_long_hold(func)
+                        self._events.append(('long_hold', func, None))
                     elif self.was_short_held[func]:
-                        self.on_release_after_short_hold(func)
+                        self._events.append(('short_hold', func, None))
                     else:
-                        self.on_press(func)
+                        self._events.append(('press', func, None))
                     # Reset button state and LED
                     self.button_hold_time[func] = None
                     self.was_short_held[func] = False
                     self.was_long_held[func] = False
-                    self.flash_state[func] = False
-                    self.encoders[func].set_pixel(self.led_colors[func])
+                    self.animator.clear_effect(func)
+
+    def any_button_held(self):
+        return any(t is not None for t in self.button_hold_time.values())
+
+    def has_pending_rotation(self):
+        return any(t is not None for t in self._pending_since.values())
+
+    def _flush_rotation(self, func, now):
+        detents = self._pending_delta[func]
+        self._pending_delta[func] = 0
+        self._pending_since[func] = None
+        history = self._detent_times[func]
+        while history and history[0][0] <= now - VELOCITY_SPAN:
+            history.popleft()
+        if detents == 0:
+            return
+        rate = sum(count for _, count in history) / VELOCITY_SPAN
+        multiplier = next((m for threshold, m in VELOCITY_STEPS if rate >= threshold), 1)
+        logger.debug(f"{func}: {detents} detent(s), {rate:.0f}/s over {VELOCITY_SPAN * 1000:.0f} ms -> step {detents * multiplier}")
+        self._events.append(('rotate', func, detents * multiplier))
+
+    def _send(self, synth_id, command, channel, value):
+        """Queue a synth command for the main loop, or send it directly without a queue."""
+        if self.command_queue is not None:
+            self.command_queue.put({'synth_id': synth_id, 'command': command, 'channel': channel,
+                                    'value': value, 'source': 'encoder'})
+        elif command == 'set_harmonics_multi':
+            self.synth_interface[synth_id].set_harmonics_multi(value)
+        elif command == 'rig_apply':
+            apply_rig_change(value, self.synth_interface, self.state)
+        else:
+            getattr(self.synth_interface[synth_id], command)(channel, value)
+
+    def _send_harmonics(self, synth_id, channels):
+        """Send the active harmonics of `channels` (from state) as one replace per synth."""
+        synth = self.state.synths[synth_id]
+        value = {
+            ch: [{'order': h.get('order'), 'amplitude': h.get('amplitude'), 'phase': h.get('phase', 0)}
+                 for h in synth.get(f'harmonics_{ch}', [])
+                 if (h.get('order') or 0) >= 3 and (h.get('amplitude') or 0) > 0]
+            for ch in channels
+        }
+        self._send(synth_id, 'set_harmonics_multi', None, value)
 
     def on_rotate(self, func, delta):
         """Handle rotation for each encoder based on its own selection_mode and func. Reset inactivity timer."""
@@ -104,9 +203,7 @@ class EncoderManager:
         """Handle short button press for each encoder: cycle selection modes for that encoder only."""
         logger.info(f"{func}: Button pressed (cycle selection mode)")
         self.selection_mode_last_changed[func] = time.time()  # Update last changed time
-        self.encoders[func].set_pixel((0, 0, 255))
-        time.sleep(0.1)
-        self.encoders[func].set_pixel(self.led_colors[func])
+        self.animator.flash(func, (0, 0, 255), duration=0.1)
 
         num_synths = self.state.num_synths
         channels = ['a', 'b']
@@ -139,6 +236,7 @@ class EncoderManager:
             current_index = 0
         next_index = (current_index + 1) % len(selection_modes)
         self.selection_mode[func] = selection_modes[next_index]
+        self.state.mark_selection_changed()
         logger.info(f"Selection mode for {func} changed to Synth {self.selection_mode[func]['synth']}, Channel {self.selection_mode[func]['ch']}")
 
     def _toggle_channel_enabled(self, channel, func):
@@ -151,16 +249,16 @@ class EncoderManager:
             for i in range(self.state.num_synths):
                 current_state = self.state.synths[i]['enabled'][channel]
                 new_state = not current_state
-                self.state.synths[i]['enabled'][channel] = new_state
-                self.synth_interface[i].set_enabled(channel, new_state)
+                self.state.set_enabled(i, channel, new_state)
+                self._send(i, 'set_enabled', channel, new_state)
                 logger.info(f"Synth {i} channel {channel}: {current_state} -> {new_state}")
         else:
             # Toggle specific synth for this channel
             synth_id = mode['synth']
             current_state = self.state.synths[synth_id]['enabled'][channel]
             new_state = not current_state
-            self.state.synths[synth_id]['enabled'][channel] = new_state
-            self.synth_interface[synth_id].set_enabled(channel, new_state)
+            self.state.set_enabled(synth_id, channel, new_state)
+            self._send(synth_id, 'set_enabled', channel, new_state)
             logger.info(f"Synth {synth_id} channel {channel}: {current_state} -> {new_state}")
 
     def on_release_after_short_hold(self, func):
@@ -184,37 +282,34 @@ class EncoderManager:
         mode = self.selection_mode.get(func, {'synth': 'all', 'ch': 'all'})
         defaults = self.state.defaults
         synths = self.state.synths
-        synth_interface = self.synth_interface
 
         # Helper to send command for a synth/channel (existing reset logic)
         def send_default(synth_id, channel):
             if func == 'voltage':
                 value = defaults[synth_id]['amplitude_a']
-                synths[synth_id]['amplitude_a'] = value
-                synth_interface[synth_id].set_amplitude('a', value)
+                self.state.set_value(synth_id, 'amplitude_a', value)
+                self._send(synth_id, 'set_amplitude', 'a', value)
             elif func == 'current':
                 value = defaults[synth_id]['amplitude_b']
-                synths[synth_id]['amplitude_b'] = value
-                synth_interface[synth_id].set_amplitude('b', value)
+                self.state.set_value(synth_id, 'amplitude_b', value)
+                self._send(synth_id, 'set_amplitude', 'b', value)
             elif func == 'phase':
                 channels = ['a', 'b'] if channel == 'all' else [channel]
                 for ch in channels:
                     phase_key = f'phase_{ch}'
                     value = defaults[synth_id][phase_key]
-                    synths[synth_id][phase_key] = value
-                    synth_interface[synth_id].set_phase(ch, value)
+                    self.state.set_value(synth_id, phase_key, value)
+                    self._send(synth_id, 'set_phase', ch, value)
             elif func == 'frequency':
                 for ch in ['a', 'b']:
                     freq_key = f'frequency_{ch}'
                     value = defaults[synth_id][freq_key]
-                    synths[synth_id][freq_key] = value
-                    synth_interface[synth_id].set_frequency(ch, value)
+                    self.state.set_value(synth_id, freq_key, value)
+                    self._send(synth_id, 'set_frequency', ch, value)
             elif func == 'harmonics':
                 harmonics_channels = ['a', 'b'] if channel == 'all' else [channel]
 
                 for ch in harmonics_channels:
-                    synth_interface[synth_id].clear_harmonics(ch)
-
                     harmonics_key = f'harmonics_{ch}'
                     default_harmonics = defaults[synth_id].get(harmonics_key, [])
                     synth_harmonics = synths[synth_id].get(harmonics_key, [])
@@ -239,19 +334,16 @@ class EncoderManager:
                         synth_harmonics[j]['amplitude'] = amp
                         synth_harmonics[j]['order'] = order
                         synth_harmonics[j]['phase'] = phase
-                        value = {'order': order, 'amplitude': amp, 'phase': phase}
-                        synth_interface[synth_id].set_harmonics(ch, value)
                     # Set extra harmonics (not in defaults) to amplitude 0
                     extra_count = len(synth_harmonics) - len(default_harmonics)
                     for j in range(len(default_harmonics), len(synth_harmonics)):
                         synth_harmonics[j]['amplitude'] = 0
-                        order = synth_harmonics[j].get('order', 0)
-                        phase = synth_harmonics[j].get('phase', 0)
-                        value = {'order': order, 'amplitude': 0, 'phase': phase}
-                        synth_interface[synth_id].set_harmonics(ch, value)
                     # Remove extra harmonics from state
                     if extra_count > 0:
                         del synth_harmonics[len(default_harmonics):]
+                    self.state.mark_changed(synth_id, harmonics_key)
+                # Clear and re-set the channels on the synth in one replace
+                self._send_harmonics(synth_id, harmonics_channels)
 
         # Determine which synths/channels to send (existing logic)
         if mode['synth'] == 'all':
@@ -278,82 +370,66 @@ class EncoderManager:
         # LED color is already restored in the main update method
 
     def set_led(self, func, color):
-        self.encoders[func].set_pixel(color)
+        self.animator.set_base(func, color)
 
     def clear_led(self, func):
-        self.encoders[func].clear_pixel()
-
-    def _handle_led_flashing(self, func, current_time, flash_interval):
-        """Handle LED flashing during button hold periods."""
-        if current_time - self.last_flash_time[func] >= flash_interval:
-            self.flash_state[func] = not self.flash_state[func]
-            self.last_flash_time[func] = current_time
-            
-            if self.flash_state[func]:
-                # LED on - show hold indication color
-                if self.was_long_held[func]:
-                    self.encoders[func].set_pixel((255, 255, 255))  # White for long hold
-                elif self.was_short_held[func]:
-                    self.encoders[func].set_pixel(self.led_colors[func])  # func is the color for short hold
-            else:
-                # LED off - turn off during flash
-                self.encoders[func].clear_pixel()
+        self.animator.set_base(func, (0, 0, 0))
 
     # --- Internal handler methods ---
     def _handle_voltage(self, delta, mode):
         if mode['synth'] == 'all':
-            logger.info(f"[ALL][voltage] Rotated {delta} (adjust voltage placeholder)")
+            logger.debug(f"[ALL][voltage] Rotated {delta} (adjust voltage placeholder)")
             # Calculate new voltages first, but check for out-of-bounds
             would_exceed = any((self.state.synths[i]['amplitude_a'] + delta) < 0 or (self.state.synths[i]['amplitude_a'] + delta) > 100 for i in range(self.state.num_synths))
             if would_exceed:
-                logger.info("At least one synth would exceed voltage bounds, skipping command.")
+                logger.debug("At least one synth would exceed voltage bounds, skipping command.")
                 return
             for i in range(self.state.num_synths):
                 old_voltage = self.state.synths[i]['amplitude_a']
                 new_voltage = round(max(0, min(100, old_voltage + delta)), 2)
-                self.state.synths[i]['amplitude_a'] = new_voltage
+                self.state.set_value(i, 'amplitude_a', new_voltage)
                 if old_voltage != new_voltage:
-                    self.synth_interface[i].set_amplitude('a', new_voltage)
+                    self._send(i, 'set_amplitude', 'a', new_voltage)
         else:
-            logger.info(f"[{mode}][voltage] Rotated {delta} (adjust voltage placeholder)")
+            logger.debug(f"[{mode}][voltage] Rotated {delta} (adjust voltage placeholder)")
             synth_id = mode['synth']
             channel = mode['ch']
             old_voltage = self.state.synths[synth_id]['amplitude_a']
             new_voltage = round(max(0, min(100, old_voltage + delta)), 2)
-            self.state.synths[synth_id]['amplitude_a'] = new_voltage
+            self.state.set_value(synth_id, 'amplitude_a', new_voltage)
             if old_voltage != new_voltage:
-                self.synth_interface[synth_id].set_amplitude(channel, new_voltage)
+                self._send(synth_id, 'set_amplitude', channel, new_voltage)
             
 
     def _handle_current(self, delta, mode):
         if mode['synth'] == 'all':
-            logger.info(f"[ALL][current] Rotated {delta} (adjust current placeholder)")
+            logger.debug(f"[ALL][current] Rotated {delta} (adjust current placeholder)")
             # Check if any synth would exceed bounds for channel b
             would_exceed = any((self.state.synths[i]['amplitude_b'] + delta) < 0 or (self.state.synths[i]['amplitude_b'] + delta) > 100 for i in range(self.state.num_synths))
             if would_exceed:
-                logger.info("At least one synth would exceed current bounds, skipping command.")
+                logger.debug("At least one synth would exceed current bounds, skipping command.")
                 return
             for i in range(self.state.num_synths):
                 old_current = self.state.synths[i]['amplitude_b']
                 new_current = round(max(0, min(100, old_current + delta)), 2)
-                self.state.synths[i]['amplitude_b'] = new_current
+                self.state.set_value(i, 'amplitude_b', new_current)
                 if old_current != new_current:
-                    self.synth_interface[i].set_amplitude('b', new_current)
+                    self._send(i, 'set_amplitude', 'b', new_current)
         else:
-            logger.info(f"[{mode}][current] Rotated {delta} (adjust current placeholder)")
+            logger.debug(f"[{mode}][current] Rotated {delta} (adjust current placeholder)")
             synth_id = mode['synth']
             channel = mode['ch']
             old_current = self.state.synths[synth_id]['amplitude_b']
             new_current = round(max(0, min(100, old_current + delta)), 2)
-            self.state.synths[synth_id]['amplitude_b'] = new_current
+            self.state.set_value(synth_id, 'amplitude_b', new_current)
             if old_current != new_current:
-                self.synth_interface[synth_id].set_amplitude(channel, new_current)
+                self._send(synth_id, 'set_amplitude', channel, new_current)
 
     def _handle_phase(self, delta, mode):
         channel = mode['ch']
         phase_key = f'phase_{channel}'
         if mode['synth'] == 'all':
-            logger.info(f"[ALL][phase] Rotated {delta} (adjust phase placeholder)")
+            logger.debug(f"[ALL][phase] Rotated {delta} (adjust phase placeholder)")
 
             for i in range(self.state.num_synths):
                 old_phase = self.state.synths[i]['phase_b']
@@ -365,11 +441,11 @@ class EncoderManager:
                     new_phase = -180 + (new_phase - 180)
                 # Clamp to -180/+180 if slightly over due to floating point
                 new_phase = round(max(-180, min(180, new_phase)), 2)
-                self.state.synths[i]['phase_b'] = new_phase
+                self.state.set_value(i, 'phase_b', new_phase)
                 if old_phase != new_phase:
-                    self.synth_interface[i].set_phase('b', new_phase)
+                    self._send(i, 'set_phase', 'b', new_phase)
         else:
-            logger.info(f"[{mode}][phase] Rotated {delta} (adjust phase placeholder)")
+            logger.debug(f"[{mode}][phase] Rotated {delta} (adjust phase placeholder)")
             synth_id = mode['synth']
             old_phase = self.state.synths[synth_id][phase_key]
             new_phase = old_phase + delta
@@ -380,12 +456,12 @@ class EncoderManager:
                 new_phase = -180 + (new_phase - 180)
             # Clamp to -180/+180 if slightly over due to floating point
             new_phase = round(max(-180, min(180, new_phase)), 2)
-            self.state.synths[synth_id][phase_key] = new_phase
+            self.state.set_value(synth_id, phase_key, new_phase)
             if old_phase != new_phase:
-                self.synth_interface[synth_id].set_phase(channel, new_phase)
+                self._send(synth_id, 'set_phase', channel, new_phase)
 
     def _handle_frequency(self, delta, mode):
-        logger.info(f"[ALL][frequency] Rotated {delta} (adjust frequency for all synths/channels)")
+        logger.debug(f"[ALL][frequency] Rotated {delta} (adjust frequency for all synths/channels)")
         # Check if any synth/channel would exceed frequency bounds
         would_exceed = any(
             (self.state.synths[i]['frequency_a'] + delta) < 20 or (self.state.synths[i]['frequency_a'] + delta) > 70 or
@@ -393,16 +469,20 @@ class EncoderManager:
             for i in range(self.state.num_synths)
         )
         if would_exceed:
-            logger.info("At least one synth/channel would exceed frequency bounds, skipping command.")
+            logger.debug("At least one synth/channel would exceed frequency bounds, skipping command.")
             return
+        changes = []
         for i in range(self.state.num_synths):
             for ch in ['a', 'b']:
                 freq_key = f'frequency_{ch}'
                 old_freq = self.state.synths[i][freq_key]
                 new_freq = round(max(20, min(70, old_freq + delta)), 2)
-                self.state.synths[i][freq_key] = new_freq
+                self.state.set_value(i, freq_key, new_freq)
                 if old_freq != new_freq:
-                    self.synth_interface[i].set_frequency(ch, new_freq)
+                    changes.append({'synth_id': i, 'channel': ch, 'frequency': new_freq})
+        if changes:
+            # One rig-wide commit at the sync edge keeps L1/L2/L3 phase-coherent
+            self._send(None, 'rig_apply', None, changes)
 
     def _handle_harmonics(self, delta, mode):
         channels = ['a', 'b'] if mode['ch'] == 'all' else [mode['ch']]
@@ -411,7 +491,7 @@ class EncoderManager:
             # Check bounds for all synths
             for ch in channels:
                 harmonics_key = f'harmonics_{ch}'
-                logger.info(f"[{mode}][harmonics] Rotated {delta} (adjust harmonics for channel {ch})")
+                logger.debug(f"[{mode}][harmonics] Rotated {delta} (adjust harmonics for channel {ch})")
                 would_exceed = any(
                     (self.state.synths[i][harmonics_key][j]['amplitude'] + delta) < 0 or
                     (self.state.synths[i][harmonics_key][j]['amplitude'] + delta) > 100
@@ -419,9 +499,10 @@ class EncoderManager:
                     for j in range(len(self.state.synths[i][harmonics_key]))
                 )
                 if would_exceed:
-                    logger.info("At least one synth/channel would exceed harmonics bounds, skipping command.")
+                    logger.debug("At least one synth/channel would exceed harmonics bounds, skipping command.")
                     return
             for i in range(self.state.num_synths):
+                changed_channels = []
                 for ch in channels:
                     harmonics_key = f'harmonics_{ch}'
                     for j in range(len(self.state.synths[i][harmonics_key])):
@@ -436,23 +517,28 @@ class EncoderManager:
                             'phase': round(harmonic.get('phase', 0), 2)
                         }
                         if old_amp != new_amp:
-                            self.synth_interface[i].set_harmonics(ch, value)
-                            logger.info(f"Updated harmonics for synth {i}, channel {ch}, id {value['id']} order {value['order']} to amplitude {new_amp}")
-            logger.info(f"Applied harmonics changes for all synths on channel(s) {channels}")
+                            self.state.mark_changed(i, harmonics_key)
+                            if ch not in changed_channels:
+                                changed_channels.append(ch)
+                            logger.debug(f"Updated harmonics for synth {i}, channel {ch}, id {value['id']} order {value['order']} to amplitude {new_amp}")
+                if changed_channels:
+                    self._send_harmonics(i, changed_channels)
+            logger.debug(f"Applied harmonics changes for all synths on channel(s) {channels}")
         else:
             # Only update the selected synth
             synth_id = mode['synth']
             for ch in channels:
                 harmonics_key = f'harmonics_{ch}'
-                logger.info(f"[Synth {synth_id}][harmonics] Rotated {delta} (adjust harmonics for channel {ch})")
+                logger.debug(f"[Synth {synth_id}][harmonics] Rotated {delta} (adjust harmonics for channel {ch})")
                 would_exceed = any(
                     (self.state.synths[synth_id][harmonics_key][j]['amplitude'] + delta) < 0 or
                     (self.state.synths[synth_id][harmonics_key][j]['amplitude'] + delta) > 100
                     for j in range(len(self.state.synths[synth_id][harmonics_key]))
                 )
                 if would_exceed:
-                    logger.info("Synth would exceed harmonics bounds, skipping command.")
+                    logger.debug("Synth would exceed harmonics bounds, skipping command.")
                     return
+                changed = False
                 for j in range(len(self.state.synths[synth_id][harmonics_key])):
                     harmonic = self.state.synths[synth_id][harmonics_key][j]
                     old_amp = harmonic['amplitude']
@@ -465,11 +551,14 @@ class EncoderManager:
                         'phase': round(harmonic.get('phase', 0), 2)
                     }
                     if old_amp != new_amp:
-                        self.synth_interface[synth_id].set_harmonics(ch, value)
-                        logger.info(f"Updated harmonics for synth {synth_id}, channel {ch}, id {value['id']} order {value['order']} to amplitude {new_amp}")
-            logger.info(f"Applied harmonics changes for synth {synth_id} on channel(s) {channels}")
+                        self.state.mark_changed(synth_id, harmonics_key)
+                        changed = True
+                        logger.debug(f"Updated harmonics for synth {synth_id}, channel {ch}, id {value['id']} order {value['order']} to amplitude {new_amp}")
+                if changed:
+                    self._send_harmonics(synth_id, [ch])
+            logger.debug(f"Applied harmonics changes for synth {synth_id} on channel(s) {channels}")
 
 
     def _handle_generic(self, delta, mode):
-        logger.info(f"[{mode}][generic] Rotated {delta} (generic placeholder)")
+        logger.debug(f"[{mode}][generic] Rotated {delta} (generic placeholder)")
         # TODO: Implement other func actions
@@ -0,0 +1,143 @@
+"""
+Non-blocking LED animation for the encoder pixels.
+
+Callers queue effects (flash, blink, pulse, rainbow) or set a steady base
+color and return immediately; one timer thread renders a frame every
+`frame_interval` and writes a pixel only when its color changed since the last
+write. Any number of effect changes between two frames cost at most one I2C
+write per pixel, and an idle animator writes nothing and sleeps until the
+next request.
+"""
+import colorsys
+import logging
+import math
+import threading
+import time
+
+from .encoder import I2C_LOCK
+
+logger = logging.getLogger("NHP_Synth")
+
+OFF = (0, 0, 0)
+
+
+def _scale(color, factor):
+    return tuple(int(c * factor) for c in color)
+
+
+class LedAnimator:
+    def __init__(self, pixels, frame_interval=0.02):
+        """
+        :param pixels: dict mapping keys (encoder functions) to pixel objects with fill(color); None entries are skipped
+        :param frame_interval: seconds per rendered frame while an effect is running
+        """
+        self.pixels = {key: pixel for key, pixel in pixels.items() if pixel is not None}
+        self.frame_interval = frame_interval
+        self._base = {key: OFF for key in self.pixels}
+        self._effects = {}   # key -> (start_time, render(elapsed) -> color, or None when finished)
+        self._written = {}   # key -> last color written to the pixel
+        self._lock = threading.Lock()
+        self._wake = threading.Event()
+        self._stop = threading.Event()
+        self._thread = None
+
+    def start(self):
+        if self._thread is None and self.pixels:
+            self._thread = threading.Thread(target=self._run, name="led-animator", daemon=True)
+            self._thread.start()
+        return self
+
+    def stop(self):
+        self._stop.set()
+        self._wake.set()
+        if self._thread is not None:
+            self._thread.join(timeout=1.0)
+            self._thread = None
+
+    # --- Effects ---
+    def set_base(self, key, color):
+        """Steady color shown whenever no effect is running on the pixel."""
+        self._update(key, base=tuple(color))
+
+    def clear_effect(self, key):
+        self._update(key, effect=None)
+
+    def flash(self, key, color, duration=0.1):
+        """Show `color` for `duration` seconds, then return to the base color."""
+        color = tuple(color)
+        self._update(key, effect=lambda t: color if t < duration else None)
+
+    def blink(self, key, color, interval, duration=None):
+        """Alternate `color` and off every `interval` seconds until cleared (or for `duration`)."""
+        color = tuple(color)
+
+        def render(t):
+            if duration is not None and t >= duration:
+                return None
+            return color if int(t / interval) % 2 == 0 else OFF
+        self._update(key, effect=render)
+
+    def pulse(self, key, color, period=1.0, duration=None):
+        """Fade `color` in and out with the given period until cleared (or for `duration`)."""
+        color = tuple(color)
+
+        def render(t):
+            if duration is not None and t >= duration:
+                return None
+            return _scale(color, 0.5 - 0.5 * math.cos(2 * math.pi * t / period))
+        self._update(key, effect=render)
+
+    def rainbow(self, keys=None, duration=1.2):
+        """Sweep every pixel (or `keys`) once through the hue wheel."""
+        def render(t):
+            if t >= duration:
+                return None
+            return tuple(int(c * 255) for c in colorsys.hsv_to_rgb(t / duration, 1.0, 1.0))
+        for key in (self.pixels if keys is None else keys):
+            self._update(key, effect=render)
+
+    def _update(self, key, base=None, effect=False):
+        if key not in self.pixels:
+            return
+        with self._lock:
+            if base is not None:
+                self._base[key] = base
+            if effect is None:
+                self._effects.pop(key, None)
+            elif effect is not False:
+                self._effects[key] = (time.monotonic(), effect)
+        self._wake.set()
+
+    # --- Rendering ---
+    def _frame(self, now):
+        """Colors for this frame; returns (colors, animating)."""
+        colors = {}
+        with self._lock:
+            for key in self.pixels:
+                color = None
+                if key in self._effects:
+                    start, render = self._effects[key]
+                    color = render(now - start)
+                    if color is None:
+                        del self._effects[key]
+                colors[key] = self._base[key] if color is None else color
+            return colors, bool(self._effects)
+
+    def _run(self):
+        while not self._stop.is_set():
+            self._wake.clear()
+            started = time.monotonic()
+            colors, animating = self._frame(started)
+            for key, color in colors.items():
+                if self._written.get(key) == color:
+                    continue
+                try:
+                    with I2C_LOCK:
+                        self.pixels[key].fill(color)
+                    self._written[key] = color
+                except Exception as e:
+                    logger.debug(f"LED write failed for {key}: {e}")
+            if animating:
+                self._stop.wait(max(0.0, self.frame_interval - (time.monotonic() - started)))
+            else:
+                self._wake.wait()
@@ -1,9 +1,13 @@
 
 import glob
 import os
+from concurrent.futures import ThreadPoolExecutor
 import logging
 logger = logging.getLogger("NHP_Synth")
 
+# Override the device glob (e.g. to point at tools/synth_emulator.py links).
+DEVICE_GLOB = os.environ.get('NHP_SYNTH_DEVICE_GLOB', '/dev/serial/by-path/*')
+
 class SynthDiscovery:
     """
     Utility class for discovering synthesizer USB devices.
@@ -22,12 +26,15 @@ class SynthDiscovery:
         return lookup
 
     @staticmethod
-    def find_all_synth_endpoints():
-        """Find synthesizers and return endpoint metadata keyed by physical USB path."""
+    def find_all_synth_endpoints(known_paths=()):
+        """
+        Find synthesizers and return endpoint metadata keyed by physical USB path.
+        Ports in `known_paths` (already open synths) are listed without being probed.
+        """
         from synth_control import SynthInterface  # Delayed import to avoid circular import
 
         synth_endpoints = []
-        path_devices = glob.glob('/dev/serial/by-path/*')
+        path_devices = sorted(glob.glob(DEVICE_GLOB))
 
         usb_devices = []
         priority_keywords = ['usb', 'esp', 'arduino', 'ch34', 'cp210', 'ftdi']
@@ -44,26 +51,38 @@ class SynthDiscovery:
         by_id_lookup = SynthDiscovery._build_by_id_lookup()
 
         logger.info(f"Scanning {len(usb_devices)} potential devices...")
-        for i, device in enumerate(usb_devices):
+
+        def endpoint_for(device):
+            device_name = device.split('/')[-1]
+            resolved = os.path.realpath(device)
+            # Phase mapping is intentionally tied to fixed Raspberry Pi USB topology.
+            # Keep identity based on by-path so each physical Pi USB port is a stable slot.
+            return {
+                'path': device,
+                'resolved_path': resolved,
+                'device_key': f"by-path:{device_name}",
+                'by_id_name': by_id_lookup.get(resolved),
+            }
+
+        def probe(i, device):
+            if device in known_paths:
+                return endpoint_for(device)
             try:
                 device_name = device.split('/')[-1]
                 logger.info(f"[{i+1}/{len(usb_devices)}] Trying: {device_name}")
                 with SynthInterface(device) as synth:
-                    resolved = os.path.realpath(device)
-                    by_id_name = by_id_lookup.get(resolved)
-                    # Phase mapping is intentionally tied to fixed Raspberry Pi USB topology.
-                    # Keep identity based on by-path so each physical Pi USB port is a stable slot.
-                    device_key = f"by-path:{device_name}"
-
-                    synth_endpoints.append({
-                        'path': device,
-                        'resolved_path': resolved,
-                        'device_key': device_key,
-                        'by_id_name': by_id_name,
-                    })
-                    logger.info(f"✓ Found synthesizer ({device_key})")
+                    if not synth.online:
+                        return None
+                    endpoint = endpoint_for(device)
+                    logger.info(f"✓ Found synthesizer ({endpoint['device_key']})")
+                    return endpoint
             except Exception:
-                continue
+                return None
+
+        # Probe every port at once; the scan takes as long as the slowest device, in glob order.
+        with ThreadPoolExecutor(max_workers=max(1, len(usb_devices))) as executor:
+            probed = list(executor.map(probe, range(len(usb_devices)), usb_devices))
+        synth_endpoints = [endpoint for endpoint in probed if endpoint is not None]
 
         if not synth_endpoints:
             logger.error("✗ No synthesizers found. Tried devices:")
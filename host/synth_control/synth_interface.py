@@ -6,10 +6,14 @@ Provides a Python interface to control the ESP32 synthesizer via UART commands.
 
 import serial
 import time
+from contextlib import contextmanager
 from typing import Optional, Union
 import logging
 from utils.command_parser import parse_synth_command
-from utils.harmonic_calibration import apply_command_phase_correction, apply_readback_phase_correction
+from utils.harmonic_calibration import (apply_command_phase_correction, apply_command_phase_corrections,
+                                        apply_readback_phase_correction)
+from utils.metrics import SERIAL_RTT, COMMANDS_SENT
+from utils.command_journal import JOURNAL
 logger = logging.getLogger("NHP_Synth")
 
 class SynthInterface:
@@ -28,6 +32,14 @@ class SynthInterface:
         self.ser: Optional[serial.Serial] = None
         self.id = id
         self.silent = False
+        self.multi_harmonic = None  # firmware whm support: None until the first multi-harmonic write
+        self._pending = None  # setter lines buffered by transaction()
+        self._pending_journal = None
+        self.sync_commit = None  # firmware wsf/wsp/wcs support: None until the first get_commit()
+        self._staged = []  # setters staged on the synth, journaled once their commit is confirmed
+        self._committing = None  # (version, staged setters) armed but not yet confirmed by get_commit()
+        # Frequency each channel runs at, as far as this interface wrote it (None until written)
+        self.running_frequency = {'a': None, 'b': None}
         
     def connect(self) -> bool:
         """
@@ -44,6 +56,11 @@ class SynthInterface:
             logger.error(f"Failed to connect: {e}")
             return False
             
+    @property
+    def online(self) -> bool:
+        """True while the serial port is open"""
+        return self.ser is not None and self.ser.is_open
+
     def disconnect(self):
         """Disconnect from synthesizer"""
         if self.ser and self.ser.is_open:
@@ -63,16 +80,108 @@ class SynthInterface:
             logger.error("Not connected to synthesizer")
             return False
 
+        if self._pending is not None:
+            self._pending.append(command)
+            return True
+
         try:
             if logger.isEnabledFor(logging.DEBUG) and not self.silent:
                 logger.debug(f"Synth # {self.id} sending cmd: {command} \t\t {parse_synth_command(command)}")
                 
             self.ser.write(f"{command}\r".encode())
+            COMMANDS_SENT.inc(synth=self.id, kind='read' if command[:1] == 'r' else 'write')
             return True
         except Exception as e:
             logger.error(f"Failed to send command: {e}")
             return False
         
+    # Firmware command line buffer (CMD_BUF_SIZE in firmware/main/main.c)
+    CMD_BUF_SIZE = 160
+    # Transaction writes go out in bursts of at most half the firmware's UART RX buffer
+    # (UART_RX_BUF_SIZE in firmware/main/main.c), so a burst never overruns it
+    BURST_BYTES = 128
+
+    @contextmanager
+    def transaction(self):
+        """
+        Buffer the setters called inside the block and write them together on exit
+
+        If the block raises, nothing is written to the synth or the command journal,
+        so a group of setters is applied completely or not at all. Reads are not
+        allowed inside a transaction. Nested transactions join the outer one.
+
+        Raises:
+            ConnectionError: if the buffered lines could not be written
+        """
+        if self._pending is not None:
+            yield self
+            return
+        self._pending, self._pending_journal = [], []
+        try:
+            yield self
+            lines, journal = self._pending, self._pending_journal
+        finally:
+            self._pending = self._pending_journal = None
+        if not self._write_burst(lines):
+            raise ConnectionError(f"Synth # {self.id} transaction write failed")
+        for kind, channel, value in journal:
+            self._record(kind, channel, value)
+
+    def _write_burst(self, commands) -> bool:
+        """Write whole command lines with as few writes as BURST_BYTES allows."""
+        if not commands:
+            return True
+        if not self.ser or not self.ser.is_open:
+            logger.error("Not connected to synthesizer")
+            return False
+        if logger.isEnabledFor(logging.DEBUG) and not self.silent:
+            for command in commands:
+                logger.debug(f"Synth # {self.id} sending cmd: {command} \t\t {parse_synth_command(command)}")
+        try:
+            burst = b''
+            for command in commands:
+                line = f"{command}\r".encode()
+                if burst and len(burst) + len(line) > self.BURST_BYTES:
+                    self.ser.write(burst)
+                    burst = b''
+                burst += line
+            self.ser.write(burst)
+        except Exception as e:
+            logger.error(f"Failed to send command: {e}")
+            return False
+        for command in commands:
+            COMMANDS_SENT.inc(synth=self.id, kind='read' if command[:1] == 'r' else 'write')
+        return True
+
+    def _query(self, command: str) -> str:
+        """Send a read command and return the stripped response line, recording the round trip."""
+        if self._pending is not None:
+            raise RuntimeError("Reads are not allowed inside a transaction")
+        start = time.perf_counter()
+        self.send_command(command)
+        response = self.ser.readline().decode().strip()
+        SERIAL_RTT.observe(time.perf_counter() - start, synth=self.id)
+        return response
+
+    def _apply(self, command: str, kind: str, channel: str, value=None) -> bool:
+        """Send a setter command and append it to the command journal if it was written."""
+        sent = self.send_command(command)
+        if sent:
+            self._journal(kind, channel.lower(), value)
+        return sent
+
+    def _journal(self, kind: str, channel: str, value):
+        """Record a written setter; inside a transaction, once the transaction is written."""
+        if self._pending_journal is not None:
+            self._pending_journal.append((kind, channel, value))
+        else:
+            self._record(kind, channel, value)
+
+    def _record(self, kind: str, channel: str, value):
+        if kind == 'set_frequency':
+            self.running_frequency[channel] = value
+        JOURNAL.record(self.id, kind, channel, value)
+
     def get_enabled(self, channel: str) -> bool:
         """
         Check if output is enabled for a channel
@@ -84,8 +193,7 @@ class SynthInterface:
         """
         if channel.lower() not in ['a', 'b']:
             raise ValueError("Channel must be 'a' or 'b'")
-        self.send_command(f"ren{channel.lower()}")
-        response = self.ser.readline().decode().strip()
+        response = self._query(f"ren{channel.lower()}")
         if logger.isEnabledFor(logging.DEBUG) and not self.silent:
             logger.debug(f"Synth # {self.id} rcvd res: {response} \t\t {parse_synth_command(response)}")
             
@@ -110,7 +218,7 @@ class SynthInterface:
             raise ValueError("Channel must be 'a' or 'b'")
         
         command = f"wen{channel.lower()}{1 if enabled else 0}"
-        return self.send_command(command)
+        return self._apply(command, 'set_enabled', channel, bool(enabled))
 
     def get_frequency(self, channel: str) -> Union[float, None]:
         """
@@ -126,8 +234,7 @@ class SynthInterface:
         if channel.lower() not in ['a', 'b']:
             raise ValueError("Channel must be 'a' or 'b'")
         
-        self.send_command(f"rf{channel.lower()}")
-        response = self.ser.readline().decode().strip()
+        response = self._query(f"rf{channel.lower()}")
         if logger.isEnabledFor(logging.DEBUG) and not self.silent:
             logger.debug(f"Synth # {self.id} rcvd freq res: {response} \t\t {parse_synth_command(response)}")
             
@@ -153,7 +260,7 @@ class SynthInterface:
         if not (20 <= frequency <= 8000):
             raise ValueError("Frequency must be between 20 and 8000 Hz")
             
-        return self.send_command(f"wf{channel.lower()}{frequency}")
+        return self._apply(f"wf{channel.lower()}{frequency}", 'set_frequency', channel, frequency)
 
     def get_amplitude(self, channel: str) -> Union[float, None]:
         """
@@ -169,8 +276,7 @@ class SynthInterface:
         if channel.lower() not in ['a', 'b']:
             raise ValueError("Channel must be 'a' or 'b'")
         
-        self.send_command(f"ra{channel.lower()}")
-        response = self.ser.readline().decode().strip()
+        response = self._query(f"ra{channel.lower()}")
         if logger.isEnabledFor(logging.DEBUG) and not self.silent:
             logger.debug(f"Synth # {self.id} rcvd res: {response} \t\t {parse_synth_command(response)}")
             
@@ -196,7 +302,7 @@ class SynthInterface:
         if not (0 <= amplitude <= 100):
             raise ValueError("Amplitude must be between 0 and 100")
             
-        return self.send_command(f"wa{channel.lower()}{amplitude}")
+        return self._apply(f"wa{channel.lower()}{amplitude}", 'set_amplitude', channel, amplitude)
 
     def get_phase(self, channel: str) -> Union[float, None]:
         """
@@ -212,8 +318,7 @@ class SynthInterface:
         if channel.lower() not in ['a', 'b']:
             raise ValueError("Channel must be 'a' or 'b'")
         
-        self.send_command(f"rp{channel.lower()}")
-        response = self.ser.readline().decode().strip()
+        response = self._query(f"rp{channel.lower()}")
         if logger.isEnabledFor(logging.DEBUG) and not self.silent:
             logger.debug(f"Synth # {self.id} rcvd phase res: {response} \t\t {parse_synth_command(response)}")
 
@@ -237,7 +342,7 @@ class SynthInterface:
             raise ValueError("Channel must be 'a' or 'b'")
         if not (-360 <= phase <= 360):
             raise ValueError("Phase must be between -360 and +360 degrees")
-        return self.send_command(f"wp{channel.lower()}{phase}")
+        return self._apply(f"wp{channel.lower()}{phase}", 'set_phase', channel, phase)
 
     def get_harmonics(self, channel: str) -> Union[list, None]:
         """
@@ -257,8 +362,7 @@ class SynthInterface:
         if channel.lower() not in ['a', 'b']:
             raise ValueError("Channel must be 'a' or 'b'")
 
-        self.send_command(f"rh{channel.lower()}")
-        response = self.ser.readline().decode().strip()
+        response = self._query(f"rh{channel.lower()}")
         if logger.isEnabledFor(logging.DEBUG) and not self.silent:
             logger.debug(f"Synth # {self.id} rcvd harmonics res: {response} \t\t {parse_synth_command(response)}")
 
@@ -315,7 +419,104 @@ class SynthInterface:
             raise ValueError("Harmonic phase must be between -360 and +360 degrees")
 
         corrected_phase = apply_command_phase_correction(order, phase)
-        return self.send_command(f"wh{channel.lower()}{order},{amplitude},{corrected_phase}")
+        return self._apply(f"wh{channel.lower()}{order},{amplitude},{corrected_phase}",
+                           'set_harmonics', channel, (order, amplitude, phase))
+
+    def set_harmonics_multi(self, channels: dict) -> bool:
+        """
+        Replace the harmonics of one or both channels in a single command
+
+        The firmware applies a `whm` line as one transaction, so a calibration or
+        preset change never leaves a channel half updated. Firmware without `whm`
+        is detected on first use (it answers with an unknown-command warning) and
+        gets whcl + wh instead. An order listed twice for a channel keeps its last
+        entry, as consecutive wh writes would.
+
+        Args:
+            channels: {'a': [harmonic dicts], 'b': [...]}; an empty list clears the channel
+        Returns:
+            True if the harmonics were sent
+        """
+        entries = []
+        channels = {channel: list({h.get('order'): h for h in harmonics}.values())
+                    for channel, harmonics in channels.items()}
+        for channel, harmonics in channels.items():
+            if channel.lower() not in ['a', 'b']:
+                raise ValueError("Channel must be 'a' or 'b'")
+            for harmonic in harmonics:
+                order = harmonic.get('order')
+                amplitude = harmonic.get('amplitude')
+                phase = harmonic.get('phase', 0)
+                if order is None or amplitude is None:
+                    raise ValueError("Harmonic dict must contain 'order' and 'amplitude'")
+                if order < 3 or order % 2 == 0:
+                    raise ValueError("Harmonic order must be odd and >= 3")
+                if not (0 <= amplitude <= 100):
+                    raise ValueError("Harmonic amplitude must be between 0 and 100")
+                if not (-360 <= phase <= 360):
+                    raise ValueError("Harmonic phase must be between -360 and +360 degrees")
+                entries.append((channel.lower(), order, amplitude, phase))
+
+        # A 0 % entry is a no-op in a replacing write, so only the audible ones go out
+        entries = [e for e in entries if e[2] > 0]
+        corrected = apply_command_phase_corrections([e[1] for e in entries], [e[3] for e in entries])
+        segments = [f"{ch}{order},{amplitude},{phase}"
+                    for (ch, order, amplitude, _), phase in zip(entries, corrected)]
+        segments += [ch.lower() for ch in channels if not any(e[0] == ch.lower() for e in entries)]
+        command = "whm" + ";".join(segments)
+
+        # whm support is probed with a read, which a transaction cannot do
+        if (self.multi_harmonic is False or len(command) >= self.CMD_BUF_SIZE
+                or (self.multi_harmonic is None and self._pending is not None)):
+            return self._set_harmonics_sequential(channels)
+        if not self.send_command(command):
+            return False
+        if self.multi_harmonic is None:
+            self.multi_harmonic = self._probe_multi_harmonic(next(iter(channels)).lower())
+            if self.multi_harmonic is False:
+                logger.info(f"Synth # {self.id} firmware has no whm support, using per-harmonic writes")
+            if not self.multi_harmonic:
+                return self._set_harmonics_sequential(channels)
+        for channel, harmonics in channels.items():
+            self._journal('clear_harmonics', channel.lower(), None)
+            for harmonic in harmonics:
+                self._journal('set_harmonics', channel.lower(),
+                              (harmonic['order'], harmonic['amplitude'], harmonic.get('phase', 0)))
+        return True
+
+    # Lines read while waiting for the probe's rh reply before giving up on it
+    PROBE_LINES = 4
+
+    def _probe_multi_harmonic(self, channel: str) -> Union[bool, None]:
+        """
+        Tell from the lines before an rh reply whether the whm just sent was understood
+
+        Old firmware logs an unknown-command warning for whm, which arrives ahead of the
+        rh reply, so this works whatever the whm carried. Lines are read up to the reply
+        itself, leaving nothing behind for the next query.
+
+        Returns:
+            True or False, or None if the reply did not arrive (support stays unknown)
+        """
+        response = self._query(f"rh{channel}")
+        unknown = False
+        for _ in range(self.PROBE_LINES):
+            if response.startswith(f"rh{channel}"):
+                return not unknown
+            if not response:
+                break
+            unknown = unknown or "Unknown command" in response
+            response = self.ser.readline().decode().strip()
+        logger.warning(f"Synth # {self.id} no harmonics reply to the whm probe, last line: {response}")
+        return None
+
+    def _set_harmonics_sequential(self, channels: dict) -> bool:
+        ok = True
+        for channel, harmonics in channels.items():
+            ok = self.clear_harmonics(channel) and ok
+            for harmonic in harmonics:
+                ok = self.set_harmonics(channel, harmonic) and ok
+        return ok
 
     def clear_harmonics(self, channel: str) -> bool:
         """
@@ -330,7 +531,101 @@ class SynthInterface:
         if channel.lower() not in ['a', 'b']:
             raise ValueError("Channel must be 'a' or 'b'")
             
-        return self.send_command(f"whcl{channel.lower()}")
+        return self._apply(f"whcl{channel.lower()}", 'clear_harmonics', channel)
+
+    def stage_frequency(self, channel: str, frequency: float) -> bool:
+        """
+        Stage a frequency for a channel; the synth keeps its current one until commit_staged()
+
+        Args:
+            channel: 'a' or 'b'
+            frequency: Frequency in Hz (20-8000)
+        """
+        if channel.lower() not in ['a', 'b']:
+            raise ValueError("Channel must be 'a' or 'b'")
+        if not (20 <= frequency <= 8000):
+            raise ValueError("Frequency must be between 20 and 8000 Hz")
+        sent = self.send_command(f"wsf{channel.lower()}{frequency}")
+        if sent:
+            self._staged.append(('set_frequency', channel.lower(), frequency))
+        return sent
+
+    def stage_phase(self, channel: str, phase: float) -> bool:
+        """
+        Stage a phase for a channel; the synth keeps its current one until commit_staged()
+
+        Args:
+            channel: 'a' or 'b'
+            phase: Phase in degrees (-360 to +360)
+        """
+        if channel.lower() not in ['a', 'b']:
+            raise ValueError("Channel must be 'a' or 'b'")
+        if not (-360 <= phase <= 360):
+            raise ValueError("Phase must be between -360 and +360 degrees")
+        sent = self.send_command(f"wsp{channel.lower()}{phase}")
+        if sent:
+            self._staged.append(('set_phase', channel.lower(), phase))
+        return sent
+
+    def commit_staged(self, version: int, at_sync: bool = True) -> bool:
+        """
+        Apply the staged writes as commit `version`
+
+        The writes are journaled when get_commit() reports `version` applied, not on
+        send: an armed commit can still miss its edge or be discarded.
+
+        Args:
+            version: commit number reported back by get_commit() once applied
+            at_sync: apply at the next sync edge (and realign the DDS there) rather than immediately
+        Returns:
+            True if command sent successfully
+        """
+        sent = self.send_command(f"{'wcs' if at_sync else 'wcn'}{int(version) & 0xFFFFFFFF}")
+        if sent:
+            # An unconfirmed earlier commit is still staged on the synth and applies with this one
+            earlier = self._committing[1] if self._committing else []
+            self._committing = (int(version) & 0xFFFFFFFF, earlier + self._staged)
+            self._staged = []
+        return sent
+
+    def discard_staged(self) -> bool:
+        """Drop staged writes (and an armed commit that has not been applied yet)."""
+        self._staged = []
+        self._committing = None
+        return self.send_command("wcx")
+
+    def get_commit(self) -> Union[tuple, None]:
+        """
+        Read the last applied commit
+
+        Returns:
+            (version, state) from response "rc<version>,<state>", state 0 = applied,
+            1 = writes staged, 2 = commit armed; None on a bad response or firmware without
+            commit support (sync_commit is then False)
+            example: "rc42,0" -> (42, 0)
+        """
+        response = self._query("rc")
+        try:
+            version, state = response.split("rc", 1)[1].split(",")
+            result = (int(version), int(state))
+        except (ValueError, IndexError):
+            if "Unknown command" in response:
+                # Older firmware: the staged lines before rc were unknown too, drop their warnings
+                logger.info(f"Synth # {self.id} firmware has no staged commit support, using direct writes")
+                self.sync_commit = False
+                self._staged = []
+                self._committing = None
+                if self.ser:
+                    self.ser.reset_input_buffer()
+            else:
+                logger.error(f"Synth # {self.id} invalid commit response: {response}")
+            return None
+        self.sync_commit = True
+        if self._committing and result == (self._committing[0], 0):
+            for kind, channel, value in self._committing[1]:
+                self._journal(kind, channel, value)
+            self._committing = None
+        return result
         
     def __enter__(self):
         """Context manager entry"""
@@ -340,3 +635,25 @@ class SynthInterface:
     def __exit__(self, exc_type, exc_val, exc_tb):
         """Context manager exit"""
         self.disconnect()
+
+
+class OfflineSynth(SynthInterface):
+    """
+    Placeholder for a synth slot whose device is missing or failed to open.
+
+    Keeps synth ids (and their phase assignment) aligned while a partial rig runs
+    degraded: setters return False, reads raise ConnectionError, and the poller
+    reports the slot as failed so reconnect keeps looking for the device.
+    """
+
+    def __init__(self, port: Optional[str] = None, id: int = 0):
+        super().__init__(port=port, id=id)
+
+    def connect(self) -> bool:
+        return False
+
+    def send_command(self, command: str) -> bool:
+        return False
+
+    def _query(self, command: str) -> str:
+        raise ConnectionError(f"Synth {self.id} is offline")
@@ -2,8 +2,38 @@ import os
 import json
 import logging
 import copy
+import threading
+import time
+from utils.file_utils import atomic_write_text
+from utils.history import HISTORY
 logger = logging.getLogger("NHP_Synth")
 
+# Synth count used when there is no defaults file yet (one rig = three phases).
+DEFAULT_SYNTH_COUNT = int(os.environ.get('NHP_SYNTH_COUNT', '3'))
+
+
+def default_synth_entry(index):
+    """Factory defaults for synth `index`; phases repeat 0/120/-120 deg for each three-synth rig."""
+    phase = (0.0, 120.0, -120.0)[index % 3]
+    return {
+        "auto_on": False,
+        "enabled": { "a": False, "b": False },
+        "amplitude_a": 96.0,
+        "amplitude_b": 50.0,
+        "frequency_a": 50.0,
+        "frequency_b": 50.0,
+        "phase_a": phase,
+        "phase_b": phase,
+        "harmonics_a": [],
+        "harmonics_b": [
+            {"id": 0, "order": 5, "amplitude": 0, "phase": 0},
+            {"id": 1, "order": 7, "amplitude": 0, "phase": 0},
+            {"id": 2, "order": 11, "amplitude": 0, "phase": 0},
+            {"id": 3, "order": 13, "amplitude": 0, "phase": 0}
+        ]
+    }
+
+
 class SynthStateManager:
     def __init__(self, state_file, defaults_file):
         self.state_file = state_file
@@ -14,6 +44,25 @@ class SynthStateManager:
         self.synth_device_map = []
         self.selection_mode = None
 
+        # Change tracking: every mutation bumps `version` and records the changed path
+        # ((synth_id, key), ('selectionMode',) or ('synths',) for a full replace).
+        self.version = 0
+        self._changed_paths = set()
+        self._change_cond = threading.Condition()
+
+        # Write-behind persistence: writers bump the dirty versions, the writer
+        # thread (start_writer) coalesces them into one atomic write per debounce window.
+        self._persist_cond = threading.Condition()
+        self._flush_lock = threading.Lock()
+        self._state_dirty_version = 0
+        self._state_saved_version = 0
+        self._defaults_dirty_version = 0
+        self._defaults_saved_version = 0
+        self._first_dirty = None
+        self._last_dirty = 0.0
+        self._writer = None
+        self._writer_stop = False
+
         self.defaults = copy.deepcopy(self.load_defaults())
         loaded_state = self.load_state()
         if isinstance(loaded_state, dict):
@@ -22,6 +71,157 @@ class SynthStateManager:
             # load_state returned the defaults list directly
             self.synths = loaded_state
 
+    def mark_changed(self, synth_id=None, key=None):
+        """Record that synths[synth_id][key] changed (synth_id=None: the whole synth list)."""
+        if synth_id is None:
+            path = ('synths',)
+        elif key is None:
+            path = ('synths', synth_id)
+        else:
+            path = (synth_id, key)
+        with self._change_cond:
+            self.version += 1
+            self._changed_paths.add(path)
+            self._change_cond.notify_all()
+        self.request_save()
+
+    def mark_selection_changed(self):
+        with self._change_cond:
+            self.version += 1
+            self._changed_paths.add(('selectionMode',))
+            self._change_cond.notify_all()
+
+    def ensure_synth_count(self, count):
+        """Grow defaults and state to `count` synths (new slots get factory defaults). Returns True if grown."""
+        grown = False
+        while len(self.defaults) < count:
+            self.defaults.append(default_synth_entry(len(self.defaults)))
+            self.mark_defaults_changed()
+            grown = True
+        while len(self.synths) < count:
+            index = len(self.synths)
+            self.synths.append(copy.deepcopy(self.defaults[index]))
+            grown = True
+        if grown:
+            self.num_synths = len(self.synths)
+            self.mark_changed()
+        return grown
+
+    def set_value(self, synth_id, key, value):
+        """Set a top-level synth field, recording the change only if the value differs."""
+        synth = self.synths[synth_id]
+        if key in synth and synth[key] == value:
+            return False
+        synth[key] = value
+        HISTORY.record(synth_id, key, value)
+        self.mark_changed(synth_id, key)
+        return True
+
+    def set_enabled(self, synth_id, channel, value):
+        enabled = self.synths[synth_id].setdefault('enabled', {})
+        if enabled.get(channel) == value:
+            return False
+        enabled[channel] = value
+        self.mark_changed(synth_id, 'enabled')
+        return True
+
+    def wait_for_changes(self, since_version, timeout=None):
+        """Block until version > since_version; return (version, changed paths) and reset the path set.
+
+        Intended for a single consumer (the dashboard broadcaster).
+        """
+        with self._change_cond:
+            if self.version <= since_version:
+                self._change_cond.wait(timeout)
+            paths = self._changed_paths
+            self._changed_paths = set()
+            return self.version, paths
+
+    def request_save(self):
+        """Mark synth state dirty; the writer thread persists it after the debounce window."""
+        self._mark_dirty(state=True)
+
+    def mark_defaults_changed(self):
+        self._mark_dirty(defaults=True)
+
+    def _mark_dirty(self, state=False, defaults=False):
+        with self._persist_cond:
+            if state:
+                self._state_dirty_version += 1
+            if defaults:
+                self._defaults_dirty_version += 1
+            self._last_dirty = time.monotonic()
+            if self._first_dirty is None:
+                self._first_dirty = self._last_dirty
+            self._persist_cond.notify()
+
+    def _is_dirty(self):
+        return (self._state_dirty_version != self._state_saved_version
+                or self._defaults_dirty_version != self._defaults_saved_version)
+
+    def start_writer(self, debounce=1.0, max_delay=5.0):
+        """Start the background writer: persist once changes have been quiet for `debounce`
+        seconds, or at most `max_delay` seconds after the first unsaved change."""
+        if self._writer is not None:
+            return
+        self._writer_stop = False
+        self._writer = threading.Thread(
+            target=self._writer_loop, args=(debounce, max_delay), name='state-writer', daemon=True)
+        self._writer.start()
+
+    def stop_writer(self):
+        """Stop the writer thread and flush anything still pending."""
+        writer = self._writer
+        if writer is not None:
+            with self._persist_cond:
+                self._writer_stop = True
+                self._persist_cond.notify()
+            writer.join(timeout=5.0)
+            self._writer = None
+        self.flush()
+
+    def _writer_loop(self, debounce, max_delay):
+        while True:
+            with self._persist_cond:
+                while not self._writer_stop and not self._is_dirty():
+                    self._persist_cond.wait()
+                while not self._writer_stop:
+                    now = time.monotonic()
+                    deadline = min(self._last_dirty + debounce, (self._first_dirty or now) + max_delay)
+                    if now >= deadline:
+                        break
+                    self._persist_cond.wait(deadline - now)
+                if self._writer_stop:
+                    return
+            if not self.flush():
+                # Write failed (e.g. read-only or full SD card): back off, keep the data dirty
+                with self._persist_cond:
+                    self._persist_cond.wait(max_delay)
+
+    def flush(self):
+        """Write pending state/defaults changes now. Returns False if a write failed."""
+        with self._flush_lock:
+            with self._persist_cond:
+                state_version = self._state_dirty_version
+                defaults_version = self._defaults_dirty_version
+                self._first_dirty = None
+            ok = True
+            if state_version != self._state_saved_version:
+                if self.save_state():
+                    self._state_saved_version = state_version
+                else:
+                    ok = False
+            if defaults_version != self._defaults_saved_version:
+                if self.save_defaults():
+                    self._defaults_saved_version = defaults_version
+                else:
+                    ok = False
+            if not ok:
+                with self._persist_cond:
+                    if self._first_dirty is None:
+                        self._first_dirty = time.monotonic()
+            return ok
+
     def get_defaults(self, idx, key):
         if idx < len(self.defaults):
             return self.defaults[idx].get(key, self.defaults[0].get(key, 0.0))
@@ -33,34 +233,17 @@ class SynthStateManager:
         return copy.deepcopy(self.defaults)
 
     def save_defaults(self):
-        """Save the defaults to the defaults JSON file."""
+        """Save the defaults to the defaults JSON file now (atomic; kept indented for hand editing)."""
         try:
-            with open(self.defaults_file, 'w') as f:
-                json.dump(self.defaults, f, indent=2)
+            atomic_write_text(self.defaults_file, json.dumps(self.defaults, indent=2))
+            return True
         except Exception as e:
             logger.warning(f"Could not save defaults: {e}")
+            return False
 
     def load_defaults(self):
         """Load defaults from the defaults JSON file, or use hardcoded defaults if file does not exist."""
-        default_data = []
-        for i in range(3):
-            default_data.append({
-                "auto_on": False,
-                "enabled": { "a": False, "b": False },
-                "amplitude_a": 96.0,
-                "amplitude_b": 50.0,
-                "frequency_a": 50.0,
-                "frequency_b": 50.0,
-                "phase_a": 0.0 if i == 0 else (120.0 if i == 1 else -120.0),
-                "phase_b": 0.0 if i == 0 else (120.0 if i == 1 else -120.0),
-                "harmonics_a": [],
-                "harmonics_b": [
-                    {"id": 0, "order": 5, "amplitude": 0, "phase": 0},
-                    {"id": 1, "order": 7, "amplitude": 0, "phase": 0},
-                    {"id": 2, "order": 11, "amplitude": 0, "phase": 0},
-                    {"id": 3, "order": 13, "amplitude": 0, "phase": 0}
-                ]
-            })
+        default_data = [default_synth_entry(i) for i in range(DEFAULT_SYNTH_COUNT)]
 
         if not os.path.exists(self.defaults_file):
             self.defaults = default_data
@@ -77,26 +260,39 @@ class SynthStateManager:
             return self._return_defaults()
 
     def save_state(self):
-        """Save the current synth/channel values to JSON file."""
-        try:
-            with open(self.state_file, 'w') as f:
-                json.dump(
+        """Save the current synth/channel values to the JSON file now (compact, atomic).
+
+        Prefer request_save() from hot paths; this is what the writer thread calls.
+        """
+        for _ in range(3):
+            try:
+                text = json.dumps(
                     {
                         'num_synths': self.num_synths,
                         'synths': self.synths,
                         'synth_device_map': self.synth_device_map,
                     },
-                    f,
-                    indent=2,
+                    separators=(',', ':'),
                 )
+                break
+            except RuntimeError:
+                continue  # synth dict mutated by another thread mid-serialise; retry
+        else:
+            logger.warning("Could not save synth state: state kept changing during serialisation")
+            return False
+        try:
+            atomic_write_text(self.state_file, text)
+            return True
         except Exception as e:
             logger.warning(f"Could not save synth state: {e}")
+            return False
 
     def load_state(self):
         """Load synth/channel values from JSON file, update internal state, and return the state dict."""
         if not os.path.exists(self.state_file):
             self.num_synths = len(self.defaults)
             self.synths = copy.deepcopy(self.defaults)
+            self.mark_changed()
             self.save_state()
             return copy.deepcopy(self.defaults)
         try:
@@ -114,6 +310,7 @@ class SynthStateManager:
                 for key in ['harmonics_a', 'harmonics_b']:
                     if key not in synth or not isinstance(synth[key], list):
                         synth[key] = []
+            self.mark_changed()
             return state
         except Exception as e:
             logger.warning(f"Could not load synth state: {e}")
@@ -1,25 +1,40 @@
+import os
 import time
 from concurrent.futures import ThreadPoolExecutor, as_completed
-import board
-import busio
-from adafruit_seesaw.seesaw import Seesaw
-from adafruit_seesaw.rotaryio import IncrementalEncoder
-from adafruit_seesaw import digitalio, neopixel
-from .synth_interface import SynthInterface
+try:
+    import board
+    import busio
+    from adafruit_seesaw.seesaw import Seesaw
+    from adafruit_seesaw.rotaryio import IncrementalEncoder
+    from adafruit_seesaw import digitalio, neopixel
+except (ImportError, NotImplementedError, RuntimeError):
+    # Off the Pi (emulator, bench tools) only the serial side of the package is usable.
+    board = busio = Seesaw = IncrementalEncoder = digitalio = neopixel = None
+from .synth_interface import SynthInterface, OfflineSynth
+from .synth_state import DEFAULT_SYNTH_COUNT
 from .synth_discovery import SynthDiscovery
+from .led_animator import LedAnimator
+from utils.startup import StartupError, StartupPipeline
 import logging
-import colorsys
 logger = logging.getLogger("NHP_Synth")
 
+# How long startup waits for every synth to enumerate on USB before giving up.
+DEVICE_WAIT_SECONDS = float(os.environ.get('NHP_DEVICE_WAIT', '30'))
+DEVICE_POLL_INTERVAL = 1.0
+# Set to 1 to abort startup unless every expected synth is present (default: run degraded).
+REQUIRE_ALL_SYNTHS = os.environ.get('NHP_REQUIRE_ALL_SYNTHS', '0') == '1'
+
 class SystemInitializer:
     """
     Handles full system initialization for NHP_Synth.
     """
     @staticmethod
     def _expected_synth_count(state_manager):
+        """NHP_SYNTH_COUNT if set, otherwise one synth per entry in the defaults file."""
+        if os.environ.get('NHP_SYNTH_COUNT'):
+            return DEFAULT_SYNTH_COUNT
         defaults = getattr(state_manager, 'defaults', [])
-        expected = len(defaults) if isinstance(defaults, list) and defaults else 3
-        return max(3, expected)
+        return len(defaults) if isinstance(defaults, list) and defaults else DEFAULT_SYNTH_COUNT
 
     @staticmethod
     def _close_synths(synths):
@@ -30,158 +45,217 @@ class SystemInitializer:
                 pass
 
     @staticmethod
-    def _order_endpoints(endpoints, state_manager):
+    def _assign_slots(endpoints, state_manager, count):
+        """
+        Place endpoints in synth slots (synth id = slot = phase assignment). A device seen
+        before keeps its saved slot; new devices take slots with no saved device, then any
+        free slot, then extend the rig. Missing devices leave their slot as None.
+        """
         saved_map = getattr(state_manager, 'synth_device_map', [])
-        if not isinstance(saved_map, list) or not saved_map:
-            return sorted(endpoints, key=lambda ep: ep.get('path', ''))
-
-        index_by_key = {key: idx for idx, key in enumerate(saved_map)}
+        saved_map = saved_map if isinstance(saved_map, list) else []
+        slots = [None] * count
+        index_by_key = {key: idx for idx, key in enumerate(saved_map[:count]) if key}
+
+        new_endpoints = []
+        for endpoint in sorted(endpoints, key=lambda ep: ep.get('path', '')):
+            idx = index_by_key.get(endpoint.get('device_key'))
+            if idx is not None and slots[idx] is None:
+                slots[idx] = endpoint
+            else:
+                new_endpoints.append(endpoint)
 
-        def sort_key(endpoint):
-            key = endpoint.get('device_key')
-            if key in index_by_key:
-                return (0, index_by_key[key])
-            return (1, endpoint.get('path', ''))
+        unclaimed = [i for i in range(count) if slots[i] is None and not (i < len(saved_map) and saved_map[i])]
+        free = unclaimed + [i for i in range(count) if slots[i] is None and i not in unclaimed]
+        for endpoint in new_endpoints:
+            if free:
+                slots[free.pop(0)] = endpoint
+            else:
+                slots.append(endpoint)
+        return slots
 
-        return sorted(endpoints, key=sort_key)
+    @staticmethod
+    def _update_device_map(state_manager, endpoints):
+        """Record the device in each connected slot; offline slots stay reserved for their last device."""
+        saved_map = getattr(state_manager, 'synth_device_map', [])
+        device_map = list(saved_map) if isinstance(saved_map, list) else []
+        device_map += [None] * (len(endpoints) - len(device_map))
+        for i, endpoint in enumerate(endpoints):
+            if endpoint is not None:
+                device_map[i] = endpoint.get('device_key')
+        state_manager.synth_device_map = device_map
 
     @staticmethod
-    def _connect_synths(endpoints):
-        synth_init_errors = []
-        synths = []
-        connected_endpoints = []
+    def _connect_one(i, endpoint):
+        """Open and health-check one synth. Returns (synth or None, errors, seconds)."""
+        started = time.monotonic()
+        errors = []
+        device_path = endpoint.get('path')
+        device_name = device_path.split('/')[-1] if device_path else f'device-{i}'
+        try:
+            synth = SynthInterface(port=device_path, id=i)
+            if not synth.connect():
+                raise ConnectionError("could not open port")
+        except Exception as e:
+            logger.error(f"✗ Failed to connect to {device_name}: {e}")
+            errors.append(f"Synth {i} ({device_name}) connection error: {e}")
+            return None, errors, time.monotonic() - started
 
-        for i, endpoint in enumerate(endpoints):
-            device_path = endpoint.get('path')
-            device_name = device_path.split('/')[-1] if device_path else f'device-{i}'
+        try:
+            enabled_a = synth.get_enabled('a')
+            enabled_b = synth.get_enabled('b')
+            amp_a = synth.get_amplitude('a')
+            amp_b = synth.get_amplitude('b')
+            freq_a = synth.get_frequency('a')
+            freq_b = synth.get_frequency('b')
+            phase_a = synth.get_phase('a')
+            phase_b = synth.get_phase('b')
+            harmonics_a = synth.get_harmonics('a')
+            harmonics_b = synth.get_harmonics('b')
+            logger.debug(
+                f"enabled_a={enabled_a}, enabled_b={enabled_b}, amp_a={amp_a}, amp_b={amp_b}, "
+                f"freq_a={freq_a}, freq_b={freq_b}, phase_a={phase_a}, phase_b={phase_b}, "
+                f"harmonics_a={harmonics_a}, harmonics_b={harmonics_b}"
+            )
             try:
-                synth = SynthInterface(port=device_path, id=i)
-                synth.__enter__()
-                synths.append(synth)
-                connected_endpoints.append(endpoint)
-
-                try:
-                    enabled_a = synth.get_enabled('a')
-                    enabled_b = synth.get_enabled('b')
-                    amp_a = synth.get_amplitude('a')
-                    amp_b = synth.get_amplitude('b')
-                    freq_a = synth.get_frequency('a')
-                    freq_b = synth.get_frequency('b')
-                    phase_a = synth.get_phase('a')
-                    phase_b = synth.get_phase('b')
-                    harmonics_a = synth.get_harmonics('a')
-                    harmonics_b = synth.get_harmonics('b')
-                    logger.debug(
-                        f"enabled_a={enabled_a}, enabled_b={enabled_b}, amp_a={amp_a}, amp_b={amp_b}, "
-                        f"freq_a={freq_a}, freq_b={freq_b}, phase_a={phase_a}, phase_b={phase_b}, "
-                        f"harmonics_a={harmonics_a}, harmonics_b={harmonics_b}"
+                synth.set_frequency('a', freq_a)
+                synth.set_frequency('b', freq_b)
+                freq_a_check = synth.get_frequency('a')
+                freq_b_check = synth.get_frequency('b')
+                if freq_a != freq_a_check or freq_b != freq_b_check:
+                    errors.append(
+                        f"Synth {i} ({device_name}) frequency round-trip mismatch: "
+                        f"a={freq_a}->{freq_a_check}, b={freq_b}->{freq_b_check}"
                     )
-                    try:
-                        synth.set_frequency('a', freq_a)
-                        synth.set_frequency('b', freq_b)
-                        freq_a_check = synth.get_frequency('a')
-                        freq_b_check = synth.get_frequency('b')
-                        if freq_a != freq_a_check or freq_b != freq_b_check:
-                            synth_init_errors.append(
-                                f"Synth {i} ({device_name}) frequency round-trip mismatch: "
-                                f"a={freq_a}->{freq_a_check}, b={freq_b}->{freq_b_check}"
-                            )
-                        else:
-                            logger.debug(f"✓ Synth {i} frequency round-trip OK")
-                    except Exception as e:
-                        synth_init_errors.append(
-                            f"Synth {i} ({device_name}) frequency round-trip error: {e}"
-                        )
-
-                    logger.info(f"✓ Synth {i} Comms OK ({endpoint.get('device_key', 'unknown-key')})")
-                except Exception as comms_e:
-                    logger.error(f"Could not read parameters from {device_name}: {comms_e}")
-                    synth_init_errors.append(f"Synth {i} ({device_name}) comms error: {comms_e}")
+                else:
+                    logger.debug(f"✓ Synth {i} frequency round-trip OK")
             except Exception as e:
-                logger.error(f"✗ Failed to connect to {device_name}: {e}")
-                synth_init_errors.append(f"Synth {i} ({device_name}) connection error: {e}")
+                errors.append(f"Synth {i} ({device_name}) frequency round-trip error: {e}")
+
+            logger.info(f"✓ Synth {i} Comms OK ({endpoint.get('device_key', 'unknown-key')})")
+        except Exception as comms_e:
+            logger.error(f"Could not read parameters from {device_name}: {comms_e}")
+            errors.append(f"Synth {i} ({device_name}) comms error: {comms_e}")
+        return synth, errors, time.monotonic() - started
+
+    @staticmethod
+    def _connect_synths(slots, report=None, indices=None):
+        """
+        Connect the endpoint in each slot (or only `indices`) concurrently, one worker per UART.
+        Returns {slot: (synth, endpoint)}; a missing or failed device gets an OfflineSynth and endpoint None.
+        """
+        indices = range(len(slots)) if indices is None else indices
+        synth_init_errors = []
+        connected = {}
+
+        with ThreadPoolExecutor(max_workers=max(1, len(slots))) as executor:
+            futures = {i: executor.submit(SystemInitializer._connect_one, i, slots[i])
+                       for i in indices if slots[i] is not None}
+            for i in indices:
+                endpoint = slots[i]
+                if endpoint is None:
+                    synth_init_errors.append(f"Synth {i} not found, running without it")
+                    connected[i] = (OfflineSynth(id=i), None)
+                    continue
+                synth, errors, seconds = futures[i].result()
+                synth_init_errors.extend(errors)
+                if report is not None:
+                    report.note('synth_connect', endpoint.get('device_key') or f'device-{i}', round(seconds, 3))
+                if synth is None:
+                    connected[i] = (OfflineSynth(port=endpoint.get('path'), id=i), None)
+                else:
+                    connected[i] = (synth, endpoint)
 
         if synth_init_errors:
             logger.warning("Synthesizer issues:")
             for err in synth_init_errors:
                 logger.warning(f"  {err}")
 
-        return synths, connected_endpoints
+        return connected
 
     @staticmethod
-    def _sync_synths_to_state(synths, state_manager):
-        for i, synth in enumerate(synths):
-            for ch in ['a', 'b']:
-                try:
-                    synth.clear_harmonics(ch)
-                except Exception as e:
-                    logger.warning(f"Synth {i} failed to clear harmonics on channel {ch}: {e}")
-
-            synth_state = state_manager.synths[i] if i < len(state_manager.synths) else None
-            if not synth_state:
-                continue
-
+    def _sync_synth_to_state(i, synth, state_manager):
+        if not synth.online:
+            return
+        for ch in ['a', 'b']:
             try:
-                if not synth_state.get('auto_on', False):
-                    synth.set_enabled('a', False)
-                    synth.set_enabled('b', False)
-                else:
-                    synth.set_enabled('a', synth_state.get('enabled', {}).get('a', False))
-                    synth.set_enabled('b', synth_state.get('enabled', {}).get('b', False))
-
-                synth.set_amplitude('a', synth_state.get('amplitude_a', 0))
-                synth.set_amplitude('b', synth_state.get('amplitude_b', 0))
-                synth.set_frequency('a', synth_state.get('frequency_a', 50))
-                synth.set_frequency('b', synth_state.get('frequency_b', 50))
-                synth.set_phase('a', synth_state.get('phase_a', 0))
-                synth.set_phase('b', synth_state.get('phase_b', 0))
-
-                for ch in ['a', 'b']:
-                    harmonics_key = f'harmonics_{ch}'
-                    harmonics = synth_state.get(harmonics_key, [])
-                    for h in harmonics:
-                        synth.set_harmonics(ch, h)
+                synth.clear_harmonics(ch)
             except Exception as e:
-                logger.warning(f"Synth {i} failed to set state: {e}")
+                logger.warning(f"Synth {i} failed to clear harmonics on channel {ch}: {e}")
 
-    @staticmethod
-    def reconnect_synths(state_manager, existing_synths=None):
-        """Reconnect synthesizers after USB disruptions while preserving phase assignment."""
-        expected_count = SystemInitializer._expected_synth_count(state_manager)
-        endpoints = SynthDiscovery.find_all_synth_endpoints()
-        if len(endpoints) != expected_count:
-            raise Exception(
-                f"Expected {expected_count} synthesizers, discovered {len(endpoints)}. "
-                "Waiting for all synths before reconnect."
-            )
+        synth_state = state_manager.synths[i] if i < len(state_manager.synths) else None
+        if not synth_state:
+            return
 
-        # Only close current handles once we know all expected synth endpoints are present.
-        if existing_synths:
-            SystemInitializer._close_synths(existing_synths)
+        try:
+            if not synth_state.get('auto_on', False):
+                synth.set_enabled('a', False)
+                synth.set_enabled('b', False)
+            else:
+                synth.set_enabled('a', synth_state.get('enabled', {}).get('a', False))
+                synth.set_enabled('b', synth_state.get('enabled', {}).get('b', False))
 
-        ordered_endpoints = SystemInitializer._order_endpoints(endpoints, state_manager)
-        synths, connected_endpoints = SystemInitializer._connect_synths(ordered_endpoints)
-        if len(synths) != expected_count:
-            raise Exception(
-                f"Expected {expected_count} synthesizers after reconnect, connected {len(synths)}"
-            )
+            synth.set_amplitude('a', synth_state.get('amplitude_a', 0))
+            synth.set_amplitude('b', synth_state.get('amplitude_b', 0))
+            synth.set_frequency('a', synth_state.get('frequency_a', 50))
+            synth.set_frequency('b', synth_state.get('frequency_b', 50))
+            synth.set_phase('a', synth_state.get('phase_a', 0))
+            synth.set_phase('b', synth_state.get('phase_b', 0))
 
-        SystemInitializer._sync_synths_to_state(synths, state_manager)
-        state_manager.synth_device_map = [ep.get('device_key') for ep in connected_endpoints]
-        state_manager.num_synths = len(synths)
-        state_manager.save_state()
-        return synths, connected_endpoints
+            for ch in ['a', 'b']:
+                harmonics_key = f'harmonics_{ch}'
+                harmonics = synth_state.get(harmonics_key, [])
+                for h in harmonics:
+                    synth.set_harmonics(ch, h)
+        except Exception as e:
+            logger.warning(f"Synth {i} failed to set state: {e}")
 
     @staticmethod
-    def initialize_system(state_manager):
-        # The full code of initialize_system from main.py, with references to globals replaced by arguments.
+    def _sync_synths_to_state(synths, state_manager, indices=None):
+        """Push the saved state to every synth (or only `indices`), one worker per synth UART."""
+        indices = range(len(synths)) if indices is None else indices
+        with ThreadPoolExecutor(max_workers=max(1, len(synths))) as executor:
+            for future in [executor.submit(SystemInitializer._sync_synth_to_state, i, synths[i], state_manager)
+                           for i in indices]:
+                future.result()
 
-        init_start_time = time.time()
-        logger.info("=" * 60)
-        logger.info(" NHP_Synth Initialization ".center(60))
-        logger.info("=" * 60)
-        logger.info("[Step 1/4] Connecting to I2C rotary encoders...")
+    @staticmethod
+    def reconnect_synths(state_manager, existing_synths=None, slots=None):
+        """
+        Reconnect synthesizers after USB disruptions while preserving phase assignment.
+
+        Only `slots` (default: every slot) are closed and reopened; healthy synths keep
+        their handle and are not probed. Slots whose device is still missing get an
+        OfflineSynth. Returns the full slot-aligned (synths, endpoints) lists.
+        """
+        existing = list(existing_synths or [])
+        count = max(SystemInitializer._expected_synth_count(state_manager), len(existing))
+        targets = set(range(count) if slots is None else slots) | set(range(len(existing), count))
+        keep_paths = [synth.port for i, synth in enumerate(existing) if i not in targets and synth.online]
 
+        try:
+            endpoints = SynthDiscovery.find_all_synth_endpoints(known_paths=keep_paths)
+        except Exception as e:
+            logger.warning(f"Reconnect discovery failed: {e}")
+            endpoints = []
+        assignment = SystemInitializer._assign_slots(endpoints, state_manager, count)
+        targets |= set(range(count, len(assignment)))
+
+        for i in targets:
+            if i < len(existing):
+                SystemInitializer._close_synths([existing[i]])
+        connected = SystemInitializer._connect_synths(assignment, indices=sorted(targets))
+
+        synths = [connected[i][0] if i in connected else existing[i] for i in range(len(assignment))]
+        endpoints = [connected[i][1] if i in connected else assignment[i] for i in range(len(assignment))]
+        state_manager.ensure_synth_count(len(synths))
+        SystemInitializer._sync_synths_to_state(synths, state_manager, indices=sorted(targets))
+        SystemInitializer._update_device_map(state_manager, endpoints)
+        state_manager.num_synths = len(synths)
+        state_manager.request_save()
+        return synths, endpoints
+
+    @staticmethod
+    def _init_encoders():
         encoder_configs = [
             {'addr': 0x36, 'name': 'Voltage', 'function': 'voltage'},
             {'addr': 0x37, 'name': 'Current', 'function': 'current'},
@@ -192,6 +266,8 @@ class SystemInitializer:
 
         encoder_init_errors = []
         try:
+            if busio is None:
+                raise RuntimeError("I2C libraries (board/busio/adafruit_seesaw) are not available")
             i2c = busio.I2C(board.SCL, board.SDA)
             logger.info("Scanning I2C bus for devices...")
             available_addresses = set()
@@ -303,92 +379,142 @@ class SystemInitializer:
                 logger.warning("Encoder/Peripheral issues:")
                 for err in encoder_init_errors:
                     logger.warning(f"  {err}")
-            step1_end_time = time.time()
-            step1_duration = step1_end_time - init_start_time
-            logger.info(f"[Step 1/4] Done in {step1_duration:.2f}s")
+            return {'encoders': encoders, 'buttons': buttons, 'pixels': pixels}
         except Exception as e:
             logger.error(f"✗ Failed to connect to rotary encoder: {e}")
             logger.warning("Make sure the I2C rotary encoder is connected and powered")
             raise
-    
-        for i in range(120):
-            color = tuple(int(c * 255) for c in colorsys.hsv_to_rgb(3*i/360, 1.0, 1.0))
-            for pixel in pixels.values():
-                if pixel:
-                    pixel.fill(color)
-                    if i == 120:
-                        pixel.fill((255, 255, 255))
-
-        step2_start_time = time.time()
-        logger.info("[Step 2/4] Connecting to synthesizer...")
-        try:
-            expected_count = SystemInitializer._expected_synth_count(state_manager)
-            endpoints = SynthDiscovery.find_all_synth_endpoints()
-            if len(endpoints) != expected_count:
-                raise Exception(
-                    f"Expected {expected_count} synthesizers, discovered {len(endpoints)}. "
-                    "Aborting initialization."
-                )
 
-            ordered_endpoints = SystemInitializer._order_endpoints(endpoints, state_manager)
-            logger.info(f"Found {len(ordered_endpoints)} synthesizer(s)")
+    @staticmethod
+    def _discover_synths(state_manager, report=None):
+        """
+        Wait for the expected number of synths to enumerate (up to DEVICE_WAIT_SECONDS),
+        so boot proceeds as soon as the slowest USB device appears instead of after a fixed delay.
+        If some never appear the rig starts degraded with those slots offline, unless
+        NHP_REQUIRE_ALL_SYNTHS is set. Returns the slot-aligned endpoint list.
+        """
+        expected_count = SystemInitializer._expected_synth_count(state_manager)
+        started = time.monotonic()
+        deadline = started + DEVICE_WAIT_SECONDS
+        attempts = 0
+        while True:
+            attempts += 1
+            try:
+                endpoints = SynthDiscovery.find_all_synth_endpoints()
+            except Exception as e:
+                endpoints = []
+                last_error = e
+            else:
+                last_error = None
+            if len(endpoints) >= expected_count:
+                break
+            if time.monotonic() >= deadline:
+                if not endpoints or REQUIRE_ALL_SYNTHS:
+                    raise Exception(
+                        f"Expected {expected_count} synthesizers, discovered {len(endpoints)}"
+                        f"{f' ({last_error})' if last_error else ''}. Aborting initialization."
+                    )
+                logger.warning(f"Only {len(endpoints)}/{expected_count} synthesizer(s) found, running degraded")
+                break
+            logger.info(f"Found {len(endpoints)}/{expected_count} synthesizer(s), waiting for the rest...")
+            time.sleep(DEVICE_POLL_INTERVAL)
+
+        if report is not None:
+            report.note('synth_discovery', 'attempts', attempts)
+            report.note('synth_discovery', 'found', len(endpoints))
+            report.note('synth_discovery', 'expected', expected_count)
+            report.note('synth_discovery', 'wait_s', round(time.monotonic() - started, 3))
+        logger.info(f"Found {len(endpoints)} synthesizer(s)")
+        return SystemInitializer._assign_slots(endpoints, state_manager, expected_count)
 
-            synths, connected_endpoints = SystemInitializer._connect_synths(ordered_endpoints)
-            if len(synths) != expected_count:
-                raise Exception(
-                    f"Expected {expected_count} synthesizers, connected {len(synths)}. "
-                    "Aborting initialization."
-                )
+    @staticmethod
+    def initialize_system(state_manager, pipeline=None):
+        """
+        Bring up the hardware as a dependency graph:
 
-            state_manager.synth_device_map = [ep.get('device_key') for ep in connected_endpoints]
-            device_paths = [ep.get('path') for ep in connected_endpoints]
+            i2c_encoders -> led_animator -> encoder_leds
+            synth_discovery -> synth_connect -> state_sync
 
-            step2_end_time = time.time()
-            step2_duration = step2_end_time - step2_start_time
-            logger.info(f"[Step 2/4] Done in {step2_duration:.2f}s")
+        The two chains (and any stages the caller already added to `pipeline`,
+        such as the web server) run concurrently; per-stage timings land in
+        STARTUP_REPORT.
+        """
+        logger.info("=" * 60)
+        logger.info(" NHP_Synth Initialization ".center(60))
+        logger.info("=" * 60)
 
-            step3_start_time = time.time()
-            logger.info("[Step 3/4] Syncing synths to state_manager...")
+        pipeline = pipeline if pipeline is not None else StartupPipeline()
+        report = pipeline.report
+        led_colors = {
+            'voltage': (255, 0, 0),
+            'current': (255, 165, 0),
+            'frequency': (0, 255, 0),
+            'phase': (0, 0, 255),
+            'harmonics': (255, 0, 255)
+        }
+
+        def start_animator(inputs):
+            # Startup rainbow plays on the animator thread while the synths connect
+            led_animator = LedAnimator(inputs['i2c_encoders']['pixels']).start()
+            led_animator.rainbow(duration=1.2)
+            return led_animator
+
+        def set_encoder_leds(inputs):
+            # Shown once the startup rainbow finishes
+            for func, color in led_colors.items():
+                inputs['led_animator'].set_base(func, color)
+
+        def connect_synths(inputs):
+            slots = inputs['synth_discovery']
+            connected = SystemInitializer._connect_synths(slots, report)
+            synths = [connected[i][0] for i in range(len(slots))]
+            endpoints = [connected[i][1] for i in range(len(slots))]
+            online = sum(1 for synth in synths if synth.online)
+            if online == 0 or (REQUIRE_ALL_SYNTHS and online < len(synths)):
+                SystemInitializer._close_synths(synths)
+                raise Exception(
+                    f"Expected {len(synths)} synthesizers, connected {online}. "
+                    "Aborting initialization."
+                )
+            if online < len(synths):
+                offline = [i for i, synth in enumerate(synths) if not synth.online]
+                logger.warning(f"Running degraded: synth(s) {offline} offline, reconnect will keep looking")
+            report.note('synth_connect', 'online', online)
+            state_manager.ensure_synth_count(len(synths))
+            SystemInitializer._update_device_map(state_manager, endpoints)
+            return synths, endpoints
+
+        def sync_state(inputs):
+            synths, _ = inputs['synth_connect']
             SystemInitializer._sync_synths_to_state(synths, state_manager)
 
-            step3_end_time = time.time()
-            step3_duration = step3_end_time - step3_start_time
-            logger.info(f"[Step 3/4] Done in {step3_duration:.2f}s")
-
-            step4_start_time = time.time()
-            logger.info("[Step 4/4] Initializing control system...")
-            num_synths = len(synths)
-            led_colors = {
-                'voltage': (255, 0, 0),
-                'current': (255, 165, 0),
-                'frequency': (0, 255, 0),
-                'phase': (0, 0, 255),
-                'harmonics': (255, 0, 255)
-            }
-
-            for func, pixel in pixels.items():
-                if pixel and func in led_colors:
-                    try:
-                        pixel.fill(led_colors[func])
-                    except:
-                        pass
-
-            step4_end_time = time.time()
-            step4_duration = step4_end_time - step4_start_time
-            total_init_time = step4_end_time - init_start_time
-            logger.info(f"[Step 4/4] Done in {step4_duration:.2f}s")
-            logger.info(f"✓ Initialization complete in {total_init_time:.2f}s.")
-            logger.info("-" * 60)
-            return {
-                'encoders': encoders,
-                'buttons': buttons,
-                'pixels': pixels,
-                'synths': synths,
-                'device_paths': device_paths,
-                'led_colors': led_colors,
-                'num_synths': num_synths
-            }
-        except Exception as e:
-            if 'synths' in locals():
-                SystemInitializer._close_synths(synths)
+        pipeline.stage('i2c_encoders', lambda inputs: SystemInitializer._init_encoders())
+        pipeline.stage('led_animator', start_animator, after=('i2c_encoders',))
+        pipeline.stage('encoder_leds', set_encoder_leds, after=('led_animator',))
+        pipeline.stage('synth_discovery', lambda inputs: SystemInitializer._discover_synths(state_manager, report))
+        pipeline.stage('synth_connect', connect_synths, after=('synth_discovery',))
+        pipeline.stage('state_sync', sync_state, after=('synth_connect',))
+
+        try:
+            results = pipeline.run()
+        except StartupError as e:
+            if 'led_animator' in e.results:
+                e.results['led_animator'].stop()
+            if 'synth_connect' in e.results:
+                SystemInitializer._close_synths(e.results['synth_connect'][0])
             raise
+
+        hardware = results['i2c_encoders']
+        synths, connected_endpoints = results['synth_connect']
+        logger.info(f"✓ Initialization complete in {report.snapshot()['total_s']:.2f}s.")
+        logger.info("-" * 60)
+        return {
+            'encoders': hardware['encoders'],
+            'buttons': hardware['buttons'],
+            'pixels': hardware['pixels'],
+            'synths': synths,
+            'device_paths': [ep.get('path') if ep else None for ep in connected_endpoints],
+            'led_colors': led_colors,
+            'led_animator': results['led_animator'],
+            'num_synths': len(synths)
+        }
@@ -0,0 +1,5 @@
+"""
+Unit tests for the host, runnable without synths or encoder hardware:
+
+    cd host && python3 -m unittest discover -s tests -t .
+"""
@@ -0,0 +1,78 @@
+import os
+import tempfile
+import unittest
+
+from utils import command_journal
+from utils.command_journal import (CommandJournal, read_journal, recover_state, recover_state_manager,
+                                   _HEADER, _pack_command, _pack_snapshot)
+
+SNAPSHOT = {'num_synths': 1, 'synths': [{'amplitude_a': 10.0, 'enabled': {'a': True, 'b': True}}]}
+
+
+class FakeStateManager:
+    def __init__(self, state_file):
+        self.state_file = state_file
+        self.synths = None
+        self.num_synths = 0
+        self.changed = False
+
+    def mark_changed(self):
+        self.changed = True
+
+
+class CommandJournalTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.addCleanup(self.directory.cleanup)
+        self.path = os.path.join(self.directory.name, 'session-20260101-000000' + command_journal.FILE_SUFFIX)
+
+    def write(self, *tails):
+        """A session: snapshot at t=1, amplitude 20 at t=2 and 30 at t=3, then `tails` appended."""
+        data = (_HEADER.pack(command_journal.MAGIC, command_journal.FORMAT_VERSION, 0.0) +
+                _pack_snapshot(1.0, SNAPSHOT) +
+                _pack_command(2.0, 'encoder', 0, 'set_amplitude', 'a', 20.0) +
+                _pack_command(3.0, 'rest', 0, 'set_amplitude', 'a', 30.0))
+        with open(self.path, 'wb') as f:
+            f.write(data + b''.join(tails))
+        return len(data)
+
+    def assert_recovers_amplitude(self, amplitude, last_t):
+        with self.assertLogs('NHP_Synth', 'WARNING'):
+            state, t = recover_state(self.path)
+        self.assertEqual(state['synths'][0]['amplitude_a'], amplitude)
+        self.assertEqual(t, last_t)
+
+    def test_round_trip_through_the_writer(self):
+        journal = CommandJournal()
+        journal.open(self.directory.name, snapshot_fn=lambda: SNAPSHOT, flush_interval=0.01)
+        journal.record(0, 'set_amplitude', 'a', 40.0, source='encoder')
+        journal.close()
+        commands = [r for r in read_journal(journal.path) if r['type'] == 'command']
+        self.assertEqual([(r['source'], r['command'], r['channel'], r['value']) for r in commands],
+                         [('encoder', 'set_amplitude', 'a', 40.0)])
+
+    def test_truncated_tail_keeps_the_complete_records(self):
+        self.write(_pack_command(4.0, 'rest', 0, 'set_amplitude', 'a', 40.0)[:-3])
+        self.assert_recovers_amplitude(30.0, 3.0)
+
+    def test_zero_filled_tail_keeps_the_records_before_it(self):
+        self.write(b'\0' * 4096)
+        self.assert_recovers_amplitude(30.0, 3.0)
+
+    def test_garbled_record_ends_the_file(self):
+        garbled = bytearray(_pack_command(4.0, 'rest', 0, 'set_amplitude', 'a', 40.0))
+        garbled[14] ^= 0xff  # inside the value: type and command still parse, the CRC does not
+        self.write(bytes(garbled), _pack_command(5.0, 'rest', 0, 'set_amplitude', 'a', 50.0))
+        self.assert_recovers_amplitude(30.0, 3.0)
+
+    def test_damaged_tail_does_not_skip_recovery(self):
+        self.write(b'\0' * 512)
+        manager = FakeStateManager(os.path.join(self.directory.name, 'missing.json'))
+        with self.assertLogs('NHP_Synth', 'INFO'):
+            self.assertTrue(recover_state_manager(manager, self.directory.name))
+        self.assertEqual(manager.synths[0]['amplitude_a'], 30.0)
+        self.assertTrue(manager.changed)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,103 @@
+import unittest
+
+from utils.command_queue import coalesce_commands, dispatch_synth_command
+
+
+def multi(synth_id, channels):
+    return {'synth_id': synth_id, 'command': 'set_harmonics_multi', 'channel': None, 'value': channels}
+
+
+class CoalesceMultiTest(unittest.TestCase):
+    def test_per_channel_multis_both_survive(self):
+        a = multi(0, {'a': [{'order': 3, 'amplitude': 10.0, 'phase': 0.0}]})
+        b = multi(0, {'b': [{'order': 5, 'amplitude': 4.0, 'phase': 0.0}]})
+        kept, dropped = coalesce_commands([a, b])
+        self.assertEqual(kept, [a, b])
+        self.assertEqual(dropped, 0)
+
+    def test_later_multi_replaces_only_its_channels(self):
+        first = multi(0, {'a': [{'order': 3, 'amplitude': 10.0, 'phase': 0.0}], 'b': []})
+        second = multi(0, {'a': [{'order': 3, 'amplitude': 20.0, 'phase': 0.0}]})
+        kept, dropped = coalesce_commands([first, second])
+        self.assertEqual(kept, [multi(0, {'b': []}), second])
+        self.assertEqual(dropped, 0)
+        self.assertEqual(set(first['value']), {'a', 'b'})  # the queued command is not modified
+
+    def test_fully_replaced_multi_is_dropped(self):
+        first = multi(0, {'a': []})
+        other_synth = multi(1, {'a': []})
+        second = multi(0, {'a': [{'order': 7, 'amplitude': 1.0, 'phase': 0.0}], 'b': []})
+        kept, dropped = coalesce_commands([first, other_synth, second])
+        self.assertEqual(kept, [other_synth, second])
+        self.assertEqual(dropped, 1)
+
+    def test_setters_still_last_write_wins(self):
+        commands = [{'synth_id': 0, 'command': 'set_amplitude', 'channel': 'a', 'value': v} for v in (10, 20)]
+        kept, dropped = coalesce_commands(commands)
+        self.assertEqual(kept, commands[1:])
+        self.assertEqual(dropped, 1)
+
+
+def rig(changes, **extra):
+    return dict({'synth_id': None, 'command': 'rig_apply', 'channel': None, 'value': changes}, **extra)
+
+
+class CoalesceRigApplyTest(unittest.TestCase):
+    def test_rig_applies_merge_latest_value_per_key(self):
+        first = rig([{'synth_id': 0, 'channel': 'a', 'frequency': 51.0},
+                     {'synth_id': 0, 'channel': 'b', 'frequency': 51.0, 'phase': 10.0}], batch_id='x')
+        amplitude = {'synth_id': 1, 'command': 'set_amplitude', 'channel': 'a', 'value': 50}
+        second = rig([{'synth_id': 0, 'channel': 'b', 'frequency': 52.0},
+                      {'synth_id': 1, 'channel': 'a', 'frequency': 52.0}], batch_id='y')
+        kept, dropped = coalesce_commands([first, amplitude, second])
+        self.assertEqual(dropped, 1)
+        self.assertEqual(kept[1], amplitude)
+        self.assertEqual(kept[0]['value'], [{'synth_id': 0, 'channel': 'a', 'frequency': 51.0},
+                                            {'synth_id': 0, 'channel': 'b', 'frequency': 52.0, 'phase': 10.0},
+                                            {'synth_id': 1, 'channel': 'a', 'frequency': 52.0}])
+        self.assertEqual(kept[0]['batch_ids'], ['x', 'y'])
+
+    def test_frequency_write_between_keeps_rig_applies_apart(self):
+        first = rig([{'synth_id': 0, 'channel': 'a', 'frequency': 51.0}])
+        direct = {'synth_id': 0, 'command': 'set_frequency', 'channel': 'a', 'value': 40.0}
+        second = rig([{'synth_id': 0, 'channel': 'b', 'frequency': 52.0}])
+        kept, dropped = coalesce_commands([first, direct, second])
+        self.assertEqual(kept, [first, direct, second])
+        self.assertEqual(dropped, 0)
+
+
+class FakeSynth:
+    def __init__(self):
+        self.calls = []
+
+    def set_harmonics(self, channel, value):
+        self.calls.append(('set_harmonics', channel, value))
+
+    def set_harmonics_multi(self, channels):
+        self.calls.append(('set_harmonics_multi', channels))
+
+
+class FakeStateManager:
+    def __init__(self, synths):
+        self.synths = synths
+        self.changed = []
+
+    def mark_changed(self, synth_id=None, key=None):
+        self.changed.append((synth_id, key))
+
+
+class DispatchHarmonicListTest(unittest.TestCase):
+    def test_list_form_replaces_channel_and_records_state(self):
+        state = {'harmonics_a': [], 'harmonics_b': [{'id': 'old', 'order': 9, 'amplitude': 1.0, 'phase': 0.0}]}
+        synth, manager = FakeSynth(), FakeStateManager([state])
+        dispatch_synth_command(synth, 0, manager, 'set_harmonics', 'b', [2.0, 0.0])
+        harmonics = [{'id': 'order-3', 'order': 3, 'amplitude': 2.0, 'phase': 0.0}]
+        self.assertEqual(synth.calls[0], ('set_harmonics_multi', {'b': harmonics}))
+        self.assertEqual(state['harmonics_b'], harmonics)
+        self.assertEqual([(h['order'], h['amplitude']) for h in state['harmonics_a']], [(3, 2.0), (5, 0.0)])
+        self.assertIn((0, 'harmonics_b'), manager.changed)
+        self.assertIn((0, 'harmonics_a'), manager.changed)
+
+
+if __name__ == '__main__':
+    unittest.main()
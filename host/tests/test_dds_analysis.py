@@ -0,0 +1,51 @@
+import unittest
+
+from utils import dds_analysis, dds_model
+from tests.test_dds_model import synth
+
+
+def command(name, channel, value, synth_id=0):
+    return {'synth_id': synth_id, 'command': name, 'channel': channel, 'value': value}
+
+
+class ProjectCommandsTest(unittest.TestCase):
+    def test_multi_replaces_listed_channels_without_injection(self):
+        state = synth(harmonics_a=[{'id': 'x', 'order': 3, 'amplitude': 5.0, 'phase': 0.0}],
+                      harmonics_b=[{'id': 'y', 'order': 5, 'amplitude': 2.0, 'phase': 0.0}])
+        projected = dds_analysis.project_commands(state, [command('set_harmonics_multi', None, {
+            'b': [{'order': 7, 'amplitude': 3.0, 'phase': 90.0}]})])
+        self.assertEqual(projected['harmonics_a'], state['harmonics_a'])
+        self.assertEqual(projected['harmonics_b'], [{'order': 7, 'amplitude': 3.0, 'phase': 90.0}])
+
+    def test_list_form_sets_odd_orders_and_injects_current_into_voltage(self):
+        state = synth(harmonics_a=[{'id': 'order-3', 'order': 3, 'amplitude': 4.0, 'phase': 0.0}])
+        projected = dds_analysis.project_commands(state, [command('set_harmonics', 'b', [0.0, 6.0])])
+        self.assertEqual([(h['order'], h['amplitude']) for h in projected['harmonics_b']], [(5, 6.0)])
+        # The 0 clears the order 3 injected before
+        self.assertEqual(sorted((h['order'], h['amplitude']) for h in projected['harmonics_a']),
+                         [(3, 0.0), (5, 6.0)])
+        self.assertEqual(state['harmonics_b'], [])  # the state entry is not modified
+
+
+@unittest.skipUnless(dds_model.available(), "numpy is not installed")
+class ClipWarningsTest(unittest.TestCase):
+    def test_multi_and_list_form_are_checked(self):
+        loud = synth(amplitude_a=100.0)
+        multi = command('set_harmonics_multi', None, {'a': [{'order': 3, 'amplitude': 60.0, 'phase': 90.0}]})
+        listed = command('set_harmonics', 'a', [60.0])
+        for cmd in (multi, listed):
+            warnings = dds_analysis.clip_warnings([loud], [cmd])
+            self.assertEqual([w['channel'] for w in warnings], ['a'])
+
+    def test_repeated_check_is_cached_per_version(self):
+        cmd = command('set_amplitude', 'a', 100.0)
+        state = synth(harmonics_a=[{'id': 'x', 'order': 3, 'amplitude': 60.0, 'phase': 90.0}])
+        first = dds_analysis.clip_warnings([state], [cmd], version=7)
+        self.assertTrue(first)
+        # A cached answer does not look at the state again; a new version does
+        self.assertEqual(dds_analysis.clip_warnings([synth()], [cmd], version=7), first)
+        self.assertEqual(dds_analysis.clip_warnings([synth()], [cmd], version=8), [])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,33 @@
+import unittest
+
+from utils import dds_model
+
+
+def synth(**overrides):
+    state = {'frequency_a': 50.0, 'frequency_b': 50.0, 'amplitude_a': 80.0, 'amplitude_b': 80.0,
+             'phase_a': 0.0, 'phase_b': -120.0, 'harmonics_a': [], 'harmonics_b': [],
+             'enabled': {'a': True, 'b': True}}
+    state.update(overrides)
+    return state
+
+
+@unittest.skipUnless(dds_model.available(), "numpy is not installed")
+class DdsModelTest(unittest.TestCase):
+    def test_disabled_channel_is_mid_scale(self):
+        result = dds_model.model_synth(synth(enabled={'a': True, 'b': False}))
+        self.assertEqual(set(result['channels']['b']['samples'].tolist()), {127})
+        self.assertGreater(result['channels']['a']['max_code'], 200)
+
+    def test_enable_flag_is_part_of_the_key(self):
+        enabled = dds_model.model_synth(synth())
+        disabled = dds_model.model_synth(synth(enabled={'a': False, 'b': False}))
+        self.assertNotEqual(enabled['key'], disabled['key'])
+
+    def test_negative_phase_plays_as_zero(self):
+        negative = dds_model.model_synth(synth(phase_b=-120.0))['channels']['b']['samples']
+        zero = dds_model.model_synth(synth(phase_b=0.0))['channels']['b']['samples']
+        self.assertEqual(negative.tolist(), zero.tolist())
+
+
+if __name__ == '__main__':
+    unittest.main()
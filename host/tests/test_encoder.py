@@ -0,0 +1,114 @@
+import queue
+import unittest
+from unittest import mock
+
+from synth_control import encoder_manager
+from synth_control.encoder import Encoder
+from synth_control.encoder_manager import EncoderManager, ROTATION_WINDOW
+
+
+class FakeSeesaw:
+    """Seesaw registers of one encoder: the raw position and the delta since it was last read."""
+
+    def __init__(self):
+        self.raw = 0
+        self._read_at = 0
+
+    def turn(self, ticks):
+        self.raw += ticks
+
+    def encoder_position(self, encoder=0):
+        return self.raw
+
+    def encoder_delta(self, encoder=0):
+        delta, self._read_at = self.raw - self._read_at, self.raw
+        return delta
+
+    def digital_read_bulk(self, mask):
+        return mask  # pulled up: not pressed
+
+
+class FakeIncrementalEncoder:
+    """adafruit_seesaw.rotaryio.IncrementalEncoder: position is the negated register."""
+
+    def __init__(self, seesaw, encoder=0):
+        self._seesaw = seesaw
+        self._encoder = encoder
+
+    @property
+    def position(self):
+        return -self._seesaw.encoder_position(self._encoder)
+
+
+class FakeButton:
+    _pin = 24
+    value = True
+
+
+class EncoderReadTest(unittest.TestCase):
+    def test_read_turns_the_same_way_as_position(self):
+        seesaw = FakeSeesaw()
+        by_register = Encoder(FakeIncrementalEncoder(seesaw), FakeButton())
+        by_position = Encoder(FakeIncrementalEncoder(seesaw), FakeButton())
+        for ticks in (1, 3, -2, -5, 4):
+            seesaw.turn(ticks)
+            delta, pressed = by_register.read()
+            self.assertEqual(delta, by_position.delta)
+            self.assertFalse(pressed)
+
+
+class FakeManagedEncoder:
+    pixel = None
+
+    def __init__(self):
+        self.delta = 0
+        self.pressed = False
+
+    def read(self):
+        delta, self.delta = self.delta, 0
+        return delta, self.pressed
+
+
+class FakeState:
+    def __init__(self):
+        self.num_synths = 1
+        self.synths = [{'amplitude_a': 50.0}]
+
+    def set_value(self, synth_id, key, value):
+        self.synths[synth_id][key] = value
+
+    def mark_selection_changed(self):
+        pass
+
+
+class FakeAnimator:
+    def __getattr__(self, name):
+        return lambda *args, **kwargs: None
+
+
+class EncoderThreadingTest(unittest.TestCase):
+    def test_input_thread_side_leaves_state_to_handle_events(self):
+        encoder, state, commands = FakeManagedEncoder(), FakeState(), queue.Queue()
+        manager = EncoderManager({'voltage': encoder}, {'voltage': (0, 0, 0)}, state=state,
+                                 command_queue=commands, animator=FakeAnimator())
+        now = [1000.0]
+        with mock.patch.object(encoder_manager.time, 'time', lambda: now[0]):
+            encoder.delta = 3
+            manager.read_inputs()
+            now[0] += 2 * ROTATION_WINDOW
+            manager.read_inputs()
+            encoder.pressed = True
+            manager.read_inputs()
+            encoder.pressed = False
+            manager.read_inputs()
+            # Read and batched, but nothing handled: state and queue are the control thread's
+            self.assertEqual(state.synths[0]['amplitude_a'], 50.0)
+            self.assertTrue(commands.empty())
+            self.assertEqual(manager.handle_events(), 2)
+        self.assertEqual(state.synths[0]['amplitude_a'], 53.0)
+        self.assertEqual(commands.get_nowait()['value'], 53.0)
+        self.assertEqual(manager.selection_mode['voltage'], {'synth': 0, 'ch': 'a'})
+
+
+if __name__ == '__main__':
+    unittest.main()
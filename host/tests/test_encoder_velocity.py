@@ -0,0 +1,72 @@
+import random
+import unittest
+from unittest import mock
+
+from synth_control import encoder_manager
+from synth_control.encoder_manager import EncoderManager, ROTATION_WINDOW
+
+
+class FakeEncoder:
+    pixel = None
+
+    def __init__(self):
+        self.delta = 0
+
+    def read(self):
+        delta, self.delta = self.delta, 0
+        return delta, False
+
+
+class FakeState:
+    def mark_selection_changed(self):
+        pass
+
+
+class FakeAnimator:
+    def set_base(self, func, color):
+        pass
+
+
+class VelocityTest(unittest.TestCase):
+    def setUp(self):
+        self.encoder = FakeEncoder()
+        self.manager = EncoderManager({'volt': self.encoder}, {'volt': (0, 0, 0)}, state=FakeState(),
+                                      animator=FakeAnimator())
+        self.steps = []
+        self.manager.on_rotate = lambda func, step: self.steps.append(step)
+        self.now = 1000.0
+
+    POLL = 0.005  # EncoderInputThread polls much faster than ROTATION_WINDOW
+
+    def spin(self, direction, detent_interval, duration, jitter=0.0, seed=1):
+        """Turn one detent every `detent_interval` (+- jitter) seconds for `duration`; returns the detent count."""
+        rng = random.Random(seed)
+        start = self.now
+        next_detent = start
+        turned = 0
+        with mock.patch.object(encoder_manager.time, 'time', lambda: self.now):
+            while self.now < start + duration + 2 * ROTATION_WINDOW:
+                if self.now >= next_detent and self.now < start + duration:
+                    self.encoder.delta += direction
+                    turned += 1
+                    next_detent += detent_interval + rng.uniform(-jitter, jitter)
+                self.manager.update()
+                self.now += self.POLL
+        return turned
+
+    def test_one_detent_per_window_is_not_accelerated(self):
+        for seed in range(20):
+            self.steps = []
+            turned = self.spin(1, ROTATION_WINDOW, 2.0, jitter=0.4 * ROTATION_WINDOW, seed=seed)
+            self.assertEqual(sum(self.steps), turned)
+
+    def test_slow_turn_is_step_one(self):
+        turned = self.spin(-1, 0.3, 3.0, jitter=0.1)
+        self.assertEqual(self.steps, [-1] * turned)
+
+    def test_fast_spin_is_accelerated(self):
+        turned = self.spin(1, 0.005, 1.0)
+        self.assertGreater(sum(self.steps), 4 * turned)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,137 @@
+import queue
+import time
+import unittest
+from contextlib import contextmanager
+from unittest import mock
+
+from utils.command_queue import process_command_queue
+from utils.rig_sync import RigChange, RigChangeQueue
+
+
+class FakeSynth:
+    """Stages and arms like the firmware; the commit applies when the test calls edge()."""
+    online = True
+    sync_commit = True
+
+    def __init__(self, frequency_a):
+        self.running_frequency = {'a': frequency_a, 'b': frequency_a}
+        self.staged = {}
+        self.armed = None
+        self.applied = None
+        self.rc_reads = 0
+        self.direct = []
+
+    @contextmanager
+    def transaction(self):
+        yield self
+
+    def stage_frequency(self, channel, frequency):
+        assert self.armed is None, "firmware rejects staged writes while a commit is armed"
+        self.staged[channel] = frequency
+
+    def set_frequency(self, channel, frequency):
+        self.direct.append((channel, frequency))
+        self.running_frequency[channel] = frequency
+
+    def commit_staged(self, version, at_sync=True):
+        self.armed = version
+        if not at_sync:
+            self.edge()
+        return True
+
+    def edge(self):
+        if self.armed is not None:
+            self.applied, self.armed = self.armed, None
+            self.running_frequency.update(self.staged)
+            self.staged = {}
+
+    def get_commit(self):
+        self.rc_reads += 1
+        return (self.applied, 2 if self.armed is not None else 0)
+
+
+class FakeState:
+    def __init__(self, synths):
+        self.synths = synths
+
+    def set_value(self, synth_id, key, value):
+        self.synths[synth_id][key] = value
+
+
+class RigChangeTest(unittest.TestCase):
+    def setUp(self):
+        self.synths = [FakeSynth(20.0), FakeSynth(20.0)]
+        # The encoder has already moved state to the new frequency; the wait must not use it
+        self.state = FakeState([{'frequency_a': 70.0}, {'frequency_a': 70.0}])
+        self.changes = [{'synth_id': i, 'channel': 'a', 'frequency': 70.0} for i in range(2)]
+
+    def test_wait_uses_the_running_frequency(self):
+        change = RigChange(self.changes, self.synths, self.state).start()
+        self.assertAlmostEqual(change.check_at - time.monotonic(), 1 / 20.0, delta=0.01)
+
+    def test_poll_does_not_block_until_the_edge(self):
+        change = RigChange(self.changes, self.synths, self.state).start()
+        started = time.monotonic()
+        self.assertFalse(change.poll())
+        self.assertLess(time.monotonic() - started, 0.01)
+        self.assertEqual(sum(s.rc_reads for s in self.synths), 0)  # edge not due yet
+        change.check_at = 0.0
+        self.assertFalse(change.poll())
+        for synth in self.synths:
+            synth.edge()
+        self.assertTrue(change.poll())
+        self.assertTrue(change.result['coherent'])
+        self.assertEqual([s['status'] for s in change.result['synths']], ['synced', 'synced'])
+
+    def test_missed_edge_is_forced_after_the_deadline(self):
+        change = RigChange(self.changes, self.synths, self.state).start()
+        change.check_at = change.deadline = 0.0
+        with self.assertLogs('NHP_Synth', 'WARNING'):
+            self.assertTrue(change.poll())
+        self.assertEqual([s['status'] for s in change.result['synths']], ['forced', 'forced'])
+
+    def test_queue_merges_changes_waiting_for_the_armed_one(self):
+        rig_changes = RigChangeQueue()
+        results = []
+        rig_changes.submit(self.changes, self.synths, self.state, on_done=results.append)
+        for frequency in (30.0, 40.0):
+            rig_changes.submit([{'synth_id': 0, 'channel': 'a', 'frequency': frequency}], self.synths, self.state,
+                               on_done=results.append)
+        self.assertEqual(rig_changes.waiting[0], [{'synth_id': 0, 'channel': 'a', 'frequency': 40.0}])
+        rig_changes.active[0].check_at = 0.0
+        for synth in self.synths:
+            synth.edge()
+        rig_changes.poll()  # first change confirmed, merged one armed
+        self.assertEqual(len(results), 1)
+        rig_changes.active[0].check_at = 0.0
+        self.synths[0].edge()
+        rig_changes.poll()
+        self.assertFalse(rig_changes.busy)
+        self.assertEqual(len(results), 3)  # both merged submissions get the merged result
+        self.assertEqual(self.synths[0].running_frequency['a'], 40.0)
+
+
+    def test_direct_write_before_confirmation_is_not_lost(self):
+        rig_changes = RigChangeQueue()
+        commands = queue.Queue()
+        with mock.patch('utils.rig_sync.RIG_CHANGES', rig_changes):
+            commands.put({'synth_id': None, 'command': 'rig_apply', 'channel': None, 'value': self.changes})
+            process_command_queue(commands, self.synths, self.state)
+            # Armed, edge not seen yet: a later direct write to synth 0
+            commands.put({'synth_id': 0, 'command': 'set_frequency', 'channel': 'a', 'value': 55.0})
+            process_command_queue(commands, self.synths, self.state)
+            self.assertEqual(self.synths[0].direct, [])
+            rig_changes.active[0].check_at = 0.0
+            for synth in self.synths:
+                synth.edge()
+            process_command_queue(commands, self.synths, self.state)  # rig change confirmed, the write armed
+            rig_changes.active[0].check_at = 0.0
+            self.synths[0].edge()
+            process_command_queue(commands, self.synths, self.state)
+            self.assertFalse(rig_changes.busy)
+        self.assertEqual(self.synths[0].running_frequency['a'], 55.0)
+        self.assertEqual(self.state.synths[0]['frequency_a'], 55.0)
+        self.assertEqual(self.synths[1].running_frequency['a'], 70.0)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,59 @@
+import os
+import tempfile
+import threading
+import time
+import unittest
+
+from utils.shared_memory import ChangeSignal, SeqlockBlock
+from utils.shared_state import SharedStateView, encode_command
+
+
+class WaitForChangesTest(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.TemporaryDirectory()
+        self.block = SeqlockBlock(os.path.join(self.dir.name, 'state'), 1 << 16, create=True)
+        self.listener = ChangeSignal.listen(os.path.join(self.dir.name, 'signal'))
+        self.notifier = ChangeSignal.notifier(self.listener.path)
+        self.publish(1)
+        # A fallback poll far longer than the test, so only the signal can wake the view in time
+        self.view = SharedStateView(self.block, None, signal=self.listener, poll_interval=10.0)
+
+    def tearDown(self):
+        self.notifier.close()
+        self.listener.close()
+        self.block.close()
+        self.dir.cleanup()
+
+    def publish(self, version, amplitude=0.0):
+        self.block.write(encode_command({'version': version, 'num_synths': 1,
+                                         'synths': [{'amplitude_a': amplitude}],
+                                         'defaults': [], 'selectionMode': None}))
+
+    def test_publish_wakes_the_waiter(self):
+        def publish_later():
+            time.sleep(0.05)
+            self.publish(2, amplitude=50.0)
+            self.notifier.notify()
+
+        threading.Thread(target=publish_later).start()
+        start = time.monotonic()
+        version, paths = self.view.wait_for_changes(1, timeout=5.0)
+        self.assertLess(time.monotonic() - start, 1.0)
+        self.assertEqual(version, 2)
+        self.assertEqual(paths, {('synths',)})  # first diff has no base
+        self.publish(3, amplitude=60.0)
+        self.notifier.notify()
+        self.assertEqual(self.view.wait_for_changes(2, timeout=5.0), (3, {(0, 'amplitude_a')}))
+
+    def test_timeout_without_change(self):
+        self.view.poll_interval = 0.01
+        self.assertEqual(self.view.wait_for_changes(1, timeout=0.05), (1, set()))
+
+    def test_notify_without_listener_is_dropped(self):
+        signal = ChangeSignal.notifier(os.path.join(self.dir.name, 'nobody'))
+        signal.notify()
+        signal.close()
+
+
+if __name__ == '__main__':
+    unittest.main()
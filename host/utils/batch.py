@@ -0,0 +1,158 @@
+"""
+Batch commands (POST /api/batch).
+
+The web side validates every command of a batch up front and queues the batch
+as a single {'command': 'batch'} item, so it reaches the control loop as one
+unit and no other command is interleaved with it. The control loop applies it
+with utils.command_queue.apply_batch (one transaction per synth) and puts the
+per-command results on a results queue - a CommandRing back to the web process
+in the split host - where BatchResults hands them to the waiting request.
+"""
+import logging
+import queue
+import threading
+import time
+import uuid
+
+logger = logging.getLogger("NHP_Synth")
+
+MAX_BATCH_COMMANDS = 256
+CHANNELS = ('a', 'b')
+
+# command -> (low, high) for the numeric setters, as enforced by SynthInterface
+RANGES = {
+    'set_amplitude': (0.0, 100.0),
+    'set_frequency': (20.0, 8000.0),
+    'set_phase': (-360.0, 360.0),
+}
+
+
+def _number(value, low, high, name):
+    if isinstance(value, bool):
+        raise ValueError(f"{name} must be a number")
+    try:
+        number = float(value)
+    except (TypeError, ValueError):
+        raise ValueError(f"{name} must be a number")
+    if not low <= number <= high:
+        raise ValueError(f"{name} must be between {low:g} and {high:g}")
+    return number
+
+
+def _harmonic(value, with_id):
+    if not isinstance(value, dict):
+        raise ValueError("harmonic must be an object")
+    try:
+        harmonic = {'id': int(value['id'])} if with_id else {}
+        harmonic['order'] = order = int(value['order'])
+    except (KeyError, TypeError, ValueError):
+        raise ValueError("harmonic needs integer 'order'" + (" and 'id'" if with_id else ""))
+    # set_harmonics deletes a harmonic (by id) by moving it below order 3
+    if (order >= 3 and order % 2 == 0) or (order < 3 and not with_id):
+        raise ValueError("harmonic order must be odd and >= 3")
+    harmonic['amplitude'] = _number(value.get('amplitude'), 0.0, 100.0, 'harmonic amplitude')
+    harmonic['phase'] = _number(value.get('phase', 0), -360.0, 360.0, 'harmonic phase')
+    return harmonic
+
+
+def validate_command(entry, num_synths):
+    """Normalised copy of one batch entry; raises ValueError if it cannot be applied."""
+    if not isinstance(entry, dict):
+        raise ValueError("command must be an object")
+    synth_id = entry.get('synth_id')
+    if isinstance(synth_id, bool) or not isinstance(synth_id, int) or not 0 <= synth_id < num_synths:
+        raise ValueError(f"synth_id must be an integer from 0 to {num_synths - 1}")
+    command = entry.get('command')
+    channel = entry.get('channel')
+    value = entry.get('value')
+
+    if command == 'set_harmonics_multi':
+        if not isinstance(value, dict) or not value or any(ch not in CHANNELS for ch in value):
+            raise ValueError("value must map channel 'a'/'b' to a list of harmonics")
+        if not all(isinstance(harmonics, list) for harmonics in value.values()):
+            raise ValueError("value must map channel 'a'/'b' to a list of harmonics")
+        value = {ch: [_harmonic(h, with_id=False) for h in harmonics] for ch, harmonics in value.items()}
+        for ch, harmonics in value.items():
+            orders = [h['order'] for h in harmonics]
+            if len(set(orders)) != len(orders):
+                raise ValueError(f"channel {ch} lists a harmonic order more than once")
+        return {'synth_id': synth_id, 'command': command, 'channel': None, 'value': value}
+
+    if channel not in CHANNELS:
+        raise ValueError("channel must be 'a' or 'b'")
+    if command == 'set_enabled':
+        if not isinstance(value, bool):
+            raise ValueError("value must be true or false")
+    elif command in RANGES:
+        value = _number(value, *RANGES[command], 'value')
+    elif command == 'set_harmonics':
+        value = _harmonic(value, with_id=True)
+    else:
+        raise ValueError(f"unsupported command {command!r}")
+    return {'synth_id': synth_id, 'command': command, 'channel': channel, 'value': value}
+
+
+def validate_batch(entries, num_synths):
+    """Returns (commands, errors); errors is a list of {'index', 'error'} and empty when all are valid."""
+    commands, errors = [], []
+    for index, entry in enumerate(entries):
+        try:
+            commands.append(validate_command(entry, num_synths))
+        except ValueError as e:
+            errors.append({'index': index, 'error': str(e)})
+    return commands, errors
+
+
+class BatchResults:
+    """Hands batch results from the control loop's results queue to the requests waiting for them."""
+
+    def __init__(self, results_queue, poll_interval=0.005):
+        self.results_queue = results_queue
+        self.poll_interval = poll_interval
+        self._lock = threading.Lock()
+        self._waiting = {}  # batch_id -> [Event, result]
+        self._thread = None
+
+    def start(self):
+        if self._thread is None:
+            self._thread = threading.Thread(target=self._run, name="batch-results", daemon=True)
+            self._thread.start()
+        return self
+
+    def register(self):
+        """New batch id; call before queueing the batch so its result cannot be missed."""
+        batch_id = uuid.uuid4().hex
+        with self._lock:
+            self._waiting[batch_id] = [threading.Event(), None]
+        return batch_id
+
+    def discard(self, batch_id):
+        with self._lock:
+            self._waiting.pop(batch_id, None)
+
+    def wait(self, batch_id, timeout):
+        """The batch's {'results', 'apply_s'}, or None if it was not applied within timeout."""
+        with self._lock:
+            slot = self._waiting.get(batch_id)
+        if slot is None:
+            return None
+        slot[0].wait(timeout)
+        with self._lock:
+            self._waiting.pop(batch_id, None)
+        return slot[1]
+
+    def _run(self):
+        while True:
+            try:
+                result = self.results_queue.get_nowait()
+            except queue.Empty:
+                time.sleep(self.poll_interval)
+                continue
+            except RuntimeError as e:
+                logger.error(f"Batch results: {e}")
+                continue
+            with self._lock:
+                slot = self._waiting.get(result.get('batch_id'))
+            if slot is not None:
+                slot[1] = result
+                slot[0].set()
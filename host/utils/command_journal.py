@@ -0,0 +1,398 @@
+"""
+Append-only binary journal of every command applied to the synths.
+
+SynthInterface setters call JOURNAL.record() after a command is written to the
+UART; the caller's source (encoder, socket, rest, calibration, system, ...) is
+taken from the journal_source() context of the current thread. record() only
+appends a tuple to an in-memory list - a background thread packs pending
+records into one write every flush interval, so the command path never waits
+on the SD card. Full state snapshots are written at open and periodically, so
+recovery and replay only need the last snapshot plus the commands after it.
+
+File layout (little endian), one file per session in the journal directory:
+
+    header    b'NHPJ' u8 version, f64 session start (unix time)
+    command   u8 type=1, f64 t, u8 source, u8 synth, u8 command, u8 channel, payload, u32 crc
+                set_harmonics: u16 order, f64 amplitude, f64 phase (requested, uncorrected)
+                clear_harmonics: (none)
+                otherwise:     f64 value (set_enabled: 0/1)
+    snapshot  u8 type=2, f64 t, u32 length, compact JSON {"num_synths", "synths"}, u32 crc
+
+crc is the CRC32 of the record bytes before it (version 1 files have none). A power
+cut on the SD card can leave the tail truncated, zero-filled or garbled, so
+read_journal() ends the file at the first record that does not check out (type,
+command, length, CRC or JSON) and keeps everything before it.
+"""
+import glob
+import json
+import logging
+import os
+import struct
+import threading
+import time
+import zlib
+from contextlib import contextmanager
+
+from utils.metrics import REGISTRY
+
+logger = logging.getLogger("NHP_Synth")
+
+MAGIC = b'NHPJ'
+FORMAT_VERSION = 2
+FILE_SUFFIX = '.nhpj'
+DEFAULT_DIR = os.environ.get(
+    'NHP_JOURNAL_DIR', os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), 'journal'))
+
+REC_COMMAND = 1
+REC_SNAPSHOT = 2
+
+# Append only: indices are the on-disk encoding.
+SOURCES = ('system', 'dashboard', 'socket', 'rest', 'encoder', 'calibration', 'replay')
+COMMANDS = ('set_enabled', 'set_amplitude', 'set_frequency', 'set_phase', 'set_harmonics', 'clear_harmonics')
+CHANNELS = ('a', 'b')
+NO_CHANNEL = 0xff
+
+_HEADER = struct.Struct('<4sBd')
+_RECORD = struct.Struct('<BdBBBB')
+_VALUE = struct.Struct('<d')
+_HARMONIC = struct.Struct('<Hdd')
+_SNAPSHOT = struct.Struct('<BdI')
+_CRC = struct.Struct('<I')
+
+_SOURCE_CODES = {name: i for i, name in enumerate(SOURCES)}
+_COMMAND_CODES = {name: i for i, name in enumerate(COMMANDS)}
+
+JOURNAL_RECORDS = REGISTRY.counter(
+    'nhp_journal_records_total', 'Records written to the command journal', ('type',))
+JOURNAL_DROPPED = REGISTRY.counter(
+    'nhp_journal_dropped_total', 'Journal records dropped because the writer fell behind')
+
+_context = threading.local()
+
+
+@contextmanager
+def journal_source(source):
+    """Attribute journal records made by this thread inside the block to `source`."""
+    previous = getattr(_context, 'source', None)
+    _context.source = source
+    try:
+        yield
+    finally:
+        _context.source = previous
+
+
+def _with_crc(record):
+    return record + _CRC.pack(zlib.crc32(record))
+
+
+def _pack_command(t, source, synth_id, command, channel, value):
+    channel_code = CHANNELS.index(channel) if channel in CHANNELS else NO_CHANNEL
+    head = _RECORD.pack(REC_COMMAND, t, _SOURCE_CODES.get(source, 0), synth_id & 0xff,
+                        _COMMAND_CODES[command], channel_code)
+    if command == 'set_harmonics':
+        order, amplitude, phase = value
+        return _with_crc(head + _HARMONIC.pack(int(order), float(amplitude), float(phase)))
+    if command == 'clear_harmonics':
+        return _with_crc(head)
+    return _with_crc(head + _VALUE.pack(float(value)))
+
+
+def _pack_snapshot(t, state):
+    body = json.dumps(state, separators=(',', ':')).encode('utf-8')
+    return _with_crc(_SNAPSHOT.pack(REC_SNAPSHOT, t, len(body)) + body)
+
+
+class CommandJournal:
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._wake = threading.Event()
+        self._pending = []
+        self._file = None
+        self._thread = None
+        self._stop = False
+        self._snapshot_fn = None
+        self._since_snapshot = 0
+        self.path = None
+
+    @property
+    def enabled(self):
+        return self._file is not None
+
+    def open(self, directory=DEFAULT_DIR, snapshot_fn=None, flush_interval=0.25, fsync_interval=2.0,
+             snapshot_interval=60.0, max_pending=100000, keep_sessions=20):
+        """Start a new session file and the background writer.
+
+        snapshot_fn() must return a JSON-serialisable {"num_synths", "synths"} dict.
+        """
+        if self._file is not None:
+            return self.path
+        os.makedirs(directory, exist_ok=True)
+        self._prune(directory, keep_sessions - 1)
+        started = time.time()
+        self.path = os.path.join(directory, time.strftime('session-%Y%m%d-%H%M%S', time.localtime(started)) + FILE_SUFFIX)
+        self._file = open(self.path, 'ab', buffering=0)
+        self._file.write(_HEADER.pack(MAGIC, FORMAT_VERSION, started))
+        self._snapshot_fn = snapshot_fn
+        self._max_pending = max_pending
+        self._stop = False
+        self._thread = threading.Thread(
+            target=self._writer_loop, args=(flush_interval, fsync_interval, snapshot_interval),
+            name='command-journal', daemon=True)
+        self._thread.start()
+        logger.info(f"Command journal: {self.path}")
+        return self.path
+
+    def close(self):
+        """Flush pending records, write a closing snapshot and close the file."""
+        if self._thread is not None:
+            self._stop = True
+            self._wake.set()
+            self._thread.join(timeout=5.0)
+            self._thread = None
+        if self._file is not None:
+            try:
+                os.fsync(self._file.fileno())
+            except OSError:
+                pass
+            self._file.close()
+            self._file = None
+
+    def record(self, synth_id, command, channel=None, value=None, source=None):
+        """Queue one applied command. Cheap and non-blocking; a no-op while the journal is closed."""
+        if self._file is None or command not in _COMMAND_CODES:
+            return
+        source = source or getattr(_context, 'source', None) or 'system'
+        with self._lock:
+            if len(self._pending) >= self._max_pending:
+                JOURNAL_DROPPED.inc()
+                return
+            self._pending.append((time.time(), source, synth_id, command, channel, value))
+
+    def _writer_loop(self, flush_interval, fsync_interval, snapshot_interval):
+        self._write_snapshot()
+        last_fsync = last_snapshot = time.monotonic()
+        while True:
+            self._wake.wait(flush_interval)
+            self._wake.clear()
+            stopping = self._stop
+            self._write_pending()
+            now = time.monotonic()
+            if stopping or (self._since_snapshot and now - last_snapshot >= snapshot_interval):
+                self._write_snapshot()
+                last_snapshot = now
+            if stopping:
+                return
+            if now - last_fsync >= fsync_interval:
+                try:
+                    os.fsync(self._file.fileno())
+                except OSError:
+                    pass
+                last_fsync = now
+
+    def _write_pending(self):
+        with self._lock:
+            batch, self._pending = self._pending, []
+        if not batch:
+            return
+        chunks = []
+        for record in batch:
+            try:
+                chunks.append(_pack_command(*record))
+            except (ValueError, TypeError, KeyError, struct.error):
+                JOURNAL_DROPPED.inc()
+        try:
+            self._file.write(b''.join(chunks))
+            JOURNAL_RECORDS.inc(len(chunks), type='command')
+            self._since_snapshot += len(chunks)
+        except OSError as e:
+            JOURNAL_DROPPED.inc(len(chunks))
+            logger.warning(f"Command journal write failed: {e}")
+
+    def _write_snapshot(self):
+        if self._snapshot_fn is None:
+            return
+        for _ in range(3):
+            try:
+                data = _pack_snapshot(time.time(), self._snapshot_fn())
+                break
+            except RuntimeError:
+                continue  # state mutated mid-serialise; retry
+            except Exception as e:
+                logger.warning(f"Command journal snapshot failed: {e}")
+                return
+        else:
+            return
+        try:
+            self._file.write(data)
+            JOURNAL_RECORDS.inc(type='snapshot')
+            self._since_snapshot = 0
+        except OSError as e:
+            logger.warning(f"Command journal snapshot write failed: {e}")
+
+    @staticmethod
+    def _prune(directory, keep):
+        sessions = sorted(glob.glob(os.path.join(directory, '*' + FILE_SUFFIX)))
+        for path in sessions[:max(0, len(sessions) - max(0, keep))]:
+            try:
+                os.remove(path)
+            except OSError:
+                pass
+
+
+def _parse_record(data, pos, crc_size):
+    """(record dict, end) of the record at `pos`, or (None, None) if it is incomplete or damaged."""
+    kind = data[pos]
+    if kind == REC_COMMAND:
+        end = pos + _RECORD.size
+        if end > len(data):
+            return None, None
+        _, t, source, synth_id, command, channel = _RECORD.unpack_from(data, pos)
+        if command >= len(COMMANDS):
+            return None, None
+        command = COMMANDS[command]
+        if command == 'set_harmonics':
+            if end + _HARMONIC.size > len(data):
+                return None, None
+            order, amplitude, phase = _HARMONIC.unpack_from(data, end)
+            end += _HARMONIC.size
+            value = {'order': order, 'amplitude': amplitude, 'phase': phase}
+        elif command == 'clear_harmonics':
+            value = None
+        else:
+            if end + _VALUE.size > len(data):
+                return None, None
+            value = _VALUE.unpack_from(data, end)[0]
+            end += _VALUE.size
+            if command == 'set_enabled':
+                value = bool(value)
+        record = {
+            'type': 'command', 't': t,
+            'source': SOURCES[source] if source < len(SOURCES) else str(source),
+            'synth_id': synth_id, 'command': command,
+            'channel': CHANNELS[channel] if channel < len(CHANNELS) else None,
+            'value': value,
+        }
+    elif kind == REC_SNAPSHOT:
+        if pos + _SNAPSHOT.size > len(data):
+            return None, None
+        _, t, length = _SNAPSHOT.unpack_from(data, pos)
+        end = pos + _SNAPSHOT.size + length
+        if end > len(data):
+            return None, None
+        record = None  # decoded once the CRC checks out
+    else:
+        return None, None
+    if crc_size:
+        if end + crc_size > len(data) or _CRC.unpack_from(data, end)[0] != zlib.crc32(data[pos:end]):
+            return None, None
+        end += crc_size
+    if kind == REC_SNAPSHOT:
+        try:
+            state = json.loads(data[pos + _SNAPSHOT.size:end - crc_size].decode('utf-8'))
+        except ValueError:
+            return None, None
+        record = {'type': 'snapshot', 't': t, 'state': state}
+    return record, end
+
+
+def read_journal(path):
+    """Yield the journal's records as dicts, ending at the first incomplete or damaged record."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) < _HEADER.size:
+        return
+    magic, version, started = _HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version not in (1, FORMAT_VERSION):
+        raise ValueError(f"{path} is not an NHP_Synth command journal (v1-v{FORMAT_VERSION})")
+    crc_size = _CRC.size if version >= 2 else 0
+    pos = _HEADER.size
+    yield {'type': 'session', 't': started}
+    while pos < len(data):
+        record, end = _parse_record(data, pos, crc_size)
+        if record is None:
+            logger.warning(f"{os.path.basename(path)}: incomplete or damaged record at byte {pos}, "
+                           f"ignoring the last {len(data) - pos} bytes")
+            return
+        yield record
+        pos = end
+
+
+def latest_journal(directory=DEFAULT_DIR):
+    sessions = sorted(glob.glob(os.path.join(directory, '*' + FILE_SUFFIX)))
+    return sessions[-1] if sessions else None
+
+
+def apply_command_to_state(synths, record):
+    """Apply one journaled command to a synth state list (as process_command_queue would)."""
+    synth_id = record['synth_id']
+    if synth_id >= len(synths):
+        return
+    synth = synths[synth_id]
+    command, channel, value = record['command'], record['channel'], record['value']
+    if channel not in CHANNELS:
+        return
+    if command == 'set_enabled':
+        synth.setdefault('enabled', {})[channel] = bool(value)
+    elif command in ('set_amplitude', 'set_frequency', 'set_phase'):
+        synth[command[4:] + '_' + channel] = value
+    elif command == 'clear_harmonics':
+        synth['harmonics_' + channel] = []
+    elif command == 'set_harmonics':
+        # Harmonic ids are not journaled; match on order, which is unique per channel.
+        harmonics = synth.setdefault('harmonics_' + channel, [])
+        for harmonic in harmonics:
+            if harmonic.get('order') == value['order']:
+                harmonic['amplitude'] = value['amplitude']
+                harmonic['phase'] = value['phase']
+                break
+        else:
+            next_id = max((h.get('id', -1) for h in harmonics), default=-1) + 1
+            harmonics.append({'id': next_id, **value})
+
+
+def recover_state(path):
+    """Rebuild the newest state from a journal: last snapshot plus the commands after it.
+
+    Returns (state dict, time of the last record) or (None, None) if there is no snapshot.
+    """
+    state = None
+    last_t = None
+    for record in read_journal(path):
+        if record['type'] == 'snapshot':
+            state = record['state']
+        elif record['type'] == 'command' and state is not None:
+            apply_command_to_state(state.get('synths', []), record)
+        if record['type'] != 'session':
+            last_t = record['t']
+    return (state, last_t) if state is not None else (None, None)
+
+
+JOURNAL = CommandJournal()
+
+
+def recover_state_manager(state_manager, directory=DEFAULT_DIR):
+    """Crash recovery: restore synth state from the newest journal if it is newer than the state file.
+
+    The state file is written behind (debounced), so after a crash the journal's
+    last snapshot plus subsequent commands can be up to a few seconds ahead of it.
+    """
+    path = latest_journal(directory)
+    if path is None:
+        return False
+    try:
+        state, last_t = recover_state(path)
+        saved_at = os.path.getmtime(state_manager.state_file) if os.path.exists(state_manager.state_file) else 0.0
+    except (OSError, ValueError) as e:
+        logger.warning(f"Command journal recovery skipped: {e}")
+        return False
+    if state is None or last_t is None or last_t <= saved_at:
+        return False
+    synths = state.get('synths')
+    if not isinstance(synths, list) or not synths:
+        return False
+    state_manager.synths = synths
+    state_manager.num_synths = len(synths)
+    state_manager.mark_changed()
+    logger.info(f"Recovered synth state from {os.path.basename(path)} "
+                f"({last_t - saved_at:.1f} s newer than {os.path.basename(state_manager.state_file)})")
+    return True
@@ -1,99 +1,316 @@
-def process_command_queue(command_queue, synths, state_manager):
-    """Process all commands in the multiprocessing queue and dispatch to synths."""
+# Setters whose value replaces the previous one outright: when several are queued for
+# the same (synth, command, channel) only the newest needs to reach the synth.
+LAST_WRITE_WINS = ('set_enabled', 'set_amplitude', 'set_frequency', 'set_phase',
+                   'set_auto_on', 'set_defaults', 'apply_settings')
+
+# State-only commands from the dashboard web process (split host): they change what the
+# control process owns - saved defaults, auto-on flags, settings - and never touch a synth.
+STATE_COMMANDS = ('set_auto_on', 'set_defaults', 'apply_settings')
+
+
+def coalesce_commands(commands):
+    """Drop absolute setters superseded by a later one for the same target; keeps order otherwise.
+
+    set_harmonics_multi carries its channels in the value (channel is None), so each
+    channel of a multi is superseded separately: a multi keeps the channels no later
+    multi for the same synth replaces, and is dropped when none are left.
+
+    A rig_apply joins an earlier one (latest value per synth, channel and key, at the
+    earlier one's place) unless a frequency or phase write lies between them; the
+    merged command lists every batch_id in 'batch_ids'.
+
+    Returns (commands, dropped_count).
+    """
+    from utils.rig_sync import merge_rig_changes
+    last_index = {}
+    for i, cmd in enumerate(commands):
+        if cmd.get('command') in LAST_WRITE_WINS:
+            last_index[(cmd.get('synth_id'), cmd.get('command'), cmd.get('channel'))] = i
+    replaced_later = {}  # synth_id -> channels set by a later multi
+    kept = []
+    for i in range(len(commands) - 1, -1, -1):
+        cmd = commands[i]
+        command = cmd.get('command')
+        if command in LAST_WRITE_WINS:
+            if last_index[(cmd.get('synth_id'), command, cmd.get('channel'))] != i:
+                continue
+        elif command == 'set_harmonics_multi' and isinstance(cmd.get('value'), dict):
+            replaced = replaced_later.setdefault(cmd.get('synth_id'), set())
+            channels = {ch: harmonics for ch, harmonics in cmd['value'].items() if ch not in replaced}
+            replaced.update(channels)
+            if not channels:
+                continue
+            if len(channels) != len(cmd['value']):
+                cmd = dict(cmd, value=channels)
+        kept.append(cmd)
+    kept.reverse()
+
+    merged = []
+    open_rig = None  # index in merged of the rig_apply a later one can join
+    for cmd in kept:
+        command = cmd.get('command')
+        if command == 'rig_apply' and isinstance(cmd.get('value'), list):
+            if open_rig is not None:
+                earlier = merged[open_rig]
+                merged[open_rig] = dict(earlier, value=merge_rig_changes(earlier['value'], cmd['value']),
+                                        batch_ids=_batch_ids(earlier) + _batch_ids(cmd))
+                continue
+            open_rig = len(merged)
+        elif command in ('set_frequency', 'set_phase', 'batch'):
+            open_rig = None
+        merged.append(cmd)
+    return merged, len(commands) - len(merged)
+
+
+def _batch_ids(cmd):
+    if 'batch_ids' in cmd:
+        return cmd['batch_ids']
+    return [cmd['batch_id']] if cmd.get('batch_id') is not None else []
+
+
+def apply_state_command(state_manager, synth_id, command, value):
+    from utils.settings_service import SETTINGS
+    if command == 'apply_settings' and isinstance(value, dict):
+        # Already validated and saved by the web process; refresh this process's copy
+        SETTINGS.replace(value, persist=False)
+    elif command == 'set_defaults' and isinstance(value, list):
+        state_manager.defaults = value
+        state_manager.mark_defaults_changed()
+    elif command == 'set_auto_on' and synth_id is not None and 0 <= synth_id < len(state_manager.synths):
+        state_manager.set_value(synth_id, 'auto_on', bool(value))
+
+
+def _apply_harmonic_update(synth, synth_state, target_channel, harmonic_value):
+    """Apply one harmonic update to the target channel and keep state in sync."""
+    harmonic_id = harmonic_value.get('id')
+    new_order = harmonic_value.get('order')
+    channel_key = 'harmonics_' + target_channel
+
+    # Check if the id exists and the order is changing.
+    original_harmonic = None
+    for harmonic in synth_state[channel_key]:
+        if harmonic['id'] == harmonic_id:
+            original_harmonic = harmonic
+            break
+
+    if original_harmonic and original_harmonic['order'] != new_order:
+        # Set original harmonic's amplitude to zero to remove it.
+        synth.set_harmonics(target_channel, {
+            'id': harmonic_id,
+            'order': original_harmonic['order'],
+            'amplitude': 0,
+            'phase': 0
+        })
+        original_harmonic['amplitude'] = 0
+
+    # Setting amplitude to 0 deletes the harmonic if order < 3.
+    command_value = dict(harmonic_value)
+    if new_order < 3:
+        command_value['amplitude'] = 0
+        command_value['order'] = 3
+
+    synth.set_harmonics(target_channel, command_value)
+
+    # Update in-memory state.
+    update_harmonic_state(synth_state, target_channel, harmonic_value)
+
+
+def harmonics_from_amplitudes(amplitudes, include_zero=False):
+    """
+    The list form of set_harmonics (POST /api/synths/<id>/harmonics with a list or a
+    comma-separated string): amplitudes of orders 3, 5, 7, ... in turn, at phase 0,
+    replacing the channel's harmonics. A 0 leaves its order out unless `include_zero`.
+    """
+    return [{'id': f'order-{3 + 2 * i}', 'order': 3 + 2 * i, 'amplitude': float(amplitude), 'phase': 0.0}
+            for i, amplitude in enumerate(amplitudes) if include_zero or float(amplitude) > 0]
+
+
+def update_harmonic_state(synth_state, target_channel, harmonic_value):
+    """Record one harmonic update in a synth state entry: replace by id, append, or delete (order < 3)."""
+    harmonic_id = harmonic_value.get('id')
+    new_order = harmonic_value.get('order')
+    channel_key = 'harmonics_' + target_channel
+    for harmonic in synth_state[channel_key]:
+        if harmonic['id'] == harmonic_id:
+            if new_order < 3:
+                synth_state[channel_key].remove(harmonic)
+            else:
+                harmonic['order'] = new_order
+                harmonic['amplitude'] = harmonic_value.get('amplitude')
+                harmonic['phase'] = harmonic_value.get('phase', 0)
+            break
+    else:
+        synth_state[channel_key].append({
+            'id': harmonic_id,
+            'order': new_order,
+            'amplitude': harmonic_value.get('amplitude'),
+            'phase': harmonic_value.get('phase', 0)
+        })
+
+
+def dispatch_synth_command(synth, synth_id, state_manager, command, channel, value):
+    """Send one setter to a synth and record it in the state manager."""
+    synth_state = state_manager.synths[synth_id]
+    if command == 'set_enabled':
+        synth.set_enabled(channel, value)
+        state_manager.set_enabled(synth_id, channel, value)
+    elif command == 'set_amplitude':
+        synth.set_amplitude(channel, value)
+        if channel in ('a', 'b'):
+            state_manager.set_value(synth_id, 'amplitude_' + channel, value)
+    elif command == 'set_frequency':
+        synth.set_frequency(channel, value)
+        if channel in ('a', 'b'):
+            state_manager.set_value(synth_id, 'frequency_' + channel, value)
+    elif command == 'set_phase':
+        synth.set_phase(channel, value)
+        if channel in ('a', 'b'):
+            state_manager.set_value(synth_id, 'phase_' + channel, value)
+    elif command == 'set_harmonics' and isinstance(value, list):
+        harmonics = harmonics_from_amplitudes(value)
+        synth.set_harmonics_multi({channel: harmonics})
+        synth_state['harmonics_' + channel] = [dict(h) for h in harmonics]
+        state_manager.mark_changed(synth_id, 'harmonics_' + channel)
+        # Current harmonics are injected into the voltage channel, as for a single harmonic;
+        # a 0 clears the order injected before
+        if channel == 'b':
+            for harmonic in harmonics_from_amplitudes(value, include_zero=True):
+                _apply_harmonic_update(synth, synth_state, 'a', harmonic)
+            state_manager.mark_changed(synth_id, 'harmonics_a')
+    elif command == 'set_harmonics':
+        _apply_harmonic_update(synth, synth_state, channel, value)
+        state_manager.mark_changed(synth_id, 'harmonics_' + channel)
+
+        # Finite source impedance behavior:
+        # applying current harmonics also injects matching voltage harmonics.
+        if channel == 'b':
+            _apply_harmonic_update(synth, synth_state, 'a', value)
+            state_manager.mark_changed(synth_id, 'harmonics_a')
+    elif command == 'set_harmonics_multi':
+        # Re-send of harmonics already in state (calibration change):
+        # value is {'a': [...], 'b': [...]}, one firmware transaction.
+        synth.set_harmonics_multi(value)
+
+
+def apply_batch(commands, synths, state_manager):
+    """
+    Apply a validated batch (see utils/batch.py) as one transaction per synth.
+
+    Synths are visited in the order of their first command and each synth's
+    commands run in batch order inside synth.transaction(): they reach the UART
+    together, and if any of them fails none are written and that synth's state
+    is restored. Returns {'results': [one per command], 'apply_s': seconds}.
+    """
+    import copy
+    import time
+
+    started = time.perf_counter()
+    results = [None] * len(commands)
+    groups = {}
+    for index, cmd in enumerate(commands):
+        groups.setdefault(cmd.get('synth_id'), []).append(index)
+
+    for synth_id, indices in groups.items():
+        def report(status, error=None, failed_index=None):
+            for i in indices:
+                entry = {'index': i, 'synth_id': synth_id, 'status': status}
+                if error is not None:
+                    entry['error'] = error if failed_index in (None, i) else 'Aborted with its synth transaction'
+                results[i] = entry
+
+        if not isinstance(synth_id, int) or not 0 <= synth_id < len(synths):
+            report('failed', f'Unknown synth {synth_id}')
+            continue
+        synth = synths[synth_id]
+        if not synth.online:
+            report('failed', f'Synth {synth_id} is offline')
+            continue
+        synth_state = state_manager.synths[synth_id]
+        before = copy.deepcopy(synth_state)
+        current = None
+        try:
+            with synth.transaction():
+                for current in indices:
+                    cmd = commands[current]
+                    dispatch_synth_command(synth, synth_id, state_manager,
+                                           cmd['command'], cmd.get('channel'), cmd.get('value'))
+                current = None
+        except Exception as e:
+            synth_state.clear()
+            synth_state.update(before)
+            state_manager.mark_changed(synth_id)
+            report('failed', str(e), failed_index=current)
+            continue
+        report('applied')
+
+    return {'results': results, 'apply_s': round(time.perf_counter() - started, 6)}
+
+
+def process_command_queue(command_queue, synths, state_manager, max_commands=None, batch_results=None):
+    """
+    Process the commands waiting in the queue (at most max_commands) and dispatch them to synths.
+
+    batch_results, if given, receives {'batch_id', 'results', 'apply_s'} for each applied batch
+    and the apply_rig_change result (plus batch_id) for each rig_apply. A rig_apply only
+    starts here; its result follows on the pass that sees the commit confirmed (RIG_CHANGES).
+    A set_frequency/set_phase for a synth in a rig change still settling joins the next one.
+    """
     import logging
+    import queue
+    from utils.metrics import COMMANDS_PROCESSED, COMMANDS_COALESCED
+    from utils.command_journal import journal_source
+    from utils.rig_sync import RIG_CHANGES
     logger = logging.getLogger("NHP_Synth")
 
-    def apply_harmonic_update(synth, synth_state, target_channel, harmonic_value):
-        """Apply one harmonic update to the target channel and keep state in sync."""
-        delete_harmonic = False
-        harmonic_id = harmonic_value.get('id')
-        new_order = harmonic_value.get('order')
-        amplitude = harmonic_value.get('amplitude')
-        phase = harmonic_value.get('phase', 0)
-        channel_key = 'harmonics_' + target_channel
-
-        # Check if the id exists and the order is changing.
-        original_harmonic = None
-        for harmonic in synth_state[channel_key]:
-            if harmonic['id'] == harmonic_id:
-                original_harmonic = harmonic
-                break
-
-        if original_harmonic and original_harmonic['order'] != new_order:
-            # Set original harmonic's amplitude to zero to remove it.
-            synth.set_harmonics(target_channel, {
-                'id': harmonic_id,
-                'order': original_harmonic['order'],
-                'amplitude': 0,
-                'phase': 0
-            })
-            original_harmonic['amplitude'] = 0
-
-        # Setting amplitude to 0 deletes the harmonic if order < 3.
-        command_value = dict(harmonic_value)
-        if new_order < 3:
-            command_value['amplitude'] = 0
-            command_value['order'] = 3
-            delete_harmonic = True
-
-        synth.set_harmonics(target_channel, command_value)
-
-        # Update in-memory state.
-        for harmonic in synth_state[channel_key]:
-            if harmonic['id'] == harmonic_id:
-                if delete_harmonic:
-                    synth_state[channel_key].remove(harmonic)
-                else:
-                    harmonic['order'] = new_order
-                    harmonic['amplitude'] = amplitude
-                    harmonic['phase'] = phase
-                break
-        else:
-            synth_state[channel_key].append({
-                'id': harmonic_id,
-                'order': new_order,
-                'amplitude': amplitude,
-                'phase': phase
-            })
-
-    while not command_queue.empty():
+    def report(batch_ids):
+        def deliver(result):
+            for batch_id in batch_ids:
+                try:
+                    batch_results.put(dict(result, batch_id=batch_id), block=False)
+                except queue.Full:
+                    logger.warning(f"Batch {batch_id} applied but its result was dropped")
+        return deliver if batch_results is not None and batch_ids else None
+
+    # Advance the armed rig change, if any, before anything else is written to the synths
+    RIG_CHANGES.poll()
+
+    pending = []
+    while not command_queue.empty() and (max_commands is None or len(pending) < max_commands):
+        try:
+            pending.append(command_queue.get_nowait())
+        except queue.Empty:
+            break
+        except RuntimeError as e:
+            logger.error(f"Command ring: {e}")
+            break
+    commands, coalesced = coalesce_commands(pending)
+    if coalesced:
+        COMMANDS_COALESCED.inc(coalesced)
+
+    for cmd in commands:
         try:
-            cmd = command_queue.get_nowait()
             synth_id = cmd.get('synth_id')
             command = cmd.get('command')
             channel = cmd.get('channel')
             value = cmd.get('value')
-            if synth_id is not None and 0 <= synth_id < len(synths):
-                synth = synths[synth_id]
-                synth_state = state_manager.synths[synth_id]
-                if command == 'set_enabled':
-                    synth.set_enabled(channel, value)
-                    synth_state['enabled'][channel] = value
-                elif command == 'set_amplitude':
-                    synth.set_amplitude(channel, value)
-                    if channel == 'a':
-                        synth_state['amplitude_a'] = value
-                    elif channel == 'b':
-                        synth_state['amplitude_b'] = value
-                elif command == 'set_frequency':
-                    synth.set_frequency(channel, value)
-                    if channel == 'a':
-                        synth_state['frequency_a'] = value
-                    elif channel == 'b':
-                        synth_state['frequency_b'] = value
-                elif command == 'set_phase':
-                    synth.set_phase(channel, value)
-                    if channel == 'a':
-                        synth_state['phase_a'] = value
-                    elif channel == 'b':
-                        synth_state['phase_b'] = value
-                elif command == 'set_harmonics':
-                    apply_harmonic_update(synth, synth_state, channel, value)
-
-                    # Finite source impedance behavior:
-                    # applying current harmonics also injects matching voltage harmonics.
-                    if channel == 'b':
-                        apply_harmonic_update(synth, synth_state, 'a', value)
+            COMMANDS_PROCESSED.inc(source=cmd.get('source', 'dashboard'), command=command)
+            with journal_source(cmd.get('source', 'dashboard')):
+                if command in STATE_COMMANDS:
+                    apply_state_command(state_manager, synth_id, command, value)
+                elif command == 'batch':
+                    deliver = report(_batch_ids(cmd))
+                    result = apply_batch(value, synths, state_manager)
+                    if deliver is not None:
+                        deliver(result)
+                elif command == 'rig_apply':
+                    RIG_CHANGES.submit(value, synths, state_manager, on_done=report(_batch_ids(cmd)),
+                                       source=cmd.get('source', 'dashboard'))
+                elif command in ('set_frequency', 'set_phase') and channel in ('a', 'b') and RIG_CHANGES.targets(synth_id):
+                    # Sent now, the armed commit would overwrite it at the edge: it joins the next change
+                    RIG_CHANGES.submit([{'synth_id': synth_id, 'channel': channel, command[len('set_'):]: value}],
+                                       synths, state_manager, source=cmd.get('source', 'dashboard'))
+                elif synth_id is not None and 0 <= synth_id < len(synths):
+                    dispatch_synth_command(synths[synth_id], synth_id, state_manager, command, channel, value)
 
         except Exception as e:
             logger.error(f"Failed to process command from queue: {e}")
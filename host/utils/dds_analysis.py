@@ -0,0 +1,249 @@
+"""
+Spectrum, THD and crest factor of a synth's modelled DAC output (utils.dds_model).
+
+dds_output() realigns both accumulators at every rising sync edge, so the output
+repeats exactly once per sync cycle. An rfft of one modelled cycle is therefore the
+output's line spectrum at multiples of the sync frequency, with no window and no
+leakage. Clipping, which dds_output() applies silently, is part of it, along with the
+8-bit truncation and the phase jump at the edge.
+
+A channel at the sync frequency has harmonic order n on bin n. A channel at another
+multiple k of channel A's frequency has order n on bin n * k. Any other frequency is not
+periodic in the sync cycle: its orders are read from the nearest bins and the result has
+'synchronous': False.
+
+Levels are fractions of full scale: DAC code 255 is +1 and code 0 is -1, so 100 %
+amplitude without harmonics has a fundamental of about 1.
+
+project_commands() applies setters to a copy of a synth state entry, the way the control
+loop records them, or for set_harmonics_multi the way the firmware applies them.
+clip_warnings() uses that to warn about a command before it reaches a synth; given the
+state version, it answers a repeated check from a cache.
+"""
+import copy
+import json
+import logging
+import math
+import threading
+from collections import OrderedDict
+
+from utils import dds_model
+from utils.command_queue import harmonics_from_amplitudes, update_harmonic_state
+
+logger = logging.getLogger("NHP_Synth")
+np = dds_model.np
+
+CACHE_SIZE = 64
+DEFAULT_ORDERS = 50
+MAX_ORDERS = 500
+# Setters that change the output waveform, so a clip check is worth running
+WAVEFORM_COMMANDS = ('set_amplitude', 'set_frequency', 'set_phase', 'set_harmonics', 'set_harmonics_multi')
+WARNING_CACHE_SIZE = 256
+
+_cache = OrderedDict()  # dds_model.parameter_key -> analysis
+_warning_cache = OrderedDict()  # (state version, synth_id, commands) -> warnings for that synth
+_lock = threading.Lock()
+
+
+def _analyse_channel(channel, modelled, cycle, sync_frequency, frequency_a):
+    x = (modelled['samples'].astype(np.float64) - 127.5) / 127.5
+    spectrum = np.fft.rfft(x)
+    magnitudes = np.abs(spectrum) * (2.0 / cycle)
+    magnitudes[0] /= 2.0
+    if cycle % 2 == 0:
+        magnitudes[-1] /= 2.0
+    # Sine phase at the sync edge, in (-180, 180]
+    phases = (np.degrees(np.angle(spectrum)) + 90.0 + 180.0) % 360.0 - 180.0
+    phases[phases == -180.0] = 180.0
+
+    ratio = channel['frequency'] / frequency_a if frequency_a > 0 else 0.0
+    multiple = max(1, int(round(ratio)))
+    synchronous = abs(ratio - multiple) < 1e-3
+    fundamental_bin = max(1, int(round(channel['frequency'] / sync_frequency)))
+    orders = np.arange(1, (len(magnitudes) - 1) // fundamental_bin + 1)
+    order_magnitudes = magnitudes[orders * fundamental_bin]
+    order_phases = phases[orders * fundamental_bin]
+    for array in (order_magnitudes, order_phases):
+        array.flags.writeable = False
+
+    dc = float(x.mean())
+    rms = float(np.sqrt(np.mean((x - dc) ** 2)))
+    peak = float(np.max(np.abs(x - dc)))
+    fundamental = float(order_magnitudes[0]) if len(order_magnitudes) else 0.0
+    distortion = float(np.sqrt(np.sum(order_magnitudes[1:] ** 2)))
+    # Everything that is not the fundamental: harmonics, quantisation and the edge jump
+    residual = math.sqrt(max(0.0, 2.0 * rms * rms - fundamental * fundamental))
+    configured = math.sqrt(sum((amplitude / 100.0) ** 2 for _, amplitude, _ in channel['harmonics']))
+    # The unclamped sum, so a clipping waveform shows how far past full scale it goes
+    unclamped_peak = float(np.max(np.abs(modelled['dac'].astype(np.float64) - 127.5)) / 127.5)
+
+    return {
+        'frequency': channel['frequency'],
+        'frequency_actual': modelled['frequency_actual'],
+        'synchronous': bool(synchronous),
+        'fundamental_bin': fundamental_bin,
+        'order_magnitudes': order_magnitudes,
+        'order_phases': order_phases,
+        'fundamental': fundamental,
+        'thd_percent': 100.0 * distortion / fundamental if fundamental > 0 else None,
+        'thd_n_percent': 100.0 * residual / fundamental if fundamental > 0 else None,
+        'thd_configured_percent': 100.0 * configured,
+        'dc': dc,
+        'rms': rms,
+        'peak': peak,
+        'crest_factor': peak / rms if rms > 0 else None,
+        'unclamped_peak': unclamped_peak,
+        'clipped_samples': modelled['clipped_samples'],
+    }
+
+
+def analyse_parameters(params):
+    """Analyse one modelled sync cycle of both channels for dds_model.synth_parameters() output (cached)."""
+    modelled = dds_model.model_parameters(params)
+    key = modelled['key']
+    with _lock:
+        result = _cache.get(key)
+        if result is not None:
+            _cache.move_to_end(key)
+            return result
+    cycle = modelled['cycle_samples']
+    result = {
+        'key': key,
+        'sample_rate': modelled['sample_rate'],
+        'cycle_samples': cycle,
+        'sync_frequency': modelled['sync_frequency'],
+        'channels': {ch: _analyse_channel(params[ch], modelled['channels'][ch], cycle,
+                                          modelled['sync_frequency'], params['frequency_a'])
+                     for ch in ('a', 'b')},
+    }
+    with _lock:
+        _cache[key] = result
+        while len(_cache) > CACHE_SIZE:
+            _cache.popitem(last=False)
+    return result
+
+
+def analyse_synth(synth_state, calibrate=True):
+    """Analyse a synth state entry; see analyse_parameters()."""
+    return analyse_parameters(dds_model.synth_parameters(synth_state, calibrate))
+
+
+def analysis_to_json(result, max_order=DEFAULT_ORDERS):
+    """JSON-ready copy of an analyse_parameters() result with orders 1..max_order of the spectrum."""
+    channels = {}
+    for ch, channel in result['channels'].items():
+        data = {name: value for name, value in channel.items() if not name.startswith('order_')}
+        magnitudes = channel['order_magnitudes'][:max_order]
+        fundamental = channel['fundamental']
+        data['spectrum'] = [
+            {'order': order, 'magnitude': float(magnitude), 'phase': round(float(phase), 3),
+             'percent': 100.0 * float(magnitude) / fundamental if fundamental > 0 else None}
+            for order, (magnitude, phase) in enumerate(zip(magnitudes, channel['order_phases']), start=1)
+        ]
+        channels[ch] = data
+    return {
+        'key': result['key'],
+        'sample_rate': result['sample_rate'],
+        'cycle_samples': result['cycle_samples'],
+        'sync_frequency': result['sync_frequency'],
+        'channels': channels,
+    }
+
+
+def project_commands(synth_state, commands):
+    """Copy of a synth state entry with setters applied as dispatch_synth_command() records them."""
+    projected = copy.deepcopy(synth_state)
+    for cmd in commands:
+        command, channel, value = cmd.get('command'), cmd.get('channel'), cmd.get('value')
+        if command == 'set_harmonics_multi' and isinstance(value, dict):
+            # One firmware transaction replacing each listed channel, without injection
+            for ch, harmonics in value.items():
+                if ch in ('a', 'b') and isinstance(harmonics, list):
+                    projected['harmonics_' + ch] = [dict(h) for h in harmonics]
+            continue
+        if channel not in ('a', 'b'):
+            continue
+        if command in ('set_amplitude', 'set_frequency', 'set_phase') and isinstance(value, (int, float)):
+            projected[command[len('set_'):] + '_' + channel] = float(value)
+        elif command == 'set_harmonics' and isinstance(value, list):
+            harmonics = harmonics_from_amplitudes(value)
+            projected['harmonics_' + channel] = [dict(h) for h in harmonics]
+            if channel == 'b':
+                for harmonic in harmonics_from_amplitudes(value, include_zero=True):
+                    update_harmonic_state(projected, 'a', harmonic)
+        elif command == 'set_harmonics' and isinstance(value, dict):
+            update_harmonic_state(projected, channel, value)
+            # Current harmonics are injected into the voltage channel as well
+            if channel == 'b':
+                update_harmonic_state(projected, 'a', value)
+    return projected
+
+
+def clip_warnings(synths, commands, version=None):
+    """
+    Warnings for the channels that would clip once `commands` are applied, one per
+    channel: {synth_id, channel, clipped_samples, cycle_samples, unclamped_peak,
+    already_clipping, message}. Empty when nothing clips or the model is unavailable.
+
+    `version` is the state version `synths` was read at; with it, the same commands
+    against the same state are answered from a cache instead of modelled again.
+    """
+    if not dds_model.available():
+        return []
+    by_synth = OrderedDict()
+    for cmd in commands:
+        synth_id = cmd.get('synth_id')
+        if cmd.get('command') in WAVEFORM_COMMANDS and isinstance(synth_id, int) and 0 <= synth_id < len(synths):
+            by_synth.setdefault(synth_id, []).append(cmd)
+    warnings = []
+    for synth_id, synth_commands in by_synth.items():
+        key = None
+        if version is not None:
+            key = (version, synth_id, json.dumps([(cmd.get('command'), cmd.get('channel'), cmd.get('value'))
+                                                  for cmd in synth_commands], sort_keys=True, default=str))
+            with _lock:
+                cached = _warning_cache.get(key)
+                if cached is not None:
+                    _warning_cache.move_to_end(key)
+                    warnings.extend(cached)
+                    continue
+        synth_warnings = _synth_clip_warnings(synths[synth_id], synth_id, synth_commands)
+        if synth_warnings is None:
+            continue
+        if key is not None:
+            with _lock:
+                _warning_cache[key] = synth_warnings
+                while len(_warning_cache) > WARNING_CACHE_SIZE:
+                    _warning_cache.popitem(last=False)
+        warnings.extend(synth_warnings)
+    return warnings
+
+
+def _synth_clip_warnings(synth_state, synth_id, commands):
+    """clip_warnings() for one synth; None when the check could not run."""
+    try:
+        before = dds_model.model_synth(synth_state)
+        after = dds_model.model_synth(project_commands(synth_state, commands))
+    except (KeyError, TypeError, ValueError) as e:
+        # A warning is advisory; a malformed value is the command path's to reject
+        logger.warning(f"Clip check skipped for synth {synth_id}: {e}")
+        return None
+    warnings = []
+    for ch in ('a', 'b'):
+        clipped = after['channels'][ch]['clipped_samples']
+        if not clipped:
+            continue
+        dac = after['channels'][ch]['dac']
+        unclamped_peak = float(np.max(np.abs(dac.astype(np.float64) - 127.5)) / 127.5)
+        warnings.append({
+            'synth_id': synth_id,
+            'channel': ch,
+            'clipped_samples': clipped,
+            'cycle_samples': after['cycle_samples'],
+            'unclamped_peak': unclamped_peak,
+            'already_clipping': before['channels'][ch]['clipped_samples'] > 0,
+            'message': (f"Synth {synth_id} channel {ch.upper()} clips on {clipped} of "
+                        f"{after['cycle_samples']} samples per cycle "
+                        f"(peak {100.0 * unclamped_peak:.0f} % of full scale)"),
+        })
+    return warnings
@@ -0,0 +1,244 @@
+"""
+Sample-exact model of a synth's DAC output (firmware/main/dds_core.c).
+
+The scope preview draws ideal sinusoids, but the firmware plays a 65536-entry
+quarter-wave table through a truncated integer dds_step, indexes harmonics at
+order * phase_acc, and clamps and truncates the sum to 8 bits. So frequency
+error and clipping only showed up on a real scope. model_synth() reproduces
+dds_output() for one sync cycle of both channels: from a rising edge of the
+sync square wave, where the accumulators are realigned, to the next one. It
+uses numpy float32 in the firmware's operation order, so every sample equals the
+value written to the DAC. tools/check_dds_model.py compiles dds_core.c and
+compares the two.
+
+The model assumes:
+- a steady state, with the amplitude and enable ramps finished (a disabled channel sits at mid-scale, code 127);
+- the synth's own sync square wave (an external sync at the same rate gives the same cycle);
+- harmonics summed in the order they were sent.
+
+The sine table uses a correctly rounded sinf. The device's libm can differ in the
+last bit, which moves a table entry only when it falls within one ulp of a step.
+
+Results are cached per parameter set (as the firmware holds it, after float32
+rounding and harmonic phase calibration). The arrays in a result are read-only.
+"""
+import hashlib
+import math
+import threading
+from collections import OrderedDict
+
+from utils.harmonic_calibration import apply_command_phase_corrections
+
+try:
+    import numpy as np
+except ImportError:  # model_synth() raises ModelUnavailable; /api endpoints answer 503
+    np = None
+
+# firmware/main/dds_core.h and main.c
+TABLE_SIZE = 1 << 16
+QUARTER = TABLE_SIZE // 4
+PHASE_SCALE = int(TABLE_SIZE / (2.0 * math.pi))
+PERIOD_US = 50
+SAMPLE_RATE = 1_000_000 / PERIOD_US
+MAX_HARMONICS = 8
+
+CACHE_SIZE = 64
+
+_table = None
+_cache = OrderedDict()  # parameter key -> result
+_lock = threading.Lock()
+
+
+class ModelUnavailable(RuntimeError):
+    """numpy is not installed."""
+
+
+def available():
+    return np is not None
+
+
+def _require_numpy():
+    if np is None:
+        raise ModelUnavailable("numpy is not installed")
+
+
+def _f32(value):
+    return np.float32(value)
+
+
+def waveform_table():
+    """Full-cycle table (TABLE_SIZE uint8): the firmware's quarter table unfolded by dds_table_value's symmetry."""
+    global _table
+    if _table is None:
+        _require_numpy()
+        # (M_PI_2 * i) / (float)quarter is computed in double and stored as float
+        phase_val = (math.pi / 2 * np.arange(QUARTER, dtype=np.float64) / float(QUARTER)).astype(np.float32)
+        val = np.sin(phase_val.astype(np.float64)).astype(np.float32)
+        quarter = (val * _f32(127.5) + _f32(127.5)).astype(np.uint8)
+        table = np.concatenate((quarter, quarter[::-1], 255 - quarter, 255 - quarter[::-1]))
+        table.flags.writeable = False
+        _table = table
+    return _table
+
+
+def dds_step(frequency):
+    """dds_compute_step(): (TABLE_SIZE * frequency * PERIOD_US / 1000000) in float, truncated."""
+    step = _f32(TABLE_SIZE) * _f32(frequency)
+    step = step * _f32(PERIOD_US)
+    return int(step / _f32(1000000))
+
+
+def _radians(degrees):
+    # phase * M_PI_180: the float is promoted to double and the product stored as float
+    return _f32(float(_f32(degrees)) * (math.pi / 180.0))
+
+
+def _phase_offset(phase):
+    """dds_compute_phase_offset(): truncated toward zero, negative values are 0."""
+    offset = phase * _f32(PHASE_SCALE)
+    return int(offset) % TABLE_SIZE if offset > 0 else 0
+
+
+def sync_cycle_samples(frequency_a):
+    """DDS ticks between rising sync edges: twice the half-period ticks dds_output() derives from channel A."""
+    half = int((1000000.0 / float(_f32(2) * _f32(frequency_a))) / PERIOD_US)
+    return 2 * max(1, half)
+
+
+def synth_parameters(synth_state, calibrate=True):
+    """
+    The values the firmware holds for a synth state entry (frequency, amplitude, phase per
+    channel and the active harmonics as sent, i.e. with the phase calibration applied).
+    Floats are rounded to float32, so parameter sets the firmware cannot tell apart are equal.
+    """
+    _require_numpy()
+    params = {'frequency_a': float(_f32(synth_state.get('frequency_a', 50.0)))}
+    # An entry without the flags (a bare parameter set) is modelled as enabled
+    enabled = synth_state.get('enabled') or {'a': True, 'b': True}
+    for channel in ('a', 'b'):
+        amplitude = min(100.0, max(0.0, float(synth_state.get(f'amplitude_{channel}', 0.0))))
+        phase = min(360.0, max(-360.0, float(synth_state.get(f'phase_{channel}', 0.0))))
+        harmonics = [h for h in synth_state.get(f'harmonics_{channel}', []) or []
+                     if int(h.get('order', 0)) >= 3 and int(h['order']) % 2 == 1 and float(h.get('amplitude', 0)) > 0]
+        orders = [int(h['order']) for h in harmonics]
+        phases = [float(h.get('phase', 0)) for h in harmonics]
+        if calibrate and harmonics:
+            phases = apply_command_phase_corrections(orders, phases)
+        params[channel] = {
+            'enabled': bool(enabled.get(channel, False)),
+            'frequency': float(_f32(synth_state.get(f'frequency_{channel}', 50.0))),
+            'amplitude': float(_f32(amplitude)),
+            'phase': float(_f32(phase)),
+            'harmonics': [(order, float(_f32(h['amplitude'])), float(_f32(p)))
+                          for order, h, p in zip(orders, harmonics, phases)][:MAX_HARMONICS],
+        }
+    return params
+
+
+def parameter_key(params):
+    """Stable hash of synth_parameters() output, used as the cache key."""
+    canonical = repr((params['frequency_a'],) + tuple(
+        (params[ch]['enabled'], params[ch]['frequency'], params[ch]['amplitude'], params[ch]['phase'],
+         tuple(params[ch]['harmonics']))
+        for ch in ('a', 'b')))
+    return hashlib.sha1(canonical.encode()).hexdigest()[:16]
+
+
+def _model_channel(table, channel, cycle):
+    """dds_sample() for the `cycle` ticks after a sync edge; returns (codes uint8, unclamped values float32, step)."""
+    step = dds_step(channel['frequency'])
+    offset = _phase_offset(_radians(channel['phase']))
+    # Sync edge: dds_acc = (dds_phase_offset + TABLE_SIZE / 4) % TABLE_SIZE, then += step per tick
+    acc0 = (offset + QUARTER) % TABLE_SIZE
+    acc = (acc0 + step * np.arange(cycle, dtype=np.int64)) % TABLE_SIZE
+    phase_acc = (acc + offset) % TABLE_SIZE
+
+    half = _f32(127.5)
+    fundamental = (table[phase_acc].astype(np.float32) - half) / half
+    harmonics_sum = np.zeros(cycle, dtype=np.float32)
+    for order, amplitude, phase in channel['harmonics']:
+        percent = _f32(amplitude) / _f32(100.0)
+        # phase_offset_int = (int)(phase * PHASE_SCALE), truncated toward zero
+        offset_int = int(_radians(phase) * _f32(PHASE_SCALE))
+        index = (order * phase_acc + offset_int) % TABLE_SIZE
+        harmonic = (table[index].astype(np.float32) - half) / half
+        harmonics_sum = harmonics_sum + harmonic * percent
+
+    val = fundamental + harmonics_sum
+    val = val * (_f32(channel['amplitude']) / _f32(100.0))
+    # output_scale: 1 once the enable ramp is done, 0 once the disable ramp is
+    val = val * _f32(1.0 if channel['enabled'] else 0.0)
+    dac = val * half + half
+    codes = np.clip(dac, _f32(0.0), _f32(255.0)).astype(np.uint8)
+    return codes, dac, step
+
+
+def _channel_result(channel, codes, dac, step, cycle):
+    # The accumulator advanced cycle * step by the next edge, which realigns it to acc0:
+    # anything short of whole table cycles is a phase jump of the fundamental at every edge
+    advance = (cycle * step) % TABLE_SIZE
+    jump = -advance if advance < TABLE_SIZE // 2 else TABLE_SIZE - advance
+    for array in (codes, dac):
+        array.flags.writeable = False
+    actual = step * SAMPLE_RATE / TABLE_SIZE
+    return {
+        'samples': codes,
+        'dac': dac,
+        'step': step,
+        'frequency': channel['frequency'],
+        'frequency_actual': actual,
+        'frequency_error_hz': actual - channel['frequency'],
+        'edge_phase_jump_deg': jump * 360.0 / TABLE_SIZE,
+        'clipped_samples': int(np.count_nonzero((dac > 255.0) | (dac < 0.0))),
+        'min_code': int(codes.min()),
+        'max_code': int(codes.max()),
+    }
+
+
+def model_parameters(params):
+    """Model one sync cycle of both channels for synth_parameters() output (cached)."""
+    _require_numpy()
+    key = parameter_key(params)
+    with _lock:
+        result = _cache.get(key)
+        if result is not None:
+            _cache.move_to_end(key)
+            return result
+    table = waveform_table()
+    cycle = sync_cycle_samples(params['frequency_a'])
+    channels = {}
+    for ch in ('a', 'b'):
+        codes, dac, step = _model_channel(table, params[ch], cycle)
+        channels[ch] = _channel_result(params[ch], codes, dac, step, cycle)
+    result = {
+        'key': key,
+        'sample_rate': SAMPLE_RATE,
+        'cycle_samples': cycle,
+        'sync_frequency': SAMPLE_RATE / cycle,
+        'channels': channels,
+    }
+    with _lock:
+        _cache[key] = result
+        while len(_cache) > CACHE_SIZE:
+            _cache.popitem(last=False)
+    return result
+
+
+def model_synth(synth_state, calibrate=True):
+    """Model one sync cycle of a synth state entry; see model_parameters()."""
+    return model_parameters(synth_parameters(synth_state, calibrate))
+
+
+def model_to_json(result):
+    """JSON-ready copy of a model_parameters() result (samples as a list of DAC codes)."""
+    return {
+        'key': result['key'],
+        'sample_rate': result['sample_rate'],
+        'cycle_samples': result['cycle_samples'],
+        'sync_frequency': result['sync_frequency'],
+        'channels': {
+            ch: {name: (value.tolist() if name == 'samples' else value)
+                 for name, value in channel.items() if name != 'dac'}
+            for ch, channel in result['channels'].items()
+        },
+    }
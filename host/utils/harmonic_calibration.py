@@ -1,90 +1,53 @@
-import json
-import os
-import time
+from utils.settings_service import SETTINGS
 
+try:
+    import numpy as np
+except ImportError:  # batch apply falls back to a list comprehension
+    np = None
 
-_SETTINGS_FILE = os.path.join(os.path.dirname(__file__), "..", "config", "settings.json")
-_CACHE = {
-    "loaded_at": 0.0,
-    "mtime": None,
-    "cfg": {
-        "enabled": False,
-        "mode": "linear",
-        "linearA": 0.0,
-        "perHarmonic": {},
-    },
-}
+# Orders 0..MAX_TABLE_ORDER get a precomputed correction; higher orders (rare) are computed.
+MAX_TABLE_ORDER = 127
 
+# Calibration config is pushed by the settings service when it changes, and turned
+# into a dense per-order correction table, so the harmonic command and readback
+# paths are a single index instead of a config lookup and mode branch.
+_CACHE = {"cfg": None, "table": None}
 
-def _phase_wrap(value):
-    # Keep phase in synth-supported range [-360, 360].
-    wrapped = ((float(value) + 360.0) % 720.0) - 360.0
-    return round(wrapped, 2)
 
+def _on_settings_changed(settings, changed_keys):
+    if "harmonicCalibration" in changed_keys:
+        _set_config(settings["harmonicCalibration"])
 
-def _normalize_cfg(raw_cfg):
-    cfg = {
-        "enabled": False,
-        "mode": "linear",
-        "linearA": 0.0,
-        "perHarmonic": {},
-    }
-    if not isinstance(raw_cfg, dict):
-        return cfg
 
-    cfg["enabled"] = bool(raw_cfg.get("enabled", False))
-    mode = str(raw_cfg.get("mode", "linear"))
-    cfg["mode"] = mode if mode in ["linear", "per_harmonic"] else "linear"
-    try:
-        cfg["linearA"] = float(raw_cfg.get("linearA", 0.0))
-    except (TypeError, ValueError):
-        cfg["linearA"] = 0.0
+SETTINGS.subscribe(_on_settings_changed)
 
-    per_harmonic = raw_cfg.get("perHarmonic", {})
-    if isinstance(per_harmonic, dict):
-        normalized = {}
-        for key, value in per_harmonic.items():
-            try:
-                normalized[str(int(key))] = float(value)
-            except (TypeError, ValueError):
-                continue
-        cfg["perHarmonic"] = normalized
 
-    return cfg
+def _set_config(cfg):
+    table = [_correction_from_config(order, cfg) for order in range(MAX_TABLE_ORDER + 1)]
+    _CACHE["table"] = np.asarray(table, dtype=np.float64) if np is not None else table
+    _CACHE["cfg"] = cfg
 
 
-def get_harmonic_calibration_config(force_reload=False):
-    now = time.time()
-    if not force_reload and (now - _CACHE["loaded_at"]) < 1.0:
-        return _CACHE["cfg"]
-
-    try:
-        mtime = os.path.getmtime(_SETTINGS_FILE)
-    except OSError:
-        _CACHE["loaded_at"] = now
-        return _CACHE["cfg"]
-
-    if not force_reload and _CACHE["mtime"] == mtime:
-        _CACHE["loaded_at"] = now
-        return _CACHE["cfg"]
+def _phase_wrap(value):
+    # Keep phase in synth-supported range [-360, 360].
+    wrapped = ((float(value) + 360.0) % 720.0) - 360.0
+    return round(wrapped, 2)
 
-    try:
-        with open(_SETTINGS_FILE, "r") as f:
-            settings = json.load(f)
-        cfg = _normalize_cfg(settings.get("harmonicCalibration", {}))
-        _CACHE["cfg"] = cfg
-        _CACHE["mtime"] = mtime
-        _CACHE["loaded_at"] = now
-    except Exception:
-        _CACHE["loaded_at"] = now
 
+def get_harmonic_calibration_config(force_reload=False):
+    if _CACHE["cfg"] is None or force_reload:
+        _set_config(SETTINGS.get_section("harmonicCalibration"))
     return _CACHE["cfg"]
 
 
-def phase_correction_for_order(order, cfg=None):
-    if cfg is None:
-        cfg = get_harmonic_calibration_config()
+def correction_table():
+    """Dense per-order phase correction (degrees), index = harmonic order."""
+    if _CACHE["table"] is None:
+        get_harmonic_calibration_config()
+    return _CACHE["table"]
+
 
+def _correction_from_config(order, cfg):
     if not cfg.get("enabled", False):
         return 0.0
 
@@ -107,6 +70,29 @@ def phase_correction_for_order(order, cfg=None):
     return a * (1.0 - harmonic_order)
 
 
+def phase_correction_for_order(order, cfg=None):
+    if cfg is not None:
+        return _correction_from_config(order, cfg)
+    table = correction_table()
+    try:
+        harmonic_order = int(order)
+    except (TypeError, ValueError):
+        return 0.0
+    if 0 <= harmonic_order <= MAX_TABLE_ORDER:
+        return float(table[harmonic_order])
+    return _correction_from_config(harmonic_order, _CACHE["cfg"])
+
+
+def apply_command_phase_corrections(orders, desired_phases):
+    """Batch apply_command_phase_correction for a multi-harmonic update (same rounding/wrap)."""
+    if not orders:
+        return []
+    if np is not None and max(orders) <= MAX_TABLE_ORDER and min(orders) >= 0:
+        corrected = np.asarray(desired_phases, dtype=np.float64) + correction_table()[np.asarray(orders, dtype=np.intp)]
+        return np.round(np.mod(corrected + 360.0, 720.0) - 360.0, 2).tolist()
+    return [apply_command_phase_correction(order, phase) for order, phase in zip(orders, desired_phases)]
+
+
 def apply_command_phase_correction(order, desired_phase, cfg=None):
     correction = phase_correction_for_order(order, cfg)
     return _phase_wrap(float(desired_phase) + correction)
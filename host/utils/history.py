@@ -0,0 +1,304 @@
+"""
+Synth state history for trend views (GET /api/history).
+
+state.synths only holds the latest values, and every poll overwrites them, so
+drift over a test run is lost. HISTORY keeps amplitude, frequency and phase of
+every synth and channel as time series with three resolutions:
+
+    raw   every poll readback and every commanded change     HISTORY_RAW samples
+    1s    mean/min/max of the samples in each second          HISTORY_1S buckets (2 h)
+    1m    mean/min/max of the samples in each minute          HISTORY_1M buckets (7 days)
+
+Each resolution is a columnar ring (a float64 time column plus float32 value
+columns). All rings are laid out in one buffer sized at open(), so memory stays
+the same however long the rig runs (about 2.2 MB per synth with the defaults). In the split host the control process writes
+the buffer as a file-backed mmap (see utils/shared_memory.py) and the web process
+attaches to it read-only. A reader copies the columns and then drops any slots
+the writer wrapped over while it was copying.
+"""
+import os
+import struct
+import threading
+import time
+
+from utils.shared_memory import _Mapping
+
+TRACKED_KEYS = ('amplitude_a', 'amplitude_b', 'frequency_a', 'frequency_b', 'phase_a', 'phase_b')
+RESOLUTIONS = ('raw', '1s', '1m')
+BUCKET_SECONDS = {'1s': 1.0, '1m': 60.0}
+
+HISTORY_RAW = int(os.environ.get('NHP_HISTORY_RAW', '2048'))
+HISTORY_1S = int(os.environ.get('NHP_HISTORY_1S', '7200'))
+HISTORY_1M = int(os.environ.get('NHP_HISTORY_1M', '10080'))
+
+_MAGIC = b'NHPH'
+_HEADER = struct.Struct('<4sIIIII')  # magic, num_synths, num_keys, raw, 1s, 1m capacities
+_HEADER_SIZE = 64
+
+
+def _align8(n):
+    return (n + 7) & ~7
+
+
+class _Ring:
+    """u64 head (samples ever written), t column (float64), value columns (float32)."""
+
+    def __init__(self, buf, offset, capacity, columns):
+        self.capacity = capacity
+        self._head = buf[offset:offset + 8].cast('Q')
+        offset += 8
+        self.t = buf[offset:offset + 8 * capacity].cast('d')
+        offset += 8 * capacity
+        self.columns = []
+        for _ in columns:
+            self.columns.append(buf[offset:offset + 4 * capacity].cast('f'))
+            offset += 4 * capacity
+        self.end = _align8(offset)
+
+    @staticmethod
+    def size(capacity, columns):
+        return _align8(8 + 8 * capacity + 4 * capacity * len(columns))
+
+    @property
+    def head(self):
+        return self._head[0]
+
+    def append(self, t, values):
+        head = self._head[0]
+        slot = head % self.capacity
+        self.t[slot] = t
+        for column, value in zip(self.columns, values):
+            column[slot] = value
+        self._head[0] = head + 1
+
+    def covers(self, start):
+        """True if no sample at or after `start` has been overwritten yet."""
+        return self._head[0] <= self.capacity or self.oldest() <= start
+
+    def oldest(self):
+        """Time of the oldest retained sample, None if empty."""
+        head = self._head[0]
+        if head == 0:
+            return None
+        return self.t[0 if head <= self.capacity else head % self.capacity]
+
+    def read(self):
+        """(t, [column values]) of every retained sample, oldest first."""
+        cap = self.capacity
+        first = self._head[0]
+        lo = max(0, first - cap)
+        start = lo % cap
+        copies = [self.t] + self.columns
+        if first - lo == cap and start:
+            data = [col[start:].tolist() + col[:start].tolist() for col in copies]
+        else:
+            data = [col[start:start + first - lo].tolist() for col in copies]
+        # Slot of sample `head` (being written now) held sample head - cap
+        drop = max(0, self._head[0] - cap + 1 - lo)
+        if drop:
+            data = [col[drop:] for col in data]
+        return data[0], data[1:]
+
+    def release(self):
+        for view in [self._head, self.t] + self.columns:
+            view.release()
+
+
+class _Bucket:
+    __slots__ = ('start', 'total', 'count', 'low', 'high')
+
+    def __init__(self, start, value):
+        self.start, self.total, self.count, self.low, self.high = start, value, 1, value, value
+
+    def add(self, value):
+        self.total += value
+        self.count += 1
+        self.low = min(self.low, value)
+        self.high = max(self.high, value)
+
+
+class HistoryStore:
+    def __init__(self):
+        self.num_synths = 0
+        self._map = None
+        self._buf = None
+        self._rings = {}    # (synth_id, key) -> {'raw': _Ring, '1s': _Ring, '1m': _Ring}
+        self._buckets = {}  # (synth_id, key, resolution) -> open _Bucket (writer only)
+        self._lock = threading.Lock()
+
+    @property
+    def opened(self):
+        return self._buf is not None
+
+    @property
+    def nbytes(self):
+        return len(self._buf) if self._buf is not None else 0
+
+    def open(self, num_synths, path=None, raw=HISTORY_RAW, per_second=HISTORY_1S, per_minute=HISTORY_1M):
+        """Allocate the rings; in a file-backed mmap at `path` (for the web process) or in memory."""
+        capacities = (raw, per_second, per_minute)
+        size = _HEADER_SIZE + num_synths * len(TRACKED_KEYS) * (
+            _Ring.size(raw, ('value',)) + _Ring.size(per_second, 'abc') + _Ring.size(per_minute, 'abc'))
+        if path is None:
+            buf = memoryview(bytearray(size))
+        else:
+            self._map = _Mapping(path, size, create=True)
+            buf = memoryview(self._map.buf)
+        _HEADER.pack_into(buf, 0, _MAGIC, num_synths, len(TRACKED_KEYS), *capacities)
+        self._layout(buf, num_synths, capacities)
+        return self
+
+    @classmethod
+    def attach(cls, path):
+        """Read-only view of a store another process opened at `path`; ValueError until it is ready."""
+        store = cls()
+        store._map = _Mapping(path, None, create=False)
+        buf = memoryview(store._map.buf)
+        magic, num_synths, num_keys, *capacities = _HEADER.unpack_from(buf, 0)
+        if magic != _MAGIC or num_keys != len(TRACKED_KEYS):
+            buf.release()
+            store._map.close()
+            raise ValueError(f"{path} is not an initialised history store")
+        store._layout(buf, num_synths, capacities)
+        return store
+
+    def _layout(self, buf, num_synths, capacities):
+        offset = _HEADER_SIZE
+        for synth_id in range(num_synths):
+            for key in TRACKED_KEYS:
+                rings = {}
+                for resolution, capacity in zip(RESOLUTIONS, capacities):
+                    columns = ('value',) if resolution == 'raw' else ('mean', 'min', 'max')
+                    rings[resolution] = ring = _Ring(buf, offset, capacity, columns)
+                    offset = ring.end
+                self._rings[(synth_id, key)] = rings
+        self.num_synths = num_synths
+        self._buf = buf
+
+    def close(self):
+        with self._lock:
+            for rings in self._rings.values():
+                for ring in rings.values():
+                    ring.release()
+            self._rings.clear()
+            if self._buf is not None:
+                self._buf.release()
+                self._buf = None
+            if self._map is not None:
+                self._map.close()
+                self._map = None
+
+    # -- writer (control process) --
+
+    def record(self, synth_id, key, value, t=None):
+        """Add one sample; ignored for untracked keys or before open()."""
+        rings = self._rings.get((synth_id, key))
+        if rings is None or isinstance(value, bool):
+            return
+        try:
+            value = float(value)
+        except (TypeError, ValueError):
+            return
+        t = time.time() if t is None else t
+        with self._lock:
+            if self._buf is None:
+                return
+            rings['raw'].append(t, (value,))
+            for resolution, width in BUCKET_SECONDS.items():
+                start = t - t % width
+                bucket = self._buckets.get((synth_id, key, resolution))
+                if bucket is not None and bucket.start == start:
+                    bucket.add(value)
+                    continue
+                if bucket is not None:
+                    rings[resolution].append(bucket.start, (bucket.total / bucket.count, bucket.low, bucket.high))
+                self._buckets[(synth_id, key, resolution)] = _Bucket(start, value)
+
+    def record_values(self, synth_id, values, t=None):
+        """Add the tracked keys of a values dict (one poll readback) at the same time."""
+        t = time.time() if t is None else t
+        for key in TRACKED_KEYS:
+            if key in values:
+                self.record(synth_id, key, values[key], t)
+
+    # -- readers --
+
+    def retention(self):
+        """Capacity and oldest sample time of each resolution (from synth 0's first key)."""
+        rings = self._rings.get((0, TRACKED_KEYS[0]), {})
+        return {resolution: {'capacity': ring.capacity, 'oldest': ring.oldest()}
+                for resolution, ring in rings.items()}
+
+    def query(self, synth_id, key, start=None, end=None, resolution='auto', max_points=500):
+        """
+        Samples of one series in [start, end] (unix seconds) as columns.
+
+        resolution 'auto' picks the finest ring that still holds everything since `start`;
+        samples newer than a rollup's last closed bucket come from the raw ring. More
+        than max_points samples are merged into max_points equal time buckets.
+        Returns {'resolution', 'decimated', 't', 'mean', 'min', 'max'}.
+        """
+        rings = self._rings.get((synth_id, key))
+        if rings is None:
+            raise KeyError(f"no history for synth {synth_id} {key}")
+        end = time.time() if end is None else end
+        start = 0.0 if start is None else start
+        if resolution == 'auto':
+            resolution = next((r for r in RESOLUTIONS if rings[r].covers(start)), RESOLUTIONS[-1])
+
+        t, columns = rings[resolution].read()
+        if resolution == 'raw':
+            columns = columns * 3
+        else:
+            # The open bucket is not in the ring yet; fill the tail from raw samples
+            closed_until = t[-1] + BUCKET_SECONDS[resolution] if t else start
+            raw_t, (raw_v,) = rings['raw'].read()
+            tail = [i for i, ts in enumerate(raw_t) if ts >= closed_until]
+            t = t + [raw_t[i] for i in tail]
+            columns = [column + [raw_v[i] for i in tail] for column in columns]
+
+        # A bucket is kept if any of it falls in the range
+        width = BUCKET_SECONDS.get(resolution, 0.0)
+        keep = [i for i, ts in enumerate(t) if ts + width >= start and ts <= end]
+        t = [t[i] for i in keep]
+        mean, low, high = ([column[i] for i in keep] for column in columns)
+        decimated = len(t) > max_points
+        if decimated:
+            t, mean, low, high = self._decimate(t, mean, low, high, max_points)
+        return {'resolution': resolution, 'decimated': decimated, 't': t, 'mean': mean, 'min': low, 'max': high}
+
+    @staticmethod
+    def _decimate(t, mean, low, high, max_points):
+        width = (t[-1] - t[0]) / max_points or 1.0
+        out = ([], [], [], [])
+        group = []
+        group_index = None
+        for i, ts in enumerate(t + [None]):
+            index = None if ts is None else min(max_points - 1, int((ts - t[0]) / width))
+            if group and index != group_index:
+                out[0].append(t[group[0]])
+                out[1].append(sum(mean[j] for j in group) / len(group))
+                out[2].append(min(low[j] for j in group))
+                out[3].append(max(high[j] for j in group))
+                group = []
+            group.append(i)
+            group_index = index
+        return out
+
+
+def history_reader(path):
+    """Callable returning the store the control process opened at `path`, or None until it exists."""
+    store = None
+
+    def get():
+        nonlocal store
+        if store is None and os.path.exists(path):
+            try:
+                store = HistoryStore.attach(path)
+            except (OSError, ValueError, struct.error):
+                return None
+        return store
+    return get
+
+
+HISTORY = HistoryStore()
@@ -0,0 +1,209 @@
+"""
+In-process tailer for the service log (synth_autostart.log).
+
+One background thread follows the file and keeps the newest lines in a bounded
+ring buffer; /api/logs answers from the buffer and the serviceLogs Socket.IO
+stream is a subscriber, so neither re-opens or re-reads the file.
+
+On Linux the thread sleeps on inotify (watching the directory, so it also sees
+run_main.sh rotating the log by rename); elsewhere it falls back to polling.
+A rotated file is drained through the still-open descriptor before the new one
+is opened, so no lines are lost across a rotation.
+"""
+import collections
+import ctypes
+import ctypes.util
+import logging
+import os
+import select
+import struct
+import threading
+
+logger = logging.getLogger("NHP_Synth")
+
+# inotify(7)
+IN_MODIFY = 0x00000002
+IN_MOVED_FROM = 0x00000040
+IN_MOVED_TO = 0x00000080
+IN_CREATE = 0x00000100
+IN_DELETE = 0x00000200
+IN_NONBLOCK = 0o4000
+IN_CLOEXEC = 0o2000000
+_EVENT_HEADER = struct.Struct('iIII')
+
+
+class _Inotify:
+    """Minimal ctypes binding; raises OSError where inotify is unavailable."""
+
+    def __init__(self):
+        libc = ctypes.CDLL(ctypes.util.find_library('c') or 'libc.so.6', use_errno=True)
+        if not hasattr(libc, 'inotify_init1'):
+            raise OSError("inotify not available")
+        self._libc = libc
+        self.fd = libc.inotify_init1(IN_NONBLOCK | IN_CLOEXEC)
+        if self.fd < 0:
+            raise OSError(ctypes.get_errno(), "inotify_init1 failed")
+
+    def add_watch(self, path, mask):
+        wd = self._libc.inotify_add_watch(self.fd, os.fsencode(path), mask)
+        if wd < 0:
+            raise OSError(ctypes.get_errno(), f"inotify_add_watch failed for {path}")
+        return wd
+
+    def read_names(self):
+        """Drain pending events, returning the file names they refer to."""
+        names = set()
+        while True:
+            try:
+                data = os.read(self.fd, 4096)
+            except BlockingIOError:
+                return names
+            offset = 0
+            while offset + _EVENT_HEADER.size <= len(data):
+                _, _, _, name_len = _EVENT_HEADER.unpack_from(data, offset)
+                offset += _EVENT_HEADER.size
+                names.add(data[offset:offset + name_len].rstrip(b'\0').decode(errors='replace'))
+                offset += name_len
+
+    def close(self):
+        os.close(self.fd)
+
+
+class LogTailer:
+    def __init__(self, path, capacity=2000, poll_interval=0.5):
+        self.path = path
+        self.capacity = capacity
+        self.poll_interval = poll_interval
+        self._lines = collections.deque(maxlen=capacity)
+        self._lock = threading.Lock()
+        self._subscribers = []
+        self._stop = threading.Event()
+        self._thread = None
+        self._file = None
+        self._inode = None
+        self._partial = b''
+
+    def tail(self, count):
+        """The newest `count` lines (oldest first)."""
+        with self._lock:
+            if count >= len(self._lines):
+                return list(self._lines)
+            return list(self._lines)[-count:]
+
+    def subscribe(self, callback):
+        """callback(lines) runs on the tailer thread for every batch of new lines."""
+        self._subscribers.append(callback)
+
+    def start(self):
+        if self._thread is None:
+            # Watch before priming the buffer so nothing written in between is missed
+            inotify = self._watch()
+            self._load_existing()
+            self._thread = threading.Thread(target=self._run, args=(inotify,), name="log-tailer", daemon=True)
+            self._thread.start()
+        return self
+
+    def stop(self):
+        self._stop.set()
+        if self._thread is not None:
+            self._thread.join(timeout=2.0)
+            self._thread = None
+        if self._file is not None:
+            self._file.close()
+            self._file = None
+
+    def _load_existing(self):
+        """Prime the buffer with the end of the current file and follow it from there."""
+        if not self._open():
+            return
+        size = os.fstat(self._file.fileno()).st_size
+        data = b''
+        pos = size
+        while pos > 0 and data.count(b'\n') <= self.capacity:
+            step = min(65536, pos)
+            pos -= step
+            self._file.seek(pos)
+            data = self._file.read(step) + data
+        self._file.seek(size)
+        if pos > 0:
+            data = data.split(b'\n', 1)[-1]  # drop the first, partial line
+        self._append(data, notify=False)
+
+    def _open(self):
+        try:
+            f = open(self.path, 'rb')
+        except OSError:
+            return False
+        if self._file is not None:
+            self._file.close()
+        self._file = f
+        self._inode = os.fstat(f.fileno()).st_ino
+        self._partial = b''
+        return True
+
+    def _append(self, data, notify=True):
+        data = self._partial + data
+        *complete, self._partial = data.split(b'\n')
+        if not complete:
+            return
+        lines = [line.decode('utf-8', errors='replace').rstrip('\r') for line in complete]
+        with self._lock:
+            self._lines.extend(lines)
+        if notify:
+            for callback in list(self._subscribers):
+                try:
+                    callback(lines)
+                except Exception as e:
+                    logger.debug(f"Log tailer subscriber failed: {e}")
+
+    def _check(self):
+        """Read whatever was appended; follow truncation and rotation."""
+        if self._file is None:
+            if not self._open():
+                return
+        try:
+            st = os.stat(self.path)
+        except FileNotFoundError:
+            st = None
+        if st is not None and st.st_size < self._file.tell() and st.st_ino == self._inode:
+            self._file.seek(0)  # truncated in place
+            self._partial = b''
+        self._append(self._file.read())
+        if st is None or st.st_ino != self._inode:
+            # Rotated: the old file is drained above, switch to the new one
+            if self._partial:
+                self._append(b'\n')
+            if st is not None and self._open():
+                self._append(self._file.read())
+
+    def _watch(self):
+        inotify = None
+        try:
+            inotify = _Inotify()
+            inotify.add_watch(os.path.dirname(os.path.abspath(self.path)),
+                              IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+            return inotify
+        except OSError as e:
+            logger.info(f"Log tailer polling {self.path} ({e})")
+            if inotify is not None:
+                inotify.close()
+            return None
+
+    def _run(self, inotify):
+        name = os.path.basename(self.path)
+        try:
+            while not self._stop.is_set():
+                if inotify is None:
+                    self._stop.wait(self.poll_interval)
+                else:
+                    # The timeout is a safety net for missed events, not the main path.
+                    readable, _, _ = select.select([inotify.fd], [], [], 1.0)
+                    if readable and name not in inotify.read_names():
+                        continue
+                try:
+                    self._check()
+                except Exception as e:
+                    logger.debug(f"Log tailer read failed: {e}")
+        finally:
+            if inotify is not None:
+                inotify.close()
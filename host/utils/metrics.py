@@ -0,0 +1,297 @@
+"""
+In-process metrics for the NHP_Synth host.
+
+Counters, gauges and fixed-bucket histograms that are cheap enough to update
+from the serial and main-loop hot paths on a Raspberry Pi (a dict update and a
+bisect under a per-metric lock). Rendered for /api/metrics in the Prometheus
+text exposition format, or summarised as JSON for the dashboard.
+"""
+import bisect
+import threading
+import time
+
+# Latency buckets in seconds: 0.5 ms .. 10 s
+LATENCY_BUCKETS = (0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0)
+
+
+def _format_labels(labelnames, values, extra=None):
+    pairs = list(zip(labelnames, values))
+    if extra:
+        pairs.append(extra)
+    if not pairs:
+        return ''
+    escaped = (str(v).replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n') for _, v in pairs)
+    return '{' + ','.join(f'{k}="{v}"' for (k, _), v in zip(pairs, escaped)) + '}'
+
+
+def _format_value(value):
+    if value == float('inf'):
+        return '+Inf'
+    if isinstance(value, float) and value.is_integer():
+        return str(int(value))
+    return repr(value) if isinstance(value, float) else str(value)
+
+
+class _Metric:
+    kind = 'untyped'
+
+    def __init__(self, name, documentation, labelnames=()):
+        self.name = name
+        self.documentation = documentation
+        self.labelnames = tuple(labelnames)
+        self._lock = threading.Lock()
+        self._values = {}
+
+    def _key(self, labels):
+        if not self.labelnames:
+            return ()
+        return tuple(str(labels.get(name, '')) for name in self.labelnames)
+
+    def header(self):
+        return [f'# HELP {self.name} {self.documentation}', f'# TYPE {self.name} {self.kind}']
+
+
+class Counter(_Metric):
+    kind = 'counter'
+
+    def inc(self, amount=1, **labels):
+        key = self._key(labels)
+        with self._lock:
+            self._values[key] = self._values.get(key, 0) + amount
+
+    def value(self, **labels):
+        return self._values.get(self._key(labels), 0)
+
+    def total(self):
+        with self._lock:
+            return sum(self._values.values())
+
+    def render(self):
+        with self._lock:
+            items = sorted(self._values.items())
+        return self.header() + [f'{self.name}{_format_labels(self.labelnames, k)} {_format_value(v)}'
+                                for k, v in items]
+
+    def summary(self):
+        with self._lock:
+            return {'total': sum(self._values.values()),
+                    'series': {','.join(k): v for k, v in self._values.items()} if self.labelnames else None}
+
+
+class Gauge(_Metric):
+    kind = 'gauge'
+
+    def __init__(self, name, documentation, labelnames=()):
+        super().__init__(name, documentation, labelnames)
+        self._functions = {}
+
+    def set(self, value, **labels):
+        key = self._key(labels)
+        with self._lock:
+            self._values[key] = value
+
+    def set_function(self, fn, **labels):
+        """Evaluate fn() at scrape time instead of updating the gauge on the hot path."""
+        key = self._key(labels)
+        with self._lock:
+            self._functions[key] = fn
+
+    def _collect(self):
+        with self._lock:
+            values = dict(self._values)
+            functions = dict(self._functions)
+        for key, fn in functions.items():
+            try:
+                values[key] = fn()
+            except Exception:
+                continue
+        return values
+
+    def render(self):
+        return self.header() + [f'{self.name}{_format_labels(self.labelnames, k)} {_format_value(v)}'
+                                for k, v in sorted(self._collect().items())]
+
+    def summary(self):
+        values = self._collect()
+        if not self.labelnames:
+            return {'value': values.get((), 0)}
+        return {'series': {','.join(k): v for k, v in values.items()}}
+
+
+class Histogram(_Metric):
+    kind = 'histogram'
+
+    def __init__(self, name, documentation, labelnames=(), buckets=LATENCY_BUCKETS):
+        super().__init__(name, documentation, labelnames)
+        self.buckets = tuple(sorted(buckets))
+
+    def observe(self, value, **labels):
+        key = self._key(labels)
+        idx = bisect.bisect_left(self.buckets, value)
+        with self._lock:
+            series = self._values.get(key)
+            if series is None:
+                series = self._values[key] = [[0] * (len(self.buckets) + 1), 0.0, 0]
+            series[0][idx] += 1
+            series[1] += value
+            series[2] += 1
+
+    def time(self, **labels):
+        return _Timer(self, labels)
+
+    def render(self):
+        lines = self.header()
+        with self._lock:
+            items = sorted((k, ([*v[0]], v[1], v[2])) for k, v in self._values.items())
+        for key, (counts, total, count) in items:
+            cumulative = 0
+            for bound, bucket_count in zip(self.buckets + (float('inf'),), counts):
+                cumulative += bucket_count
+                le = ('le', _format_value(float(bound)))
+                lines.append(f'{self.name}_bucket{_format_labels(self.labelnames, key, le)} {cumulative}')
+            lines.append(f'{self.name}_sum{_format_labels(self.labelnames, key)} {_format_value(total)}')
+            lines.append(f'{self.name}_count{_format_labels(self.labelnames, key)} {count}')
+        return lines
+
+    def _quantile(self, counts, count, q):
+        """Upper bucket bound containing quantile q (coarse, but allocation-free)."""
+        if count == 0:
+            return 0.0
+        rank = q * count
+        cumulative = 0
+        for bound, bucket_count in zip(self.buckets + (float('inf'),), counts):
+            cumulative += bucket_count
+            if cumulative >= rank:
+                return bound if bound != float('inf') else self.buckets[-1]
+        return self.buckets[-1]
+
+    def summary(self):
+        with self._lock:
+            items = {k: ([*v[0]], v[1], v[2]) for k, v in self._values.items()}
+        merged = [0] * (len(self.buckets) + 1)
+        total_sum = 0.0
+        total_count = 0
+        series = {}
+        for key, (counts, total, count) in items.items():
+            merged = [a + b for a, b in zip(merged, counts)]
+            total_sum += total
+            total_count += count
+            if self.labelnames:
+                series[','.join(key)] = {
+                    'count': count,
+                    'mean': total / count if count else 0.0,
+                    'p50': self._quantile(counts, count, 0.5),
+                    'p99': self._quantile(counts, count, 0.99),
+                }
+        result = {
+            'count': total_count,
+            'mean': total_sum / total_count if total_count else 0.0,
+            'p50': self._quantile(merged, total_count, 0.5),
+            'p99': self._quantile(merged, total_count, 0.99),
+        }
+        if series:
+            result['series'] = series
+        return result
+
+
+class _Timer:
+    __slots__ = ('_histogram', '_labels', '_start')
+
+    def __init__(self, histogram, labels):
+        self._histogram = histogram
+        self._labels = labels
+
+    def __enter__(self):
+        self._start = time.perf_counter()
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self._histogram.observe(time.perf_counter() - self._start, **self._labels)
+
+
+class MetricsRegistry:
+    def __init__(self):
+        self._metrics = {}
+        self._lock = threading.Lock()
+        self.started_at = time.time()
+
+    def _register(self, cls, name, documentation, labelnames=(), **kwargs):
+        with self._lock:
+            existing = self._metrics.get(name)
+            if existing is not None:
+                return existing
+            metric = cls(name, documentation, labelnames, **kwargs)
+            self._metrics[name] = metric
+            return metric
+
+    def counter(self, name, documentation, labelnames=()):
+        return self._register(Counter, name, documentation, labelnames)
+
+    def gauge(self, name, documentation, labelnames=()):
+        return self._register(Gauge, name, documentation, labelnames)
+
+    def histogram(self, name, documentation, labelnames=(), buckets=LATENCY_BUCKETS):
+        return self._register(Histogram, name, documentation, labelnames, buckets=buckets)
+
+    def render_text(self):
+        with self._lock:
+            metrics = list(self._metrics.values())
+        lines = []
+        for metric in metrics:
+            lines.extend(metric.render())
+        return '\n'.join(lines) + '\n'
+
+    def snapshot(self):
+        with self._lock:
+            metrics = list(self._metrics.items())
+        return {
+            'timestamp': time.time(),
+            'uptime_s': round(time.time() - self.started_at, 1),
+            'metrics': {name: {'type': metric.kind, **metric.summary()} for name, metric in metrics},
+        }
+
+
+REGISTRY = MetricsRegistry()
+
+# Host metrics, shared by the serial layer, main loop and dashboard.
+SERIAL_RTT = REGISTRY.histogram(
+    'nhp_serial_rtt_seconds', 'Serial read command round trip time per synth', ('synth',))
+COMMANDS_SENT = REGISTRY.counter(
+    'nhp_serial_commands_sent_total', 'Commands written to synth UARTs', ('synth', 'kind'))
+COMMANDS_PROCESSED = REGISTRY.counter(
+    'nhp_commands_processed_total', 'Queued commands dispatched to synths', ('source', 'command'))
+COMMANDS_COALESCED = REGISTRY.counter(
+    'nhp_commands_coalesced_total', 'Queued commands superseded by a newer value before dispatch')
+COMMAND_QUEUE_DEPTH = REGISTRY.gauge(
+    'nhp_command_queue_depth', 'Commands waiting in the dashboard command queue')
+COMMAND_RING_BYTES = REGISTRY.gauge(
+    'nhp_command_ring_bytes', 'Bytes waiting in the shared-memory command ring from the web process')
+COMMAND_RING_REJECTED = REGISTRY.gauge(
+    'nhp_command_ring_rejected', 'Commands the web process could not enqueue because the ring was full')
+POLL_DURATION = REGISTRY.histogram(
+    'nhp_poll_duration_seconds', 'Duration of a full hardware readback poll')
+POLL_FAILURES = REGISTRY.counter(
+    'nhp_poll_failures_total', 'Synth polls that failed or returned invalid readbacks', ('synth',))
+RECONNECTS = REGISTRY.counter(
+    'nhp_reconnects_total', 'Automatic synth reconnect attempts', ('result',))
+SOCKET_EMITS = REGISTRY.counter(
+    'nhp_socket_emits_total', 'Socket.IO events emitted by the server', ('event',))
+MAIN_LOOP_ITERATION = REGISTRY.histogram(
+    'nhp_main_loop_iteration_seconds', 'Main loop work time per iteration (excluding idle sleep)')
+ENCODER_READ_DURATION = REGISTRY.histogram(
+    'nhp_encoder_read_seconds', 'Encoder thread time to read and handle all encoder boards')
+SOCKET_MSGPACK_CLIENTS = REGISTRY.gauge(
+    'nhp_socket_msgpack_clients', 'Dashboard clients that negotiated MessagePack payloads')
+SOCKET_CLIENTS = REGISTRY.gauge(
+    'nhp_socket_clients', 'Connected dashboard Socket.IO clients')
+SOCKET_CLIENTS_REFUSED = REGISTRY.counter(
+    'nhp_socket_clients_refused_total', 'Dashboard connections refused at the client limit')
+SOCKET_BACKPRESSURE = REGISTRY.counter(
+    'nhp_socket_backpressure_total', 'Slow dashboard clients paused from or resumed to state broadcasts', ('action',))
+# Sampled side-by-side encodes of the same state payload, so the JSON vs MessagePack
+# size and time saving is visible whether or not any client has opted in.
+CODEC_SAMPLE_BYTES = REGISTRY.counter(
+    'nhp_socket_codec_sample_bytes_total', 'Encoded size of sampled synth state payloads', ('encoding',))
+CODEC_ENCODE_TIME = REGISTRY.histogram(
+    'nhp_socket_codec_encode_seconds', 'Encode time of sampled synth state payloads', ('encoding',),
+    buckets=(0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01))
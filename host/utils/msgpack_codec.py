@@ -0,0 +1,242 @@
+"""
+MessagePack codec for binary Socket.IO payloads.
+
+Dashboard clients can opt in to receiving synthState/synthStateDelta and sending
+`command` events as MessagePack instead of JSON text. Dict keys that appear in
+SCHEMA_KEYS are replaced by their index (a one byte positive fixint), so a synth
+entry like {"amplitude_a": 96.0} costs 2 + 9 bytes instead of ~20 characters.
+Floats that survive a float32 round trip are sent as float32.
+
+The key table is mirrored in static/js/msgpack.js; bump SCHEMA_VERSION whenever
+it changes so stale clients fall back to JSON instead of mis-decoding.
+
+Uses the `msgpack` C extension when installed and a small pure-Python
+packer/unpacker otherwise (same wire format, slower).
+"""
+import struct
+
+try:
+    import msgpack as _msgpack
+except ImportError:  # optional dependency
+    _msgpack = None
+
+SCHEMA_VERSION = 1
+
+# Append only: indices are the wire format.
+SCHEMA_KEYS = (
+    'synths', 'selectionMode', 'version', 'base', 'ops', 'op', 'path', 'value',
+    'synth_id', 'command', 'channel',
+    'auto_on', 'enabled', 'amplitude_a', 'amplitude_b', 'frequency_a', 'frequency_b',
+    'phase_a', 'phase_b', 'harmonics_a', 'harmonics_b',
+    'id', 'order', 'amplitude', 'phase', 'a', 'b', 'synth', 'ch',
+)
+_KEY_INDEX = {key: i for i, key in enumerate(SCHEMA_KEYS)}
+
+_float32 = struct.Struct('>f')
+
+
+def compact(obj):
+    """Replace known dict keys with their schema index (recursively)."""
+    if isinstance(obj, dict):
+        return {_KEY_INDEX.get(k, k): compact(v) for k, v in obj.items()}
+    if isinstance(obj, (list, tuple)):
+        return [compact(v) for v in obj]
+    return obj
+
+
+def expand(obj):
+    """Inverse of compact()."""
+    if isinstance(obj, dict):
+        return {(SCHEMA_KEYS[k] if isinstance(k, int) and 0 <= k < len(SCHEMA_KEYS) else k): expand(v)
+                for k, v in obj.items()}
+    if isinstance(obj, list):
+        return [expand(v) for v in obj]
+    return obj
+
+
+def _is_float32(value):
+    try:
+        return _float32.unpack(_float32.pack(value))[0] == value
+    except (OverflowError, struct.error):
+        return False
+
+
+def _pack_into(obj, out):
+    if obj is None:
+        out.append(0xc0)
+    elif obj is True:
+        out.append(0xc3)
+    elif obj is False:
+        out.append(0xc2)
+    elif isinstance(obj, int):
+        if 0 <= obj < 0x80:
+            out.append(obj)
+        elif -32 <= obj < 0:
+            out.append(obj & 0xff)
+        elif 0 <= obj <= 0xff:
+            out += b'\xcc' + struct.pack('>B', obj)
+        elif 0 <= obj <= 0xffff:
+            out += b'\xcd' + struct.pack('>H', obj)
+        elif 0 <= obj <= 0xffffffff:
+            out += b'\xce' + struct.pack('>I', obj)
+        elif obj > 0:
+            out += b'\xcf' + struct.pack('>Q', obj)
+        elif obj >= -0x80:
+            out += b'\xd0' + struct.pack('>b', obj)
+        elif obj >= -0x8000:
+            out += b'\xd1' + struct.pack('>h', obj)
+        elif obj >= -0x80000000:
+            out += b'\xd2' + struct.pack('>i', obj)
+        else:
+            out += b'\xd3' + struct.pack('>q', obj)
+    elif isinstance(obj, float):
+        if _is_float32(obj):
+            out += b'\xca' + _float32.pack(obj)
+        else:
+            out += b'\xcb' + struct.pack('>d', obj)
+    elif isinstance(obj, str):
+        data = obj.encode('utf-8')
+        n = len(data)
+        if n < 32:
+            out.append(0xa0 | n)
+        elif n <= 0xff:
+            out += b'\xd9' + struct.pack('>B', n)
+        elif n <= 0xffff:
+            out += b'\xda' + struct.pack('>H', n)
+        else:
+            out += b'\xdb' + struct.pack('>I', n)
+        out += data
+    elif isinstance(obj, (bytes, bytearray)):
+        n = len(obj)
+        if n <= 0xff:
+            out += b'\xc4' + struct.pack('>B', n)
+        elif n <= 0xffff:
+            out += b'\xc5' + struct.pack('>H', n)
+        else:
+            out += b'\xc6' + struct.pack('>I', n)
+        out += obj
+    elif isinstance(obj, (list, tuple)):
+        n = len(obj)
+        if n < 16:
+            out.append(0x90 | n)
+        elif n <= 0xffff:
+            out += b'\xdc' + struct.pack('>H', n)
+        else:
+            out += b'\xdd' + struct.pack('>I', n)
+        for item in obj:
+            _pack_into(item, out)
+    elif isinstance(obj, dict):
+        n = len(obj)
+        if n < 16:
+            out.append(0x80 | n)
+        elif n <= 0xffff:
+            out += b'\xde' + struct.pack('>H', n)
+        else:
+            out += b'\xdf' + struct.pack('>I', n)
+        for key, value in obj.items():
+            _pack_into(key, out)
+            _pack_into(value, out)
+    else:
+        raise TypeError(f"Cannot MessagePack-encode {type(obj).__name__}")
+
+
+class _Reader:
+    __slots__ = ('data', 'pos')
+
+    def __init__(self, data):
+        self.data = memoryview(data)
+        self.pos = 0
+
+    def take(self, n):
+        end = self.pos + n
+        if end > len(self.data):
+            raise ValueError("Truncated MessagePack data")
+        chunk = self.data[self.pos:end]
+        self.pos = end
+        return chunk
+
+    def unpack(self, fmt, n):
+        return struct.unpack(fmt, self.take(n))[0]
+
+
+_FIXED_FORMATS = {
+    0xca: ('>f', 4), 0xcb: ('>d', 8),
+    0xcc: ('>B', 1), 0xcd: ('>H', 2), 0xce: ('>I', 4), 0xcf: ('>Q', 8),
+    0xd0: ('>b', 1), 0xd1: ('>h', 2), 0xd2: ('>i', 4), 0xd3: ('>q', 8),
+}
+
+
+def _unpack_from(reader):
+    tag = reader.take(1)[0]
+    if tag < 0x80:
+        return tag
+    if tag >= 0xe0:
+        return tag - 0x100
+    if tag <= 0x8f:
+        return _read_map(reader, tag & 0x0f)
+    if tag <= 0x9f:
+        return _read_array(reader, tag & 0x0f)
+    if tag <= 0xbf:
+        return str(reader.take(tag & 0x1f), 'utf-8')
+    if tag == 0xc0:
+        return None
+    if tag == 0xc2:
+        return False
+    if tag == 0xc3:
+        return True
+    if tag in _FIXED_FORMATS:
+        return reader.unpack(*_FIXED_FORMATS[tag])
+    if tag in (0xc4, 0xc5, 0xc6):
+        n = reader.unpack(('>B', '>H', '>I')[tag - 0xc4], (1, 2, 4)[tag - 0xc4])
+        return bytes(reader.take(n))
+    if tag in (0xd9, 0xda, 0xdb):
+        n = reader.unpack(('>B', '>H', '>I')[tag - 0xd9], (1, 2, 4)[tag - 0xd9])
+        return str(reader.take(n), 'utf-8')
+    if tag == 0xdc:
+        return _read_array(reader, reader.unpack('>H', 2))
+    if tag == 0xdd:
+        return _read_array(reader, reader.unpack('>I', 4))
+    if tag == 0xde:
+        return _read_map(reader, reader.unpack('>H', 2))
+    if tag == 0xdf:
+        return _read_map(reader, reader.unpack('>I', 4))
+    raise ValueError(f"Unsupported MessagePack type 0x{tag:02x}")
+
+
+def _read_array(reader, n):
+    return [_unpack_from(reader) for _ in range(n)]
+
+
+def _read_map(reader, n):
+    result = {}
+    for _ in range(n):
+        key = _unpack_from(reader)
+        result[key] = _unpack_from(reader)
+    return result
+
+
+def packb(obj):
+    if _msgpack is not None:
+        return _msgpack.packb(obj, use_bin_type=True, use_single_float=False)
+    out = bytearray()
+    _pack_into(obj, out)
+    return bytes(out)
+
+
+def unpackb(data):
+    if _msgpack is not None:
+        return _msgpack.unpackb(data, raw=False, strict_map_key=False)
+    reader = _Reader(data)
+    result = _unpack_from(reader)
+    if reader.pos != len(reader.data):
+        raise ValueError("Trailing bytes after MessagePack value")
+    return result
+
+
+def encode_message(obj):
+    """Compact-schema MessagePack encoding of a Socket.IO event payload."""
+    return packb(compact(obj))
+
+
+def decode_message(data):
+    return expand(unpackb(data))
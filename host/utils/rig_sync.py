@@ -0,0 +1,305 @@
+"""
+Rig-wide frequency and phase changes applied at one sync edge (POST /api/rig/apply,
+frequency encoder).
+
+Writing set_frequency to every synth and channel in turn leaves L1/L2/L3 running
+at different frequencies for as long as the writes take, which walks them off
+their 120 degree relationship. apply_rig_change instead stages the change on
+every synth (wsf/wsp, held by the firmware), then arms the same commit version on
+all of them back to back (wcs<version>). Each synth applies it on the next edge of
+the shared sync square wave and realigns its DDS there, so the rig switches
+together; rc is then read from every synth to confirm they all report that
+version. Firmware without staged commits gets direct writes, and the result says
+the change was not coherent.
+
+The control loop must not wait for that edge, so a RigChange is started in one
+pass and its rc reads are repeated on later passes until every synth confirmed or
+the deadline passed (RIG_CHANGES). Only one change is armed at a time, since the
+firmware rejects staged writes while a commit is armed; changes that arrive
+meanwhile are merged and started next. A direct frequency or phase write to a synth
+in the armed or waiting change joins the waiting one too: sent at once, it would be
+overwritten by the armed commit at the edge and in state once that settles.
+apply_rig_change() runs one to completion for callers outside the loop.
+"""
+import itertools
+import logging
+import time
+from collections import OrderedDict
+
+from utils.batch import CHANNELS, RANGES, _number
+from utils.command_journal import journal_source
+
+logger = logging.getLogger("NHP_Synth")
+
+MAX_RIG_CHANGES = 64
+# Extra time allowed past two sync periods for the edge and the rc round trips
+VERIFY_MARGIN_S = 0.05
+# Poll interval of apply_rig_change(); the control loop polls once per pass instead
+VERIFY_POLL_S = 0.002
+
+# Commit versions only need to differ from whatever the synths applied last, including
+# before a host restart, so they continue from the clock rather than from zero
+_versions = itertools.count(int(time.time()) & 0x7FFFFFFF)
+
+
+def validate_rig_change(entries, num_synths):
+    """
+    Returns (changes, errors) for a list of {'synth_id', 'channel', 'frequency', 'phase'}
+    entries, where at least one of frequency/phase is given; errors is a list of
+    {'index', 'error'} and empty when all are valid.
+    """
+    changes, errors = [], []
+    for index, entry in enumerate(entries):
+        try:
+            if not isinstance(entry, dict):
+                raise ValueError("change must be an object")
+            synth_id = entry.get('synth_id')
+            if isinstance(synth_id, bool) or not isinstance(synth_id, int) or not 0 <= synth_id < num_synths:
+                raise ValueError(f"synth_id must be an integer from 0 to {num_synths - 1}")
+            if entry.get('channel') not in CHANNELS:
+                raise ValueError("channel must be 'a' or 'b'")
+            change = {'synth_id': synth_id, 'channel': entry['channel']}
+            if entry.get('frequency') is not None:
+                change['frequency'] = _number(entry['frequency'], *RANGES['set_frequency'], 'frequency')
+            if entry.get('phase') is not None:
+                change['phase'] = _number(entry['phase'], *RANGES['set_phase'], 'phase')
+            if len(change) == 2:
+                raise ValueError("change needs a frequency and/or a phase")
+            changes.append(change)
+        except ValueError as e:
+            errors.append({'index': index, 'error': str(e)})
+    return changes, errors
+
+
+def _write(synth, changes, staged):
+    """Stage (or, for firmware without commits, directly write) one synth's changes as one burst."""
+    with synth.transaction():
+        for change in changes:
+            if 'frequency' in change:
+                (synth.stage_frequency if staged else synth.set_frequency)(change['channel'], change['frequency'])
+            if 'phase' in change:
+                (synth.stage_phase if staged else synth.set_phase)(change['channel'], change['phase'])
+
+
+def merge_rig_changes(*change_lists):
+    """One change list holding the latest frequency and phase per synth and channel, in first-seen order."""
+    merged = OrderedDict()
+    for changes in change_lists:
+        for change in changes:
+            key = (change['synth_id'], change['channel'])
+            merged.setdefault(key, {'synth_id': change['synth_id'], 'channel': change['channel']}).update(
+                {k: v for k, v in change.items() if k in ('frequency', 'phase')})
+    return list(merged.values())
+
+
+class RigChange:
+    """
+    One rig change: start() stages and arms it on every synth, poll() reads the commit
+    back and returns True once every synth is settled, with the outcome in `result`
+    (see apply_rig_change).
+    """
+
+    def __init__(self, changes, synths, state_manager, at_sync=True):
+        self.changes = changes
+        self.synths = synths
+        self.state_manager = state_manager
+        self.at_sync = at_sync
+        self.version = next(_versions)
+        self.groups = {}
+        for change in changes:
+            self.groups.setdefault(change['synth_id'], []).append(change)
+        self.results = {}
+        self.pending = []
+        self.check_at = self.deadline = 0.0
+        self.result = None
+        self._started = None
+
+    def _period(self, synth_id):
+        """Channel A period the synth runs at before the change; its sync edge comes within one."""
+        frequency = self.synths[synth_id].running_frequency.get('a')
+        if frequency is None:
+            frequency = self.state_manager.synths[synth_id].get('frequency_a')
+        return 1.0 / max(1.0, frequency or 1.0)
+
+    def start(self):
+        self._started = time.perf_counter()
+        armed = []
+        for synth_id, group in self.groups.items():
+            synth = self.synths[synth_id] if 0 <= synth_id < len(self.synths) else None
+            if synth is None or not synth.online:
+                self.results[synth_id] = {'synth_id': synth_id, 'status': 'offline'}
+                continue
+            staged = synth.sync_commit is not False
+            try:
+                _write(synth, group, staged)
+            except Exception as e:
+                self.results[synth_id] = {'synth_id': synth_id, 'status': 'failed', 'error': str(e)}
+                continue
+            if staged:
+                armed.append(synth_id)
+            else:
+                self.results[synth_id] = {'synth_id': synth_id, 'status': 'direct'}
+
+        # Periods before arming: running_frequency only moves once a commit is confirmed
+        period = max((self._period(synth_id) for synth_id in armed), default=0.0)
+        # Arm every synth before reading any back: the commit lines go out within a
+        # fraction of a sync period, so all synths wait for the same edge
+        for synth_id in armed:
+            self.synths[synth_id].commit_staged(self.version, at_sync=self.at_sync)
+        now = time.monotonic()
+        self.pending = armed
+        self.check_at = now + (period if self.at_sync else 0.0)
+        self.deadline = now + 2 * period + VERIFY_MARGIN_S
+        return self
+
+    def poll(self):
+        """Read back the commit from the synths still pending (once the edge is due); True when done."""
+        if self.result is not None:
+            return True
+        now = time.monotonic()
+        if self.pending and now < self.check_at:
+            return False
+        for synth_id in list(self.pending):
+            synth = self.synths[synth_id]
+            try:
+                commit = synth.get_commit()
+            except Exception as e:
+                self.results[synth_id] = {'synth_id': synth_id, 'status': 'failed', 'error': str(e)}
+                self.pending.remove(synth_id)
+                continue
+            if commit == (self.version, 0):
+                self.results[synth_id] = {'synth_id': synth_id, 'status': 'synced', 'version': self.version}
+                self.pending.remove(synth_id)
+            elif commit is None and synth.sync_commit is False:
+                # First change on older firmware: the staged lines were ignored
+                try:
+                    _write(synth, self.groups[synth_id], staged=False)
+                    self.results[synth_id] = {'synth_id': synth_id, 'status': 'direct'}
+                except Exception as e:
+                    self.results[synth_id] = {'synth_id': synth_id, 'status': 'failed', 'error': str(e)}
+                self.pending.remove(synth_id)
+        if self.pending and now < self.deadline:
+            return False
+        self._force_pending()
+        self._finish()
+        return True
+
+    def _force_pending(self):
+        # No edge seen (sync input idle and internal edge not reached): apply now rather than
+        # leaving the rig split between armed and applied synths
+        for synth_id in self.pending:
+            synth = self.synths[synth_id]
+            try:
+                synth.commit_staged(self.version, at_sync=False)
+                commit = synth.get_commit()
+            except Exception as e:
+                commit, error = None, str(e)
+            else:
+                error = f"reported commit {commit}"
+            if commit == (self.version, 0):
+                self.results[synth_id] = {'synth_id': synth_id, 'status': 'forced', 'version': self.version}
+            else:
+                self.results[synth_id] = {'synth_id': synth_id, 'status': 'failed', 'error': error}
+            logger.warning(f"Synth {synth_id} missed the sync edge for commit {self.version}: "
+                           f"{self.results[synth_id]['status']}")
+        self.pending = []
+
+    def _finish(self):
+        for synth_id, group in self.groups.items():
+            if self.results[synth_id]['status'] in ('synced', 'forced', 'direct'):
+                for change in group:
+                    for key in ('frequency', 'phase'):
+                        if key in change:
+                            self.state_manager.set_value(synth_id, f"{key}_{change['channel']}", change[key])
+
+        ordered = [self.results[synth_id] for synth_id in self.groups]
+        self.result = {
+            'version': self.version,
+            'coherent': bool(ordered) and all(r['status'] == 'synced' for r in ordered),
+            'synths': ordered,
+            'apply_s': round(time.perf_counter() - self._started, 6),
+        }
+
+
+def apply_rig_change(changes, synths, state_manager, at_sync=True):
+    """
+    Apply validated changes (see validate_rig_change) to all their synths at once,
+    waiting for the sync edge.
+
+    Returns {'version', 'coherent', 'synths': [{'synth_id', 'status', ...}], 'apply_s'}.
+    A synth's status is 'synced' (applied the commit at the shared edge), 'forced'
+    (no edge within the verify window, applied on request instead), 'direct' (no
+    commit support, written directly), 'offline' or 'failed'. coherent is True when
+    every targeted synth is 'synced'.
+    """
+    change = RigChange(changes, synths, state_manager, at_sync).start()
+    while not change.poll():
+        time.sleep(VERIFY_POLL_S)
+    return change.result
+
+
+class RigChangeQueue:
+    """
+    Rig changes of the control loop. submit() starts a change, or merges it into the
+    one waiting while another is armed; poll(), once per pass, advances the armed
+    change and reports each finished one to its callbacks.
+    """
+
+    def __init__(self):
+        self.active = None  # (RigChange, callbacks, journal source)
+        self.waiting = None  # (changes, synths, state_manager, callbacks, journal source)
+
+    def submit(self, changes, synths, state_manager, on_done=None, source=None):
+        callbacks = [on_done] if on_done is not None else []
+        if self.waiting is not None:
+            changes = merge_rig_changes(self.waiting[0], changes)
+            callbacks = self.waiting[3] + callbacks
+        self.waiting = (changes, synths, state_manager, callbacks, source)
+        self.poll()
+
+    def poll(self):
+        while True:
+            if self.active is not None:
+                change, callbacks, source = self.active
+                try:
+                    with journal_source(source):
+                        done = change.poll()
+                except Exception as e:
+                    logger.error(f"Rig change {change.version} abandoned: {e}")
+                    self.active = None
+                    continue
+                if not done:
+                    return
+                self.active = None
+                for callback in callbacks:
+                    callback(change.result)
+            if self.waiting is None:
+                return
+            changes, synths, state_manager, callbacks, source = self.waiting
+            self.waiting = None
+            try:
+                with journal_source(source):
+                    self.active = (RigChange(changes, synths, state_manager).start(), callbacks, source)
+            except Exception as e:
+                logger.error(f"Rig change not started: {e}")
+
+    def targets(self, synth_id):
+        """True if the armed or the waiting change writes to `synth_id`."""
+        if self.active is not None and synth_id in self.active[0].groups:
+            return True
+        return self.waiting is not None and any(change['synth_id'] == synth_id for change in self.waiting[0])
+
+    @property
+    def busy(self):
+        return self.active is not None or self.waiting is not None
+
+    def finish(self, timeout=1.0):
+        """Poll until the queued changes are settled (at shutdown, when no later pass comes)."""
+        deadline = time.monotonic() + timeout
+        self.poll()
+        while self.busy and time.monotonic() < deadline:
+            time.sleep(VERIFY_POLL_S)
+            self.poll()
+
+
+RIG_CHANGES = RigChangeQueue()
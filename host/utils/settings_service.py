@@ -0,0 +1,184 @@
+"""
+In-memory settings service backed by config/settings.json.
+
+The file is parsed once; reads are served from memory. Updates bump `version`,
+notify subscribers (harmonic calibration cache, dashboard settingsUpdated emit,
+auto-on sync) and are written behind a short debounce with an atomic rename, so
+neither REST requests nor the harmonic command path touch the SD card.
+"""
+import atexit
+import copy
+import datetime
+import json
+import logging
+import os
+import threading
+
+from utils.file_utils import atomic_write_text
+
+logger = logging.getLogger("NHP_Synth")
+
+SETTINGS_FILE = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), 'config', 'settings.json')
+
+
+def default_settings():
+    return {
+        'maxVoltage': 230,
+        'maxCurrent': 5,
+        'chartRefreshRate': 100,
+        'precisionDigits': 2,
+        'autoSaveSettings': True,
+        'debugMode': False,
+        'synthAutoOn': [],  # one flag per synth; /api/settings fills it from the synth state
+        'harmonicCalibration': {
+            'enabled': False,
+            'mode': 'linear',
+            'linearA': 0.0,
+            'perHarmonic': {}
+        }
+    }
+
+
+def normalize_harmonic_calibration(raw_cfg):
+    normalized = {
+        'enabled': False,
+        'mode': 'linear',
+        'linearA': 0.0,
+        'perHarmonic': {}
+    }
+
+    if not isinstance(raw_cfg, dict):
+        return normalized
+
+    normalized['enabled'] = bool(raw_cfg.get('enabled', False))
+    mode = str(raw_cfg.get('mode', 'linear'))
+    normalized['mode'] = mode if mode in ['linear', 'per_harmonic'] else 'linear'
+    try:
+        normalized['linearA'] = float(raw_cfg.get('linearA', 0.0))
+    except (TypeError, ValueError):
+        normalized['linearA'] = 0.0
+
+    per_harmonic = raw_cfg.get('perHarmonic', {})
+    if isinstance(per_harmonic, dict):
+        cleaned = {}
+        for key, value in per_harmonic.items():
+            try:
+                cleaned[str(int(key))] = float(value)
+            except (TypeError, ValueError):
+                continue
+        normalized['perHarmonic'] = cleaned
+
+    return normalized
+
+
+class SettingsService:
+    def __init__(self, path=SETTINGS_FILE, save_delay=0.5):
+        self.path = path
+        self.save_delay = save_delay
+        self.version = 0
+        self._lock = threading.RLock()
+        self._write_lock = threading.Lock()
+        self._settings = None
+        self._subscribers = []
+        self._dirty = False
+        self._timer = None
+
+    def _ensure_loaded(self):
+        if self._settings is not None:
+            return
+        settings = default_settings()
+        try:
+            with open(self.path, 'r') as f:
+                loaded = json.load(f)
+            if isinstance(loaded, dict):
+                settings.update(loaded)
+        except FileNotFoundError:
+            self._schedule_save()  # first run: persist the defaults
+        except Exception as e:
+            logger.warning(f"Could not load settings, using defaults: {e}")
+        settings['harmonicCalibration'] = normalize_harmonic_calibration(settings.get('harmonicCalibration', {}))
+        self._settings = settings
+
+    def get(self):
+        """Deep copy of the current settings."""
+        with self._lock:
+            self._ensure_loaded()
+            return copy.deepcopy(self._settings)
+
+    def get_section(self, key, default=None):
+        with self._lock:
+            self._ensure_loaded()
+            return copy.deepcopy(self._settings.get(key, default))
+
+    def subscribe(self, callback):
+        """callback(settings, changed_keys) runs after every change, on the updating thread."""
+        with self._lock:
+            self._subscribers.append(callback)
+        return lambda: self._subscribers.remove(callback)
+
+    def replace(self, settings, persist=True):
+        """
+        Replace the whole settings dict (already validated). Returns the stored copy.
+        persist=False applies settings another process has already saved (split host).
+        """
+        settings = dict(settings)
+        settings['harmonicCalibration'] = normalize_harmonic_calibration(settings.get('harmonicCalibration', {}))
+        if persist:
+            settings['lastSaved'] = datetime.datetime.now().isoformat()
+        with self._lock:
+            self._ensure_loaded()
+            previous = self._settings
+            changed = {key for key in set(previous) | set(settings)
+                       if key != 'lastSaved' and previous.get(key) != settings.get(key)}
+            self._settings = settings
+            self.version += 1
+            if persist:
+                self._schedule_save()
+            subscribers = list(self._subscribers)
+            snapshot = copy.deepcopy(settings)
+        for callback in subscribers:
+            try:
+                callback(snapshot, changed)
+            except Exception as e:
+                logger.warning(f"Settings subscriber failed: {e}")
+        return snapshot
+
+    def update(self, partial):
+        """Merge top-level keys into the current settings."""
+        with self._lock:
+            self._ensure_loaded()
+            merged = {**self._settings, **partial}
+        return self.replace(merged)
+
+    def reset(self):
+        return self.replace(default_settings())
+
+    def _schedule_save(self):
+        with self._lock:
+            self._dirty = True
+            if self._timer is None:
+                self._timer = threading.Timer(self.save_delay, self.flush)
+                self._timer.daemon = True
+                self._timer.start()
+
+    def flush(self):
+        """Write pending changes now."""
+        with self._write_lock:
+            with self._lock:
+                self._timer = None
+                if not self._dirty or self._settings is None:
+                    return True
+                text = json.dumps(self._settings, indent=2)
+                self._dirty = False
+            try:
+                atomic_write_text(self.path, text)
+                return True
+            except Exception as e:
+                logger.warning(f"Could not save settings: {e}")
+                with self._lock:
+                    self._dirty = True
+                return False
+
+
+SETTINGS = SettingsService()
+atexit.register(SETTINGS.flush)
@@ -0,0 +1,293 @@
+"""
+Shared-memory primitives for the split control/web host (see utils/shared_state.py).
+
+Both live in a file-backed mmap (in /dev/shm when available) that the control
+process creates and the web process attaches to by path, so neither side ever
+takes a lock the other holds:
+
+- SeqlockBlock: one writer publishes a byte payload; readers copy it without
+  blocking the writer and retry when the sequence number shows they raced a write.
+- CommandRing: single-producer / single-consumer ring of length-prefixed records.
+  The producer only advances `head`, the consumer only advances `tail`; a full
+  ring rejects the record instead of blocking the producer.
+
+CPython gives no memory fences between the two processes, so both structures carry a
+CRC of every payload and readers re-read until it matches rather than trusting
+store ordering.
+
+ChangeSignal is the wakeup that goes with a SeqlockBlock: a Unix datagram socket
+next to it, so a reader can sleep in select() until the writer publishes.
+"""
+import mmap
+import os
+import queue
+import select
+import socket
+import struct
+import tempfile
+import threading
+import time
+import zlib
+
+SHM_DIR = '/dev/shm' if os.path.isdir('/dev/shm') else tempfile.gettempdir()
+
+
+def shm_path(name):
+    return os.path.join(SHM_DIR, f'nhp_synth_{os.getpid()}_{name}')
+
+
+class _Mapping:
+    def __init__(self, path, size, create):
+        self.path = path
+        flags = os.O_RDWR | (os.O_CREAT | os.O_TRUNC if create else 0)
+        fd = os.open(path, flags, 0o600)
+        try:
+            if create:
+                os.ftruncate(fd, size)
+            else:
+                size = os.fstat(fd).st_size
+            self.buf = mmap.mmap(fd, size)
+        finally:
+            os.close(fd)
+        self.size = size
+        self._owner = create
+
+    def close(self):
+        try:
+            self.buf.close()
+        except (BufferError, ValueError):
+            pass
+        if self._owner:
+            try:
+                os.unlink(self.path)
+            except FileNotFoundError:
+                pass
+
+
+class SeqlockBlock:
+    """
+    Header: u64 sequence (odd while a write is in progress), u32 length, u32 crc32.
+    Single writer; any number of readers in any process.
+    """
+    _HEADER = struct.Struct('<QII')
+
+    def __init__(self, path, capacity=None, create=False):
+        size = None if capacity is None else self._HEADER.size + capacity
+        self._map = _Mapping(path, size, create)
+        self.path = path
+        self.capacity = self._map.size - self._HEADER.size
+
+    @classmethod
+    def create(cls, name, capacity):
+        return cls(shm_path(name), capacity, create=True)
+
+    @classmethod
+    def attach(cls, path):
+        return cls(path)
+
+    @property
+    def sequence(self):
+        """Cheap change check: the sequence moves on every write."""
+        return struct.unpack_from('<Q', self._map.buf, 0)[0]
+
+    def write(self, payload):
+        if len(payload) > self.capacity:
+            raise ValueError(f"payload of {len(payload)} bytes exceeds {self.capacity}-byte block")
+        buf = self._map.buf
+        seq = self.sequence
+        struct.pack_into('<Q', buf, 0, seq + 1)
+        buf[self._HEADER.size:self._HEADER.size + len(payload)] = payload
+        struct.pack_into('<II', buf, 8, len(payload), zlib.crc32(payload))
+        struct.pack_into('<Q', buf, 0, seq + 2)
+
+    def read(self, timeout=1.0):
+        """Consistent copy of the payload (b'' before the first write); None if no stable read within timeout."""
+        buf = self._map.buf
+        deadline = time.monotonic() + timeout
+        while True:
+            seq, length, crc = self._HEADER.unpack_from(buf, 0)
+            if seq % 2 == 0 and length <= self.capacity:
+                payload = bytes(buf[self._HEADER.size:self._HEADER.size + length])
+                if self.sequence == seq and zlib.crc32(payload) == crc:
+                    return payload
+            if time.monotonic() >= deadline:
+                return None
+            time.sleep(0.0005)
+
+    def close(self):
+        self._map.close()
+
+
+class CommandRing:
+    """
+    Header: u64 head (bytes written, producer-owned), u64 tail (bytes read,
+    consumer-owned), u64 rejected (producer-owned). Records are u32 length,
+    u32 crc32, u32 stream offset (low bits of head when written, so a stale
+    record from the previous lap never validates), payload. A record never
+    wraps: a WRAP marker (or too little room for a record header) sends the
+    consumer back to the start of the buffer.
+
+    put()/get_nowait()/empty()/qsize() mirror queue.Queue so process_command_queue
+    can drain a ring like the local command queue. Threads of the producing
+    process share a process-local lock; the consumer never waits on it.
+    """
+    _HEADER_SIZE = 64
+    _RECORD = struct.Struct('<III')
+    _WRAP = 0xFFFFFFFF
+
+    def __init__(self, path, capacity=None, create=False, encode=None, decode=None):
+        size = None if capacity is None else self._HEADER_SIZE + capacity
+        self._map = _Mapping(path, size, create)
+        self.path = path
+        self.capacity = self._map.size - self._HEADER_SIZE
+        self._encode = encode or (lambda item: item)
+        self._decode = decode or (lambda data: data)
+        self._put_lock = threading.Lock()
+
+    @classmethod
+    def create(cls, name, capacity, **codec):
+        return cls(shm_path(name), capacity, create=True, **codec)
+
+    @classmethod
+    def attach(cls, path, **codec):
+        return cls(path, **codec)
+
+    def _load(self, offset):
+        return struct.unpack_from('<Q', self._map.buf, offset)[0]
+
+    def _store(self, offset, value):
+        struct.pack_into('<Q', self._map.buf, offset, value)
+
+    @property
+    def rejected(self):
+        """Records refused because the ring was full."""
+        return self._load(16)
+
+    def qsize(self):
+        """Bytes waiting (the ring holds variable-size records)."""
+        return self._load(0) - self._load(8)
+
+    def empty(self):
+        return self._load(0) == self._load(8)
+
+    def put(self, item, block=True, timeout=0.05):
+        """Append a record; raises queue.Full if there is no room within `timeout`."""
+        payload = self._encode(item)
+        need = self._RECORD.size + len(payload)
+        if need > self.capacity // 2:
+            raise ValueError(f"record of {len(payload)} bytes is too large for the ring")
+        buf = self._map.buf
+        deadline = time.monotonic() + (timeout if block else 0.0)
+        with self._put_lock:
+            while True:
+                head, tail = self._load(0), self._load(8)
+                pos = head % self.capacity
+                room = self.capacity - pos
+                skip = room if room < need else 0
+                if self.capacity - (head - tail) >= skip + need:
+                    break
+                if time.monotonic() >= deadline:
+                    self._store(16, self.rejected + 1)
+                    raise queue.Full
+                time.sleep(0.001)
+            base = self._HEADER_SIZE
+            if skip:
+                if room >= self._RECORD.size:
+                    self._RECORD.pack_into(buf, base + pos, self._WRAP, 0, head & 0xFFFFFFFF)
+                head += skip
+                pos = 0
+            buf[base + pos + self._RECORD.size:base + pos + need] = payload
+            self._RECORD.pack_into(buf, base + pos, len(payload), zlib.crc32(payload), head & 0xFFFFFFFF)
+            self._store(0, head + need)
+
+    def get_nowait(self):
+        buf = self._map.buf
+        base = self._HEADER_SIZE
+        deadline = None
+        while True:
+            head, tail = self._load(0), self._load(8)
+            if head == tail:
+                raise queue.Empty
+            pos = tail % self.capacity
+            room = self.capacity - pos
+            if room < self._RECORD.size:
+                self._store(8, tail + room)
+                continue
+            length, crc, offset = self._RECORD.unpack_from(buf, base + pos)
+            if offset == tail & 0xFFFFFFFF and length == self._WRAP:
+                self._store(8, tail + room)
+                continue
+            if offset == tail & 0xFFFFFFFF and length <= room - self._RECORD.size:
+                start = base + pos + self._RECORD.size
+                payload = bytes(buf[start:start + length])
+                if zlib.crc32(payload) == crc:
+                    self._store(8, tail + self._RECORD.size + length)
+                    return self._decode(payload)
+            # Header or payload not visible yet: the producer's stores are still landing
+            deadline = deadline or time.monotonic() + 0.1
+            if time.monotonic() >= deadline:
+                # Unreadable record (producer died mid-write): drop what is pending and resynchronise
+                self._store(8, head)
+                raise RuntimeError(f"dropped {head - tail} unreadable bytes from the command ring")
+            time.sleep(0.0001)
+
+    def close(self):
+        self._map.close()
+
+
+class ChangeSignal:
+    """
+    One-way wakeup between processes. The waiting side binds a Unix datagram socket
+    at `path`; notify() sends it one byte and never blocks. A notification sent
+    while nobody is bound, or while the socket buffer is full, is dropped, so a
+    waiter still re-checks what it waits for after its timeout.
+
+    wait() sleeps in select(), which the web process's eventlet/gevent monkey patch
+    turns into a green-thread wait.
+    """
+
+    def __init__(self, path, listen=False):
+        self.path = path
+        self._listening = listen
+        self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+        self._sock.setblocking(False)
+        if listen:
+            try:
+                os.unlink(path)
+            except FileNotFoundError:
+                pass
+            self._sock.bind(path)
+
+    @classmethod
+    def notifier(cls, path):
+        return cls(path)
+
+    @classmethod
+    def listen(cls, path):
+        return cls(path, listen=True)
+
+    def notify(self):
+        try:
+            self._sock.sendto(b'\x01', self.path)
+        except OSError:
+            pass  # no listener yet, or it is already behind on wakeups
+
+    def wait(self, timeout):
+        """True if notified within `timeout` seconds; pending notifications are consumed."""
+        readable, _, _ = select.select([self._sock], [], [], max(0.0, timeout))
+        if not readable:
+            return False
+        try:
+            while self._sock.recv(64):
+                pass
+        except (BlockingIOError, InterruptedError):
+            pass
+        return True
+
+    def close(self):
+        self._sock.close()
+        if self._listening:
+            try:
+                os.unlink(self.path)
+            except FileNotFoundError:
+                pass
@@ -0,0 +1,242 @@
+"""
+Synth state shared between the control process and the web process.
+
+The control process owns SynthStateManager. StatePublisher waits on its change
+notifications and publishes a compact JSON snapshot into a SeqlockBlock (at most
+once per `min_interval`), plus a status block with the control process's
+metrics and startup report once a second. Each state publish also fires a
+ChangeSignal, which wakes the web process instead of it polling the block. The web
+process wraps the blocks in a SharedStateView, which gives create_app the same read
+interface as SynthStateManager (synths, defaults, selection_mode, version,
+wait_for_changes); the few writes the dashboard makes are sent to the control
+process as commands.
+"""
+import json
+import logging
+import queue
+import threading
+import time
+
+from utils.metrics import REGISTRY
+from utils.startup import STARTUP_REPORT
+
+logger = logging.getLogger("NHP_Synth")
+
+STATE_BLOCK_BYTES = 1 << 20
+STATUS_BLOCK_BYTES = 1 << 20
+COMMAND_RING_BYTES = 1 << 18
+
+
+def encode_command(command):
+    return json.dumps(command, separators=(',', ':')).encode('utf-8')
+
+
+def decode_command(data):
+    return json.loads(data.decode('utf-8'))
+
+
+class StatePublisher:
+    def __init__(self, state_manager, state_block, status_block=None, min_interval=0.02, status_interval=1.0,
+                 signal=None):
+        self.state_manager = state_manager
+        self.state_block = state_block
+        self.status_block = status_block
+        self.signal = signal  # ChangeSignal notified after every state write
+        self.min_interval = min_interval
+        self.status_interval = status_interval
+        self._stop = threading.Event()
+        self._thread = None
+
+    def start(self):
+        if self._thread is None:
+            self.publish_state()
+            self.publish_status()
+            self._thread = threading.Thread(target=self._run, name="state-publisher", daemon=True)
+            self._thread.start()
+        return self
+
+    def stop(self):
+        self._stop.set()
+        if self._thread is not None:
+            self._thread.join(timeout=2.0)
+            self._thread = None
+
+    def publish_state(self):
+        state = self.state_manager
+        for _ in range(3):
+            try:
+                payload = encode_command({
+                    'version': state.version,
+                    'num_synths': state.num_synths,
+                    'synths': state.synths,
+                    'defaults': state.defaults,
+                    'selectionMode': state.selection_mode,
+                })
+                break
+            except RuntimeError:
+                continue  # synth dict mutated by another thread mid-serialise; retry
+        else:
+            return False
+        self.state_block.write(payload)
+        if self.signal is not None:
+            self.signal.notify()
+        return True
+
+    def publish_status(self):
+        if self.status_block is None:
+            return
+        self.status_block.write(encode_command({
+            'metrics': REGISTRY.snapshot(),
+            'metrics_text': REGISTRY.render_text(),
+            'startup': STARTUP_REPORT.snapshot(),
+        }))
+
+    def _run(self):
+        version = self.state_manager.version
+        last_status = time.monotonic()
+        while not self._stop.is_set():
+            try:
+                new_version, _ = self.state_manager.wait_for_changes(version, timeout=self.status_interval)
+                if new_version != version and self.publish_state():
+                    version = new_version
+                if time.monotonic() - last_status >= self.status_interval:
+                    self.publish_status()
+                    last_status = time.monotonic()
+            except Exception as e:
+                logger.warning(f"State publish failed: {e}")
+            self._stop.wait(self.min_interval)
+
+
+class SharedStateView:
+    """
+    Read-only SynthStateManager stand-in for the web process.
+
+    With a ChangeSignal, wait_for_changes() sleeps until StatePublisher announces a
+    write and re-checks the block every `poll_interval` only in case a wakeup was
+    lost; without one it polls the block at that interval.
+    """
+
+    def __init__(self, state_block, command_queue, signal=None, poll_interval=None):
+        self.state_block = state_block
+        self.command_queue = command_queue
+        self.signal = signal
+        self.poll_interval = poll_interval if poll_interval is not None else (0.5 if signal else 0.01)
+        self._lock = threading.Lock()
+        self._sequence = None
+        self._snapshot = {'version': 0, 'num_synths': 0, 'synths': [], 'defaults': [], 'selectionMode': None}
+        self._diff_base = None
+        self._force_full = False
+        self._refresh()
+
+    def _refresh(self):
+        """Pick up the latest published snapshot; returns it."""
+        sequence = self.state_block.sequence
+        with self._lock:
+            if sequence == self._sequence:
+                return self._snapshot
+        payload = self.state_block.read()
+        if payload:
+            snapshot = json.loads(payload.decode('utf-8'))
+            with self._lock:
+                self._snapshot = snapshot
+                self._sequence = sequence
+        with self._lock:
+            return self._snapshot
+
+    @property
+    def version(self):
+        return self._refresh()['version']
+
+    @property
+    def num_synths(self):
+        return self._refresh()['num_synths']
+
+    @property
+    def synths(self):
+        return self._refresh()['synths']
+
+    @property
+    def selection_mode(self):
+        return self._refresh()['selectionMode']
+
+    @property
+    def defaults(self):
+        return self._refresh()['defaults']
+
+    @defaults.setter
+    def defaults(self, defaults):
+        self._send({'synth_id': None, 'command': 'set_defaults', 'channel': None, 'value': defaults})
+
+    def mark_defaults_changed(self):
+        pass  # set_defaults is persisted by the control process
+
+    def set_value(self, synth_id, key, value):
+        if key != 'auto_on':
+            raise ValueError(f"'{key}' is owned by the control process; send a command instead")
+        self._send({'synth_id': synth_id, 'command': 'set_auto_on', 'channel': None, 'value': bool(value)})
+        return True
+
+    def mark_changed(self, synth_id=None, key=None):
+        """Next wait_for_changes reports a full change (the dashboard resyncs everyone)."""
+        self._force_full = True
+
+    def _send(self, command):
+        command.setdefault('source', 'dashboard')
+        try:
+            self.command_queue.put(command)
+        except queue.Full:
+            logger.warning(f"Command ring full, dropped {command['command']}")
+
+    @staticmethod
+    def _diff(old, new):
+        """Changed paths in SynthStateManager form: (synth_id, key), ('selectionMode',) or ('synths',)."""
+        if old is None or len(old['synths']) != len(new['synths']):
+            return {('synths',)}
+        paths = set()
+        for synth_id, (before, after) in enumerate(zip(old['synths'], new['synths'])):
+            for key in set(before) | set(after):
+                if before.get(key) != after.get(key):
+                    paths.add((synth_id, key))
+        if old.get('selectionMode') != new.get('selectionMode'):
+            paths.add(('selectionMode',))
+        return paths
+
+    def wait_for_changes(self, since_version, timeout=None):
+        """Wait until a snapshot newer than since_version is published (single consumer)."""
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while True:
+            snapshot = self._refresh()
+            if snapshot['version'] > since_version or self._force_full:
+                break
+            wait = self.poll_interval
+            if deadline is not None:
+                wait = min(wait, deadline - time.monotonic())
+                if wait <= 0:
+                    return snapshot['version'], set()
+            if self.signal is not None:
+                self.signal.wait(wait)
+            else:
+                time.sleep(wait)
+        paths = {('synths',)} if self._force_full else self._diff(self._diff_base, snapshot)
+        self._force_full = False
+        # Snapshots are replaced on refresh and never modified, so the base needs no copy
+        self._diff_base = snapshot
+        return snapshot['version'], paths
+
+
+class ControlStatus:
+    """Web-process reader for the control process's status block."""
+
+    def __init__(self, status_block):
+        self.status_block = status_block
+        self._sequence = None
+        self._status = None
+
+    def __call__(self):
+        sequence = self.status_block.sequence
+        if sequence != self._sequence:
+            payload = self.status_block.read()
+            if payload:
+                self._status = json.loads(payload.decode('utf-8'))
+                self._sequence = sequence
+        return self._status
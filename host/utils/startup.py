@@ -0,0 +1,225 @@
+"""
+Staged startup pipeline.
+
+Startup work is declared as named stages with dependencies. Each stage runs on
+its own worker as soon as the stages it depends on have finished, so independent
+hardware (I2C encoders, serial synths) and the dashboard server come up in
+parallel and boot takes as long as the slowest chain instead of the sum of all
+steps. Every run is recorded in STARTUP_REPORT, which /api/startup serves.
+"""
+import logging
+import socket
+import threading
+import time
+from concurrent.futures import FIRST_COMPLETED, ThreadPoolExecutor, wait
+
+logger = logging.getLogger("NHP_Synth")
+
+
+def _seconds_since_boot():
+    try:
+        with open('/proc/uptime', 'r') as f:
+            return float(f.read().split()[0])
+    except (OSError, ValueError, IndexError):
+        return None
+
+
+class StartupError(Exception):
+    """A critical stage failed. `results` holds what the other stages produced, for cleanup."""
+
+    def __init__(self, stage, error, results):
+        super().__init__(f"Startup stage '{stage}' failed: {error}")
+        self.stage = stage
+        self.error = error
+        self.results = results
+
+
+class StartupReport:
+    """Per-stage timings of the most recent startup run."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._started = None
+        self._started_at = None
+        self._finished = None
+        self._boot_offset = None
+        self._stages = {}
+
+    def begin(self, stages):
+        with self._lock:
+            self._started = time.monotonic()
+            self._started_at = time.time()
+            self._finished = None
+            self._boot_offset = _seconds_since_boot()
+            self._stages = {
+                stage.name: {
+                    'name': stage.name,
+                    'after': list(stage.after),
+                    'critical': stage.critical,
+                    'status': 'pending',
+                    'start_s': None,
+                    'duration_s': None,
+                    'error': None,
+                    'detail': {},
+                }
+                for stage in stages
+            }
+
+    def stage_started(self, name):
+        with self._lock:
+            entry = self._stages[name]
+            entry['status'] = 'running'
+            entry['start_s'] = round(time.monotonic() - self._started, 4)
+
+    def stage_finished(self, name, error=None):
+        with self._lock:
+            entry = self._stages[name]
+            entry['status'] = 'failed' if error is not None else 'ok'
+            entry['duration_s'] = round(time.monotonic() - self._started - entry['start_s'], 4)
+            entry['error'] = None if error is None else str(error)
+            return entry['duration_s']
+
+    def stage_skipped(self, name, reason):
+        with self._lock:
+            self._stages[name]['status'] = 'skipped'
+            self._stages[name]['error'] = reason
+
+    def note(self, name, key, value):
+        """Attach extra detail to a stage (e.g. per-device timings)."""
+        with self._lock:
+            if name in self._stages:
+                self._stages[name]['detail'][key] = value
+
+    def finish(self):
+        with self._lock:
+            self._finished = time.monotonic()
+
+    def _critical_path(self, stages):
+        """Chain of stages ending at the last one to finish, following the latest-finishing dependency."""
+        def end(entry):
+            return entry['start_s'] + entry['duration_s']
+
+        timed = {name: entry for name, entry in stages.items() if entry['duration_s'] is not None}
+        if not timed:
+            return []
+        path = [max(timed.values(), key=end)['name']]
+        while True:
+            deps = [timed[dep] for dep in timed[path[-1]]['after'] if dep in timed]
+            if not deps:
+                return list(reversed(path))
+            path.append(max(deps, key=end)['name'])
+
+    def snapshot(self):
+        with self._lock:
+            if self._started is None:
+                return {'started_at': None, 'complete': False, 'total_s': None, 'stages': []}
+            stages = {name: dict(entry, detail=dict(entry['detail'])) for name, entry in self._stages.items()}
+            end = self._finished if self._finished is not None else time.monotonic()
+            total = round(end - self._started, 4)
+            return {
+                'started_at': self._started_at,
+                'complete': self._finished is not None,
+                'total_s': total,
+                # Time from kernel boot to the end of startup, when the host was started at boot
+                'since_boot_s': None if self._boot_offset is None else round(self._boot_offset + total, 2),
+                'critical_path': self._critical_path(stages),
+                'stages': sorted(stages.values(),
+                                 key=lambda e: (e['start_s'] is None, e['start_s'] or 0.0)),
+            }
+
+
+class _Stage:
+    def __init__(self, name, fn, after, critical):
+        self.name = name
+        self.fn = fn
+        self.after = tuple(after)
+        self.critical = critical
+
+
+class StartupPipeline:
+    def __init__(self, report=None):
+        self.report = report if report is not None else STARTUP_REPORT
+        self._stages = {}
+
+    def stage(self, name, fn, after=(), critical=True):
+        """
+        Add a stage. fn(inputs) receives a dict of its dependencies' results and
+        returns this stage's result. A failed critical stage fails the run; a
+        failed non-critical stage only skips the stages that depend on it.
+        """
+        if name in self._stages:
+            raise ValueError(f"Duplicate startup stage '{name}'")
+        self._stages[name] = _Stage(name, fn, after, critical)
+        return self
+
+    def _execute(self, stage, inputs):
+        self.report.stage_started(stage.name)
+        try:
+            result = stage.fn(inputs)
+        except Exception as e:
+            duration = self.report.stage_finished(stage.name, error=e)
+            logger.error(f"✗ [{stage.name}] failed after {duration:.2f}s: {e}")
+            raise
+        duration = self.report.stage_finished(stage.name)
+        logger.info(f"✓ [{stage.name}] done in {duration:.2f}s")
+        return result
+
+    def run(self):
+        """Run every stage as early as its dependencies allow. Returns {name: result}."""
+        self.report.begin(self._stages.values())
+        results, failed = {}, {}
+        pending = dict(self._stages)
+        running = {}
+        with ThreadPoolExecutor(max_workers=max(1, len(pending)), thread_name_prefix='startup') as executor:
+            while pending or running:
+                progressed = True
+                while progressed:
+                    progressed = False
+                    for name, stage in list(pending.items()):
+                        blocked = [dep for dep in stage.after if dep in failed or dep not in self._stages]
+                        if blocked:
+                            failed[name] = None
+                            self.report.stage_skipped(name, f"dependency unavailable: {', '.join(blocked)}")
+                            del pending[name]
+                            progressed = True
+                        elif all(dep in results for dep in stage.after):
+                            inputs = {dep: results[dep] for dep in stage.after}
+                            running[executor.submit(self._execute, stage, inputs)] = name
+                            del pending[name]
+                            progressed = True
+                if not running:
+                    break  # anything left waits on itself
+                done, _ = wait(running, return_when=FIRST_COMPLETED)
+                for future in done:
+                    name = running.pop(future)
+                    try:
+                        results[name] = future.result()
+                    except Exception as e:
+                        failed[name] = e
+        for name in pending:
+            self.report.stage_skipped(name, "dependency cycle")
+        self.report.finish()
+
+        snapshot = self.report.snapshot()
+        logger.info(f"Startup finished in {snapshot['total_s']:.2f}s "
+                    f"(critical path: {' -> '.join(snapshot['critical_path']) or 'none'})")
+        for name, error in failed.items():
+            if error is not None and self._stages[name].critical:
+                raise StartupError(name, error, results)
+        return results
+
+
+def wait_for_listen(port, host='127.0.0.1', timeout=10.0, interval=0.05):
+    """Block until something accepts TCP connections on host:port. Returns True if it did in time."""
+    deadline = time.monotonic() + timeout
+    while True:
+        try:
+            with socket.create_connection((host, port), timeout=interval * 4):
+                return True
+        except OSError:
+            if time.monotonic() >= deadline:
+                return False
+            time.sleep(interval)
+
+
+STARTUP_REPORT = StartupReport()
@@ -1,4 +1,9 @@
 import logging
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+from utils.history import HISTORY
+from utils.metrics import POLL_DURATION, POLL_FAILURES
 
 logger = logging.getLogger("NHP_Synth")
 
@@ -10,86 +15,115 @@ def _to_float(value, fallback):
         return fallback
 
 
+# One worker per synth UART: a poll takes as long as the slowest synth, not the sum,
+# and a synth that times out does not hold up the others.
+_pool = None
+_pool_size = 0
+
+
+def _executor(size):
+    global _pool, _pool_size
+    if _pool is None or _pool_size < size:
+        if _pool is not None:
+            _pool.shutdown(wait=False)
+        _pool = ThreadPoolExecutor(max_workers=size, thread_name_prefix='synth-poll')
+        _pool_size = size
+    return _pool
+
+
+def _poll_one(synth_id, synth, synth_state, state_manager):
+    """Poll one synth and reconcile its state. Returns (ok, changed)."""
+    changed_keys = []
+    if not getattr(synth, 'online', True):
+        # Offline slot of a degraded rig: counts as a failed poll so reconnect keeps looking
+        POLL_FAILURES.inc(synth=synth_id)
+        return False, False
+
+    try:
+        enabled_a = synth.get_enabled("a")
+        enabled_b = synth.get_enabled("b")
+        amp_a = synth.get_amplitude("a")
+        amp_b = synth.get_amplitude("b")
+        freq_a = synth.get_frequency("a")
+        freq_b = synth.get_frequency("b")
+        phase_a = synth.get_phase("a")
+        phase_b = synth.get_phase("b")
+    except Exception as exc:
+        logger.warning(f"Synth {synth_id} poll failed: {exc}")
+        POLL_FAILURES.inc(synth=synth_id)
+        return False, False
+
+    # If any critical numeric readback is invalid (None), treat this synth as a failed poll cycle.
+    # This catches cases where ESP boot logs/noise are read instead of protocol responses.
+    if any(v is None for v in [amp_a, amp_b, freq_a, freq_b, phase_a, phase_b]):
+        logger.warning(
+            f"Synth {synth_id} poll returned invalid numeric readbacks; skipping state update for this cycle"
+        )
+        POLL_FAILURES.inc(synth=synth_id)
+        return False, False
+
+    expected_enabled_a = bool(enabled_a)
+    expected_enabled_b = bool(enabled_b)
+    if synth_state.get("enabled", {}).get("a") != expected_enabled_a:
+        synth_state.setdefault("enabled", {})["a"] = expected_enabled_a
+        changed_keys.append("enabled")
+    if synth_state.get("enabled", {}).get("b") != expected_enabled_b:
+        synth_state.setdefault("enabled", {})["b"] = expected_enabled_b
+        changed_keys.append("enabled")
+
+    new_amp_a = round(_to_float(amp_a, synth_state.get("amplitude_a", 0.0)), 3)
+    new_amp_b = round(_to_float(amp_b, synth_state.get("amplitude_b", 0.0)), 3)
+    new_freq_a = round(_to_float(freq_a, synth_state.get("frequency_a", 50.0)), 3)
+    new_freq_b = round(_to_float(freq_b, synth_state.get("frequency_b", 50.0)), 3)
+    new_phase_a = round(_to_float(phase_a, synth_state.get("phase_a", 0.0)), 2)
+    new_phase_b = round(_to_float(phase_b, synth_state.get("phase_b", 0.0)), 2)
+
+    if synth_state.get("amplitude_a") != new_amp_a:
+        synth_state["amplitude_a"] = new_amp_a
+        changed_keys.append("amplitude_a")
+    if synth_state.get("amplitude_b") != new_amp_b:
+        synth_state["amplitude_b"] = new_amp_b
+        changed_keys.append("amplitude_b")
+    if synth_state.get("frequency_a") != new_freq_a:
+        synth_state["frequency_a"] = new_freq_a
+        changed_keys.append("frequency_a")
+    if synth_state.get("frequency_b") != new_freq_b:
+        synth_state["frequency_b"] = new_freq_b
+        changed_keys.append("frequency_b")
+    if synth_state.get("phase_a") != new_phase_a:
+        synth_state["phase_a"] = new_phase_a
+        changed_keys.append("phase_a")
+    if synth_state.get("phase_b") != new_phase_b:
+        synth_state["phase_b"] = new_phase_b
+        changed_keys.append("phase_b")
+
+    for key in set(changed_keys):
+        state_manager.mark_changed(synth_id, key)
+    # Every readback goes into the history, changed or not, so trends show the poll cadence
+    HISTORY.record_values(synth_id, synth_state)
+    return True, bool(changed_keys)
+
+
 def poll_synth_states(synths, state_manager):
     """Read back live values from hardware and reconcile state_manager.synths in-place.
 
     Returns poll health and update counts.
     """
     if not synths or not hasattr(state_manager, "synths"):
-        return {"updated_count": 0, "failed_count": 0, "total_count": 0}
+        return {"updated_count": 0, "failed_count": 0, "total_count": 0, "failed_ids": []}
 
-    updated_count = 0
-    failed_count = 0
+    poll_started = time.perf_counter()
     synth_count = min(len(synths), len(state_manager.synths))
+    pool = _executor(synth_count)
+    futures = [pool.submit(_poll_one, synth_id, synths[synth_id], state_manager.synths[synth_id], state_manager)
+               for synth_id in range(synth_count)]
+    results = [future.result() for future in futures]
+    failed_ids = [synth_id for synth_id, (ok, _) in enumerate(results) if not ok]
 
-    for synth_id in range(synth_count):
-        synth = synths[synth_id]
-        synth_state = state_manager.synths[synth_id]
-        changed = False
-
-        try:
-            enabled_a = synth.get_enabled("a")
-            enabled_b = synth.get_enabled("b")
-            amp_a = synth.get_amplitude("a")
-            amp_b = synth.get_amplitude("b")
-            freq_a = synth.get_frequency("a")
-            freq_b = synth.get_frequency("b")
-            phase_a = synth.get_phase("a")
-            phase_b = synth.get_phase("b")
-        except Exception as exc:
-            logger.warning(f"Synth {synth_id} poll failed: {exc}")
-            failed_count += 1
-            continue
-
-        # If any critical numeric readback is invalid (None), treat this synth as a failed poll cycle.
-        # This catches cases where ESP boot logs/noise are read instead of protocol responses.
-        if any(v is None for v in [amp_a, amp_b, freq_a, freq_b, phase_a, phase_b]):
-            logger.warning(
-                f"Synth {synth_id} poll returned invalid numeric readbacks; skipping state update for this cycle"
-            )
-            failed_count += 1
-            continue
-
-        expected_enabled_a = bool(enabled_a)
-        expected_enabled_b = bool(enabled_b)
-        if synth_state.get("enabled", {}).get("a") != expected_enabled_a:
-            synth_state.setdefault("enabled", {})["a"] = expected_enabled_a
-            changed = True
-        if synth_state.get("enabled", {}).get("b") != expected_enabled_b:
-            synth_state.setdefault("enabled", {})["b"] = expected_enabled_b
-            changed = True
-
-        new_amp_a = round(_to_float(amp_a, synth_state.get("amplitude_a", 0.0)), 3)
-        new_amp_b = round(_to_float(amp_b, synth_state.get("amplitude_b", 0.0)), 3)
-        new_freq_a = round(_to_float(freq_a, synth_state.get("frequency_a", 50.0)), 3)
-        new_freq_b = round(_to_float(freq_b, synth_state.get("frequency_b", 50.0)), 3)
-        new_phase_a = round(_to_float(phase_a, synth_state.get("phase_a", 0.0)), 2)
-        new_phase_b = round(_to_float(phase_b, synth_state.get("phase_b", 0.0)), 2)
-
-        if synth_state.get("amplitude_a") != new_amp_a:
-            synth_state["amplitude_a"] = new_amp_a
-            changed = True
-        if synth_state.get("amplitude_b") != new_amp_b:
-            synth_state["amplitude_b"] = new_amp_b
-            changed = True
-        if synth_state.get("frequency_a") != new_freq_a:
-            synth_state["frequency_a"] = new_freq_a
-            changed = True
-        if synth_state.get("frequency_b") != new_freq_b:
-            synth_state["frequency_b"] = new_freq_b
-            changed = True
-        if synth_state.get("phase_a") != new_phase_a:
-            synth_state["phase_a"] = new_phase_a
-            changed = True
-        if synth_state.get("phase_b") != new_phase_b:
-            synth_state["phase_b"] = new_phase_b
-            changed = True
-
-        if changed:
-            updated_count += 1
-
+    POLL_DURATION.observe(time.perf_counter() - poll_started)
     return {
-        "updated_count": updated_count,
-        "failed_count": failed_count,
+        "updated_count": sum(1 for _, changed in results if changed),
+        "failed_count": len(failed_ids),
         "total_count": synth_count,
-    }
\ No newline at end of file
+        "failed_ids": failed_ids,
+    }
@@ -1,7 +1,11 @@
 // api.js - API and utility functions for NHP Synth Dashboard
 
+import { encode as msgpackEncode, decode as msgpackDecode, SCHEMA_VERSION } from './msgpack.js';
+
 let socketInstance = null;
 export function setSocket(s) { socketInstance = s; }
+const SOCKET_ENCODING_KEY = 'nhpSocketEncoding';
+let binaryCommands = false; // true once the server acknowledged MessagePack for this client
 let defaultsCache = null;
 let defaultsCacheTime = 0;
 
@@ -55,7 +59,7 @@ function sendSynthCommandWS(socket, synthId, command, channel, value, callback)
         channel: channel,
         value: value
     };
-    socket.emit('command', payload, (response) => {
+    socket.emit('command', binaryCommands ? msgpackEncode(payload) : payload, (response) => {
         if (callback) callback(response);
     });
 }
@@ -136,6 +140,75 @@ export function synthStateEquals(a, b) {
     return JSON.stringify(a) === JSON.stringify(b);
 }
 
+/**
+ * Apply a synthStateDelta's replace ops to a synth state object in place.
+ * Paths look like '/synths/0/amplitude_a' or '/selectionMode'.
+ * @returns {boolean} false if a path did not resolve (caller should resync)
+ */
+export function applySynthStatePatch(state, ops) {
+    if (!state || !Array.isArray(ops)) return false;
+    for (const op of ops) {
+        const keys = String(op.path || '').split('/').slice(1);
+        if (op.op !== 'replace' || keys.length === 0) return false;
+        let target = state;
+        for (const key of keys.slice(0, -1)) {
+            target = target?.[key];
+            if (target === null || typeof target !== 'object') return false;
+        }
+        target[keys[keys.length - 1]] = op.value;
+    }
+    return true;
+}
+
+/**
+ * Socket payload encoding preferred by this device: 'json' (default) or 'msgpack'.
+ * A ?encoding= URL parameter overrides the stored preference.
+ * @returns {string}
+ */
+export function getPreferredSocketEncoding() {
+    const fromUrl = new URLSearchParams(window.location.search).get('encoding');
+    if (fromUrl === 'msgpack' || fromUrl === 'json') return fromUrl;
+    try {
+        return localStorage.getItem(SOCKET_ENCODING_KEY) === 'msgpack' ? 'msgpack' : 'json';
+    } catch {
+        return 'json';
+    }
+}
+
+export function setPreferredSocketEncoding(encoding) {
+    try {
+        localStorage.setItem(SOCKET_ENCODING_KEY, encoding === 'msgpack' ? 'msgpack' : 'json');
+    } catch { /* storage unavailable (private mode) */ }
+    if (socketInstance && socketInstance.connected) negotiateSocketEncoding(socketInstance, true);
+}
+
+/**
+ * Ask the server for this client's payload encoding. Commands stay JSON until
+ * the server acknowledges via the 'encoding' event (see handleEncodingAck).
+ * @param {object} socket
+ * @param {boolean} [force] - also send when the preference is plain JSON
+ */
+export function negotiateSocketEncoding(socket, force = false) {
+    const encoding = getPreferredSocketEncoding();
+    binaryCommands = false;
+    if (encoding === 'json' && !force) return;
+    socket.emit('setEncoding', { encoding, schema: SCHEMA_VERSION });
+}
+
+export function handleEncodingAck(ack) {
+    binaryCommands = !!ack && ack.encoding === 'msgpack' && ack.schema === SCHEMA_VERSION;
+}
+
+/**
+ * Decode a state event payload; binary payloads are compact-schema MessagePack.
+ * @param {object|ArrayBuffer|Uint8Array} data
+ * @returns {object}
+ */
+export function decodeSocketPayload(data) {
+    if (data instanceof ArrayBuffer || ArrayBuffer.isView(data)) return msgpackDecode(data);
+    return data;
+}
+
 export async function getServiceStatus() {
     return apiGet('/api/status');
 }
@@ -144,6 +217,10 @@ export async function getLogs(lines = 200) {
     return apiGet(`/api/logs?lines=${encodeURIComponent(lines)}`);
 }
 
+export async function getMetrics() {
+    return apiGet('/api/metrics?format=json');
+}
+
 export async function restartService() {
     return apiPost('/api/restart', {});
 }
@@ -4,13 +4,14 @@ import {
     AppState, getVoltageScale, getCurrentScale, getHorizontalScale,
     getVoltageOffset, getCurrentOffset, getTimebase, getTimeOffsetMs, updatePhaseVisibilityUI
 } from './state.js';
-import { setSocket, synthStateEquals, getServiceStatus, getLogs, restartService } from './api.js';
+import { setSocket, applySynthStatePatch, negotiateSocketEncoding, handleEncodingAck, decodeSocketPayload, getServiceStatus, getLogs, restartService } from './api.js';
 import { SynthCards, ScopeChart, WaveformControl, HarmonicControl } from './components/components.js';
 import { threePhaseWaveformChart } from './components/charts.js';
 import { LoadingSpinner, debounce, throttle } from './utils.js';
 import { errorHandler } from './errorHandler.js';
 import { initializeSettings, setupSettingsListeners, applyServerSettings } from './settings.js';
 import { initTouchInputManager } from './touchInputManager.js';
+import { setupMetricsPanel } from './metricsPanel.js';
 
 export class SynthApp {
     constructor() {
@@ -25,6 +26,7 @@ export class SynthApp {
         this._preloadLines = 200; // default; will sync with selector
         this._maxBufferedLines = 2000;
         this._dragScrollState = null;
+        this.synthStateVersion = null; // version of the last synthState/synthStateDelta applied
         
         // Create debounced render function to prevent excessive re-renders
         // 100ms delay allows for multiple rapid updates to be batched
@@ -63,6 +65,7 @@ export class SynthApp {
             console.log('Socket connected');
             this.isConnected = true;
             this.reconnectAttempts = 0;
+            negotiateSocketEncoding(this.socket);
             this.throttledConnectionUpdate(true);
             errorHandler.logSuccess('Connected to synthesizers');
         });
@@ -86,20 +89,54 @@ export class SynthApp {
         });
 
         // Data handlers
-        this.socket.on('synthState', (data) => {
-            if (!synthStateEquals(AppState.synthState, data)) {
-                // Assign synthetic id if missing
-                if (data && Array.isArray(data.synths)) {
-                    data.synths.forEach((synth, idx) => {
-                        if (typeof synth.id === 'undefined') {
-                            synth.id = idx;
-                        }
-                    });
-                }
-                AppState.synthState = data;
-                // Use debounced render to prevent excessive re-renders during rapid updates
-                this.debouncedRender();
+        // Server's answer to setEncoding; binary commands only after this
+        this.socket.on('encoding', (ack) => {
+            handleEncodingAck(ack);
+            console.log(`Socket payload encoding: ${ack?.encoding}`);
+        });
+
+        // Queued commands come back with warnings when the modelled output would clip
+        this.socket.on('command_response', (response) => {
+            (response?.warnings || []).forEach(warning => errorHandler.logError(warning.message, 'warning'));
+        });
+
+        // Full snapshot: on connect, after a resync request, or when a delta would be larger
+        this.socket.on('synthState', (raw) => {
+            const data = decodeSocketPayload(raw);
+            // Assign synthetic id if missing
+            if (data && Array.isArray(data.synths)) {
+                data.synths.forEach((synth, idx) => {
+                    if (typeof synth.id === 'undefined') {
+                        synth.id = idx;
+                    }
+                });
+            }
+            AppState.synthState = data;
+            this.synthStateVersion = data?.version;
+            // Use debounced render to prevent excessive re-renders during rapid updates
+            this.debouncedRender();
+        });
+
+        // Versioned delta against the previous broadcast; resync on any gap
+        this.socket.on('synthStateDelta', (raw) => {
+            const delta = decodeSocketPayload(raw);
+            const state = AppState.synthState;
+            if (!state || delta.base !== this.synthStateVersion) {
+                this.socket.emit('requestSynthState');
+                return;
             }
+            if (!applySynthStatePatch(state, delta.ops)) {
+                this.socket.emit('requestSynthState');
+                return;
+            }
+            state.synths.forEach((synth, idx) => {
+                if (typeof synth.id === 'undefined') {
+                    synth.id = idx;
+                }
+            });
+            state.version = delta.version;
+            this.synthStateVersion = delta.version;
+            this.debouncedRender();
         });
 
         // Service status via socket
@@ -200,6 +237,7 @@ export class SynthApp {
                 this.setupFullscreenHandler();
                 this.setupTabHandlers();
                 setupSettingsListeners();
+                setupMetricsPanel();
                 initTouchInputManager();
                 this.setupDragScrollFallback();
                 // If Status tab is already open, start its refresh loop
@@ -211,6 +249,7 @@ export class SynthApp {
             this.setupFullscreenHandler();
             this.setupTabHandlers();
             setupSettingsListeners();
+            setupMetricsPanel();
             initTouchInputManager();
             this.setupDragScrollFallback();
             // If Status tab is already open, start its refresh loop
@@ -634,9 +673,10 @@ export class SynthApp {
             waveformControlContainer.innerHTML = WaveformControl(AppState);
         }
         
-        // Render waveforms tab content
+        // Render waveforms tab content; the scope markup only depends on local view settings,
+        // so it is built once and the chart on its canvas is updated in place
         const scopeContainer = document.getElementById('scope-card');
-        if (scopeContainer) {
+        if (scopeContainer && !document.getElementById('waveform_three_phase')) {
             scopeContainer.innerHTML = '';
             const waveformContent = document.createElement('div');
             waveformContent.innerHTML = ScopeChart(AppState);
@@ -1,153 +1,143 @@
 // Chart rendering for NHP Synth Dashboard
 // Exported as ES module
 
+import { renderTraces, recycleBuffers } from '../waveformSynth.js';
+import { drawScopeGrid, drawScopeLabels, scopeLabelTexts } from './scopeGrid.js';
+import { createScopeRenderer, getPreferredScopeRenderer } from './scopeRenderer.js';
+import { getDeviceModel } from '../deviceModel.js';
+
 // Oscilloscope grid plugin for Chart.js
 const oscilloscopeGridPlugin = {
     id: 'oscilloscopeGrid',
     beforeDraw: (chart) => {
-        const ctx = chart.ctx;
-        const canvas = chart.canvas;
-        const chartArea = chart.chartArea;
-        
-        // Save canvas state
-        ctx.save();
-        
-        // Set dark oscilloscope background
-        ctx.fillStyle = '#001100aa';
-        ctx.fillRect(0, 0, canvas.width, canvas.height);
-        
-        // Draw major grid lines (bright green)
-        ctx.strokeStyle = '#00aa00';
-        ctx.lineWidth = 1;
-        ctx.globalAlpha = 0.6;
-        
-        // Calculate the actual center of the chart area
-        const centerX = chartArea.left + (chartArea.right - chartArea.left) / 2;
-        
-        // Vertical major divisions - centered around the actual center line
-        const gridSpacing = (chartArea.right - chartArea.left) / 8; // 8 major divisions
-        
-        // Draw major vertical lines centered around the center line
-        for (let i = -4; i <= 4; i++) {
-            const x = centerX + (i * gridSpacing);
-            if (x >= chartArea.left && x <= chartArea.right) {
-                ctx.beginPath();
-                ctx.moveTo(x, chartArea.top);
-                ctx.lineTo(x, chartArea.bottom);
-                ctx.stroke();
-            }
-        }
-        
-        // Horizontal major divisions (static grid - 10 divisions total)
-        const horizontalDivisions = 10;
-        for (let i = 0; i <= horizontalDivisions; i++) {
-            const yPercent = (i / horizontalDivisions);
-            const y = chartArea.top + (chartArea.bottom - chartArea.top) * yPercent;
-            
-            ctx.beginPath();
-            ctx.moveTo(chartArea.left, y);
-            ctx.lineTo(chartArea.right, y);
-            ctx.stroke();
-        }
-               
-        // Draw center crosshairs (bright green)
-        ctx.strokeStyle = '#00ff00';
-        ctx.lineWidth = 2;
-        ctx.globalAlpha = 1;
-        
-        // Center vertical line (at x=0 degrees) - this is the main center reference
-        ctx.beginPath();
-        ctx.moveTo(centerX, chartArea.top);
-        ctx.lineTo(centerX, chartArea.bottom);
-        ctx.stroke();
-        
-        // Center horizontal line (static center)
-        const centerY = chartArea.top + (chartArea.bottom - chartArea.top) / 2;
-        ctx.beginPath();
-        ctx.moveTo(chartArea.left, centerY);
-        ctx.lineTo(chartArea.right, centerY);
-        ctx.stroke();
-        
-        // Restore canvas state
-        ctx.restore();
+        drawScopeGrid(chart.ctx, chart.canvas.width, chart.canvas.height, chart.chartArea);
     },
     afterDraw: (chart) => {
-        const ctx = chart.ctx;
-        const chartArea = chart.chartArea;
-        
-        // Save canvas state
-        ctx.save();
-        
-        // Add oscilloscope division labels
-        ctx.fillStyle = '#00ff00';
-        ctx.font = '18px monospace';
-        ctx.textAlign = 'left';
-        ctx.textBaseline = 'top';
-        
-        // Get scale information from chart options or defaults
-        const scales = chart.options.scales;
-        
-        // Calculate actual ms/div from the timebase setting
-        const msPerDiv = window.getTimebase ? window.getTimebase() : 10.0;
-        
-        // Get current time offset from global state
-        const timeOffsetMs = window.AppState ? window.AppState.timeOffsetMs : 0;
-        
-        // Get current vertical offsets from global state
-        const voltageOffsetV = window.AppState ? window.AppState.voltageOffsetV : 0;
-        const currentOffsetA = window.AppState ? window.AppState.currentOffsetA : 0;
-        
-        // Get current V/div and A/div directly from state (which are already the proper oscilloscope values)
-        const voltagePerDiv = window.getVoltageScale ? window.getVoltageScale() : 1.0; // This is now the actual V/div value
-        const currentPerDiv = window.getCurrentScale ? window.getCurrentScale() : 0.1; // This is now the actual A/div value
-        
-        // Draw 2x2 grid in top-left for voltage information
-        const topLeftX = chartArea.left;
-        const topLeftY = chartArea.top + 10;
-        const columnWidth = 120;
-        
-        // First row: V/div and V offset
-        ctx.fillText(`${voltagePerDiv.toFixed(voltagePerDiv < 1 ? 1 : 0).padStart(6, ' ')} V/div`, topLeftX, topLeftY);
-        const voltageOffsetSign = voltageOffsetV >= 0 ? '+' : '-';
-        ctx.fillText(`${voltageOffsetSign}${Math.abs(voltageOffsetV).toFixed(1).padStart(5, ' ')} V`, topLeftX + columnWidth, topLeftY);
-        
-        // Second row: A/div and A offset (if current scales exist)
-        if (scales.yI) {
-            ctx.fillText(`${currentPerDiv.toFixed(currentPerDiv < 1 ? 2 : 1).padStart(6, ' ')} A/div`, topLeftX + 380, topLeftY);
-            const currentOffsetSign = currentOffsetA >= 0 ? '+' : '-';
-            ctx.fillText(`${currentOffsetSign}${Math.abs(currentOffsetA).toFixed(1).padStart(5, ' ')} A`, topLeftX + 380 + columnWidth, topLeftY);
-        }
-        
-        // Draw 1x2 grid at bottom for horizontal information
-        const bottomLeftX = chartArea.left
-        const bottomLeftY = chartArea.bottom - 20;
-        
-        // Timebase
-        if (msPerDiv >= 1) {
-            ctx.fillText(`${Math.round(msPerDiv).toString().padStart(4, ' ')} ms/div`, bottomLeftX, bottomLeftY);
-        } else {
-            ctx.fillText(`${Math.round(msPerDiv * 1000).toString().padStart(5, ' ')} μs/div`, bottomLeftX, bottomLeftY);
-        }
-        
-        // Time offset
-        if (Math.abs(timeOffsetMs) < 1) {
-            const timeOffsetSign = timeOffsetMs >= 0 ? '+' : '-';
-            ctx.fillText(`${timeOffsetSign}${Math.abs(timeOffsetMs * 1000).toFixed(0).padStart(4, ' ')} μs`, bottomLeftX + columnWidth, bottomLeftY);
-        } else {
-            const timeOffsetSign = timeOffsetMs >= 0 ? '+' : '-';
-            ctx.fillText(`${timeOffsetSign}${Math.abs(timeOffsetMs).toFixed(1).padStart(5, ' ')} ms`, bottomLeftX + columnWidth, bottomLeftY);
-        }
-        
-        // Restore canvas state
-        ctx.restore();
+        drawScopeLabels(chart.ctx, chart.chartArea, scopeLabelTexts(!!chart.options.scales.yI));
     }
 };
 
 // Register the plugin
 Chart.register(oscilloscopeGridPlugin);
 
+const PHASE_LABELS = ['L1', 'L2', 'L3'];
+// Synthesis runs off the UI thread and Chart.js collapses points that share a pixel column,
+// so the trace resolution is no longer bound by main-thread Math.sin cost
+const POINTS = 2000;
+// The WebGL renderer draws every segment on the GPU
+const WEBGL_POINTS = 10000;
+// Chart.js draws datasets with a higher order first; the WebGL renderer follows the same stacking
+const DRAW_ORDER = [4, 5, 2, 3, 0, 1];
+
+// One scope per canvas, created on the first render and updated in place afterwards:
+// canvasId -> { chart | renderer, canvas, points, xKey, inFlight, queued }
+const scopeCharts = new Map();
+// Set once a WebGL context is lost; later scopes on this page use Chart.js
+let webglFailed = false;
+// Latest arguments per canvas; renders requested within one frame collapse into one update
+const pendingRenders = new Map();
+// Arguments of the last requested render per canvas, for redraws the chart starts itself
+const latestArgs = new Map();
+let frameRequested = false;
+
+// Update timing for the metrics panel (this client only)
+const updateStats = { updates: 0, lastMs: 0, meanMs: 0, maxMs: 0, frameTimes: [], renderer: null, points: 0 };
+
+/**
+ * Scope update timing: { updates, lastMs, meanMs, maxMs, fps, renderer, points } where fps
+ * counts chart updates drawn in the last second and renderer is 'webgl' or 'chartjs'. Times run from the request to the drawn
+ * update, so they include trace synthesis in the worker.
+ */
+export function getChartUpdateStats() {
+    const now = performance.now();
+    const recent = updateStats.frameTimes.filter(t => now - t <= 1000);
+    return {
+        updates: updateStats.updates,
+        lastMs: updateStats.lastMs,
+        meanMs: updateStats.meanMs,
+        maxMs: updateStats.maxMs,
+        fps: recent.length,
+        renderer: updateStats.renderer,
+        points: updateStats.points
+    };
+}
+
+function recordUpdate(started, entry) {
+    updateStats.renderer = entry.renderer ? 'webgl' : 'chartjs';
+    updateStats.points = entry.points;
+    const finished = performance.now();
+    const ms = finished - started;
+    updateStats.updates += 1;
+    updateStats.lastMs = ms;
+    // Exponential moving average, so the figure follows the current load
+    updateStats.meanMs = updateStats.updates === 1 ? ms : updateStats.meanMs * 0.9 + ms * 0.1;
+    updateStats.maxMs = Math.max(updateStats.maxMs, ms);
+    updateStats.frameTimes.push(finished);
+    if (updateStats.frameTimes.length > 120) updateStats.frameTimes.shift();
+}
+
+// Trace synthesis: in waveformWorker.js when module workers are available, otherwise
+// (or once the worker fails) on this thread with the same code. Trace arrays are
+// transferred both ways, so each frame reuses the buffers the chart has let go of.
+const synthesizer = (() => {
+    const spare = [];
+    const waiting = new Map(); // request id -> resolve
+    let nextId = 1;
+    let worker = null;
+
+    const useMainThread = (reason) => {
+        console.warn('Waveform worker unavailable, synthesizing on the main thread:', reason);
+        if (worker) worker.terminate();
+        worker = null;
+        // Requests the worker never answered are redone locally by render()
+        waiting.forEach(resolve => resolve(null));
+        waiting.clear();
+    };
+
+    try {
+        worker = new Worker(new URL('../waveformWorker.js', import.meta.url), { type: 'module' });
+        worker.onmessage = (event) => {
+            const resolve = waiting.get(event.data.id);
+            waiting.delete(event.data.id);
+            if (resolve) resolve(event.data.traces);
+        };
+        worker.onerror = (event) => useMainThread(event.message || 'worker error');
+    } catch (e) {
+        useMainThread(e.message);
+    }
+
+    return {
+        render(request) {
+            if (!worker) return Promise.resolve(renderTraces(request, spare));
+            return new Promise(resolve => {
+                const id = nextId++;
+                waiting.set(id, resolve);
+                worker.postMessage({ type: 'render', id, ...request });
+            }).then(traces => traces || renderTraces(request, spare));
+        },
+        recycle(buffers) {
+            buffers = buffers.filter(buffer => buffer instanceof Float32Array && buffer.byteLength);
+            if (!buffers.length) return;
+            if (worker) {
+                worker.postMessage({ type: 'recycle', buffers }, buffers.map(buffer => buffer.buffer));
+            } else {
+                recycleBuffers(spare, buffers);
+            }
+        }
+    };
+})();
+
+function flushChartRenders() {
+    frameRequested = false;
+    const renders = Array.from(pendingRenders.values());
+    pendingRenders.clear();
+    renders.forEach(args => updateThreePhaseChart(...args));
+}
+
 /**
  * Generates a three-phase waveform chart for the given synthesizers.
+ * The chart is drawn on the next animation frame; calls made before then only
+ * replace the arguments, so a burst of synthState updates costs one redraw.
  * @param {Array} synths - Array of synthesizer objects.
  * @param {string} canvasId - ID of the canvas element to render the chart.
  * @param {number} voltage_scale - Scale factor for voltage controls V/div (default 100)
@@ -159,130 +149,54 @@ Chart.register(oscilloscopeGridPlugin);
  */
 
 export function threePhaseWaveformChart(synths, canvasId, voltage_scale = 100, current_scale = 2, timebaseMs = 20, timeOffsetMs = 0, voltageOffsetV = 0, currentOffsetA = 0) {
-    const phaseLabels = ['L1', 'L2', 'L3'];
-    const phaseSynths = [synths[0], synths[1], synths[2]];
-    
-    if (!phaseSynths[0] || !phaseSynths[1] || !phaseSynths[2]) return;
-
-    const sqrt2 = Math.sqrt(2);
-    const frequency = phaseSynths[0].frequency_a;
-       
-    // Calculate total time span: 8 divisions × timebase
-    const totalTimeMs = 8 * timebaseMs;
-    const totalTimeSeconds = totalTimeMs / 1000;
-    
-    // Calculate Y-axis ranges based on V/div and A/div (10 divisions total = 5 above and 5 below center)
-    const voltageMax = voltage_scale * 5; // 5 divisions above center
-    const currentMax = current_scale * 5; // 5 divisions above center
-
-    // Calculate amplitudes and phases for all phases using loops
-    const phaseData = phaseLabels.map((label, i) => {
-        const synth = phaseSynths[i];
-        return {
-            label,
-            voltage: {
-                amplitude: (synth.amplitude_a / 100) * VOLTAGE_RMS_MAX * sqrt2, // Peak voltage in volts
-                phase: synth.phase_a,
-                harmonics: synth.harmonics_a,
-                visible: getPhaseVisibility(label, 'voltage')
-            },
-            current: {
-                amplitude: (synth.amplitude_b / 100) * CURRENT_RMS_MAX * sqrt2, // Peak current in amperes
-                phase: synth.phase_b,
-                harmonics: synth.harmonics_b,
-                visible: getPhaseVisibility(label, 'current')
-            }
-        };
-    });
-
-    const N = 1000;
-    const x = Array.from({ length: N }, (_, i) => {
-        const baseTime = (i / (N - 1)) * totalTimeSeconds - (totalTimeSeconds / 2);
-        return baseTime + (timeOffsetMs / 1000); // Apply time offset (convert ms to seconds)
-    });
-
-    function sumHarmonics(timeMs, amplitude, phase, harmonics) {
-        const t = timeMs;
-        let y = amplitude * Math.sin(2 * Math.PI * frequency * t + (phase * Math.PI / 180));
-        if (Array.isArray(harmonics)) {
-            harmonics.forEach(h => {
-                const harmAmplitude = amplitude * (h.amplitude / 100);
-                y += harmAmplitude * Math.sin(2 * Math.PI * h.order * frequency * t + ((h.phase + (h.order * phase)) * Math.PI / 180));
-            });
-        }
-        return y;
+    const args = [synths, canvasId, voltage_scale, current_scale, timebaseMs, timeOffsetMs, voltageOffsetV, currentOffsetA];
+    pendingRenders.set(canvasId, args);
+    latestArgs.set(canvasId, args);
+    if (!frameRequested) {
+        frameRequested = true;
+        requestAnimationFrame(flushChartRenders);
     }
-    
-    // Generate waveform data for all phases using loops
-    const waveformData = phaseData.map(phase => ({
-        label: phase.label,
-        voltage: {
-            data: x.map(timeMs => sumHarmonics(timeMs, phase.voltage.amplitude, phase.voltage.phase, phase.voltage.harmonics)),
-            visible: phase.voltage.visible
-        },
-        current: {
-            data: x.map(timeMs => sumHarmonics(timeMs, phase.current.amplitude, phase.current.phase, phase.current.harmonics)),
-            visible: phase.current.visible
-        }
-    }));
+}
 
-    // Get colors for all phases using loops
+// Build the chart once for this canvas: datasets start empty and get their data per update
+function createScopeChart(canvas, canvasId) {
     const rootStyles = getComputedStyle(document.documentElement);
-    const colors = phaseLabels.reduce((acc, label) => {
-        acc[label] = {
-            voltage: rootStyles.getPropertyValue(`--${label}-voltage-color`).trim(),
-            current: rootStyles.getPropertyValue(`--${label}-current-color`).trim()
-        };
-        return acc;
-    }, {});
-
-    const ctx = document.getElementById(canvasId)?.getContext('2d');
-    if (!ctx) return;
-    if (window[canvasId + '_chart']) {
-        window[canvasId + '_chart'].destroy();
-    }
-
-    // Generate datasets using loops
     const datasets = [];
-    
-    waveformData.forEach((phase, i) => {
-        // Add voltage dataset
+    PHASE_LABELS.forEach((label, i) => {
+        const voltageColor = rootStyles.getPropertyValue(`--${label}-voltage-color`).trim();
+        const currentColor = rootStyles.getPropertyValue(`--${label}-current-color`).trim();
         datasets.push({
-            label: `${phase.label} Voltage`,
-            data: phase.voltage.data,
-            borderColor: colors[phase.label].voltage,
+            label: `${label} Voltage`,
+            data: [],
+            borderColor: voltageColor,
             borderWidth: 3,
             pointRadius: 0,
             fill: false,
             tension: 0,
             yAxisID: 'yV',
             order: (i + 1) * 2, // 2, 4, 6 for L1, L2, L3 voltage
-            hidden: !phase.voltage.visible,
-            shadowColor: colors[phase.label].voltage,
+            shadowColor: voltageColor,
             shadowBlur: 10
         });
-        
-        // Add current dataset
         datasets.push({
-            label: `${phase.label} Current`,
-            data: phase.current.data,
-            borderColor: colors[phase.label].current,
+            label: `${label} Current`,
+            data: [],
+            borderColor: currentColor,
             borderWidth: 3,
             pointRadius: 0,
             fill: false,
             tension: 0,
             yAxisID: 'yI',
             order: (i + 1) * 2 - 1, // 1, 3, 5 for L1, L2, L3 current
-            hidden: !phase.current.visible,
-            shadowColor: colors[phase.label].current,
+            shadowColor: currentColor,
             shadowBlur: 10
         });
     });
 
-    window[canvasId + '_chart'] = new Chart(ctx, {
+    const chart = new Chart(canvas.getContext('2d'), {
         type: 'line',
         data: {
-            labels: x, // Use the actual time values as labels
+            labels: [], // The actual time values, set per update
             datasets: datasets
         },
         options: {
@@ -296,33 +210,201 @@ export function threePhaseWaveformChart(synths, canvasId, voltage_scale = 100, c
                 tooltip: { enabled: false }
             },
             scales: {
-                x: { 
+                x: {
                     position: 'center',
                     grid: { display: false },
                     ticks: { display: false },
-                    border: { display: false },
-                    min: (-totalTimeSeconds / 2) + (timeOffsetMs / 1000),
-                    max: (totalTimeSeconds / 2) + (timeOffsetMs / 1000)
+                    border: { display: false }
                 },
                 yV: {
                     display: false,
                     position: 'left',
-                    min: (-voltageMax * 1.1) + voltageOffsetV,
-                    max: (voltageMax * 1.1) + voltageOffsetV,
                     title: { display: false, text: 'Voltage (V)' },
                     grid: { display: false }
                 },
                 yI: {
                     display: false,
                     position: 'right',
-                    min: (-currentMax * 1.1) + currentOffsetA,
-                    max: (currentMax * 1.1) + currentOffsetA,
                     title: { display: false, text: 'Current (A)' },
                     grid: { display: false }
                 }
             }
         }
     });
+    window[canvasId + '_chart'] = chart;
+    return { chart, canvas, points: POINTS, xKey: null, inFlight: false, queued: null };
+}
+
+// WebGL renderer when preferred and available, Chart.js otherwise
+function createScope(canvas, canvasId) {
+    if (!webglFailed && getPreferredScopeRenderer() === 'webgl') {
+        const renderer = createScopeRenderer(canvas);
+        if (renderer) {
+            const rootStyles = getComputedStyle(document.documentElement);
+            const colors = [];
+            PHASE_LABELS.forEach(label => {
+                colors.push(rootStyles.getPropertyValue(`--${label}-voltage-color`).trim());
+                colors.push(rootStyles.getPropertyValue(`--${label}-current-color`).trim());
+            });
+            window[canvasId + '_chart'] = renderer;
+            return { renderer, colors, canvas, points: WEBGL_POINTS, inFlight: false, queued: null };
+        }
+    }
+    return createScopeChart(canvas, canvasId);
+}
+
+function destroyScope(entry) {
+    (entry.renderer || entry.chart).destroy();
+}
+
+function updateThreePhaseChart(synths, canvasId, voltage_scale, current_scale, timebaseMs, timeOffsetMs, voltageOffsetV, currentOffsetA) {
+    const phaseSynths = [synths[0], synths[1], synths[2]];
+    
+    if (!phaseSynths[0] || !phaseSynths[1] || !phaseSynths[2]) return;
+
+    let canvas = document.getElementById(canvasId);
+    if (!canvas) return;
+    let entry = scopeCharts.get(canvasId);
+    if (entry && entry.renderer && entry.renderer.lost) {
+        // The GPU context is gone; a canvas that had one cannot get a 2D context, so swap in a fresh one
+        console.warn('WebGL context lost, drawing the scope with Chart.js');
+        webglFailed = true;
+        const fresh = canvas.cloneNode(false);
+        fresh.removeAttribute('style');
+        canvas.replaceWith(fresh);
+        canvas = fresh;
+    }
+    if (entry && entry.canvas !== canvas) {
+        // The scope card was rebuilt: the old chart belongs to a detached canvas
+        destroyScope(entry);
+        scopeCharts.delete(canvasId);
+        entry = null;
+    }
+    if (!entry) {
+        entry = createScope(canvas, canvasId);
+        scopeCharts.set(canvasId, entry);
+    }
+    if (entry.inFlight) {
+        // One synthesis per chart at a time; the newest state is drawn when it returns
+        entry.queued = [synths, canvasId, voltage_scale, current_scale, timebaseMs, timeOffsetMs, voltageOffsetV, currentOffsetA];
+        return;
+    }
+    const started = performance.now();
+    const points = entry.points;
+
+    const sqrt2 = Math.sqrt(2);
+    const frequency = phaseSynths[0].frequency_a;
+       
+    // Calculate total time span: 8 divisions × timebase
+    const totalTimeMs = 8 * timebaseMs;
+    const totalTimeSeconds = totalTimeMs / 1000;
+    const t0 = -(totalTimeSeconds / 2) + (timeOffsetMs / 1000); // Apply time offset (convert ms to seconds)
+    const dt = totalTimeSeconds / (points - 1);
+    
+    // Calculate Y-axis ranges based on V/div and A/div (10 divisions total = 5 above and 5 below center)
+    const voltageMax = voltage_scale * 5; // 5 divisions above center
+    const currentMax = current_scale * 5; // 5 divisions above center
+
+    const ranges = {
+        voltage: [(-voltageMax * 1.1) + voltageOffsetV, (voltageMax * 1.1) + voltageOffsetV],
+        current: [(-currentMax * 1.1) + currentOffsetA, (currentMax * 1.1) + currentOffsetA]
+    };
+
+    // Device preview: the modelled DAC codes, scaled so full scale matches 100 % amplitude.
+    // A synth whose model has not arrived yet is drawn ideal; the chart redraws when it does.
+    const device = window.getPreviewModel && window.getPreviewModel() === 'device';
+    const redraw = () => threePhaseWaveformChart(...latestArgs.get(canvasId));
+    const sampledTrace = (model, channel, fullScale) => model && {
+        samples: model.channels[channel].samples,
+        sampleRate: model.sample_rate,
+        amplitude: fullScale
+    };
+
+    // Hidden traces are not synthesized; their datasets keep their previous data
+    const traces = [];
+    PHASE_LABELS.forEach((label, i) => {
+        const synth = phaseSynths[i];
+        const model = device ? getDeviceModel(i, synth, redraw) : null;
+        traces.push(getPhaseVisibility(label, 'voltage') ? (sampledTrace(model, 'a', VOLTAGE_RMS_MAX * sqrt2) || {
+            amplitude: (synth.amplitude_a / 100) * VOLTAGE_RMS_MAX * sqrt2, // Peak voltage in volts
+            phase: synth.phase_a,
+            harmonics: synth.harmonics_a
+        }) : null);
+        traces.push(getPhaseVisibility(label, 'current') ? (sampledTrace(model, 'b', CURRENT_RMS_MAX * sqrt2) || {
+            amplitude: (synth.amplitude_b / 100) * CURRENT_RMS_MAX * sqrt2, // Peak current in amperes
+            phase: synth.phase_b,
+            harmonics: synth.harmonics_b
+        }) : null);
+    });
+
+    entry.inFlight = true;
+    synthesizer.render({ points, t0, dt, frequency, traces }).then(data => {
+        if (scopeCharts.get(canvasId) !== entry) {
+            // Chart was replaced while the traces were being synthesized
+            synthesizer.recycle(data.filter(Boolean));
+            return;
+        }
+
+        let released;
+        if (entry.renderer) {
+            // Trace index 2k is a voltage, 2k+1 a current
+            entry.renderer.render({
+                points,
+                traces: DRAW_ORDER.map(index => ({
+                    data: data[index],
+                    color: entry.colors[index],
+                    range: index % 2 ? ranges.current : ranges.voltage
+                }))
+            });
+            // The renderer copied the traces to the GPU
+            released = data;
+        } else {
+            released = applyChartFrame(entry, data, t0, dt, totalTimeSeconds, ranges, `${timebaseMs}:${timeOffsetMs}`);
+        }
+        recordUpdate(started, entry);
+        // Arrays that are no longer drawn go back for the next frame
+        synthesizer.recycle(released.filter(Boolean));
+    }).catch(e => {
+        console.error('Scope update failed:', e);
+    }).finally(() => {
+        // Whatever happened to this frame, the state that arrived meanwhile still gets drawn
+        entry.inFlight = false;
+        if (entry.queued) {
+            const next = entry.queued;
+            entry.queued = null;
+            threePhaseWaveformChart(...next);
+        }
+    });
+}
+
+// Chart.js fallback: swap the synthesized arrays into the datasets; returns the arrays they replaced
+function applyChartFrame(entry, data, t0, dt, totalTimeSeconds, ranges, xKey) {
+    const chart = entry.chart;
+
+    // Time axis only changes with the timebase or the time offset
+    if (entry.xKey !== xKey) {
+        chart.data.labels = Array.from({ length: entry.points }, (_, i) => t0 + i * dt);
+        entry.xKey = xKey;
+    }
+
+    const released = [];
+    data.forEach((trace, index) => {
+        const dataset = chart.data.datasets[index];
+        dataset.hidden = !trace;
+        if (trace) {
+            released.push(dataset.data);
+            dataset.data = trace;
+        }
+    });
+
+    const scales = chart.options.scales;
+    scales.x.min = t0;
+    scales.x.max = t0 + totalTimeSeconds;
+    [scales.yV.min, scales.yV.max] = ranges.voltage;
+    [scales.yI.min, scales.yI.max] = ranges.current;
+
+    chart.update('none');
+    return released;
 }
 
 // Chart drag functionality for time offset control
@@ -330,7 +412,8 @@ export function initializeChartDrag() {
     const overlay = document.getElementById('chart-drag-overlay');
     const slider = document.getElementById('time-offset-slider');
     
-    if (!overlay || !slider) return;
+    if (!overlay || !slider || overlay.dataset.dragInit === '1') return;
+    overlay.dataset.dragInit = '1';
     
     let isDragging = false;
     let startX = 0;
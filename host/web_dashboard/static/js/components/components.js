@@ -134,6 +134,15 @@ export function ScopeChart(AppState) {
                                 </button>
                             </div>
                         </div>
+                        <div class="col-auto border-start border-2">
+                            <button type="button" id="toggle-preview-model"
+                                    class="btn btn-sm fs-4 ${getPreviewModel() === 'device' ? 'btn-outline-light' : 'btn-outline-secondary'}"
+                                    title="Ideal waveform or the DAC codes the firmware plays"
+                                    onclick="setPreviewModel(getPreviewModel() === 'device' ? 'ideal' : 'device')"
+                                    style="width: 70px;">
+                                ${getPreviewModel() === 'device' ? 'DAC' : 'Ideal'}
+                            </button>
+                        </div>
                         <div class="col border-start border-2">
                             <div class="btn-group gap-2" role="group" aria-label="Phase Visibility Controls">
                                 ${['L1', 'L2', 'L3'].map(phase => 
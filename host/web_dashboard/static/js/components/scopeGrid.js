@@ -0,0 +1,161 @@
+// Oscilloscope graticule and scale labels, shared by the Chart.js plugin and the WebGL scope layer
+// Exported as ES module
+
+/**
+ * Background, major divisions and center crosshairs.
+ * @param {CanvasRenderingContext2D} ctx
+ * @param {number} width - Canvas width to clear
+ * @param {number} height - Canvas height to clear
+ * @param {Object} chartArea - { left, top, right, bottom }
+ */
+export function drawScopeGrid(ctx, width, height, chartArea) {
+    // Save canvas state
+    ctx.save();
+
+    // Set dark oscilloscope background
+    ctx.fillStyle = '#001100aa';
+    ctx.fillRect(0, 0, width, height);
+
+    // Draw major grid lines (bright green)
+    ctx.strokeStyle = '#00aa00';
+    ctx.lineWidth = 1;
+    ctx.globalAlpha = 0.6;
+
+    // Calculate the actual center of the chart area
+    const centerX = chartArea.left + (chartArea.right - chartArea.left) / 2;
+
+    // Vertical major divisions - centered around the actual center line
+    const gridSpacing = (chartArea.right - chartArea.left) / 8; // 8 major divisions
+
+    // Draw major vertical lines centered around the center line
+    for (let i = -4; i <= 4; i++) {
+        const x = centerX + (i * gridSpacing);
+        if (x >= chartArea.left && x <= chartArea.right) {
+            ctx.beginPath();
+            ctx.moveTo(x, chartArea.top);
+            ctx.lineTo(x, chartArea.bottom);
+            ctx.stroke();
+        }
+    }
+
+    // Horizontal major divisions (static grid - 10 divisions total)
+    const horizontalDivisions = 10;
+    for (let i = 0; i <= horizontalDivisions; i++) {
+        const yPercent = (i / horizontalDivisions);
+        const y = chartArea.top + (chartArea.bottom - chartArea.top) * yPercent;
+
+        ctx.beginPath();
+        ctx.moveTo(chartArea.left, y);
+        ctx.lineTo(chartArea.right, y);
+        ctx.stroke();
+    }
+
+    // Draw center crosshairs (bright green)
+    ctx.strokeStyle = '#00ff00';
+    ctx.lineWidth = 2;
+    ctx.globalAlpha = 1;
+
+    // Center vertical line (at x=0 degrees) - this is the main center reference
+    ctx.beginPath();
+    ctx.moveTo(centerX, chartArea.top);
+    ctx.lineTo(centerX, chartArea.bottom);
+    ctx.stroke();
+
+    // Center horizontal line (static center)
+    const centerY = chartArea.top + (chartArea.bottom - chartArea.top) / 2;
+    ctx.beginPath();
+    ctx.moveTo(chartArea.left, centerY);
+    ctx.lineTo(chartArea.right, centerY);
+    ctx.stroke();
+
+    // Restore canvas state
+    ctx.restore();
+}
+
+/**
+ * The label texts as currently configured: V/div and offset, A/div and offset
+ * (when showCurrent), timebase and time offset. Also serves as the cache key of
+ * a pre-rendered grid layer.
+ */
+export function scopeLabelTexts(showCurrent) {
+    // Calculate actual ms/div from the timebase setting
+    const msPerDiv = window.getTimebase ? window.getTimebase() : 10.0;
+
+    // Get current time offset from global state
+    const timeOffsetMs = window.AppState ? window.AppState.timeOffsetMs : 0;
+
+    // Get current vertical offsets from global state
+    const voltageOffsetV = window.AppState ? window.AppState.voltageOffsetV : 0;
+    const currentOffsetA = window.AppState ? window.AppState.currentOffsetA : 0;
+
+    // Get current V/div and A/div directly from state (which are already the proper oscilloscope values)
+    const voltagePerDiv = window.getVoltageScale ? window.getVoltageScale() : 1.0; // This is now the actual V/div value
+    const currentPerDiv = window.getCurrentScale ? window.getCurrentScale() : 0.1; // This is now the actual A/div value
+
+    const texts = {};
+    texts.voltageScale = `${voltagePerDiv.toFixed(voltagePerDiv < 1 ? 1 : 0).padStart(6, ' ')} V/div`;
+    const voltageOffsetSign = voltageOffsetV >= 0 ? '+' : '-';
+    texts.voltageOffset = `${voltageOffsetSign}${Math.abs(voltageOffsetV).toFixed(1).padStart(5, ' ')} V`;
+
+    if (showCurrent) {
+        texts.currentScale = `${currentPerDiv.toFixed(currentPerDiv < 1 ? 2 : 1).padStart(6, ' ')} A/div`;
+        const currentOffsetSign = currentOffsetA >= 0 ? '+' : '-';
+        texts.currentOffset = `${currentOffsetSign}${Math.abs(currentOffsetA).toFixed(1).padStart(5, ' ')} A`;
+    }
+
+    // Timebase
+    if (msPerDiv >= 1) {
+        texts.timebase = `${Math.round(msPerDiv).toString().padStart(4, ' ')} ms/div`;
+    } else {
+        texts.timebase = `${Math.round(msPerDiv * 1000).toString().padStart(5, ' ')} μs/div`;
+    }
+
+    // Time offset
+    const timeOffsetSign = timeOffsetMs >= 0 ? '+' : '-';
+    if (Math.abs(timeOffsetMs) < 1) {
+        texts.timeOffset = `${timeOffsetSign}${Math.abs(timeOffsetMs * 1000).toFixed(0).padStart(4, ' ')} μs`;
+    } else {
+        texts.timeOffset = `${timeOffsetSign}${Math.abs(timeOffsetMs).toFixed(1).padStart(5, ' ')} ms`;
+    }
+    return texts;
+}
+
+/**
+ * Oscilloscope division labels: voltage (and current) scale top left, timebase bottom left.
+ * @param {CanvasRenderingContext2D} ctx
+ * @param {Object} chartArea - { left, top, right, bottom }
+ * @param {Object} texts - from scopeLabelTexts()
+ */
+export function drawScopeLabels(ctx, chartArea, texts) {
+    // Save canvas state
+    ctx.save();
+
+    ctx.fillStyle = '#00ff00';
+    ctx.font = '18px monospace';
+    ctx.textAlign = 'left';
+    ctx.textBaseline = 'top';
+
+    // Draw 2x2 grid in top-left for voltage information
+    const topLeftX = chartArea.left;
+    const topLeftY = chartArea.top + 10;
+    const columnWidth = 120;
+
+    // First row: V/div and V offset
+    ctx.fillText(texts.voltageScale, topLeftX, topLeftY);
+    ctx.fillText(texts.voltageOffset, topLeftX + columnWidth, topLeftY);
+
+    // Second row: A/div and A offset (if current scales exist)
+    if (texts.currentScale) {
+        ctx.fillText(texts.currentScale, topLeftX + 380, topLeftY);
+        ctx.fillText(texts.currentOffset, topLeftX + 380 + columnWidth, topLeftY);
+    }
+
+    // Draw 1x2 grid at bottom for horizontal information
+    const bottomLeftX = chartArea.left
+    const bottomLeftY = chartArea.bottom - 20;
+    ctx.fillText(texts.timebase, bottomLeftX, bottomLeftY);
+    ctx.fillText(texts.timeOffset, bottomLeftX + columnWidth, bottomLeftY);
+
+    // Restore canvas state
+    ctx.restore();
+}
@@ -0,0 +1,345 @@
+// WebGL scope renderer for NHP Synth Dashboard
+// Exported as ES module
+//
+// Draws the scope traces as instanced line segments (one quad per segment, widened
+// in the vertex shader so traces keep their 3 px width and glow), over a grid layer
+// and under a label layer that are rendered with the 2D canvas API and uploaded as
+// textures only when the canvas size or the label texts change. Trace data is
+// uploaded into per-trace vertex buffers, so a frame costs six buffer uploads and
+// twelve draw calls whatever the point count. Requires WebGL2 (instanced drawing and
+// gl_InstanceID); createScopeRenderer returns null without it and charts.js keeps
+// using Chart.js.
+
+import { drawScopeGrid, drawScopeLabels, scopeLabelTexts } from './scopeGrid.js';
+
+const RENDERER_KEY = 'nhp_scope_renderer';
+
+// CSS pixel widths, matching the Chart.js datasets (borderWidth 3, shadowBlur 10)
+const TRACE_WIDTH = 3;
+const GLOW_WIDTH = 10;
+const GLOW_ALPHA = 0.25;
+
+const TRACE_VERTEX_SHADER = `#version 300 es
+in vec2 a_corner;   // x: 0 at the segment start, 1 at its end; y: -1 / +1 side of the line
+in float a_y0;      // value at point gl_InstanceID
+in float a_y1;      // value at point gl_InstanceID + 1
+uniform float u_count;
+uniform vec2 u_range;   // value at the bottom and at the top of the canvas
+uniform vec2 u_size;    // canvas size in device pixels
+uniform float u_width;  // line width in device pixels
+void main() {
+    float i = float(gl_InstanceID);
+    float span = u_range.y - u_range.x;
+    vec2 p0 = vec2(i / (u_count - 1.0), (a_y0 - u_range.x) / span) * u_size;
+    vec2 p1 = vec2((i + 1.0) / (u_count - 1.0), (a_y1 - u_range.x) / span) * u_size;
+    vec2 along = p1 - p0;
+    vec2 dir = length(along) > 0.0 ? normalize(along) : vec2(1.0, 0.0);
+    vec2 normal = vec2(-dir.y, dir.x);
+    // Extend each end by half a width so consecutive segments overlap at the joints
+    vec2 pos = mix(p0, p1, a_corner.x) + dir * (a_corner.x * 2.0 - 1.0) * u_width * 0.5
+             + normal * a_corner.y * u_width * 0.5;
+    gl_Position = vec4(pos / u_size * 2.0 - 1.0, 0.0, 1.0);
+}`;
+
+const TRACE_FRAGMENT_SHADER = `#version 300 es
+precision mediump float;
+uniform vec4 u_color;
+out vec4 color;
+void main() {
+    color = vec4(u_color.rgb * u_color.a, u_color.a);
+}`;
+
+const LAYER_VERTEX_SHADER = `#version 300 es
+in vec2 a_corner;
+out vec2 v_uv;
+void main() {
+    v_uv = vec2(a_corner.x, 1.0 - a_corner.y);
+    gl_Position = vec4(a_corner * 2.0 - 1.0, 0.0, 1.0);
+}`;
+
+const LAYER_FRAGMENT_SHADER = `#version 300 es
+precision mediump float;
+uniform sampler2D u_layer;
+in vec2 v_uv;
+out vec4 color;
+void main() {
+    color = texture(u_layer, v_uv);
+}`;
+
+/**
+ * Scope renderer chosen for this device: 'webgl' (default) or 'chartjs'.
+ * A ?scope= URL parameter overrides the stored preference.
+ * @returns {string}
+ */
+export function getPreferredScopeRenderer() {
+    const fromUrl = new URLSearchParams(window.location.search).get('scope');
+    if (fromUrl === 'webgl' || fromUrl === 'chartjs') return fromUrl;
+    try {
+        return localStorage.getItem(RENDERER_KEY) === 'chartjs' ? 'chartjs' : 'webgl';
+    } catch {
+        return 'webgl';
+    }
+}
+
+export function setPreferredScopeRenderer(renderer) {
+    try {
+        localStorage.setItem(RENDERER_KEY, renderer === 'chartjs' ? 'chartjs' : 'webgl');
+    } catch { /* storage unavailable (private mode) */ }
+}
+
+/**
+ * WebGL scope renderer for the canvas, or null if WebGL2 is unavailable.
+ * @param {HTMLCanvasElement} canvas - must not have a 2D context yet
+ */
+export function createScopeRenderer(canvas) {
+    let gl = null;
+    try {
+        gl = canvas.getContext('webgl2', { antialias: true, premultipliedAlpha: true });
+    } catch {
+        gl = null;
+    }
+    if (!gl) return null;
+    try {
+        return new ScopeRenderer(canvas, gl);
+    } catch (error) {
+        console.warn('WebGL scope renderer unavailable:', error.message);
+        return null;
+    }
+}
+
+function compile(gl, vertexSource, fragmentSource) {
+    const program = gl.createProgram();
+    [[gl.VERTEX_SHADER, vertexSource], [gl.FRAGMENT_SHADER, fragmentSource]].forEach(([type, source]) => {
+        const shader = gl.createShader(type);
+        gl.shaderSource(shader, source);
+        gl.compileShader(shader);
+        if (!gl.getShaderParameter(shader, gl.COMPILE_STATUS)) {
+            throw new Error(gl.getShaderInfoLog(shader));
+        }
+        gl.attachShader(program, shader);
+        gl.deleteShader(shader);
+    });
+    gl.linkProgram(program);
+    if (!gl.getProgramParameter(program, gl.LINK_STATUS)) {
+        throw new Error(gl.getProgramInfoLog(program));
+    }
+    const locations = {};
+    const count = gl.getProgramParameter(program, gl.ACTIVE_UNIFORMS);
+    for (let i = 0; i < count; i++) {
+        const name = gl.getActiveUniform(program, i).name;
+        locations[name] = gl.getUniformLocation(program, name);
+    }
+    ['a_corner', 'a_y0', 'a_y1'].forEach(name => { locations[name] = gl.getAttribLocation(program, name); });
+    return { program, locations };
+}
+
+// CSS color -> [r, g, b, a] in 0..1, resolved once per color string
+const colorCache = new Map();
+function parseColor(css) {
+    if (!colorCache.has(css)) {
+        const probe = document.createElement('canvas').getContext('2d');
+        probe.fillStyle = css || '#00ff00';
+        probe.fillRect(0, 0, 1, 1);
+        const [r, g, b, a] = probe.getImageData(0, 0, 1, 1).data;
+        colorCache.set(css, [r / 255, g / 255, b / 255, a / 255]);
+    }
+    return colorCache.get(css);
+}
+
+class ScopeRenderer {
+    constructor(canvas, gl) {
+        this.kind = 'webgl';
+        this.canvas = canvas;
+        this.gl = gl;
+        this.lost = false;
+        this.frame = null;
+        this.layerKey = null;
+        this.traceBuffers = [];
+
+        canvas.style.display = 'block';
+        canvas.style.width = '100%';
+        canvas.style.height = '100%';
+
+        this.traceProgram = compile(gl, TRACE_VERTEX_SHADER, TRACE_FRAGMENT_SHADER);
+        this.layerProgram = compile(gl, LAYER_VERTEX_SHADER, LAYER_FRAGMENT_SHADER);
+
+        // Four corners of a unit quad, drawn as a triangle strip: segments and layers alike
+        this.cornerBuffer = gl.createBuffer();
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.cornerBuffer);
+        gl.bufferData(gl.ARRAY_BUFFER, new Float32Array([0, -1, 0, 1, 1, -1, 1, 1]), gl.STATIC_DRAW);
+        this.layerCornerBuffer = gl.createBuffer();
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.layerCornerBuffer);
+        gl.bufferData(gl.ARRAY_BUFFER, new Float32Array([0, 0, 0, 1, 1, 0, 1, 1]), gl.STATIC_DRAW);
+
+        this.layers = ['grid', 'labels'].map(() => ({ canvas: document.createElement('canvas'), texture: gl.createTexture() }));
+        this.layers.forEach(layer => {
+            gl.bindTexture(gl.TEXTURE_2D, layer.texture);
+            gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MIN_FILTER, gl.NEAREST);
+            gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_MAG_FILTER, gl.NEAREST);
+            gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_S, gl.CLAMP_TO_EDGE);
+            gl.texParameteri(gl.TEXTURE_2D, gl.TEXTURE_WRAP_T, gl.CLAMP_TO_EDGE);
+        });
+
+        this.onContextLost = (event) => {
+            event.preventDefault();
+            this.lost = true;
+        };
+        canvas.addEventListener('webglcontextlost', this.onContextLost);
+        // Redraw from the buffers already on the GPU when the card is resized
+        if (typeof ResizeObserver === 'function') {
+            this.resizeObserver = new ResizeObserver(() => this.draw());
+            this.resizeObserver.observe(canvas);
+        }
+    }
+
+    /**
+     * Upload and draw one frame.
+     * @param {Object} frame - { points, traces: [{ data: Float32Array|null, color, range: [min, max] }] }
+     *   in drawing order (last on top); traces without data are hidden. Each trace spans
+     *   the full canvas width. The data arrays are not kept and can be reused right away.
+     */
+    render(frame) {
+        if (this.lost) return;
+        const gl = this.gl;
+        frame.traces.forEach((trace, i) => {
+            if (!this.traceBuffers[i]) this.traceBuffers[i] = { buffer: gl.createBuffer(), bytes: 0 };
+            const slot = this.traceBuffers[i];
+            if (!trace.data) return;
+            gl.bindBuffer(gl.ARRAY_BUFFER, slot.buffer);
+            if (slot.bytes === trace.data.byteLength) {
+                gl.bufferSubData(gl.ARRAY_BUFFER, 0, trace.data);
+            } else {
+                gl.bufferData(gl.ARRAY_BUFFER, trace.data, gl.DYNAMIC_DRAW);
+                slot.bytes = trace.data.byteLength;
+            }
+        });
+        this.frame = {
+            points: frame.points,
+            traces: frame.traces.map(({ color, range, data }) => ({ color: parseColor(color), range, visible: !!data }))
+        };
+        this.draw();
+    }
+
+    resize() {
+        const dpr = window.devicePixelRatio || 1;
+        const width = Math.max(1, Math.round(this.canvas.clientWidth * dpr));
+        const height = Math.max(1, Math.round(this.canvas.clientHeight * dpr));
+        if (this.canvas.width !== width || this.canvas.height !== height) {
+            this.canvas.width = width;
+            this.canvas.height = height;
+        }
+        return dpr;
+    }
+
+    // Re-render the grid and label layers when the size or any label text changed
+    updateLayers(dpr) {
+        const { width, height } = this.canvas;
+        const texts = scopeLabelTexts(true);
+        const key = `${width}x${height}@${dpr}:${Object.values(texts).join('|')}`;
+        if (key === this.layerKey) return;
+        this.layerKey = key;
+
+        const cssWidth = width / dpr;
+        const cssHeight = height / dpr;
+        const area = { left: 0, top: 0, right: cssWidth, bottom: cssHeight };
+        const gl = this.gl;
+        this.layers.forEach((layer, i) => {
+            layer.canvas.width = width;
+            layer.canvas.height = height;
+            const ctx = layer.canvas.getContext('2d');
+            ctx.setTransform(dpr, 0, 0, dpr, 0, 0);
+            if (i === 0) {
+                drawScopeGrid(ctx, cssWidth, cssHeight, area);
+            } else {
+                drawScopeLabels(ctx, area, texts);
+            }
+            gl.bindTexture(gl.TEXTURE_2D, layer.texture);
+            gl.pixelStorei(gl.UNPACK_PREMULTIPLY_ALPHA_WEBGL, true);
+            gl.texImage2D(gl.TEXTURE_2D, 0, gl.RGBA, gl.RGBA, gl.UNSIGNED_BYTE, layer.canvas);
+        });
+    }
+
+    drawLayer(layer) {
+        const gl = this.gl;
+        const { program, locations } = this.layerProgram;
+        gl.useProgram(program);
+        gl.activeTexture(gl.TEXTURE0);
+        gl.bindTexture(gl.TEXTURE_2D, layer.texture);
+        gl.uniform1i(locations.u_layer, 0);
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.layerCornerBuffer);
+        gl.enableVertexAttribArray(locations.a_corner);
+        gl.vertexAttribPointer(locations.a_corner, 2, gl.FLOAT, false, 0, 0);
+        gl.drawArrays(gl.TRIANGLE_STRIP, 0, 4);
+    }
+
+    drawTrace(slot, trace, points, width, alpha) {
+        const gl = this.gl;
+        const { locations } = this.traceProgram;
+        gl.uniform1f(locations.u_width, width);
+        gl.uniform2f(locations.u_range, trace.range[0], trace.range[1]);
+        const [r, g, b, a] = trace.color;
+        gl.uniform4f(locations.u_color, r, g, b, a * alpha);
+        gl.bindBuffer(gl.ARRAY_BUFFER, slot.buffer);
+        // The same buffer feeds both ends of every segment, one float apart
+        gl.vertexAttribPointer(locations.a_y0, 1, gl.FLOAT, false, 4, 0);
+        gl.vertexAttribPointer(locations.a_y1, 1, gl.FLOAT, false, 4, 4);
+        gl.drawArraysInstanced(gl.TRIANGLE_STRIP, 0, 4, points - 1);
+    }
+
+    draw() {
+        if (this.lost || !this.frame || this.gl.isContextLost()) return;
+        const gl = this.gl;
+        const dpr = this.resize();
+        this.updateLayers(dpr);
+
+        gl.viewport(0, 0, this.canvas.width, this.canvas.height);
+        gl.clearColor(0, 0, 0, 0);
+        gl.clear(gl.COLOR_BUFFER_BIT);
+        gl.enable(gl.BLEND);
+        gl.blendFunc(gl.ONE, gl.ONE_MINUS_SRC_ALPHA);
+
+        this.drawLayer(this.layers[0]);
+
+        const { points, traces } = this.frame;
+        if (points >= 2) {
+            const { program, locations } = this.traceProgram;
+            gl.useProgram(program);
+            gl.uniform1f(locations.u_count, points);
+            gl.uniform2f(locations.u_size, this.canvas.width, this.canvas.height);
+            gl.bindBuffer(gl.ARRAY_BUFFER, this.cornerBuffer);
+            gl.enableVertexAttribArray(locations.a_corner);
+            gl.vertexAttribPointer(locations.a_corner, 2, gl.FLOAT, false, 0, 0);
+            gl.vertexAttribDivisor(locations.a_corner, 0);
+            [locations.a_y0, locations.a_y1].forEach(location => {
+                gl.enableVertexAttribArray(location);
+                gl.vertexAttribDivisor(location, 1);
+            });
+            traces.forEach((trace, i) => {
+                const slot = this.traceBuffers[i];
+                if (!trace.visible || !slot || slot.bytes < points * 4) return;
+                this.drawTrace(slot, trace, points, GLOW_WIDTH * dpr, GLOW_ALPHA);
+                this.drawTrace(slot, trace, points, TRACE_WIDTH * dpr, 1);
+            });
+            [locations.a_y0, locations.a_y1].forEach(location => {
+                gl.vertexAttribDivisor(location, 0);
+                gl.disableVertexAttribArray(location);
+            });
+        }
+
+        this.drawLayer(this.layers[1]);
+    }
+
+    destroy() {
+        if (this.resizeObserver) this.resizeObserver.disconnect();
+        this.canvas.removeEventListener('webglcontextlost', this.onContextLost);
+        const gl = this.gl;
+        if (!gl.isContextLost()) {
+            this.traceBuffers.forEach(slot => gl.deleteBuffer(slot.buffer));
+            this.layers.forEach(layer => gl.deleteTexture(layer.texture));
+            [this.cornerBuffer, this.layerCornerBuffer].forEach(buffer => gl.deleteBuffer(buffer));
+            [this.traceProgram, this.layerProgram].forEach(({ program }) => gl.deleteProgram(program));
+        }
+        this.traceBuffers = [];
+        this.frame = null;
+    }
+}
@@ -0,0 +1,63 @@
+// deviceModel.js - Client cache of /api/synths/<id>/model, the DAC codes the firmware plays
+// for a synth's settings (one sync cycle per channel, see host/utils/dds_model.py)
+
+// Settings the model depends on; a change in any of them refetches
+const MODEL_KEYS = ['enabled', 'frequency_a', 'frequency_b', 'amplitude_a', 'amplitude_b',
+    'phase_a', 'phase_b', 'harmonics_a', 'harmonics_b'];
+
+// synthId -> { signature, result, pending }
+const models = new Map();
+// Set when the host answers 503 (numpy missing): the ideal preview is all there is
+let unavailable = false;
+
+function settingsSignature(synth) {
+    return JSON.stringify(MODEL_KEYS.map(key => synth[key]));
+}
+
+export function isDeviceModelAvailable() {
+    return !unavailable;
+}
+
+/**
+ * The model for a synth's settings: { sample_rate, cycle_samples, channels: { a, b } } with
+ * samples as Uint8Arrays. When the settings changed, the model is refetched and onReady is
+ * called once it arrives; until then the previous model (or null before the first) is returned.
+ * @param {number} synthId
+ * @param {Object} synth - Synth state entry
+ * @param {Function} onReady - Called when a newer model is available
+ */
+export function getDeviceModel(synthId, synth, onReady) {
+    if (unavailable) return null;
+    let entry = models.get(synthId);
+    if (!entry) {
+        entry = { signature: null, result: null, pending: null };
+        models.set(synthId, entry);
+    }
+    const signature = settingsSignature(synth);
+    if (entry.signature === signature || entry.pending === signature) return entry.result;
+
+    entry.pending = signature;
+    fetch(`/api/synths/${synthId}/model`).then(async response => {
+        if (response.status === 503) {
+            unavailable = true;
+            console.warn('Device output model unavailable on the host; showing the ideal waveform');
+            onReady();
+            return;
+        }
+        if (!response.ok) throw new Error(`HTTP ${response.status}`);
+        const result = await response.json();
+        // Settings changed again while this was in flight; the newer fetch wins
+        if (entry.pending !== signature) return;
+        Object.values(result.channels).forEach(channel => {
+            channel.samples = Uint8Array.from(channel.samples);
+        });
+        entry.signature = signature;
+        entry.result = result;
+        entry.pending = null;
+        onReady();
+    }).catch(e => {
+        if (entry.pending === signature) entry.pending = null;
+        console.warn(`Device model fetch failed for synth ${synthId}:`, e);
+    });
+    return entry.result;
+}
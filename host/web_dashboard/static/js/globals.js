@@ -44,7 +44,8 @@ import {
     getVoltageOffset, getCurrentOffset, setVoltageOffset, setCurrentOffset,
     stepVoltageOffsetUp, stepVoltageOffsetDown, resetVoltageOffset,
     stepCurrentOffsetUp, stepCurrentOffsetDown, resetCurrentOffset,
-    stepVoltageScaleUp, stepVoltageScaleDown, stepCurrentScaleUp, stepCurrentScaleDown
+    stepVoltageScaleUp, stepVoltageScaleDown, stepCurrentScaleUp, stepCurrentScaleDown,
+    setPreviewModel, getPreviewModel
 } from './state.js';
 
 // Utilities (used in component templates)
@@ -143,6 +144,10 @@ window.setPhaseVisibility = setPhaseVisibility;
 window.getPhaseVisibility = getPhaseVisibility;
 window.updatePhaseVisibilityUI = updatePhaseVisibilityUI;
 
+// === SCOPE PREVIEW MODEL (used in onclick attributes and charts.js) ===
+window.setPreviewModel = setPreviewModel;
+window.getPreviewModel = getPreviewModel;
+
 // === UTILITY FUNCTIONS (used in component templates) ===
 window.roundToPrecision = roundToPrecision;
 window.apparentPower = apparentPower;
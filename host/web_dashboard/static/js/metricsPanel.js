@@ -0,0 +1,113 @@
+// metricsPanel.js - Live summary of /api/metrics for the settings page
+
+import { getMetrics } from './api.js';
+import { getChartUpdateStats } from './components/charts.js';
+
+const REFRESH_MS = 2000;
+let refreshTimer = null;
+let previousSnapshot = null;
+
+function formatMs(seconds) {
+    if (!Number.isFinite(seconds) || seconds <= 0) return '-';
+    const ms = seconds * 1000;
+    return ms < 10 ? `${ms.toFixed(1)} ms` : `${Math.round(ms)} ms`;
+}
+
+function latencyText(hist) {
+    if (!hist || !hist.count) return '-';
+    return `p50 ≤${formatMs(hist.p50)} · p99 ≤${formatMs(hist.p99)}`;
+}
+
+function ratePerSecond(name, snapshot) {
+    if (!previousSnapshot) return null;
+    const dt = snapshot.timestamp - previousSnapshot.timestamp;
+    const prev = previousSnapshot.metrics?.[name]?.total;
+    const curr = snapshot.metrics?.[name]?.total;
+    if (!(dt > 0) || !Number.isFinite(prev) || !Number.isFinite(curr)) return null;
+    return Math.max(0, (curr - prev) / dt);
+}
+
+function counterText(name, snapshot) {
+    const total = snapshot.metrics?.[name]?.total ?? 0;
+    const rate = ratePerSecond(name, snapshot);
+    return rate === null ? `${total}` : `${total} (${rate.toFixed(1)}/s)`;
+}
+
+function percentSaved(json, msgpack) {
+    if (!(json > 0) || !Number.isFinite(msgpack)) return null;
+    return Math.round((1 - msgpack / json) * 100);
+}
+
+function codecSavingsText(m) {
+    const bytes = m.nhp_socket_codec_sample_bytes_total?.series || {};
+    const time = m.nhp_socket_codec_encode_seconds?.series || {};
+    const size = percentSaved(bytes.json, bytes.msgpack);
+    if (size === null) return '-';
+    const encode = percentSaved(time.json?.mean, time.msgpack?.mean);
+    return encode === null ? `size −${size}%` : `size −${size}% · encode ${encode >= 0 ? '−' : '+'}${Math.abs(encode)}%`;
+}
+
+function scopeUpdateText() {
+    const stats = getChartUpdateStats();
+    if (!stats.updates) return '-';
+    return `${stats.meanMs.toFixed(1)} ms avg · ${stats.maxMs.toFixed(1)} ms max · ${stats.fps} fps · ${stats.renderer}, ${stats.points} pts`;
+}
+
+function buildRows(snapshot) {
+    const m = snapshot.metrics || {};
+    const rows = [
+        ['Uptime', `${Math.round(snapshot.uptime_s || 0)} s`],
+        ['Serial RTT', latencyText(m.nhp_serial_rtt_seconds)],
+    ];
+    const perSynth = m.nhp_serial_rtt_seconds?.series || {};
+    Object.keys(perSynth).sort((a, b) => Number(a) - Number(b)).forEach((synth) => {
+        rows.push([`&nbsp;&nbsp;Synth ${Number(synth) + 1}`, latencyText(perSynth[synth])]);
+    });
+    rows.push(
+        ['Commands sent', counterText('nhp_serial_commands_sent_total', snapshot)],
+        ['Commands coalesced', counterText('nhp_commands_coalesced_total', snapshot)],
+        ['Queue depth', `${m.nhp_command_queue_depth?.value ?? 0}`],
+        ['Poll duration', latencyText(m.nhp_poll_duration_seconds)],
+        ['Poll failures', counterText('nhp_poll_failures_total', snapshot)],
+        ['Reconnects', counterText('nhp_reconnects_total', snapshot)],
+        ['Socket emits', counterText('nhp_socket_emits_total', snapshot)],
+        ['MessagePack clients', `${m.nhp_socket_msgpack_clients?.value ?? 0}`],
+        ['MessagePack vs JSON', codecSavingsText(m)],
+        ['Main loop', latencyText(m.nhp_main_loop_iteration_seconds)],
+        ['Scope update (this screen)', scopeUpdateText()],
+    );
+    return rows;
+}
+
+async function refreshMetrics() {
+    const body = document.getElementById('metrics-summary');
+    if (!body) return;
+    try {
+        const snapshot = await getMetrics();
+        body.innerHTML = buildRows(snapshot)
+            .map(([label, value]) => `<tr><td class="text-muted">${label}</td><td class="text-end">${value}</td></tr>`)
+            .join('');
+        previousSnapshot = snapshot;
+    } catch (error) {
+        body.innerHTML = `<tr><td class="text-danger">Metrics unavailable: ${error.message}</td></tr>`;
+    }
+}
+
+/**
+ * Poll metrics only while the metrics panel is open.
+ */
+export function setupMetricsPanel() {
+    const panel = document.getElementById('metrics-panel');
+    if (!panel || panel.dataset.metricsInit === '1') return;
+    panel.dataset.metricsInit = '1';
+
+    panel.addEventListener('shown.bs.offcanvas', () => {
+        refreshMetrics();
+        if (!refreshTimer) refreshTimer = setInterval(refreshMetrics, REFRESH_MS);
+    });
+    panel.addEventListener('hidden.bs.offcanvas', () => {
+        if (refreshTimer) clearInterval(refreshTimer);
+        refreshTimer = null;
+        previousSnapshot = null;
+    });
+}
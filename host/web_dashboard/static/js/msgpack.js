@@ -0,0 +1,218 @@
+// msgpack.js - Minimal MessagePack codec for binary Socket.IO payloads
+//
+// Mirrors host/utils/msgpack_codec.py: dict keys listed in SCHEMA_KEYS travel as
+// their index, floats that are exact in float32 are sent as float32. Keep the
+// key table and SCHEMA_VERSION in sync with the server.
+
+export const SCHEMA_VERSION = 1;
+
+// Append only: indices are the wire format.
+export const SCHEMA_KEYS = [
+    'synths', 'selectionMode', 'version', 'base', 'ops', 'op', 'path', 'value',
+    'synth_id', 'command', 'channel',
+    'auto_on', 'enabled', 'amplitude_a', 'amplitude_b', 'frequency_a', 'frequency_b',
+    'phase_a', 'phase_b', 'harmonics_a', 'harmonics_b',
+    'id', 'order', 'amplitude', 'phase', 'a', 'b', 'synth', 'ch',
+];
+const KEY_INDEX = new Map(SCHEMA_KEYS.map((key, i) => [key, i]));
+
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+class Writer {
+    constructor() {
+        this.buffer = new Uint8Array(256);
+        this.view = new DataView(this.buffer.buffer);
+        this.pos = 0;
+    }
+
+    ensure(n) {
+        if (this.pos + n <= this.buffer.length) return;
+        let size = this.buffer.length * 2;
+        while (size < this.pos + n) size *= 2;
+        const next = new Uint8Array(size);
+        next.set(this.buffer.subarray(0, this.pos));
+        this.buffer = next;
+        this.view = new DataView(next.buffer);
+    }
+
+    byte(b) { this.ensure(1); this.buffer[this.pos++] = b; }
+    u8(tag, v) { this.ensure(2); this.buffer[this.pos++] = tag; this.view.setUint8(this.pos, v); this.pos += 1; }
+    u16(tag, v) { this.ensure(3); this.buffer[this.pos++] = tag; this.view.setUint16(this.pos, v); this.pos += 2; }
+    u32(tag, v) { this.ensure(5); this.buffer[this.pos++] = tag; this.view.setUint32(this.pos, v); this.pos += 4; }
+    i8(tag, v) { this.ensure(2); this.buffer[this.pos++] = tag; this.view.setInt8(this.pos, v); this.pos += 1; }
+    i16(tag, v) { this.ensure(3); this.buffer[this.pos++] = tag; this.view.setInt16(this.pos, v); this.pos += 2; }
+    i32(tag, v) { this.ensure(5); this.buffer[this.pos++] = tag; this.view.setInt32(this.pos, v); this.pos += 4; }
+    f32(v) { this.ensure(5); this.buffer[this.pos++] = 0xca; this.view.setFloat32(this.pos, v); this.pos += 4; }
+    f64(v) { this.ensure(9); this.buffer[this.pos++] = 0xcb; this.view.setFloat64(this.pos, v); this.pos += 8; }
+    bytes(b) { this.ensure(b.length); this.buffer.set(b, this.pos); this.pos += b.length; }
+}
+
+function writeValue(w, value) {
+    if (value === null || value === undefined) {
+        w.byte(0xc0);
+    } else if (value === true) {
+        w.byte(0xc3);
+    } else if (value === false) {
+        w.byte(0xc2);
+    } else if (typeof value === 'number') {
+        if (Number.isInteger(value) && value >= -0x80000000 && value <= 0xffffffff) {
+            if (value >= 0 && value < 0x80) w.byte(value);
+            else if (value < 0 && value >= -32) w.byte(value & 0xff);
+            else if (value >= 0 && value <= 0xff) w.u8(0xcc, value);
+            else if (value >= 0 && value <= 0xffff) w.u16(0xcd, value);
+            else if (value >= 0) w.u32(0xce, value);
+            else if (value >= -0x80) w.i8(0xd0, value);
+            else if (value >= -0x8000) w.i16(0xd1, value);
+            else w.i32(0xd2, value);
+        } else if (Math.fround(value) === value || Number.isNaN(value)) {
+            w.f32(value);
+        } else {
+            w.f64(value);
+        }
+    } else if (typeof value === 'string') {
+        const data = textEncoder.encode(value);
+        const n = data.length;
+        if (n < 32) w.byte(0xa0 | n);
+        else if (n <= 0xff) w.u8(0xd9, n);
+        else if (n <= 0xffff) w.u16(0xda, n);
+        else w.u32(0xdb, n);
+        w.bytes(data);
+    } else if (value instanceof Uint8Array) {
+        const n = value.length;
+        if (n <= 0xff) w.u8(0xc4, n);
+        else if (n <= 0xffff) w.u16(0xc5, n);
+        else w.u32(0xc6, n);
+        w.bytes(value);
+    } else if (Array.isArray(value)) {
+        const n = value.length;
+        if (n < 16) w.byte(0x90 | n);
+        else if (n <= 0xffff) w.u16(0xdc, n);
+        else w.u32(0xdd, n);
+        value.forEach((item) => writeValue(w, item));
+    } else if (typeof value === 'object') {
+        const keys = Object.keys(value).filter((k) => value[k] !== undefined);
+        const n = keys.length;
+        if (n < 16) w.byte(0x80 | n);
+        else if (n <= 0xffff) w.u16(0xde, n);
+        else w.u32(0xdf, n);
+        keys.forEach((key) => {
+            writeValue(w, KEY_INDEX.has(key) ? KEY_INDEX.get(key) : key);
+            writeValue(w, value[key]);
+        });
+    } else {
+        throw new TypeError(`Cannot MessagePack-encode ${typeof value}`);
+    }
+}
+
+class Reader {
+    constructor(bytes) {
+        this.bytes = bytes;
+        this.view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+        this.pos = 0;
+    }
+
+    check(n) {
+        if (this.pos + n > this.bytes.length) throw new RangeError('Truncated MessagePack data');
+    }
+
+    read(getter, n) {
+        this.check(n);
+        const value = this.view[getter](this.pos);
+        this.pos += n;
+        return value;
+    }
+
+    str(n) {
+        this.check(n);
+        const value = textDecoder.decode(this.bytes.subarray(this.pos, this.pos + n));
+        this.pos += n;
+        return value;
+    }
+
+    bin(n) {
+        this.check(n);
+        const value = this.bytes.slice(this.pos, this.pos + n);
+        this.pos += n;
+        return value;
+    }
+}
+
+function readKey(r) {
+    const key = readValue(r);
+    return typeof key === 'number' && key >= 0 && key < SCHEMA_KEYS.length ? SCHEMA_KEYS[key] : key;
+}
+
+function readArray(r, n) {
+    const out = new Array(n);
+    for (let i = 0; i < n; i++) out[i] = readValue(r);
+    return out;
+}
+
+function readMap(r, n) {
+    const out = {};
+    for (let i = 0; i < n; i++) {
+        const key = readKey(r);
+        out[key] = readValue(r);
+    }
+    return out;
+}
+
+function readValue(r) {
+    const tag = r.read('getUint8', 1);
+    if (tag < 0x80) return tag;
+    if (tag >= 0xe0) return tag - 0x100;
+    if (tag <= 0x8f) return readMap(r, tag & 0x0f);
+    if (tag <= 0x9f) return readArray(r, tag & 0x0f);
+    if (tag <= 0xbf) return r.str(tag & 0x1f);
+    switch (tag) {
+        case 0xc0: return null;
+        case 0xc2: return false;
+        case 0xc3: return true;
+        case 0xc4: return r.bin(r.read('getUint8', 1));
+        case 0xc5: return r.bin(r.read('getUint16', 2));
+        case 0xc6: return r.bin(r.read('getUint32', 4));
+        case 0xca: return r.read('getFloat32', 4);
+        case 0xcb: return r.read('getFloat64', 8);
+        case 0xcc: return r.read('getUint8', 1);
+        case 0xcd: return r.read('getUint16', 2);
+        case 0xce: return r.read('getUint32', 4);
+        case 0xcf: return Number(r.read('getBigUint64', 8));
+        case 0xd0: return r.read('getInt8', 1);
+        case 0xd1: return r.read('getInt16', 2);
+        case 0xd2: return r.read('getInt32', 4);
+        case 0xd3: return Number(r.read('getBigInt64', 8));
+        case 0xd9: return r.str(r.read('getUint8', 1));
+        case 0xda: return r.str(r.read('getUint16', 2));
+        case 0xdb: return r.str(r.read('getUint32', 4));
+        case 0xdc: return readArray(r, r.read('getUint16', 2));
+        case 0xdd: return readArray(r, r.read('getUint32', 4));
+        case 0xde: return readMap(r, r.read('getUint16', 2));
+        case 0xdf: return readMap(r, r.read('getUint32', 4));
+        default: throw new TypeError(`Unsupported MessagePack type 0x${tag.toString(16)}`);
+    }
+}
+
+/**
+ * Encode a payload with the compact key schema
+ * @param {*} value
+ * @returns {Uint8Array}
+ */
+export function encode(value) {
+    const w = new Writer();
+    writeValue(w, value);
+    return w.buffer.slice(0, w.pos);
+}
+
+/**
+ * Decode a compact-schema MessagePack payload
+ * @param {ArrayBuffer|Uint8Array} data
+ * @returns {*}
+ */
+export function decode(data) {
+    const bytes = data instanceof Uint8Array ? data : new Uint8Array(data);
+    const r = new Reader(bytes);
+    const value = readValue(r);
+    if (r.pos !== bytes.length) throw new RangeError('Trailing bytes after MessagePack value');
+    return value;
+}
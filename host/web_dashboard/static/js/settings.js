@@ -1,5 +1,7 @@
 // settings.js - Settings Management Module
 
+import { getPreferredSocketEncoding, setPreferredSocketEncoding } from './api.js';
+
 // Default settings configuration (fallback only)
 const DEFAULT_SETTINGS = {
     maxVoltage: 250,
@@ -8,7 +10,7 @@ const DEFAULT_SETTINGS = {
     precisionDigits: 2,
     autoSaveSettings: true,
     debugMode: false,
-    synthAutoOn: [false, false, false],
+    synthAutoOn: [],
     harmonicCalibration: {
         enabled: false,
         mode: 'linear',
@@ -35,6 +37,33 @@ function ensurePerHarmonicInputs() {
     grid.dataset.built = '1';
 }
 
+const PHASE_LABELS = [
+    { line: 'L1', phase: 'A', color: 'text-danger' },
+    { line: 'L2', phase: 'B', color: 'text-warning' },
+    { line: 'L3', phase: 'C', color: 'text-info' }
+];
+
+// One auto-on switch per synth; synths are grouped in three-phase rigs of three.
+function ensureSynthAutoOnInputs(count) {
+    const list = document.getElementById('synth-auto-on-list');
+    if (!list || list.dataset.count === String(count)) return;
+
+    const multiRig = count > PHASE_LABELS.length;
+    list.innerHTML = Array.from({ length: count }, (_, index) => {
+        const { line, phase, color } = PHASE_LABELS[index % PHASE_LABELS.length];
+        const rig = multiRig ? `Rig ${Math.floor(index / PHASE_LABELS.length) + 1} ` : '';
+        return `
+        <div class="form-check form-switch">
+            <input class="form-check-input" type="checkbox" id="synth-auto-on-${index}" data-synth-index="${index}">
+            <label class="form-check-label small" for="synth-auto-on-${index}">
+                <i class="bi bi-circle-fill ${color} me-1"></i>${rig}${line} (Phase ${phase}) Auto-On
+            </label>
+        </div>`;
+    }).join('');
+
+    list.dataset.count = String(count);
+}
+
 function readPerHarmonicInputs() {
     ensurePerHarmonicInputs();
     const result = {};
@@ -319,15 +348,9 @@ function collectCurrentFormValues() {
     }
     
     // Synth auto-on settings
-    const synthAutoOnCheckboxes = ['synth-auto-on-0', 'synth-auto-on-1', 'synth-auto-on-2'];
-    const autoOnValues = [];
-    synthAutoOnCheckboxes.forEach((id, index) => {
-        const checkbox = document.getElementById(id);
-        if (checkbox) {
-            autoOnValues[index] = checkbox.checked;
-        } else {
-            autoOnValues[index] = currentSettings.synthAutoOn ? currentSettings.synthAutoOn[index] : false;
-        }
+    const autoOnValues = [...(currentSettings.synthAutoOn || [])];
+    document.querySelectorAll('#synth-auto-on-list input[data-synth-index]').forEach((checkbox) => {
+        autoOnValues[Number(checkbox.dataset.synthIndex)] = checkbox.checked;
     });
     currentSettings.synthAutoOn = autoOnValues;
 
@@ -403,11 +426,12 @@ function updateSettingsUI() {
     }
 
     // Synth auto-on settings
-    const synthAutoOnCheckboxes = ['synth-auto-on-0', 'synth-auto-on-1', 'synth-auto-on-2'];
-    synthAutoOnCheckboxes.forEach((id, index) => {
-        const checkbox = document.getElementById(id);
-        if (checkbox && currentSettings.synthAutoOn && currentSettings.synthAutoOn[index] !== undefined) {
-            checkbox.checked = currentSettings.synthAutoOn[index];
+    const synthAutoOn = currentSettings.synthAutoOn || [];
+    ensureSynthAutoOnInputs(synthAutoOn.length);
+    synthAutoOn.forEach((autoOn, index) => {
+        const checkbox = document.getElementById(`synth-auto-on-${index}`);
+        if (checkbox) {
+            checkbox.checked = Boolean(autoOn);
         }
     });
 
@@ -524,19 +548,27 @@ export function setupSettingsListeners() {
             await setSetting('debugMode', e.target.checked);
         });
     }
+
+    // Socket payload encoding is a per-device preference, not a server setting
+    const binaryPayloadsCheckbox = document.getElementById('binary-socket-payloads');
+    if (binaryPayloadsCheckbox) {
+        binaryPayloadsCheckbox.checked = getPreferredSocketEncoding() === 'msgpack';
+        binaryPayloadsCheckbox.addEventListener('change', (e) => {
+            setPreferredSocketEncoding(e.target.checked ? 'msgpack' : 'json');
+        });
+    }
     
-    // Synth auto-on settings
-    const synthAutoOnCheckboxes = ['synth-auto-on-0', 'synth-auto-on-1', 'synth-auto-on-2'];
-    synthAutoOnCheckboxes.forEach((id, index) => {
-        const checkbox = document.getElementById(id);
-        if (checkbox) {
-            checkbox.addEventListener('change', async (e) => {
-                const currentAutoOn = currentSettings.synthAutoOn || [false, false, false];
-                currentAutoOn[index] = e.target.checked;
-                await setSetting('synthAutoOn', currentAutoOn);
-            });
-        }
-    });
+    // Synth auto-on settings (switches are rebuilt when the synth count changes, so delegate)
+    const synthAutoOnList = document.getElementById('synth-auto-on-list');
+    if (synthAutoOnList) {
+        synthAutoOnList.addEventListener('change', async (e) => {
+            const index = Number(e.target.dataset.synthIndex);
+            if (Number.isNaN(index)) return;
+            const currentAutoOn = [...(currentSettings.synthAutoOn || [])];
+            currentAutoOn[index] = e.target.checked;
+            await setSetting('synthAutoOn', Array.from(currentAutoOn, (value) => Boolean(value)));
+        });
+    }
 
     const harmonicEnabled = document.getElementById('harmonic-cal-enabled');
     const harmonicMode = document.getElementById('harmonic-cal-mode');
@@ -691,14 +723,14 @@ export function getPrecisionDigits() {
  * Get synth auto-on settings
  */
 export function getSynthAutoOn() {
-    return currentSettings.synthAutoOn || [false, false, false];
+    return currentSettings.synthAutoOn || [];
 }
 
 /**
  * Get auto-on setting for a specific synth
  */
 export function getSynthAutoOnForIndex(index) {
-    const autoOnSettings = currentSettings.synthAutoOn || [false, false, false];
+    const autoOnSettings = currentSettings.synthAutoOn || [];
     return autoOnSettings[index] || false;
 }
 
@@ -19,6 +19,7 @@ function loadStateFromStorage() {
                 timeOffsetMs: parsed.timeOffsetMs || 0, // time offset in ms for horizontal translation
                 voltageOffsetV: parsed.voltageOffsetV || 0, // voltage offset in V for vertical translation
                 currentOffsetA: parsed.currentOffsetA || 0, // current offset in A for vertical translation
+                previewModel: parsed.previewModel === 'device' ? 'device' : 'ideal', // scope traces: ideal or DAC output
                 phaseVisibility: parsed.phaseVisibility || {
                     L1: { voltage: true, current: true },
                     L2: { voltage: true, current: true },
@@ -41,6 +42,7 @@ function loadStateFromStorage() {
         timeOffsetMs: 0, // time offset in ms for horizontal translation
         voltageOffsetV: 0, // voltage offset in V for vertical translation
         currentOffsetA: 0, // current offset in A for vertical translation
+        previewModel: 'ideal', // scope traces: ideal or DAC output
         phaseVisibility: {
             L1: { voltage: true, current: true },
             L2: { voltage: true, current: true },
@@ -63,6 +65,7 @@ function saveStateToStorage() {
             timeOffsetMs: AppState.timeOffsetMs,
             voltageOffsetV: AppState.voltageOffsetV,
             currentOffsetA: AppState.currentOffsetA,
+            previewModel: AppState.previewModel,
             phaseVisibility: AppState.phaseVisibility
         };
         localStorage.setItem(STORAGE_KEY, JSON.stringify(stateToSave));
@@ -335,6 +338,27 @@ export function resetCurrentOffset() {
     rerenderThreePhaseChart();
 }
 
+// Scope preview: 'ideal' sinusoids or 'device', the DAC codes the firmware plays
+export function setPreviewModel(model) {
+    AppState.previewModel = model === 'device' ? 'device' : 'ideal';
+    saveStateToStorage();
+    updatePreviewModelUI();
+    rerenderThreePhaseChart();
+}
+
+export function getPreviewModel() {
+    return AppState.previewModel;
+}
+
+export function updatePreviewModelUI() {
+    const button = document.getElementById('toggle-preview-model');
+    if (!button) return;
+    const device = AppState.previewModel === 'device';
+    button.classList.toggle('btn-outline-light', device);
+    button.classList.toggle('btn-outline-secondary', !device);
+    button.textContent = device ? 'DAC' : 'Ideal';
+}
+
 // Phase visibility setters and getters
 export function setPhaseVisibility(phase, type, visible) {
     if (!AppState.phaseVisibility[phase]) {
@@ -394,10 +418,17 @@ function updateScaleDisplays() {
     if (timeOffsetSlider) {
         timeOffsetSlider.value = -AppState.timeOffsetMs;
     }
+    // Ranges follow V/div and A/div (the scope card is not rebuilt when they change)
     if (voltageOffsetSlider) {
+        voltageOffsetSlider.min = -getVoltageScale() * 5;
+        voltageOffsetSlider.max = getVoltageScale() * 5;
+        voltageOffsetSlider.step = getVoltageScale() * 0.1;
         voltageOffsetSlider.value = -AppState.voltageOffsetV;
     }
     if (currentOffsetSlider) {
+        currentOffsetSlider.min = -getCurrentScale() * 5;
+        currentOffsetSlider.max = getCurrentScale() * 5;
+        currentOffsetSlider.step = getCurrentScale() * 0.1;
         currentOffsetSlider.value = -AppState.currentOffsetA;
     }
 }
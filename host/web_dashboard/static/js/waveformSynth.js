@@ -0,0 +1,97 @@
+// waveformSynth.js - Scope trace synthesis, shared by waveformWorker.js and the main-thread fallback
+
+// The rotation is re-seeded from Math.sin/cos this often, so rounding drift stays far below a pixel
+const RESEED_INTERVAL = 1024;
+// Spare buffers kept for reuse; more than one frame's worth is never needed
+const MAX_SPARE_BUFFERS = 24;
+
+// Add amplitude * sin(2π f t + phase) at t = t0 + i * dt, advancing a sin/cos pair by a
+// fixed rotation per point instead of calling Math.sin for every sample
+function addComponent(out, t0, dt, frequency, amplitude, phaseDeg) {
+    if (!amplitude) return;
+    const omega = 2 * Math.PI * frequency;
+    const start = omega * t0 + phaseDeg * Math.PI / 180;
+    const step = omega * dt;
+    const cosStep = Math.cos(step);
+    const sinStep = Math.sin(step);
+    let s = Math.sin(start);
+    let c = Math.cos(start);
+    for (let i = 0; i < out.length; i++) {
+        out[i] += amplitude * s;
+        if ((i + 1) % RESEED_INTERVAL === 0) {
+            const angle = start + (i + 1) * step;
+            s = Math.sin(angle);
+            c = Math.cos(angle);
+        } else {
+            const next = s * cosStep + c * sinStep;
+            c = c * cosStep - s * sinStep;
+            s = next;
+        }
+    }
+}
+
+/**
+ * Fill `out` with a fundamental plus its harmonics, as drawn on the scope:
+ * harmonic n has amplitude (h.amplitude %) of the fundamental and phase h.phase + n * phase.
+ */
+export function synthesizeTrace(out, t0, dt, frequency, amplitude, phaseDeg, harmonics) {
+    out.fill(0);
+    addComponent(out, t0, dt, frequency, amplitude, phaseDeg);
+    if (Array.isArray(harmonics)) {
+        for (const h of harmonics) {
+            addComponent(out, t0, dt, h.order * frequency, amplitude * (h.amplitude / 100), h.phase + h.order * phaseDeg);
+        }
+    }
+    return out;
+}
+
+/**
+ * Fill `out` with a device-model trace: one sync cycle of DAC codes (t = 0 at the sync edge),
+ * repeated and held for a sample period each, with codes 0 and 255 at -fullScale and +fullScale.
+ */
+export function sampleTrace(out, t0, dt, samples, sampleRate, fullScale) {
+    const cycle = samples.length;
+    for (let i = 0; i < out.length; i++) {
+        // The nudge keeps times that land on a sample boundary from rounding into the previous sample
+        let index = Math.floor((t0 + i * dt) * sampleRate + 1e-6) % cycle;
+        if (index < 0) index += cycle;
+        out[i] = (samples[index] - 127.5) / 127.5 * fullScale;
+    }
+    return out;
+}
+
+function takeBuffer(spare, points) {
+    while (spare.length) {
+        const buffer = spare.pop();
+        if (buffer.length === points) return buffer;
+    }
+    return new Float32Array(points);
+}
+
+/**
+ * Keep returned buffers for the next frame (bounded).
+ */
+export function recycleBuffers(spare, buffers) {
+    for (const buffer of buffers) {
+        if (buffer && buffer.byteLength && spare.length < MAX_SPARE_BUFFERS) spare.push(buffer);
+    }
+}
+
+/**
+ * Synthesize every requested trace; hidden traces are null in the request and the result.
+ * @param {Object} request - { points, t0, dt, frequency, traces: [{ amplitude, phase, harmonics }
+ *                           | { samples, sampleRate, amplitude } | null] }, where amplitude is the
+ *                           peak of an ideal trace or the full scale of a sampled one
+ * @param {Array} spare - Float32Arrays available for reuse
+ * @returns {Array} Float32Array (or null) per trace
+ */
+export function renderTraces(request, spare) {
+    const { points, t0, dt, frequency, traces } = request;
+    return traces.map(trace => {
+        if (!trace) return null;
+        const out = takeBuffer(spare, points);
+        return trace.samples
+            ? sampleTrace(out, t0, dt, trace.samples, trace.sampleRate, trace.amplitude)
+            : synthesizeTrace(out, t0, dt, frequency, trace.amplitude, trace.phase, trace.harmonics);
+    });
+}
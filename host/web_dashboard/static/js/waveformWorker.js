@@ -0,0 +1,19 @@
+// waveformWorker.js - Synthesizes scope traces off the UI thread
+//
+// Messages in:  { type: 'render', id, points, t0, dt, frequency, traces }
+//               { type: 'recycle', buffers }   (Float32Arrays the page no longer draws)
+// Messages out: { id, traces }                 (Float32Arrays transferred, null for hidden traces)
+
+import { renderTraces, recycleBuffers } from './waveformSynth.js';
+
+const spare = [];
+
+self.onmessage = (event) => {
+    const message = event.data;
+    if (message.type === 'recycle') {
+        recycleBuffers(spare, message.buffers);
+    } else if (message.type === 'render') {
+        const traces = renderTraces(message, spare);
+        self.postMessage({ id: message.id, traces }, traces.filter(Boolean).map(trace => trace.buffer));
+    }
+};
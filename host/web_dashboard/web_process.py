@@ -0,0 +1,132 @@
+"""
+Dashboard web process.
+
+Started by main.py as `python -m web_dashboard.web_process` so Flask-SocketIO,
+the socket emitters and JSON encoding run under their own GIL and a burst of web
+traffic cannot delay encoder handling or serial I/O in the control process. Synth
+state is read from the shared state block; commands go to the control process
+through the shared command ring.
+
+Serving (NHP_WEB_SERVER): 'auto' (default) uses eventlet, then gevent, when
+installed, and falls back to the threaded Werkzeug server ('threading'). The async
+servers give every connection a green thread with a real WebSocket transport, so
+idle dashboard clients cost memory rather than OS threads. Only this module's
+stdlib imports run before the monkey patch, which is why the rest are deferred.
+
+Limits: NHP_WEB_MAX_CLIENTS caps connected Socket.IO clients (extra ones are
+refused at connect) and NHP_WEB_MAX_CONNECTIONS caps concurrent HTTP/WebSocket
+connections on the async servers.
+"""
+import argparse
+import importlib.util
+import json
+import os
+import sys
+
+WEB_SERVER = os.environ.get('NHP_WEB_SERVER', 'auto')
+MAX_CLIENTS = int(os.environ.get('NHP_WEB_MAX_CLIENTS', '32'))
+MAX_CONNECTIONS = int(os.environ.get('NHP_WEB_MAX_CONNECTIONS', '128'))
+ASYNC_MODES = ('eventlet', 'gevent')
+
+
+def select_async_mode(requested=WEB_SERVER):
+    """'eventlet', 'gevent' or 'threading', depending on what is requested and installed."""
+    if requested == 'threading':
+        return 'threading'
+    for mode in (ASYNC_MODES if requested == 'auto' else (requested,)):
+        if importlib.util.find_spec(mode) is not None:
+            return mode
+    return 'threading'
+
+
+def monkey_patch(async_mode):
+    """Make blocking stdlib calls cooperative; must run before socket/threading users are imported."""
+    if async_mode == 'eventlet':
+        import eventlet
+        eventlet.monkey_patch()
+    elif async_mode == 'gevent':
+        from gevent import monkey
+        monkey.patch_all()
+
+
+def web_process_command(paths, port):
+    """argv that starts the web process (run from the host directory)."""
+    return [sys.executable, '-m', 'web_dashboard.web_process', '--port', str(port), '--paths', json.dumps(paths)]
+
+
+def _serve(flask_app, socketio, port, async_mode):
+    if async_mode == 'eventlet':
+        socketio.run(flask_app, host='0.0.0.0', port=port, log_output=False, max_size=MAX_CONNECTIONS)
+    elif async_mode == 'gevent':
+        from gevent.pool import Pool
+        socketio.run(flask_app, host='0.0.0.0', port=port, log_output=False, spawn=Pool(MAX_CONNECTIONS))
+    else:
+        socketio.run(flask_app, host='0.0.0.0', port=port, debug=False, use_reloader=False,
+                     allow_unsafe_werkzeug=True)
+
+
+def run_web_process(paths, port, async_mode='threading', parent_pid=None):
+    """
+    :param paths: {'state', 'state_signal', 'status', 'commands', 'results', 'history'} shared-memory paths
+                  created by the control process
+    :param port: dashboard TCP port
+    :param async_mode: server from select_async_mode(); monkey_patch() must already have run for it
+    :param parent_pid: exit when this process (the control process) goes away
+    """
+    import queue
+    from utils.batch import BatchResults
+    from utils.history import history_reader
+    from utils.logger_setup import setup_logger
+    from utils.settings_service import SETTINGS
+    from utils.shared_memory import ChangeSignal, CommandRing, SeqlockBlock
+    from utils.shared_state import ControlStatus, SharedStateView, decode_command, encode_command
+
+    logger = setup_logger("DEBUG")
+    from web_dashboard.web_server import create_app  # after logging is set up in this process
+
+    commands = CommandRing.attach(paths['commands'], encode=encode_command, decode=decode_command)
+    state = SharedStateView(SeqlockBlock.attach(paths['state']), commands,
+                            signal=ChangeSignal.listen(paths['state_signal']))
+    control_status = ControlStatus(SeqlockBlock.attach(paths['status']))
+    batch_results = BatchResults(CommandRing.attach(paths['results'], encode=encode_command,
+                                                    decode=decode_command)).start()
+
+    # Settings are edited and persisted here; the control process needs the calibration
+    # (and auto-on flags) before any harmonic re-send queued by the same change, so this
+    # subscriber is registered ahead of create_app's.
+    def forward_settings(settings, changed_keys):
+        try:
+            commands.put({'synth_id': None, 'command': 'apply_settings', 'channel': None,
+                          'value': settings, 'source': 'dashboard'})
+        except queue.Full:
+            logger.warning("Command ring full, settings change not forwarded to the control process")
+
+    SETTINGS.subscribe(forward_settings)
+
+    flask_app, socketio = create_app(commands, state, control_status=control_status,
+                                     async_mode=async_mode, max_clients=MAX_CLIENTS, batch_results=batch_results,
+                                     history=history_reader(paths['history']))
+
+    def watch_parent():
+        # A crashed control process cannot terminate us; don't keep serving stale state
+        while os.getppid() == parent_pid:
+            socketio.sleep(1.0)
+        logger.warning("Control process exited, stopping the dashboard web process")
+        os._exit(0)
+
+    if parent_pid is not None:
+        socketio.start_background_task(watch_parent)
+
+    logger.info(f"Dashboard web process {os.getpid()} serving on port {port} ({async_mode})")
+    _serve(flask_app, socketio, port, async_mode)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="NHP_Synth dashboard web process")
+    parser.add_argument('--port', type=int, required=True)
+    parser.add_argument('--paths', required=True, help="JSON object of shared-memory paths")
+    args = parser.parse_args()
+
+    mode = select_async_mode()
+    monkey_patch(mode)
+    run_web_process(json.loads(args.paths), args.port, mode, parent_pid=os.getppid())
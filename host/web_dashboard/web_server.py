@@ -5,94 +5,104 @@ import copy
 import time
 import threading
 import subprocess
-
-from flask_socketio import SocketIO, emit
-from flask import Flask, jsonify, request, send_file, send_from_directory
-
-
-def create_app(command_queue, state_manager):
+import queue
+
+from flask_socketio import ConnectionRefusedError, SocketIO, emit, join_room, leave_room
+from flask import Flask, Response, jsonify, request, send_file, send_from_directory
+
+from utils.metrics import (REGISTRY, SOCKET_EMITS, SOCKET_MSGPACK_CLIENTS, SOCKET_CLIENTS, SOCKET_CLIENTS_REFUSED,
+                           SOCKET_BACKPRESSURE, CODEC_SAMPLE_BYTES, CODEC_ENCODE_TIME)
+from utils.msgpack_codec import SCHEMA_VERSION, encode_message, decode_message
+from utils.settings_service import SETTINGS, default_settings
+from utils.log_tailer import LogTailer
+from utils.startup import STARTUP_REPORT
+from utils.batch import MAX_BATCH_COMMANDS, validate_batch
+from utils.history import RESOLUTIONS, TRACKED_KEYS
+from utils.rig_sync import MAX_RIG_CHANGES, validate_rig_change
+from utils import dds_analysis, dds_model
+
+SERVICE_LOG = os.path.expanduser('~/NHP_Synth/synth_autostart.log')
+# Commands a client may send through the generic command route and socket event. Everything
+# else the control loop understands (batch, rig_apply, settings/defaults) has its own endpoint
+# with its own validation.
+PUBLIC_SETTERS = ('set_enabled', 'set_amplitude', 'set_frequency', 'set_phase', 'set_harmonics')
+# A client with more packets than this queued but unsent stops receiving state
+# broadcasts until it catches up, then gets one full snapshot.
+MAX_PENDING_PACKETS = 32
+
+
+def create_app(command_queue, state_manager, control_status=None, async_mode='threading', max_clients=None,
+               batch_results=None, history=None):
+    """
+    :param command_queue: queue (or shared command ring) the control loop drains
+    :param state_manager: SynthStateManager, or a SharedStateView in the web process
+    :param control_status: callable returning the control process's published
+        {'metrics', 'metrics_text', 'startup'} when running as a separate web process
+    :param async_mode: Socket.IO server mode ('threading', 'eventlet' or 'gevent')
+    :param max_clients: refuse Socket.IO connections beyond this many (None = no limit)
+    :param batch_results: utils.batch.BatchResults fed by the control loop, so /api/batch
+        can report what was applied (without it batches are only queued)
+    :param history: callable returning the utils.history.HistoryStore the control
+        process records into, or None while it is not open yet
+    """
     app = Flask(__name__)
-    socketio = SocketIO(app, cors_allowed_origins="*")
+    socketio = SocketIO(app, cors_allowed_origins="*", async_mode=async_mode)
 
     def queue_harmonic_reapply_commands():
-        """Re-send active harmonics so new calibration settings take effect immediately."""
+        """Re-send active harmonics so new calibration settings take effect immediately.
+
+        One set_harmonics_multi command per synth: both channels are replaced in a
+        single firmware transaction instead of one wh line per harmonic.
+        """
         synths = getattr(state_manager, 'synths', [])
         queued = 0
         for synth_id, synth_state in enumerate(synths):
+            channels = {}
             for channel in ['a', 'b']:
-                harmonics_key = f'harmonics_{channel}'
-                for idx, harmonic in enumerate(synth_state.get(harmonics_key, [])):
-                    order = harmonic.get('order')
-                    amplitude = harmonic.get('amplitude')
-                    phase = harmonic.get('phase', 0)
-                    if order is None or amplitude is None:
-                        continue
+                channels[channel] = []
+                for harmonic in synth_state.get(f'harmonics_{channel}', []):
                     try:
-                        command_queue.put({
-                            'synth_id': synth_id,
-                            'command': 'set_harmonics',
-                            'channel': channel,
-                            'value': {
-                                'id': int(harmonic.get('id', idx)),
-                                'order': int(order),
-                                'amplitude': float(amplitude),
-                                'phase': float(phase)
-                            }
-                        })
-                        queued += 1
-                    except (TypeError, ValueError):
+                        order = int(harmonic['order'])
+                        amplitude = float(harmonic['amplitude'])
+                        phase = float(harmonic.get('phase', 0))
+                    except (KeyError, TypeError, ValueError):
                         continue
+                    if order >= 3 and amplitude > 0:
+                        channels[channel].append({'order': order, 'amplitude': amplitude, 'phase': phase})
+            if not channels['a'] and not channels['b']:
+                continue
+            command_queue.put({
+                'synth_id': synth_id,
+                'command': 'set_harmonics_multi',
+                'channel': None,
+                'source': 'calibration',
+                'value': channels
+            })
+            queued += 1
         return queued
 
-    def default_settings_payload():
-        return {
-            'maxVoltage': 230,
-            'maxCurrent': 5,
-            'chartRefreshRate': 100,
-            'precisionDigits': 2,
-            'autoSaveSettings': True,
-            'debugMode': False,
-            'synthAutoOn': [False, False, False],
-            'harmonicCalibration': {
-                'enabled': False,
-                'mode': 'linear',
-                'linearA': 0.0,
-                'perHarmonic': {}
-            }
-        }
+    def on_settings_changed(settings, changed_keys):
+        """Settings service subscriber: apply side effects and push the new settings to clients."""
+        if 'harmonicCalibration' in changed_keys:
+            queued = queue_harmonic_reapply_commands()
+            if queued > 0:
+                app.logger.info(
+                    f"Queued harmonic updates for {queued} synth(s) to apply calibration immediately."
+                )
+
+        # Update synth state manager with the auto_on settings
+        if hasattr(state_manager, 'synths') and isinstance(settings.get('synthAutoOn'), list):
+            for i, auto_on in enumerate(settings['synthAutoOn']):
+                if i < len(state_manager.synths):
+                    state_manager.set_value(i, 'auto_on', auto_on)
 
-    def normalize_harmonic_calibration(raw_cfg):
-        normalized = {
-            'enabled': False,
-            'mode': 'linear',
-            'linearA': 0.0,
-            'perHarmonic': {}
-        }
-
-        if not isinstance(raw_cfg, dict):
-            return normalized
-
-        normalized['enabled'] = bool(raw_cfg.get('enabled', False))
-        mode = str(raw_cfg.get('mode', 'linear'))
-        normalized['mode'] = mode if mode in ['linear', 'per_harmonic'] else 'linear'
         try:
-            normalized['linearA'] = float(raw_cfg.get('linearA', 0.0))
-        except (TypeError, ValueError):
-            normalized['linearA'] = 0.0
-
-        per_harmonic = raw_cfg.get('perHarmonic', {})
-        if isinstance(per_harmonic, dict):
-            cleaned = {}
-            for key, value in per_harmonic.items():
-                try:
-                    harmonic_order = int(key)
-                    phase_correction = float(value)
-                    cleaned[str(harmonic_order)] = phase_correction
-                except (TypeError, ValueError):
-                    continue
-            normalized['perHarmonic'] = cleaned
+            socketio.emit('settingsUpdated', {'settings': settings})
+            SOCKET_EMITS.inc(event='settingsUpdated')
+        except Exception:
+            pass
 
-        return normalized
+    SETTINGS.subscribe(on_settings_changed)
 
     @app.route('/api/synths', methods=['GET'])
     def get_synths():
@@ -102,14 +112,33 @@ def create_app(command_queue, state_manager):
         except Exception as e:
             return jsonify({'error': str(e)}), 500
 
-    def queue_command(command_dict):
+    def queue_command(command_dict, source='rest'):
         command_dict['timestamp'] = datetime.datetime.now().isoformat()
-        command_queue.put(command_dict)
-        return {'status': 'queued', 'command': command_dict}
+        command_dict.setdefault('source', source)
+        try:
+            command_queue.put(command_dict)
+        except queue.Full:
+            # Control loop is behind; refuse rather than block the web worker
+            return {'status': 'rejected', 'error': 'Command queue full', 'command': command_dict}
+        result = {'status': 'queued', 'command': command_dict}
+        warnings = command_warnings([command_dict])
+        if warnings:
+            result['warnings'] = warnings
+        return result
+
+    def command_warnings(commands):
+        # Clipping is a warning, not a refusal: the firmware clamps, and some rigs want it
+        if not any(cmd.get('command') in dds_analysis.WAVEFORM_COMMANDS for cmd in commands):
+            return []
+        # Version first: a state that moves on meanwhile only misses the cache next time
+        version = getattr(state_manager, 'version', None)
+        return dds_analysis.clip_warnings(getattr(state_manager, 'synths', []), commands, version=version)
 
     @app.route('/api/synths/<int:synth_id>/command', methods=['POST'])
     def send_command(synth_id):
         data = request.json
+        if data.get('command') not in PUBLIC_SETTERS:
+            return jsonify({'error': f"Unsupported command {data.get('command')!r}"}), 400
         value = data.get('value')
         try:
             value = float(value)
@@ -212,7 +241,144 @@ def create_app(command_queue, state_manager):
             'value': value
         }
         return jsonify(queue_command(command))
-    
+
+    @app.route('/api/synths/<int:synth_id>/model', methods=['GET'])
+    def get_synth_model(synth_id):
+        """
+        One sync cycle of the DAC codes the firmware plays for the synth's current
+        settings (utils.dds_model), with the frequency error and clipping per channel.
+        """
+        synths = getattr(state_manager, 'synths', [])
+        if not 0 <= synth_id < len(synths):
+            return jsonify({'error': f'Unknown synth {synth_id}'}), 404
+        try:
+            return jsonify(dds_model.model_to_json(dds_model.model_synth(synths[synth_id])))
+        except dds_model.ModelUnavailable as e:
+            return jsonify({'error': f'Output model unavailable: {e}'}), 503
+
+    @app.route('/api/synths/<int:synth_id>/analysis', methods=['GET'])
+    def get_synth_analysis(synth_id):
+        """
+        Spectrum of the modelled DAC output over one sync cycle: per-order magnitude
+        (fraction of full scale), phase and percent of the fundamental, plus THD,
+        THD+N, RMS, peak and crest factor per channel. Query: orders=<n> (default 50).
+        """
+        synths = getattr(state_manager, 'synths', [])
+        if not 0 <= synth_id < len(synths):
+            return jsonify({'error': f'Unknown synth {synth_id}'}), 404
+        try:
+            orders = max(1, min(dds_analysis.MAX_ORDERS, int(request.args.get('orders', dds_analysis.DEFAULT_ORDERS))))
+        except ValueError:
+            return jsonify({'error': 'Invalid orders'}), 400
+        try:
+            return jsonify(dds_analysis.analysis_to_json(dds_analysis.analyse_synth(synths[synth_id]), orders))
+        except dds_model.ModelUnavailable as e:
+            return jsonify({'error': f'Output model unavailable: {e}'}), 503
+
+    @app.route('/api/batch', methods=['POST'])
+    def batch_commands():
+        """
+        Apply an ordered list of commands across synths as one unit.
+
+        Body: {"commands": [{"synth_id", "command", "channel", "value"}, ...],
+               "wait": true, "timeout": 5.0}
+        Every command is validated before any is queued. The control loop applies
+        each synth's commands as one transaction; the response lists a result per
+        command plus apply_s (control loop time) and total_s (request time).
+        """
+        started = time.perf_counter()
+        data = request.get_json(silent=True)
+        entries = data.get('commands') if isinstance(data, dict) else None
+        if not isinstance(entries, list) or not entries:
+            return jsonify({'error': 'commands must be a non-empty list'}), 400
+        if len(entries) > MAX_BATCH_COMMANDS:
+            return jsonify({'error': f'At most {MAX_BATCH_COMMANDS} commands per batch'}), 400
+        try:
+            timeout = min(30.0, max(0.1, float(data.get('timeout', 5.0))))
+        except (TypeError, ValueError):
+            return jsonify({'error': 'Invalid timeout'}), 400
+
+        commands, errors = validate_batch(entries, len(getattr(state_manager, 'synths', [])))
+        if errors:
+            invalid = {e['index']: e['error'] for e in errors}
+            results = [{'index': i, 'status': 'invalid', 'error': invalid[i]} if i in invalid
+                       else {'index': i, 'status': 'not_queued'} for i in range(len(entries))]
+            return jsonify({'status': 'invalid', 'error': f'{len(errors)} invalid command(s), nothing queued',
+                            'results': results}), 400
+
+        warnings = command_warnings(commands)
+        wait = data.get('wait', True) is not False and batch_results is not None
+        batch_id = batch_results.register() if wait else None
+        queued = queue_command({'synth_id': None, 'command': 'batch', 'channel': None, 'value': commands,
+                                'batch_id': batch_id})
+        if queued['status'] != 'queued':
+            if wait:
+                batch_results.discard(batch_id)
+            return jsonify({'status': 'rejected', 'error': queued.get('error')}), 503
+        if not wait:
+            return jsonify({'status': 'queued', 'count': len(commands), 'warnings': warnings,
+                            'total_s': round(time.perf_counter() - started, 6)}), 202
+
+        applied = batch_results.wait(batch_id, timeout)
+        total_s = round(time.perf_counter() - started, 6)
+        if applied is None:
+            return jsonify({'status': 'pending', 'batch_id': batch_id, 'total_s': total_s, 'warnings': warnings,
+                            'error': 'Control loop did not apply the batch in time; it is still queued'}), 504
+        ok = sum(1 for r in applied['results'] if r['status'] == 'applied')
+        status = 'applied' if ok == len(commands) else ('partial' if ok else 'failed')
+        return jsonify({'status': status, 'batch_id': batch_id, 'results': applied['results'],
+                        'warnings': warnings, 'apply_s': applied['apply_s'], 'total_s': total_s})
+
+    @app.route('/api/rig/apply', methods=['POST'])
+    def rig_apply():
+        """
+        Change frequency/phase on several synths at the same sync edge.
+
+        Body: {"changes": [{"synth_id", "channel", "frequency", "phase"}, ...],
+               "wait": true, "timeout": 5.0}
+        Every synth stages its changes and applies them as one commit version; the
+        response lists each synth's status, the version and whether the change was
+        coherent (every synth confirmed the commit at the shared edge).
+        """
+        started = time.perf_counter()
+        data = request.get_json(silent=True)
+        entries = data.get('changes') if isinstance(data, dict) else None
+        if not isinstance(entries, list) or not entries:
+            return jsonify({'error': 'changes must be a non-empty list'}), 400
+        if len(entries) > MAX_RIG_CHANGES:
+            return jsonify({'error': f'At most {MAX_RIG_CHANGES} changes per request'}), 400
+        try:
+            timeout = min(30.0, max(0.1, float(data.get('timeout', 5.0))))
+        except (TypeError, ValueError):
+            return jsonify({'error': 'Invalid timeout'}), 400
+
+        changes, errors = validate_rig_change(entries, len(getattr(state_manager, 'synths', [])))
+        if errors:
+            return jsonify({'status': 'invalid', 'error': f'{len(errors)} invalid change(s), nothing queued',
+                            'errors': errors}), 400
+
+        wait = data.get('wait', True) is not False and batch_results is not None
+        batch_id = batch_results.register() if wait else None
+        queued = queue_command({'synth_id': None, 'command': 'rig_apply', 'channel': None, 'value': changes,
+                                'batch_id': batch_id})
+        if queued['status'] != 'queued':
+            if wait:
+                batch_results.discard(batch_id)
+            return jsonify({'status': 'rejected', 'error': queued.get('error')}), 503
+        if not wait:
+            return jsonify({'status': 'queued', 'count': len(changes),
+                            'total_s': round(time.perf_counter() - started, 6)}), 202
+
+        applied = batch_results.wait(batch_id, timeout)
+        total_s = round(time.perf_counter() - started, 6)
+        if applied is None:
+            return jsonify({'status': 'pending', 'total_s': total_s,
+                            'error': 'Control loop did not apply the change in time; it is still queued'}), 504
+        ok = sum(1 for r in applied['synths'] if r['status'] in ('synced', 'forced', 'direct'))
+        status = 'applied' if ok == len(applied['synths']) else ('partial' if ok else 'failed')
+        return jsonify({'status': status, 'version': applied['version'], 'coherent': applied['coherent'],
+                        'synths': applied['synths'], 'apply_s': applied['apply_s'], 'total_s': total_s})
+
     @app.route('/api/defaults', methods=['GET'])
     def get_defaults():
         try:
@@ -229,7 +395,7 @@ def create_app(command_queue, state_manager):
             return jsonify({'error': 'Defaults must be a list'}), 400
         try:
             state_manager.defaults = defaults
-            state_manager.save_state()  # Save the new defaults to file
+            state_manager.mark_defaults_changed()  # Persisted by the write-behind writer
             return jsonify({'status': 'Defaults updated'})
         except Exception as e:
             return jsonify({'error': str(e)}), 500
@@ -238,24 +404,12 @@ def create_app(command_queue, state_manager):
     @app.route('/api/settings', methods=['GET'])
     def get_settings():
         try:
-            settings_file = os.path.join(os.path.dirname(__file__), '..', 'config', 'settings.json')
-            defaults = default_settings_payload()
-            if os.path.exists(settings_file):
-                with open(settings_file, 'r') as f:
-                    settings = json.load(f)
-                settings = {**defaults, **settings}
-                settings['harmonicCalibration'] = normalize_harmonic_calibration(settings.get('harmonicCalibration', {}))
-                
-                # Sync synthAutoOn with current synth state if available
-                if hasattr(state_manager, 'synths') and len(state_manager.synths) >= 3:
-                    settings['synthAutoOn'] = [
-                        synth.get('auto_on', False) for synth in state_manager.synths[:3]
-                    ]
-            else:
-                settings = defaults
-                # Save default settings
-                with open(settings_file, 'w') as f:
-                    json.dump(settings, f, indent=2)
+            settings = SETTINGS.get()
+            # synthAutoOn mirrors the synth state: one entry per synth in the rig
+            if hasattr(state_manager, 'synths') and state_manager.synths:
+                settings['synthAutoOn'] = [
+                    synth.get('auto_on', False) for synth in state_manager.synths
+                ]
             return jsonify(settings)
         except Exception as e:
             return jsonify({'error': str(e)}), 500
@@ -263,23 +417,8 @@ def create_app(command_queue, state_manager):
     @app.route('/api/settings', methods=['POST'])
     def save_settings():
         try:
-            settings_file = os.path.join(os.path.dirname(__file__), '..', 'config', 'settings.json')
-            previous_harmonic_calibration = None
-            if os.path.exists(settings_file):
-                try:
-                    with open(settings_file, 'r') as f:
-                        previous_settings = json.load(f)
-                    previous_harmonic_calibration = normalize_harmonic_calibration(
-                        previous_settings.get('harmonicCalibration', {})
-                    )
-                except Exception:
-                    previous_harmonic_calibration = None
-
             settings = request.json
             
-            # Ensure the directory exists
-            os.makedirs(os.path.dirname(settings_file), exist_ok=True)
-            
             # Validate settings
             if not isinstance(settings.get('maxVoltage'), (int, float)) or settings['maxVoltage'] <= 0:
                 return jsonify({'error': 'Invalid maxVoltage'}), 400
@@ -293,7 +432,7 @@ def create_app(command_queue, state_manager):
                 return jsonify({'error': 'Invalid autoSaveSettings'}), 400
             if not isinstance(settings.get('debugMode'), bool):
                 return jsonify({'error': 'Invalid debugMode'}), 400
-            if not isinstance(settings.get('synthAutoOn'), list) or len(settings['synthAutoOn']) != 3:
+            if not isinstance(settings.get('synthAutoOn'), list):
                 return jsonify({'error': 'Invalid synthAutoOn'}), 400
             if not all(isinstance(x, bool) for x in settings['synthAutoOn']):
                 return jsonify({'error': 'Invalid synthAutoOn values'}), 400
@@ -318,37 +457,9 @@ def create_app(command_queue, state_manager):
                 except (TypeError, ValueError):
                     return jsonify({'error': f'Invalid per-harmonic correction for order {order}'}), 400
 
-            settings['harmonicCalibration'] = normalize_harmonic_calibration(harmonic_cal)
-            
-            # Add timestamp
-            settings['lastSaved'] = datetime.datetime.now().isoformat()
-            
-            # Save to file
-            with open(settings_file, 'w') as f:
-                json.dump(settings, f, indent=2)
-
-            current_harmonic_calibration = normalize_harmonic_calibration(
-                settings.get('harmonicCalibration', {})
-            )
-
-            if previous_harmonic_calibration != current_harmonic_calibration:
-                queued = queue_harmonic_reapply_commands()
-                if queued > 0:
-                    app.logger.info(
-                        f"Queued {queued} harmonic command(s) to apply calibration immediately."
-                    )
-            
-            # Update synth state manager with new auto_on settings
-            if hasattr(state_manager, 'synths') and settings.get('synthAutoOn'):
-                for i, auto_on in enumerate(settings['synthAutoOn']):
-                    if i < len(state_manager.synths):
-                        state_manager.synths[i]['auto_on'] = auto_on
-                state_manager.save_state()  # Save updated synth state
-
-            try:
-                socketio.emit('settingsUpdated', {'settings': settings})
-            except Exception:
-                pass
+            # Stored in memory, persisted write-behind; subscribers reapply calibration,
+            # sync auto_on and emit settingsUpdated.
+            settings = SETTINGS.replace(settings)
             
             return jsonify({'status': 'Settings saved', 'settings': settings})
         except Exception as e:
@@ -357,22 +468,7 @@ def create_app(command_queue, state_manager):
     @app.route('/api/settings/reset', methods=['POST'])
     def reset_settings():
         try:
-            settings = default_settings_payload()
-            settings['lastSaved'] = datetime.datetime.now().isoformat()
-            
-            settings_file = os.path.join(os.path.dirname(__file__), '..', 'config', 'settings.json')
-            
-            # Ensure the directory exists
-            os.makedirs(os.path.dirname(settings_file), exist_ok=True)
-            
-            with open(settings_file, 'w') as f:
-                json.dump(settings, f, indent=2)
-
-            try:
-                socketio.emit('settingsUpdated', {'settings': settings})
-            except Exception:
-                pass
-            
+            settings = SETTINGS.reset()
             return jsonify({'status': 'Settings reset', 'settings': settings})
         except Exception as e:
             return jsonify({'error': str(e)}), 500
@@ -380,46 +476,10 @@ def create_app(command_queue, state_manager):
     @app.route('/api/settings/reset-harmonic-calibration', methods=['POST'])
     def reset_harmonic_calibration_settings():
         try:
-            settings_file = os.path.join(os.path.dirname(__file__), '..', 'config', 'settings.json')
-            defaults = default_settings_payload()
-
-            # Load existing settings so we only change harmonicCalibration.
-            if os.path.exists(settings_file):
-                with open(settings_file, 'r') as f:
-                    settings = json.load(f)
-            else:
-                settings = defaults
-
-            settings = {**defaults, **settings}
-            previous_harmonic_calibration = normalize_harmonic_calibration(
-                settings.get('harmonicCalibration', {})
-            )
-
-            settings['harmonicCalibration'] = normalize_harmonic_calibration(
-                defaults.get('harmonicCalibration', {})
-            )
-            settings['lastSaved'] = datetime.datetime.now().isoformat()
-
-            os.makedirs(os.path.dirname(settings_file), exist_ok=True)
-            with open(settings_file, 'w') as f:
-                json.dump(settings, f, indent=2)
-
-            current_harmonic_calibration = normalize_harmonic_calibration(
-                settings.get('harmonicCalibration', {})
-            )
-
-            if previous_harmonic_calibration != current_harmonic_calibration:
-                queued = queue_harmonic_reapply_commands()
-                if queued > 0:
-                    app.logger.info(
-                        f"Queued {queued} harmonic command(s) after calibration reset."
-                    )
-
-            try:
-                socketio.emit('settingsUpdated', {'settings': settings})
-            except Exception:
-                pass
-
+            # Only harmonicCalibration changes; the subscriber reapplies active harmonics.
+            settings = SETTINGS.update({
+                'harmonicCalibration': default_settings()['harmonicCalibration']
+            })
             return jsonify({
                 'status': 'Harmonic calibration reset',
                 'settings': settings
@@ -446,12 +506,72 @@ def create_app(command_queue, state_manager):
             # Emit status over socket for listeners
             try:
                 socketio.emit('serviceStatus', status)
+                SOCKET_EMITS.inc(event='serviceStatus')
             except Exception:
                 pass
             return jsonify(status)
         except Exception as e:
             return jsonify({'error': str(e)}), 500
 
+    @app.route('/api/metrics', methods=['GET'])
+    def get_metrics():
+        try:
+            # Split host: serial/encoder/main-loop metrics live in the control process;
+            # ?process=web returns this process's own (socket emits, codec samples).
+            status = control_status() if control_status and request.args.get('process') != 'web' else None
+            if request.args.get('format') == 'json':
+                return jsonify(status['metrics'] if status else REGISTRY.snapshot())
+            text = status['metrics_text'] if status else REGISTRY.render_text()
+            return Response(text, content_type='text/plain; version=0.0.4; charset=utf-8')
+        except Exception as e:
+            return jsonify({'error': str(e)}), 500
+
+    @app.route('/api/startup', methods=['GET'])
+    def get_startup_report():
+        try:
+            status = control_status() if control_status else None
+            return jsonify(status['startup'] if status else STARTUP_REPORT.snapshot())
+        except Exception as e:
+            return jsonify({'error': str(e)}), 500
+
+    @app.route('/api/history', methods=['GET'])
+    def get_history():
+        """
+        Amplitude/frequency/phase time series for trend views.
+
+        Query: synth=<id> (default all), key=<key>[,<key>...] (default all tracked keys),
+        start/end=<unix seconds> or window=<seconds before end>, resolution=auto|raw|1s|1m,
+        max_points=<n> per series (default 500). Every series is returned as columns
+        t/mean/min/max; raw samples have mean = min = max.
+        """
+        store = history() if history else None
+        if store is None:
+            return jsonify({'error': 'History is not available yet'}), 503
+        args = request.args
+        try:
+            synth_ids = [int(args['synth'])] if 'synth' in args else list(range(store.num_synths))
+            keys = args['key'].split(',') if 'key' in args else list(TRACKED_KEYS)
+            end = float(args['end']) if 'end' in args else time.time()
+            start = float(args['start']) if 'start' in args else (
+                end - float(args['window']) if 'window' in args else None)
+            max_points = max(10, min(5000, int(args.get('max_points', 500))))
+        except ValueError:
+            return jsonify({'error': 'Invalid synth, start, end, window or max_points'}), 400
+        resolution = args.get('resolution', 'auto')
+        if resolution != 'auto' and resolution not in RESOLUTIONS:
+            return jsonify({'error': f"resolution must be auto or one of {', '.join(RESOLUTIONS)}"}), 400
+        unknown = [k for k in keys if k not in TRACKED_KEYS] + [i for i in synth_ids
+                                                                if not 0 <= i < store.num_synths]
+        if unknown:
+            return jsonify({'error': f'No history for {unknown}'}), 404
+
+        series = []
+        for synth_id in synth_ids:
+            for key in keys:
+                series.append(dict(store.query(synth_id, key, start, end, resolution, max_points),
+                                   synth_id=synth_id, key=key))
+        return jsonify({'start': start, 'end': end, 'retention': store.retention(), 'series': series})
+
     @app.route('/api/logs', methods=['GET'])
     def get_logs():
         try:
@@ -460,23 +580,8 @@ def create_app(command_queue, state_manager):
                 lines = max(10, min(2000, int(lines_param)))
             except ValueError:
                 lines = 200
-            log_file = os.path.expanduser('~/NHP_Synth/synth_autostart.log')
-            raw_lines = []
-            if os.path.exists(log_file):
-                with open(log_file, 'rb') as f:
-                    f.seek(0, os.SEEK_END)
-                    size = f.tell()
-                    block = 4096
-                    data = b''
-                    while size > 0 and data.count(b'\n') <= lines * 3:
-                        read_size = min(block, size)
-                        size -= read_size
-                        f.seek(size)
-                        data = f.read(read_size) + data
-                    raw_lines = data.decode('utf-8', errors='replace').splitlines()
-
             # Temporarily show all log lines without filtering HTTP access logs
-            content = raw_lines[-lines:]
+            content = log_tailer.tail(lines)
             return jsonify({'lines': content})
         except Exception as e:
             return jsonify({'error': str(e)}), 500
@@ -522,28 +627,147 @@ def create_app(command_queue, state_manager):
     def home():
         return send_file(os.path.join(os.path.dirname(__file__), 'home.html'))
 
-    # Background task to emit synth state on change
+    # Synth state is broadcast as versioned JSON-patch style deltas driven by
+    # SynthStateManager change notifications. `broadcast_version` is the version
+    # the last broadcast brought clients to; full snapshots carry it too so the
+    # next delta's `base` lines up for every client.
+    broadcast_lock = threading.Lock()
+    broadcast_state = {'version': state_manager.version}
+    min_broadcast_interval = 0.02  # coalesce bursts (encoder spins) into one delta
+
+    def synth_state_payload():
+        with broadcast_lock:
+            version = broadcast_state['version']
+        payload = {'version': version, 'synths': copy.deepcopy(getattr(state_manager, 'synths', []))}
+        selection_mode = getattr(state_manager, 'selection_mode', None)
+        if selection_mode is not None:
+            payload['selectionMode'] = copy.deepcopy(selection_mode)
+        return payload
+
+    # Per-client payload encoding. Clients start on JSON and may negotiate
+    # MessagePack ('setEncoding'); synth state broadcasts go to one room per
+    # encoding so each payload is encoded once, not once per client.
+    JSON_ROOM = 'state-json'
+    MSGPACK_ROOM = 'state-msgpack'
+    CODEC_SAMPLE_EVERY = 10
+    client_encodings = {}
+    clients_lock = threading.Lock()
+    codec_samples = {'count': 0}
+
+    def msgpack_client_count():
+        with clients_lock:
+            return sum(1 for enc in client_encodings.values() if enc == 'msgpack')
+
+    SOCKET_MSGPACK_CLIENTS.set_function(msgpack_client_count)
+
+    def sample_codecs(payload):
+        """Encode every Nth state payload both ways for the codec size/time metrics."""
+        codec_samples['count'] += 1
+        if codec_samples['count'] % CODEC_SAMPLE_EVERY:
+            return
+        started = time.perf_counter()
+        text = json.dumps(payload, separators=(',', ':'))
+        CODEC_ENCODE_TIME.observe(time.perf_counter() - started, encoding='json')
+        CODEC_SAMPLE_BYTES.inc(len(text.encode('utf-8')), encoding='json')
+        started = time.perf_counter()
+        packed = encode_message(payload)
+        CODEC_ENCODE_TIME.observe(time.perf_counter() - started, encoding='msgpack')
+        CODEC_SAMPLE_BYTES.inc(len(packed), encoding='msgpack')
+
+    def broadcast_state_event(event, payload):
+        sample_codecs(payload)
+        socketio.emit(event, payload, to=JSON_ROOM)
+        if msgpack_client_count():
+            socketio.emit(event, encode_message(payload), to=MSGPACK_ROOM)
+        SOCKET_EMITS.inc(event=event)
+
+    def emit_state_to_client(event, payload):
+        with clients_lock:
+            encoding = client_encodings.get(request.sid, 'json')
+        emit(event, encode_message(payload) if encoding == 'msgpack' else payload)
+        SOCKET_EMITS.inc(event=event)
+
+    # Backpressure: broadcasts are queued per client by Engine.IO, so a client on a
+    # slow link would otherwise buffer every delta in server memory. Such a client
+    # leaves its broadcast room while its queue drains and then resyncs from a snapshot.
+    paused_clients = set()
+
+    def pending_packets(sid):
+        """Packets queued for a client but not yet written to its transport (0 if unknown)."""
+        try:
+            eio_sid = socketio.server.manager.eio_sid_from_sid(sid, '/')
+            return socketio.server.eio.sockets[eio_sid].queue.qsize()
+        except (AttributeError, KeyError, TypeError, NotImplementedError):
+            return 0
+
+    def apply_backpressure():
+        with clients_lock:
+            clients = list(client_encodings.items())
+        for sid, encoding in clients:
+            room = MSGPACK_ROOM if encoding == 'msgpack' else JSON_ROOM
+            pending = pending_packets(sid)
+            if sid not in paused_clients and pending > MAX_PENDING_PACKETS:
+                socketio.server.leave_room(sid, room, namespace='/')
+                paused_clients.add(sid)
+                SOCKET_BACKPRESSURE.inc(action='paused')
+            elif sid in paused_clients and pending == 0:
+                paused_clients.discard(sid)
+                socketio.server.enter_room(sid, room, namespace='/')
+                payload = synth_state_payload()
+                socketio.emit('synthState', encode_message(payload) if encoding == 'msgpack' else payload, to=sid)
+                SOCKET_EMITS.inc(event='synthState')
+                SOCKET_BACKPRESSURE.inc(action='resumed')
+
+    def build_delta_ops(paths):
+        """Turn changed paths into replace ops, or None when a full snapshot is cheaper."""
+        synths = state_manager.synths
+        if ('synths',) in paths or len(paths) > 4 * max(1, len(synths)):
+            return None
+        ops = []
+        for path in paths:
+            if path == ('selectionMode',):
+                ops.append({'op': 'replace', 'path': '/selectionMode',
+                            'value': copy.deepcopy(state_manager.selection_mode)})
+            elif path[0] == 'synths':
+                if path[1] >= len(synths):
+                    return None
+                ops.append({'op': 'replace', 'path': f'/synths/{path[1]}', 'value': copy.deepcopy(synths[path[1]])})
+            else:
+                synth_id, key = path
+                if synth_id >= len(synths) or key not in synths[synth_id]:
+                    return None
+                ops.append({'op': 'replace', 'path': f'/synths/{synth_id}/{key}',
+                            'value': copy.deepcopy(synths[synth_id][key])})
+        return ops
+
     def emit_synth_state():
-        last_state = None
-        last_selection_mode = None
+        last_emit = 0.0
         while True:
             try:
-                current_state = copy.deepcopy(getattr(state_manager, 'synths', []))
-                selection_mode = getattr(state_manager, 'selection_mode', None)
-                emit_payload = {'synths': current_state}
-                if selection_mode is not None:
-                    emit_payload['selectionMode'] = selection_mode
-                state_changed = last_state is None or json.dumps(current_state, sort_keys=True) != json.dumps(last_state, sort_keys=True)
-                selection_mode_changed = last_selection_mode is None or json.dumps(selection_mode, sort_keys=True) != json.dumps(last_selection_mode, sort_keys=True)
-                if state_changed or selection_mode_changed:
-                    socketio.emit('synthState', emit_payload)
-                    last_state = current_state
-                    last_selection_mode = copy.deepcopy(selection_mode)
+                wait = min_broadcast_interval - (time.monotonic() - last_emit)
+                if wait > 0:
+                    time.sleep(wait)
+                with broadcast_lock:
+                    base = broadcast_state['version']
+                version, paths = state_manager.wait_for_changes(base, timeout=5.0)
+                if version == base or not paths:
+                    continue
+                ops = build_delta_ops(paths)
+                # Resumed clients get a snapshot at `base`, so this delta still applies to them
+                apply_backpressure()
+                with broadcast_lock:
+                    broadcast_state['version'] = version
+                if ops is None:
+                    broadcast_state_event('synthState', synth_state_payload())
+                else:
+                    broadcast_state_event('synthStateDelta', {'base': base, 'version': version, 'ops': ops})
+                last_emit = time.monotonic()
             except Exception:
-                pass
-            time.sleep(0.1)
+                # A concurrent list mutation can break a deepcopy; resync everyone.
+                state_manager.mark_changed()
+                time.sleep(0.1)
 
-    threading.Thread(target=emit_synth_state, daemon=True).start()
+    socketio.start_background_task(emit_synth_state)
 
     # Background task: emit service status periodically (reduce API polling need)
     def emit_service_status_loop():
@@ -565,55 +789,70 @@ def create_app(command_queue, state_manager):
                             status['running'] = False
                 if status != last_status:
                     socketio.emit('serviceStatus', status)
+                    SOCKET_EMITS.inc(event='serviceStatus')
                     last_status = status
             except Exception:
                 pass
             time.sleep(1.0)
 
-    threading.Thread(target=emit_service_status_loop, daemon=True).start()
+    socketio.start_background_task(emit_service_status_loop)
 
-    # Background task: stream logs to clients (tail synth_autostart.log)
-    def stream_logs_loop():
-        log_path = os.path.expanduser('~/NHP_Synth/synth_autostart.log')
-        pos = 0
-        last_inode = None
-        while True:
-            try:
-                if not os.path.exists(log_path):
-                    time.sleep(1.0)
-                    continue
-                # Detect rotation/truncation: inode or size decreased
-                st = os.stat(log_path)
-                if last_inode is None:
-                    last_inode = st.st_ino
-                elif st.st_ino != last_inode or st.st_size < pos:
-                    # File rotated/recreated or truncated; reset position
-                    last_inode = st.st_ino
-                    pos = 0
-
-                with open(log_path, 'r', encoding='utf-8', errors='replace') as f:
-                    f.seek(pos)
-                    new_lines = f.readlines()
-                    pos = f.tell()
-                # Temporarily emit all new lines (including HTTP access logs)
-                if new_lines:
-                    socketio.emit('serviceLogs', {'lines': [ln.rstrip('\n') for ln in new_lines]})
-            except Exception:
-                pass
-            time.sleep(0.5)
+    # Stream new service log lines to clients as the tailer picks them up
+    def emit_service_logs(lines):
+        # Temporarily emit all new lines (including HTTP access logs)
+        socketio.emit('serviceLogs', {'lines': lines})
+        SOCKET_EMITS.inc(event='serviceLogs')
 
-    threading.Thread(target=stream_logs_loop, daemon=True).start()
+    log_tailer = LogTailer(SERVICE_LOG)
+    log_tailer.subscribe(emit_service_logs)
+    log_tailer.start()
+
+    # Handle socket connection to emit initial synth state (to the new client only)
+    SOCKET_CLIENTS.set_function(lambda: len(client_encodings))
 
-    # Handle socket connection to emit initial synth state
     @socketio.on('connect')
     def handle_connect():
+        with clients_lock:
+            if max_clients is not None and len(client_encodings) >= max_clients:
+                SOCKET_CLIENTS_REFUSED.inc()
+                raise ConnectionRefusedError('Dashboard client limit reached')
+            client_encodings[request.sid] = 'json'
+        join_room(JSON_ROOM)
+        try:
+            emit_state_to_client('synthState', synth_state_payload())
+        except Exception:
+            pass
+
+    @socketio.on('disconnect')
+    def handle_disconnect():
+        with clients_lock:
+            client_encodings.pop(request.sid, None)
+        paused_clients.discard(request.sid)
+
+    # Opt-in binary payloads: {'encoding': 'msgpack', 'schema': SCHEMA_VERSION}.
+    # A schema mismatch (stale cached app.js) keeps the client on JSON.
+    @socketio.on('setEncoding')
+    def handle_set_encoding(data=None):
+        data = data if isinstance(data, dict) else {}
+        use_msgpack = data.get('encoding') == 'msgpack' and data.get('schema') == SCHEMA_VERSION
+        encoding = 'msgpack' if use_msgpack else 'json'
+        with clients_lock:
+            client_encodings[request.sid] = encoding
+        paused_clients.discard(request.sid)
+        join_room(MSGPACK_ROOM if use_msgpack else JSON_ROOM)
+        leave_room(JSON_ROOM if use_msgpack else MSGPACK_ROOM)
+        emit('encoding', {'encoding': encoding, 'schema': SCHEMA_VERSION})
+        SOCKET_EMITS.inc(event='encoding')
+        try:
+            emit_state_to_client('synthState', synth_state_payload())
+        except Exception:
+            pass
+
+    # Clients that miss a delta (version gap) ask for a fresh snapshot
+    @socketio.on('requestSynthState')
+    def handle_request_synth_state(data=None):
         try:
-            current_state = copy.deepcopy(getattr(state_manager, 'synths', []))
-            selection_mode = getattr(state_manager, 'selection_mode', None)
-            emit_payload = {'synths': current_state}
-            if selection_mode is not None:
-                emit_payload['selectionMode'] = selection_mode
-            socketio.emit('synthState', emit_payload)
+            emit_state_to_client('synthState', synth_state_payload())
         except Exception:
             pass
 
@@ -621,10 +860,24 @@ def create_app(command_queue, state_manager):
     @socketio.on('command')
     def handle_command_ws(data):
         # Expecting data dict with keys: synth_id, command, channel, value
+        # (MessagePack-encoded bytes from clients that negotiated binary payloads)
+        if isinstance(data, (bytes, bytearray)):
+            try:
+                data = decode_message(data)
+            except (ValueError, TypeError, UnicodeDecodeError):
+                data = None
+        if not isinstance(data, dict):
+            emit('command_response', {'error': 'Invalid command payload'})
+            SOCKET_EMITS.inc(event='command_response')
+            return
         synth_id = data.get('synth_id')
         command_name = data.get('command')
         channel = data.get('channel')
         value = data.get('value')
+        if command_name not in PUBLIC_SETTERS:
+            emit('command_response', {'error': f'Unsupported command {command_name!r}'})
+            SOCKET_EMITS.inc(event='command_response')
+            return
         try:
             if isinstance(value, dict) and 'id' in value and 'order' in value and 'amplitude' in value:
                 value = {
@@ -637,6 +890,7 @@ def create_app(command_queue, state_manager):
                 value = float(value)
         except (TypeError, ValueError):
             emit('command_response', {'error': 'Invalid value'})
+            SOCKET_EMITS.inc(event='command_response')
             return
         command = {
             'synth_id': synth_id,
@@ -644,7 +898,8 @@ def create_app(command_queue, state_manager):
             'channel': channel,
             'value': value
         }
-        result = queue_command(command)
+        result = queue_command(command, source='socket')
         emit('command_response', result)
+        SOCKET_EMITS.inc(event='command_response')
 
     return app, socketio
\ No newline at end of file
@@ -10,26 +10,29 @@ LOG_FILE="$HOME/NHP_Synth/synth_autostart.log"
 PID_FILE="$HOME/NHP_Synth/synth.pid"
 PY_PID_FILE="$HOME/NHP_Synth/synth_python.pid"
 
-# Log trimming settings (keep latest 10,000 lines, drop oldest)
-MAX_LOG_LINES=1000
-
-trim_log_lines() {
-    # Ensure log file exists
-    [ -f "$LOG_FILE" ] || : > "$LOG_FILE"
-    local line_count
-    line_count=$(wc -l < "$LOG_FILE" 2>/dev/null | tr -d ' ')
-    if [ -n "$line_count" ] && [ "$line_count" -gt "$MAX_LOG_LINES" ]; then
-        # Keep only the last MAX_LOG_LINES lines
-        local tmpfile
-        tmpfile=$(mktemp)
-        tail -n "$MAX_LOG_LINES" "$LOG_FILE" > "$tmpfile" && mv "$tmpfile" "$LOG_FILE"
+# Log rotation settings: when the log passes MAX_LOG_BYTES it is renamed to
+# $LOG_FILE.1 (replacing the previous one) and a fresh file is started. The size
+# is only checked every ROTATE_CHECK_EVERY messages, so appending stays cheap.
+MAX_LOG_BYTES=1048576
+ROTATE_CHECK_EVERY=100
+log_count=0
+
+rotate_log() {
+    local size
+    size=$(stat -c %s "$LOG_FILE" 2>/dev/null || echo 0)
+    if [ "$size" -gt "$MAX_LOG_BYTES" ]; then
+        mv -f "$LOG_FILE" "$LOG_FILE.1"
+        : > "$LOG_FILE"
     fi
 }
 
 # Logging function
 log_message() {
     echo "$(date '+%Y-%m-%d %H:%M:%S') - $1" | tee -a "$LOG_FILE"
-    trim_log_lines
+    log_count=$((log_count + 1))
+    if [ $((log_count % ROTATE_CHECK_EVERY)) -eq 0 ]; then
+        rotate_log
+    fi
 }
 
 # Cleanup function
@@ -75,10 +78,12 @@ fi
 # Store our PID
 echo $$ > "$PID_FILE"
 
+rotate_log
+
 log_message "Starting NHP Synth auto-restart script (PID: $$)"
 
-# Wait for system to be ready (important for boot startup)
-sleep 10
+# No fixed boot delay: the host waits for each synth to enumerate on USB
+# (NHP_DEVICE_WAIT seconds at most) and starts as soon as the last one appears.
 
 # Set up paths
 VENV_PATH="$HOME/NHP_Synth/host/.venv/bin/activate"
@@ -137,6 +142,8 @@ while [ $restart_count -lt $MAX_RESTARTS ]; do
     fi
     rm -f "$PIPE_FILE"
     PIPE_FILE=""
+    # A crashed host leaves its shared-memory state and command ring behind
+    rm -f /dev/shm/nhp_synth_"$PY_PID"_*
     
     if [ $EXIT_CODE -eq 0 ]; then
         log_message "Script exited normally (code 0). Stopping auto-restart."
@@ -0,0 +1,449 @@
+#!/usr/bin/env python3
+"""
+End-to-end load and latency benchmark for the NHP_Synth host stack
+
+Runs the real Flask-SocketIO app (web_dashboard.web_server.create_app), the
+command queue, poller and encoders against emulated synths from
+tools/synth_emulator.py, then loads it with simulated dashboard clients and
+encoder spins. Encoders and the control loop pass are set up by host/main.py's own
+start_encoder_input() and control_pass(): the input thread reads the knobs, the loop
+handles their gestures, sends the queue and advances rig changes (RIG_CHANGES).
+
+Measured per dashboard command (matched by synth/field/value):
+  emit_to_serial   client socket emit -> matching write line reaches the synth
+  emit_to_echo     client socket emit -> value visible in the client's state, kept from
+                   synthState snapshots and synthStateDelta ops
+Measured per encoder spin:
+  spin_to_serial   encoder position change -> first matching write on a synth
+                   (for the frequency encoder, the wcs line arming its rig change)
+Plus command throughput, main-loop iteration time and CPU time per thread.
+
+Results are written as JSON (--output) so runs can be compared; --baseline
+prints the change in the headline numbers against an earlier result file.
+
+    python3 tools/bench_host.py --synths 3 --clients 20 --rate 5 --duration 30 \\
+        --output bench.json --baseline previous.json
+"""
+
+import argparse
+import datetime
+import json
+import multiprocessing
+import os
+import platform
+import random
+import sys
+import tempfile
+import threading
+import time
+from collections import defaultdict, deque
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+HOST_DIR = os.path.join(TOOLS_DIR, '..', 'host')
+sys.path.insert(0, HOST_DIR)
+sys.path.insert(0, TOOLS_DIR)
+
+from synth_emulator import SynthEmulator, _percentile  # noqa: E402
+
+# command name -> (state key prefix, firmware write prefix, value generator)
+COMMANDS = {
+    'set_amplitude': ('amplitude_', 'wa', lambda: round(random.uniform(0, 100), 1)),
+    'set_frequency': ('frequency_', 'wf', lambda: round(random.uniform(45, 65), 1)),
+    'set_phase': ('phase_', 'wp', lambda: round(random.uniform(-180, 180), 1)),
+}
+# encoder function -> firmware write prefix its handler produces
+ENCODER_WRITES = {'voltage': 'waa', 'current': 'wab', 'frequency': 'wcs', 'phase': 'wp'}
+HEADLINE = ('emit_to_serial_ms', 'emit_to_echo_ms', 'spin_to_serial_ms', 'loop_iteration_ms')
+
+
+def _summary(samples_s):
+    ms = [s * 1000.0 for s in samples_s]
+    return {
+        'count': len(ms),
+        'p50': round(_percentile(ms, 50), 3),
+        'p90': round(_percentile(ms, 90), 3),
+        'p99': round(_percentile(ms, 99), 3),
+        'max': round(max(ms), 3) if ms else 0.0,
+    }
+
+
+class LatencyTracker:
+    """Joins client emits, serial writes seen by the emulator and synthState echoes."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._pending = {}                      # (synth, field, value) -> [emit_t, serial_t]
+        self._spins = defaultdict(deque)        # write prefix -> spin times
+        self.emit_to_serial = []
+        self.emit_to_echo = []
+        self.spin_to_serial = []
+        self.emitted = 0
+        self.echoed = 0
+
+    def emitted_command(self, key):
+        with self._lock:
+            self._pending[key] = [time.monotonic(), None]
+            self.emitted += 1
+
+    def spun(self, prefix):
+        with self._lock:
+            self._spins[prefix].append(time.monotonic())
+
+    def serial_line(self, synth_id, line, t):
+        if len(line) < 4 or line[0] != 'w':
+            return
+        if line[:3] in ('wsf', 'wsp'):
+            line = 'w' + line[2:]  # a dashboard write merged into a rig change, staged for its edge
+        field = {'wa': 'amplitude_', 'wf': 'frequency_', 'wp': 'phase_'}.get(line[:2])
+        try:
+            value = round(float(line[3:]), 1)
+        except ValueError:
+            value = None
+        with self._lock:
+            entry = self._pending.get((synth_id, field + line[2], value)) if field and value is not None else None
+            if entry:
+                if entry[1] is None:
+                    entry[1] = t
+                    self.emit_to_serial.append(t - entry[0])
+                return
+            for prefix in (line[:3], line[:2]):
+                spins = self._spins.get(prefix)
+                if spins:
+                    self.spin_to_serial.append(t - spins.popleft())
+                    spins.clear()  # one spin fans out to every selected synth; count the first write
+                    break
+
+    def delta_received(self, mirror, data):
+        """Apply a synthStateDelta's replace ops to a client's copy of the state, then match it."""
+        if not mirror or data.get('base') != mirror.get('version'):
+            return  # no snapshot yet, or a delta this client missed the base of
+        for op in data.get('ops', []):
+            keys = str(op.get('path', '')).split('/')[1:]
+            target = mirror
+            try:
+                for key in keys[:-1]:
+                    target = target[int(key)] if isinstance(target, list) else target[key]
+                if isinstance(target, list):
+                    target[int(keys[-1])] = op.get('value')
+                else:
+                    target[keys[-1]] = op.get('value')
+            except (IndexError, KeyError, TypeError, ValueError):
+                return  # path did not resolve; the next snapshot resyncs this client
+        mirror['version'] = data.get('version')
+        self.state_received(mirror.get('synths', []))
+
+    def state_received(self, synths):
+        now = time.monotonic()
+        with self._lock:
+            done = []
+            for key, entry in self._pending.items():
+                synth_id, field, value = key
+                if synth_id < len(synths):
+                    current = synths[synth_id].get(field)
+                    if isinstance(current, (int, float)) and abs(current - value) < 0.051:
+                        self.emit_to_echo.append(now - entry[0])
+                        done.append(key)
+            for key in done:
+                del self._pending[key]
+            self.echoed += len(done)
+
+    def expire(self, older_than_s):
+        cutoff = time.monotonic() - older_than_s
+        with self._lock:
+            stale = [k for k, v in self._pending.items() if v[0] < cutoff]
+            for key in stale:
+                del self._pending[key]
+            return len(stale)
+
+
+class ThreadCpu:
+    """Per-thread CPU time from /proc/self/task/<tid>/stat (Linux only)."""
+
+    def __init__(self):
+        self._tick = os.sysconf('SC_CLK_TCK') if hasattr(os, 'sysconf') else 100
+
+    def sample(self):
+        names = {t.native_id: t.name for t in threading.enumerate() if t.native_id}
+        result = {}
+        try:
+            tids = os.listdir('/proc/self/task')
+        except OSError:
+            return result
+        for tid in tids:
+            try:
+                with open(f'/proc/self/task/{tid}/stat') as f:
+                    stat = f.read()
+            except OSError:
+                continue
+            # comm may contain spaces; fields after the closing paren are fixed.
+            fields = stat[stat.rindex(')') + 2:].split()
+            cpu = (int(fields[11]) + int(fields[12])) / self._tick
+            name = names.get(int(tid)) or stat[stat.index('(') + 1:stat.rindex(')')]
+            result[f'{name}[{tid}]'] = cpu
+        return result
+
+    @staticmethod
+    def delta(before, after, duration):
+        out = {}
+        for name, cpu in after.items():
+            used = cpu - before.get(name, 0.0)
+            if used > 0:
+                out[name] = {'cpu_s': round(used, 3), 'cpu_pct': round(100.0 * used / duration, 2)}
+        return dict(sorted(out.items(), key=lambda kv: -kv[1]['cpu_s']))
+
+
+class FakeHardwareEncoder:
+    def __init__(self):
+        self.position = 0
+
+
+class FakeButton:
+    value = True  # released
+
+
+class FakePixel:
+    def fill(self, color):
+        pass
+
+
+def _build_stack(emulator, n, args):
+    """Create state, serial connections, encoders and the Flask-SocketIO app like host/main.py does."""
+    import logging
+    from utils.logger_setup import setup_logger
+    from synth_control.synth_interface import SynthInterface
+    from synth_control.synth_state import SynthStateManager
+    from synth_control.encoder import Encoder
+    from web_dashboard.web_server import create_app
+    from main import start_encoder_input
+
+    setup_logger(args.log_level)
+    logging.getLogger('werkzeug').setLevel(logging.ERROR)
+
+    tmp = tempfile.mkdtemp(prefix='nhp_bench_')
+    state = SynthStateManager(os.path.join(tmp, 'synth_state.json'), os.path.join(tmp, 'defaults.json'))
+    template = json.dumps(state.synths[0])
+    state.synths = [json.loads(template) for _ in range(n)]
+    state.num_synths = n
+
+    synths = []
+    for i, path in enumerate(emulator.paths):
+        synth = SynthInterface(port=path, id=i)
+        if not synth.connect():
+            raise RuntimeError(f"Could not open emulated synth {path}")
+        synths.append(synth)
+
+    hardware = {func: FakeHardwareEncoder() for func in ('voltage', 'current', 'frequency', 'phase', 'harmonics')}
+    encoders = {func: Encoder(hw, FakeButton(), FakePixel()) for func, hw in hardware.items()}
+    led_colors = {func: (255, 255, 255) for func in hardware}
+
+    command_queue = multiprocessing.Queue()
+    encoder_manager, encoder_input = start_encoder_input(encoders, led_colors, state, synths, command_queue)
+    app, socketio = create_app(command_queue, state)
+    return state, synths, hardware, encoder_manager, encoder_input, command_queue, app, socketio
+
+
+def _control_loop(stop, state, synths, command_queue, encoder_manager, poll_interval, loop_times):
+    """The parts of the host/main.py loop that matter for latency."""
+    from main import control_pass
+    from utils.rig_sync import RIG_CHANGES
+    from utils.synth_poller import poll_synth_states
+
+    last_poll = time.time()
+    while not stop.is_set():
+        start = time.monotonic()
+        control_pass(encoder_manager, command_queue, synths, state)
+        if time.time() - last_poll > poll_interval:
+            for synth in synths:
+                synth.silent = True
+            poll_synth_states(synths, state)
+            for synth in synths:
+                synth.silent = False
+            last_poll = time.time()
+        loop_times.append(time.monotonic() - start)
+        time.sleep(0.01)
+    RIG_CHANGES.finish()
+
+
+def _dashboard_client(url, n, rate, stop, tracker, errors):
+    import socketio as socketio_client
+
+    client = socketio_client.Client(reconnection=False)
+    mirror = {}
+
+    def on_state(data):
+        mirror.clear()
+        mirror.update(data)
+        tracker.state_received(data.get('synths', []))
+
+    client.on('synthState', on_state)
+    client.on('synthStateDelta', lambda data: tracker.delta_received(mirror, data))
+    try:
+        client.connect(url, wait_timeout=10)
+    except Exception as e:
+        errors.append(f"connect: {e}")
+        return
+    interval = 1.0 / rate if rate > 0 else 1.0
+    next_at = time.monotonic() + random.uniform(0, interval)
+    while not stop.is_set():
+        delay = next_at - time.monotonic()
+        if delay > 0:
+            stop.wait(delay)
+            continue
+        next_at += interval
+        command = random.choice(list(COMMANDS))
+        field, _, value_fn = COMMANDS[command]
+        synth_id = random.randrange(n)
+        channel = random.choice('ab')
+        value = value_fn()
+        tracker.emitted_command((synth_id, field + channel, value))
+        try:
+            client.emit('command', {'synth_id': synth_id, 'command': command, 'channel': channel, 'value': value})
+        except Exception as e:
+            errors.append(f"emit: {e}")
+    client.disconnect()
+
+
+def _encoder_spinner(hardware, spins_per_s, stop, tracker):
+    funcs = list(ENCODER_WRITES)
+    interval = 1.0 / spins_per_s
+    while not stop.wait(interval):
+        func = random.choice(funcs)
+        tracker.spun(ENCODER_WRITES[func])
+        hardware[func].position += random.choice((-3, -1, 1, 3))
+
+
+def run(args):
+    n = args.synths
+    tracker = LatencyTracker()
+    emulator = SynthEmulator(n, args.link_dir, baud=args.baud, latency_ms=args.latency,
+                             jitter_ms=args.jitter, seed=args.seed, observer=tracker.serial_line)
+    emulator.start()
+    stop = threading.Event()
+    encoder_input = None
+    try:
+        state, synths, hardware, encoder_manager, encoder_input, command_queue, app, socketio = \
+            _build_stack(emulator, n, args)
+        server = threading.Thread(
+            target=lambda: socketio.run(app, host='127.0.0.1', port=args.port, debug=False,
+                                        use_reloader=False, allow_unsafe_werkzeug=True),
+            name='flask-socketio', daemon=True)
+        server.start()
+        time.sleep(1.0)
+
+        loop_times = []
+        control = threading.Thread(target=_control_loop, name='control-loop',
+                                   args=(stop, state, synths, command_queue, encoder_manager,
+                                         args.poll_interval, loop_times), daemon=True)
+        control.start()
+
+        errors = []
+        url = f'http://127.0.0.1:{args.port}'
+        clients = [threading.Thread(target=_dashboard_client, name=f'client-{i}',
+                                    args=(url, n, args.rate, stop, tracker, errors), daemon=True)
+                   for i in range(args.clients)]
+        for t in clients:
+            t.start()
+        if args.encoder_spins > 0:
+            threading.Thread(target=_encoder_spinner, name='encoder-spinner',
+                             args=(hardware, args.encoder_spins, stop, tracker), daemon=True).start()
+
+        time.sleep(args.warmup)
+        cpu = ThreadCpu()
+        cpu_before, wall_before, proc_before = cpu.sample(), time.monotonic(), os.times()
+        emitted_before = tracker.emitted
+        for sample_list in (tracker.emit_to_serial, tracker.emit_to_echo, tracker.spin_to_serial, loop_times):
+            sample_list.clear()
+        time.sleep(args.duration)
+        elapsed = time.monotonic() - wall_before
+        cpu_after, proc_after = cpu.sample(), os.times()
+        emitted = tracker.emitted - emitted_before
+
+        stop.set()
+        time.sleep(0.5)
+        unconfirmed = tracker.expire(0)
+        totals = emulator.stats()['totals']
+    finally:
+        stop.set()
+        if encoder_input is not None:
+            encoder_input.stop()
+        emulator.stop()
+
+    process_cpu = (proc_after.user + proc_after.system) - (proc_before.user + proc_before.system)
+    return {
+        'timestamp': datetime.datetime.now().isoformat(),
+        'host': {'python': platform.python_version(), 'machine': platform.machine(), 'cpus': os.cpu_count()},
+        'config': {k: v for k, v in vars(args).items() if k not in ('output', 'baseline')},
+        'throughput': {
+            'commands_emitted': emitted,
+            'commands_per_s': round(emitted / elapsed, 1),
+            'echoed': tracker.echoed,
+            'unconfirmed': unconfirmed,
+            'serial_lines_in': totals['commands'],
+            'serial_bytes_in': totals['bytes_in'],
+            'serial_bytes_out': totals['bytes_out'],
+        },
+        'emit_to_serial_ms': _summary(tracker.emit_to_serial),
+        'emit_to_echo_ms': _summary(tracker.emit_to_echo),
+        'spin_to_serial_ms': _summary(tracker.spin_to_serial),
+        'loop_iteration_ms': _summary(loop_times),
+        'cpu': {
+            'process_cpu_s': round(process_cpu, 3),
+            'process_cpu_pct': round(100.0 * process_cpu / elapsed, 2),
+            'threads': ThreadCpu.delta(cpu_before, cpu_after, elapsed),
+        },
+        'client_errors': errors[:20],
+    }
+
+
+def compare(result, baseline):
+    lines = [f"{'metric':<22}{'baseline':>12}{'current':>12}{'change':>10}"]
+    for metric in HEADLINE:
+        for pct in ('p50', 'p99'):
+            old = baseline.get(metric, {}).get(pct)
+            new = result.get(metric, {}).get(pct)
+            if old is None or new is None:
+                continue
+            change = f"{(new - old) / old * 100:+.1f}%" if old else 'n/a'
+            lines.append(f"{metric + ' ' + pct:<22}{old:>12.3f}{new:>12.3f}{change:>10}")
+    old = baseline.get('throughput', {}).get('commands_per_s')
+    new = result['throughput']['commands_per_s']
+    if old:
+        lines.append(f"{'commands_per_s':<22}{old:>12.1f}{new:>12.1f}{(new - old) / old * 100:>+9.1f}%")
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="End-to-end load/latency benchmark for the NHP_Synth host")
+    parser.add_argument('--synths', type=int, default=3, help="number of emulated synths")
+    parser.add_argument('--clients', type=int, default=10, help="simulated dashboard clients")
+    parser.add_argument('--rate', type=float, default=5.0, help="commands per second per client")
+    parser.add_argument('--encoder-spins', type=float, default=10.0, help="encoder detents per second (0 = off)")
+    parser.add_argument('--duration', type=float, default=20.0, help="measured seconds")
+    parser.add_argument('--warmup', type=float, default=2.0, help="seconds before measuring starts")
+    parser.add_argument('--poll-interval', type=float, default=2.5, help="hardware poll interval (host/main.py)")
+    parser.add_argument('--port', type=int, default=5055, help="port for the dashboard server")
+    parser.add_argument('--link-dir', default='/tmp/nhp_bench', help="directory for emulator links")
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--latency', type=float, default=0.2, help="emulated firmware latency in ms")
+    parser.add_argument('--jitter', type=float, default=0.0, help="emulated latency jitter in ms")
+    parser.add_argument('--seed', type=int, default=None)
+    parser.add_argument('--log-level', default='WARNING', help="NHP_Synth logger level during the run")
+    parser.add_argument('--output', default='bench_results.json', help="JSON results file")
+    parser.add_argument('--baseline', default=None, help="earlier results file to compare against")
+    args = parser.parse_args()
+
+    if args.seed is not None:
+        random.seed(args.seed)
+    result = run(args)
+    with open(args.output, 'w') as f:
+        json.dump(result, f, indent=2)
+
+    print(json.dumps({k: result[k] for k in ('throughput',) + HEADLINE}, indent=2))
+    print(f"Results written to {args.output}")
+    if args.baseline:
+        with open(args.baseline) as f:
+            print(compare(result, json.load(f)))
+
+
+if __name__ == "__main__":
+    main()
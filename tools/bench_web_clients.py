@@ -0,0 +1,324 @@
+#!/usr/bin/env python3
+"""
+Dashboard client capacity benchmark for the NHP_Synth web process
+
+Runs the real dashboard web process (host/web_dashboard/web_process.py) in a
+chosen server mode against a stand-in control process: the shared state block,
+command ring and StatePublisher from host/main.py, with one synth field changed
+at --update-rate per second. Simulated dashboard clients are then added in steps
+and, for each step, the benchmark measures how many of the updates each client
+received and how long they took to arrive (state change -> synthStateDelta).
+
+A step is sustained when every client connected, the slowest 10% of clients
+still received --min-delivery of the updates and the p99 delivery latency stayed
+under --max-latency-ms. The result is the largest sustained step.
+
+Compare server modes on the Pi by running it twice:
+
+    python3 tools/bench_web_clients.py --server threading --output before.json
+    python3 tools/bench_web_clients.py --server eventlet --output after.json --baseline before.json
+"""
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+HOST_DIR = os.path.abspath(os.path.join(TOOLS_DIR, '..', 'host'))
+sys.path.insert(0, HOST_DIR)
+sys.path.insert(0, TOOLS_DIR)
+
+from synth_emulator import _percentile  # noqa: E402
+
+FIELD = 'amplitude_a'
+
+
+class UpdateLog:
+    """Send time of every published update, keyed by the (unique) value written."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._sent = {}
+
+    def sent(self, value, t):
+        with self._lock:
+            self._sent[value] = t
+
+    def sent_at(self, value):
+        with self._lock:
+            return self._sent.get(value)
+
+    def sent_between(self, start, end):
+        with self._lock:
+            return sum(1 for t in self._sent.values() if start <= t < end)
+
+
+class DashboardClient:
+    def __init__(self, url, updates):
+        import socketio as socketio_client
+
+        self.updates = updates
+        self.received = {}      # value -> receive time
+        self.error = None
+        self._lock = threading.Lock()
+        self.client = socketio_client.Client(reconnection=False)
+        self.client.on('synthState', self._on_state)
+        self.client.on('synthStateDelta', self._on_delta)
+        try:
+            self.client.connect(url, transports=['websocket'], wait_timeout=10)
+        except Exception as e:
+            self.error = str(e)
+
+    def _record(self, value, t):
+        if self.updates.sent_at(value) is not None:
+            with self._lock:
+                self.received.setdefault(value, t)
+
+    def _on_state(self, data):
+        t = time.monotonic()
+        for synth in data.get('synths', []) if isinstance(data, dict) else []:
+            self._record(synth.get(FIELD), t)
+
+    def _on_delta(self, data):
+        t = time.monotonic()
+        for op in data.get('ops', []) if isinstance(data, dict) else []:
+            if op.get('path', '').endswith('/' + FIELD):
+                self._record(op.get('value'), t)
+
+    def window(self, start, end):
+        """Latencies (s) of updates sent within [start, end)."""
+        with self._lock:
+            received = dict(self.received)
+        latencies = []
+        for value, t in received.items():
+            sent = self.updates.sent_at(value)
+            if sent is not None and start <= sent < end:
+                latencies.append(t - sent)
+        return latencies
+
+    def close(self):
+        try:
+            self.client.disconnect()
+        except Exception:
+            pass
+
+
+def _updater(state, n, rate, stop, updates):
+    """Stand-in for encoder/poll activity: one synth field change per tick."""
+    counter = 0
+    interval = 1.0 / rate
+    next_at = time.monotonic()
+    while not stop.is_set():
+        delay = next_at - time.monotonic()
+        if delay > 0:
+            stop.wait(delay)
+            continue
+        next_at += interval
+        counter += 1
+        value = float(counter)
+        updates.sent(value, time.monotonic())
+        state.set_value(counter % n, FIELD, value)
+
+
+def _drain_ring(ring, stop):
+    import queue
+    while not stop.wait(0.01):
+        while True:
+            try:
+                ring.get_nowait()
+            except (queue.Empty, RuntimeError):
+                break
+
+
+def _wait_for_listen(port, proc, timeout):
+    from utils.startup import wait_for_listen
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        if proc.poll() is not None:
+            raise RuntimeError(f"web process exited with code {proc.returncode}")
+        if wait_for_listen(port, timeout=0.5):
+            return
+    raise RuntimeError(f"web process not listening on port {port}")
+
+
+def _process_cpu_s(pid):
+    try:
+        with open(f'/proc/{pid}/stat') as f:
+            fields = f.read().rsplit(')', 1)[1].split()
+        return (int(fields[11]) + int(fields[12])) / os.sysconf('SC_CLK_TCK')
+    except (OSError, ValueError, IndexError):
+        return None
+
+
+def _process_rss_mb(pid):
+    try:
+        with open(f'/proc/{pid}/status') as f:
+            for line in f:
+                if line.startswith('VmRSS:'):
+                    return round(int(line.split()[1]) / 1024.0, 1)
+    except (OSError, ValueError, IndexError):
+        pass
+    return None
+
+
+def run(args):
+    import logging
+    from utils.logger_setup import setup_logger
+    from utils.shared_memory import CommandRing, SeqlockBlock
+    from utils.shared_state import (COMMAND_RING_BYTES, STATE_BLOCK_BYTES, STATUS_BLOCK_BYTES,
+                                    StatePublisher, decode_command, encode_command)
+    from synth_control.synth_state import SynthStateManager, default_synth_entry
+    from web_dashboard.web_process import web_process_command
+
+    setup_logger(args.log_level)
+    logging.getLogger('NHP_Synth').setLevel(args.log_level)
+
+    tmp = tempfile.mkdtemp(prefix='nhp_webbench_')
+    state = SynthStateManager(os.path.join(tmp, 'synth_state.json'), os.path.join(tmp, 'defaults.json'))
+    state.synths = [default_synth_entry(i) for i in range(args.synths)]
+    state.num_synths = args.synths
+
+    state_block = SeqlockBlock.create('bench_state', STATE_BLOCK_BYTES)
+    status_block = SeqlockBlock.create('bench_status', STATUS_BLOCK_BYTES)
+    ring = CommandRing.create('bench_commands', COMMAND_RING_BYTES, encode=encode_command, decode=decode_command)
+    results = CommandRing.create('bench_results', 1 << 16, encode=encode_command, decode=decode_command)
+    publisher = StatePublisher(state, state_block, status_block).start()
+    paths = {'state': state_block.path, 'status': status_block.path, 'commands': ring.path, 'results': results.path}
+
+    env = dict(os.environ, NHP_WEB_SERVER=args.server,
+               NHP_WEB_MAX_CLIENTS=str(max(args.steps) + 1), NHP_WEB_MAX_CONNECTIONS=str(2 * max(args.steps) + 16))
+    proc = subprocess.Popen(web_process_command(paths, args.port), cwd=HOST_DIR, env=env,
+                            stdout=subprocess.DEVNULL if args.quiet else None, stderr=subprocess.STDOUT if args.quiet else None)
+    stop = threading.Event()
+    updates = UpdateLog()
+    clients = []
+    steps = []
+    try:
+        _wait_for_listen(args.port, proc, 30.0)
+        threading.Thread(target=_drain_ring, args=(ring, stop), name='ring-drain', daemon=True).start()
+        threading.Thread(target=_updater, args=(state, args.synths, args.update_rate, stop, updates),
+                         name='updater', daemon=True).start()
+        url = f'http://127.0.0.1:{args.port}'
+
+        for target in sorted(args.steps):
+            while len(clients) < target:
+                clients.append(DashboardClient(url, updates))
+            time.sleep(args.settle)
+            cpu_before = _process_cpu_s(proc.pid)
+            start = time.monotonic()
+            time.sleep(args.step_duration)
+            end = time.monotonic()
+            cpu_after = _process_cpu_s(proc.pid)
+            time.sleep(args.max_latency_ms / 1000.0)  # let in-flight updates land
+
+            sent = updates.sent_between(start, end)
+            connected = [c for c in clients if c.error is None]
+            delivery, latencies = [], []
+            for client in connected:
+                window = client.window(start, end)
+                delivery.append(len(window) / sent if sent else 0.0)
+                latencies.extend(window)
+            latency_ms = [s * 1000.0 for s in latencies]
+            result = {
+                'clients': target,
+                'connected': len(connected),
+                'updates_sent': sent,
+                'delivery_p10': round(_percentile(delivery, 10), 3) if delivery else 0.0,
+                'delivery_mean': round(sum(delivery) / len(delivery), 3) if delivery else 0.0,
+                'latency_ms': {
+                    'p50': round(_percentile(latency_ms, 50), 2),
+                    'p99': round(_percentile(latency_ms, 99), 2),
+                    'max': round(max(latency_ms), 2) if latency_ms else 0.0,
+                },
+                'web_cpu_pct': (round(100.0 * (cpu_after - cpu_before) / (end - start), 1)
+                                if cpu_before is not None and cpu_after is not None else None),
+                'web_rss_mb': _process_rss_mb(proc.pid),
+                'errors': sorted({c.error for c in clients if c.error})[:5],
+            }
+            result['sustained'] = (result['connected'] == target
+                                   and result['delivery_p10'] >= args.min_delivery
+                                   and result['latency_ms']['p99'] <= args.max_latency_ms)
+            steps.append(result)
+            print(f"{target:>5} clients: delivery p10 {result['delivery_p10']:.2f}, "
+                  f"p99 {result['latency_ms']['p99']:.1f} ms, web CPU {result['web_cpu_pct']}% "
+                  f"-> {'ok' if result['sustained'] else 'NOT sustained'}")
+            if not result['sustained'] and args.stop_on_failure:
+                break
+    finally:
+        stop.set()
+        for client in clients:
+            client.close()
+        proc.terminate()
+        try:
+            proc.wait(timeout=5.0)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+        publisher.stop()
+        for shared in (ring, results, state_block, status_block):
+            shared.close()
+
+    sustained = [s['clients'] for s in steps if s['sustained']]
+    return {
+        'timestamp': datetime.datetime.now().isoformat(),
+        'host': {'python': platform.python_version(), 'machine': platform.machine(), 'cpus': os.cpu_count()},
+        'config': {k: v for k, v in vars(args).items() if k not in ('output', 'baseline')},
+        'max_sustained_clients': max(sustained) if sustained else 0,
+        'steps': steps,
+    }
+
+
+def compare(result, baseline):
+    old_mode, new_mode = baseline['config'].get('server'), result['config'].get('server')
+    lines = [f"max sustained clients at {result['config']['update_rate']:g} updates/s: "
+             f"{baseline['max_sustained_clients']} ({old_mode}) -> {result['max_sustained_clients']} ({new_mode})",
+             f"{'clients':>8}{'p99 ms before':>16}{'p99 ms after':>15}{'CPU% before':>14}{'CPU% after':>13}"]
+    before = {s['clients']: s for s in baseline['steps']}
+    for step in result['steps']:
+        old = before.get(step['clients'])
+        if old is None:
+            continue
+        lines.append(f"{step['clients']:>8}{old['latency_ms']['p99']:>16.1f}{step['latency_ms']['p99']:>15.1f}"
+                     f"{str(old['web_cpu_pct']):>14}{str(step['web_cpu_pct']):>13}")
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Concurrent dashboard client benchmark for the NHP_Synth web process")
+    parser.add_argument('--server', default='auto', choices=('auto', 'threading', 'eventlet', 'gevent'),
+                        help="web process server mode (NHP_WEB_SERVER)")
+    parser.add_argument('--synths', type=int, default=3)
+    parser.add_argument('--update-rate', type=float, default=20.0, help="synth state changes per second")
+    parser.add_argument('--steps', type=lambda s: [int(x) for x in s.split(',')], default=[1, 5, 10, 20, 40, 80],
+                        help="comma-separated client counts")
+    parser.add_argument('--step-duration', type=float, default=10.0, help="measured seconds per step")
+    parser.add_argument('--settle', type=float, default=2.0, help="seconds after connecting before measuring")
+    parser.add_argument('--min-delivery', type=float, default=0.9,
+                        help="fraction of updates the slowest 10%% of clients must receive")
+    parser.add_argument('--max-latency-ms', type=float, default=250.0, help="p99 delivery latency limit")
+    parser.add_argument('--stop-on-failure', action='store_true', help="stop at the first step not sustained")
+    parser.add_argument('--port', type=int, default=5056)
+    parser.add_argument('--log-level', default='WARNING')
+    parser.add_argument('--quiet', action='store_true', help="discard the web process's output")
+    parser.add_argument('--output', default='bench_web_results.json', help="JSON results file")
+    parser.add_argument('--baseline', default=None, help="earlier results file to compare against")
+    args = parser.parse_args()
+
+    result = run(args)
+    with open(args.output, 'w') as f:
+        json.dump(result, f, indent=2)
+    print(f"Max sustained clients: {result['max_sustained_clients']} "
+          f"({args.server}, {args.update_rate:g} updates/s). Results written to {args.output}")
+    if args.baseline:
+        with open(args.baseline) as f:
+            print(compare(result, json.load(f)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+Check host/utils/dds_model.py against the firmware's DDS core, sample by sample
+
+Compiles firmware/main/dds_core.c with the host C compiler (with the same
+-ffp-contract=off as the firmware build), drives it through ctypes the way
+dds_output() does for one sync cycle, and compares every DAC code with
+model_parameters() for random and clipping parameter sets. The sine tables are
+compared separately: that is the one place the host libm's sinf can differ
+from the device's.
+
+    python3 tools/check_dds_model.py --cases 200 --seed 1
+"""
+
+import argparse
+import ctypes
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+HOST_DIR = os.path.join(TOOLS_DIR, '..', 'host')
+CORE_SOURCE = os.path.join(TOOLS_DIR, '..', 'firmware', 'main', 'dds_core.c')
+sys.path.insert(0, HOST_DIR)
+
+from utils import dds_model  # noqa: E402
+
+MAX_HARMONICS = 8
+
+
+class Harmonic(ctypes.Structure):
+    _fields_ = [('order', ctypes.c_int), ('percent', ctypes.c_float),
+                ('phase', ctypes.c_float), ('phase_offset_int', ctypes.c_int)]
+
+
+def build_core(cc, directory):
+    library = os.path.join(directory, 'libdds_core.so')
+    subprocess.run([cc, '-std=c11', '-O2', '-ffp-contract=off', '-fPIC', '-shared', '-o', library, CORE_SOURCE, '-lm'],
+                   check=True)
+    core = ctypes.CDLL(library)
+    core.dds_compute_step.restype = ctypes.c_uint32
+    core.dds_compute_step.argtypes = [ctypes.c_float, ctypes.c_float]
+    core.dds_degrees_to_radians.restype = ctypes.c_float
+    core.dds_degrees_to_radians.argtypes = [ctypes.c_float]
+    core.dds_compute_phase_offset.restype = ctypes.c_uint32
+    core.dds_compute_phase_offset.argtypes = [ctypes.c_float]
+    core.dds_set_harmonic.argtypes = [ctypes.POINTER(Harmonic), ctypes.c_int, ctypes.c_float, ctypes.c_float]
+    core.dds_sample.restype = ctypes.c_uint8
+    core.dds_sample.argtypes = [ctypes.c_char_p, ctypes.c_uint32, ctypes.c_uint32, ctypes.POINTER(Harmonic),
+                                ctypes.c_int, ctypes.c_float, ctypes.c_float]
+    return core
+
+
+def core_cycle(core, table, channel, cycle):
+    """What dds_output() writes for one channel in the `cycle` ticks after a sync edge."""
+    step = core.dds_compute_step(channel['frequency'], dds_model.PERIOD_US)
+    offset = core.dds_compute_phase_offset(core.dds_degrees_to_radians(channel['phase']))
+    harmonics = (Harmonic * MAX_HARMONICS)()
+    for slot, (order, amplitude, phase) in enumerate(channel['harmonics']):
+        core.dds_set_harmonic(ctypes.byref(harmonics[slot]), order, amplitude, phase)
+    amplitude = float(dds_model.np.float32(channel['amplitude']) / dds_model.np.float32(100.0))
+    output_scale = 1.0 if channel['enabled'] else 0.0
+    acc = (offset + dds_model.QUARTER) % dds_model.TABLE_SIZE
+    codes = []
+    for _ in range(cycle):
+        codes.append(core.dds_sample(table, acc, offset, harmonics, MAX_HARMONICS, amplitude, output_scale))
+        acc += step
+        if acc >= dds_model.TABLE_SIZE:
+            acc -= dds_model.TABLE_SIZE
+    return codes
+
+
+def random_state(rng, clipping):
+    state = {'frequency_a': round(rng.uniform(20, 400), rng.choice((0, 1, 3))),
+             'enabled': {ch: rng.random() < 0.9 for ch in ('a', 'b')}}
+    for ch in ('a', 'b'):
+        harmonics = []
+        for order in rng.sample(range(3, 26, 2), rng.randint(0, 4)):
+            harmonics.append({'order': order, 'amplitude': round(rng.uniform(0, 60 if clipping else 15), 1),
+                              'phase': round(rng.uniform(-360, 360), 2)})
+        state.update({
+            f'frequency_{ch}': state['frequency_a'] if rng.random() < 0.7 else round(rng.uniform(20, 8000), 2),
+            f'amplitude_{ch}': 100.0 if clipping else round(rng.uniform(0, 100), 1),
+            f'phase_{ch}': round(rng.uniform(-360, 360), 2),
+            f'harmonics_{ch}': harmonics,
+        })
+    return state
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[1])
+    parser.add_argument('--cases', type=int, default=100)
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--cc', default=os.environ.get('CC', 'cc'))
+    args = parser.parse_args()
+    if not dds_model.available():
+        sys.exit("numpy is required (pip install numpy)")
+
+    rng = random.Random(args.seed)
+    with tempfile.TemporaryDirectory() as directory:
+        core = build_core(args.cc, directory)
+        quarter = ctypes.create_string_buffer(dds_model.QUARTER)
+        core.dds_build_quarter_table(quarter)
+        model_quarter = dds_model.waveform_table()[:dds_model.QUARTER].tobytes()
+        table_diff = sum(a != b for a, b in zip(quarter.raw, model_quarter))
+        print(f"quarter table: {table_diff} of {dds_model.QUARTER} entries differ from the host sinf")
+        # Compare the sample path on the model's table, so a libm difference does not mask it
+        quarter = ctypes.create_string_buffer(model_quarter, dds_model.QUARTER)
+
+        failed = 0
+        clipped = 0
+        for case in range(args.cases):
+            state = random_state(rng, clipping=case % 4 == 0)
+            params = dds_model.synth_parameters(state, calibrate=False)
+            result = dds_model.model_parameters(params)
+            for ch in ('a', 'b'):
+                expected = core_cycle(core, quarter, params[ch], result['cycle_samples'])
+                modelled = result['channels'][ch]['samples'].tolist()
+                clipped += result['channels'][ch]['clipped_samples'] > 0
+                if expected != modelled:
+                    failed += 1
+                    first = next(i for i, (a, b) in enumerate(zip(expected, modelled)) if a != b)
+                    print(f"case {case} channel {ch}: first difference at sample {first} "
+                          f"(core {expected[first]}, model {modelled[first]}) for {params[ch]}")
+        print(f"{args.cases * 2} channels compared ({clipped} clipping), {failed} differ")
+    sys.exit(1 if failed or table_diff else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+"""
+NHP_Synth command journal replay
+
+Re-drives a session recorded by the host's command journal (host/journal/*.nhpj,
+see host/utils/command_journal.py) against real synths or the protocol emulator,
+at the original timing or accelerated:
+
+    python3 tools/replay_journal.py --dump host/journal/session-20250101-120000.nhpj
+    python3 tools/replay_journal.py --latest --emulator 3 --speed 10
+    python3 tools/replay_journal.py --latest --speed 1 --glob '/dev/serial/by-path/*usb*'
+
+By default the session's first snapshot is applied first (frequency, phase,
+amplitude, harmonics, then enables) so the rig starts from the recorded state;
+use --no-snapshot to send only the journaled commands.
+"""
+
+import argparse
+import glob
+import json
+import os
+import sys
+import time
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+HOST_DIR = os.path.join(TOOLS_DIR, '..', 'host')
+sys.path.insert(0, HOST_DIR)
+sys.path.insert(0, TOOLS_DIR)
+
+from utils.command_journal import DEFAULT_DIR, apply_command_to_state, latest_journal, read_journal  # noqa: E402
+
+
+def _snapshot_commands(state):
+    """Setter calls that bring a synth to a snapshot's state."""
+    commands = []
+    for synth_id, synth in enumerate(state.get('synths', [])):
+        for ch in ('a', 'b'):
+            commands.append((synth_id, 'clear_harmonics', ch, None))
+            for key in ('frequency', 'phase', 'amplitude'):
+                if f'{key}_{ch}' in synth:
+                    commands.append((synth_id, f'set_{key}', ch, synth[f'{key}_{ch}']))
+            for harmonic in synth.get(f'harmonics_{ch}', []):
+                if harmonic.get('order', 0) >= 3 and harmonic.get('amplitude', 0) > 0:
+                    commands.append((synth_id, 'set_harmonics', ch, harmonic))
+        for ch in ('a', 'b'):
+            commands.append((synth_id, 'set_enabled', ch, bool(synth.get('enabled', {}).get(ch, False))))
+    return commands
+
+
+def _send(synths, synth_id, command, channel, value):
+    if synth_id >= len(synths):
+        return False
+    synth = synths[synth_id]
+    if command == 'clear_harmonics':
+        return synth.clear_harmonics(channel)
+    return getattr(synth, command)(channel, value)
+
+
+def _print_record(record, t0):
+    if record['type'] == 'command':
+        value = record['value']
+        if isinstance(value, dict):
+            value = f"h{value['order']} {value['amplitude']:g}% {value['phase']:g}deg"
+        print(f"{record['t'] - t0:10.3f}  {record['source']:<11} synth {record['synth_id']}  "
+              f"{record['command']:<15} {record['channel'] or '-'}  {'' if value is None else value}")
+    elif record['type'] == 'snapshot':
+        print(f"{record['t'] - t0:10.3f}  snapshot ({len(record['state'].get('synths', []))} synths)")
+
+
+def dump(path):
+    records = list(read_journal(path))
+    t0 = records[0]['t'] if records else 0.0
+    counts = {}
+    for record in records:
+        _print_record(record, t0)
+        counts[record['type']] = counts.get(record['type'], 0) + 1
+    print(json.dumps(counts))
+
+
+def replay(path, ports, speed, use_snapshot, sources, verbose):
+    from synth_control.synth_interface import SynthInterface
+
+    records = list(read_journal(path))
+    snapshot = next((r for r in records if r['type'] == 'snapshot'), None)
+    commands = [r for r in records if r['type'] == 'command' and (not sources or r['source'] in sources)]
+
+    synths = []
+    for i, port in enumerate(ports):
+        synth = SynthInterface(port=port, id=i)
+        if not synth.connect():
+            raise SystemExit(f"Could not open {port}")
+        synth.silent = True
+        synths.append(synth)
+
+    expected = json.loads(json.dumps(snapshot['state'])) if snapshot else {'synths': []}
+    sent = failed = 0
+    try:
+        if use_snapshot and snapshot:
+            for synth_id, command, channel, value in _snapshot_commands(snapshot['state']):
+                sent += 1
+                failed += 0 if _send(synths, synth_id, command, channel, value) else 1
+
+        t_first = commands[0]['t'] if commands else 0.0
+        started = time.monotonic()
+        for record in commands:
+            if speed > 0:
+                delay = (record['t'] - t_first) / speed - (time.monotonic() - started)
+                if delay > 0:
+                    time.sleep(delay)
+            if verbose:
+                _print_record(record, t_first)
+            try:
+                ok = _send(synths, record['synth_id'], record['command'], record['channel'], record['value'])
+            except ValueError:
+                ok = False
+            sent += 1
+            failed += 0 if ok else 1
+            apply_command_to_state(expected.get('synths', []), record)
+        elapsed = time.monotonic() - started
+    finally:
+        for synth in synths:
+            synth.disconnect()
+
+    return {
+        'journal': os.path.basename(path),
+        'commands': len(commands),
+        'sent': sent,
+        'failed': failed,
+        'recorded_s': round(commands[-1]['t'] - commands[0]['t'], 3) if commands else 0.0,
+        'replay_s': round(elapsed, 3),
+        'speed': speed,
+        'expected_state': expected,
+    }
+
+
+def _compare_with_emulator(expected, emulator):
+    """Check the emulator's final frequency/phase/amplitude/enable against the replayed state."""
+    import math
+    mismatches = []
+    for port, synth_state in zip(emulator.ports, expected.get('synths', [])):
+        virtual = port.synth
+        for idx, ch in enumerate(('a', 'b')):
+            checks = {
+                'frequency': (virtual.freq[idx], synth_state.get(f'frequency_{ch}')),
+                'amplitude': (virtual.target_ampl[idx] * 100.0, synth_state.get(f'amplitude_{ch}')),
+                'enabled': (virtual.enabled[idx], synth_state.get('enabled', {}).get(ch)),
+            }
+            for key, (actual, wanted) in checks.items():
+                if wanted is None:
+                    continue
+                if isinstance(wanted, bool) and actual != wanted:
+                    mismatches.append(f"synth {port.index} {key}_{ch}: {actual} != {wanted}")
+                elif not isinstance(wanted, bool) and not math.isclose(actual, wanted, abs_tol=0.05):
+                    mismatches.append(f"synth {port.index} {key}_{ch}: {actual:.2f} != {wanted}")
+    return mismatches
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay an NHP_Synth command journal")
+    parser.add_argument('journal', nargs='?', help="journal file (.nhpj)")
+    parser.add_argument('--latest', action='store_true', help=f"use the newest journal in --journal-dir")
+    parser.add_argument('--journal-dir', default=DEFAULT_DIR, help="journal directory (default host/journal)")
+    parser.add_argument('--dump', action='store_true', help="print the journal records and exit")
+    parser.add_argument('--speed', type=float, default=1.0,
+                        help="timing multiplier (1 = original, 10 = ten times faster, 0 = no delays)")
+    parser.add_argument('--no-snapshot', action='store_true', help="do not apply the session's first snapshot")
+    parser.add_argument('--source', action='append', default=[],
+                        help="only replay commands from this source (repeatable: encoder, socket, rest, ...)")
+    parser.add_argument('--glob', default=os.environ.get('NHP_SYNTH_DEVICE_GLOB', '/dev/serial/by-path/*'),
+                        help="serial device glob for real synths (sorted, one per synth id)")
+    parser.add_argument('--emulator', type=int, metavar='N', default=0,
+                        help="replay into N emulated synths instead of hardware and verify the final state")
+    parser.add_argument('--verbose', action='store_true', help="print each command as it is replayed")
+    args = parser.parse_args()
+
+    path = latest_journal(args.journal_dir) if args.latest or not args.journal else args.journal
+    if not path or not os.path.exists(path):
+        raise SystemExit("No journal found (pass a file or --latest)")
+    if args.dump:
+        dump(path)
+        return
+
+    if args.emulator:
+        from synth_emulator import SynthEmulator
+        with SynthEmulator(args.emulator, '/tmp/nhp_replay_emu', baud=0, latency_ms=0.0) as emulator:
+            report = replay(path, emulator.paths, args.speed, not args.no_snapshot, args.source, args.verbose)
+            time.sleep(0.2)  # let the emulator drain the last writes
+            report['mismatches'] = _compare_with_emulator(report['expected_state'], emulator)
+    else:
+        ports = sorted(p for p in glob.glob(args.glob) if 'usb' in os.path.basename(p).lower())
+        if not ports:
+            raise SystemExit(f"No synth devices match {args.glob}")
+        report = replay(path, ports, args.speed, not args.no_snapshot, args.source, args.verbose)
+
+    report.pop('expected_state', None)
+    print(json.dumps(report, indent=2))
+
+
+if __name__ == '__main__':
+    main()
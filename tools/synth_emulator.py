@@ -0,0 +1,791 @@
+#!/usr/bin/env python3
+"""
+NHP_Synth firmware protocol emulator
+
+Creates N virtual synthesizers on pseudo-terminals that speak the same UART
+protocol as firmware/main/main.c (uart_cmd_task), so the host stack can be
+driven and load-tested without ESP32 hardware attached.
+
+Each virtual synth gets a symlink in --link-dir whose name contains "usb" so
+SynthDiscovery picks it up when pointed at that directory:
+
+    python3 tools/synth_emulator.py --synths 10 --link-dir /tmp/nhp_emu
+    NHP_SYNTH_DEVICE_GLOB='/tmp/nhp_emu/*' python3 host/main.py
+
+Firmware behaviour that is reproduced:
+  - 31 character command buffer (extra characters are dropped), CR or LF ends a line
+  - %.1f formatted read responses terminated with \\r\\n, no response to writes
+  - ESP_LOGW warning lines for invalid values / unknown commands on the same UART
+  - amplitude ramp (AMPL_RAMP_STEP per 50 us tick), so raa/rab lag behind waa/wab
+  - 8 harmonic slots shared across both channels, disabled harmonics keep their slot
+  - staged writes (wsf/wsp) applied by a commit at the next sync edge, modelled as the
+    next multiple of the channel A period on the shared clock so every synth of the
+    emulated rig applies a wcs commit at the same instant
+
+Link conditions that can be injected:
+  --baud       output is paced at baud/10 bytes per second (8N1)
+  --latency    extra per-command processing latency in ms (plus --jitter)
+  --noise      probability that an unsolicited log line precedes a response
+  --boot       emit an ESP32 ROM/bootloader banner whenever a port (re)appears
+  --disconnect mean seconds between simulated USB unplugs (--downtime to stay away)
+
+Use --selftest to run a timed load against the emulated rig and print
+throughput and latency figures (for example with 3, 10 or 50 synths).
+"""
+
+import argparse
+import json
+import os
+import random
+import re
+import select
+import struct
+import sys
+import threading
+import time
+import tty
+
+HOST_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'host')
+
+# Firmware constants (firmware/main/main.c)
+MIN_FREQ = 20
+MAX_FREQ = 8000
+MAX_HARMONICS = 8
+CMD_BUF_SIZE = 160
+PERIOD_US = 50
+AMPL_RAMP_STEP = 1e-3
+LOG_TAG = 'dac_oneshot_test'
+M_PI = 3.14159265358979323846
+M_PI_180 = M_PI / 180.0
+
+HELP_MSG = (
+    "Command: [r|w][f|p|a|h|en][a|b][<args>]\r\n"
+    "  r=read, w=write; f=frequency, p=phase, a=amplitude, h=harmonic, en=enable\r\n"
+    "  a=ch A, b=ch B; <args>=value(s) for write\r\n"
+    "\r\n"
+    "Harmonic: wh[a|b]<n>,<percent>[,<phase_deg>]\r\n"
+    "  n=odd harmonic (>=3), percent=0-100, phase_deg=deg (optional)\r\n"
+    "Special:\r\n"
+    "  whcl[a|b]   Clear all harmonics for A/B\r\n"
+    "  whm<ch><n>,<percent>[,<phase_deg>];...  Replace harmonics of every listed channel at once\r\n"
+    "  ren[a|b]    Read output enable state for A/B (0=disabled, 1=enabled)\r\n"
+    "  wen[a|b][0|1] Write output enable state for A/B (0=disable, 1=enable)\r\n"
+    "  wsf[a|b]<hz>, wsp[a|b]<deg>  Stage frequency/phase until a commit\r\n"
+    "  wcs<ver>    Commit staged writes at the next sync edge (wcn<ver>: now, wcx: discard)\r\n"
+    "  rc          Read last commit (ex. response rc42,0; state 1 = staged, 2 = armed)\r\n"
+    "  help        Show this help\r\n"
+    "\r\n"
+    "Examples:\r\n"
+    "  rfa         Read freq A (ex. response rfa50.0 = 50.0 Hz)\r\n"
+    "  wfb45.5     Set freq B to 45.5 Hz\r\n"
+    "  rpa         Read phase A (ex. response rpa-120.0 = -120.0 deg)\r\n"
+    "  wpa-90      Set phase A to -90 deg\r\n"
+    "  rab         Read amp B (ex. response rab55.0 = 55.0 %)\r\n"
+    "  waa50       Set amp A to 50%\r\n"
+    "  rena        Read enable state A (ex. response rena1 = enabled)\r\n"
+    "  wena0       Disable DAC output A\r\n"
+    "  wenb1       Enable DAC output B\r\n"
+    "  rha         Read harmonics A (ex. response rha3,10.0,0.0;5,20.0,-90.0; = 3rd 10% 0 deg; 5th 20% -90 deg)\r\n"
+    "  wha3,10     Set 3rd harm A to 10%\r\n"
+    "  whb5,5,-90  Set 5th harm B to 5%, -90 deg\r\n"
+    "  whma3,10;a5,5,-90;b  A = 3rd 10% + 5th 5% -90 deg, B cleared\r\n"
+)
+
+BOOT_BANNER = (
+    "ets Jul 29 2019 12:21:46\r\n"
+    "\r\n"
+    "rst:0x1 (POWERON_RESET),boot:0x13 (SPI_FAST_FLASH_BOOT)\r\n"
+    "configsip: 0, SPIWP:0xee\r\n"
+    "clk_drv:0x00,q_drv:0x00,d_drv:0x00,cs0_drv:0x00,hd_drv:0x00,wp_drv:0x00\r\n"
+    "mode:DIO, clock div:2\r\n"
+    "load:0x3fff0030,len:6276\r\n"
+    "entry 0x400806a8\r\n"
+    "I (31) boot: ESP-IDF v5.4.2 2nd stage bootloader\r\n"
+    "I (31) boot: chip revision: v3.0\r\n"
+    "I (134) boot: Loaded app from partition at offset 0x10000\r\n"
+    "I (241) cpu_start: Pro cpu start user code\r\n"
+    "I (259) main_task: Started on CPU0\r\n"
+    "I (269) main_task: Calling app_main()\r\n"
+)
+
+NOISE_LINES = (
+    "W ({ms}) {tag}: UART: Unknown command: 'r'",
+    "I ({ms}) main_task: Returned from app_main()",
+    "E ({ms}) task_wdt: Task watchdog got triggered.",
+)
+
+_FLOAT_RE = re.compile(r'\s*[+-]?(?:\d+\.?\d*|\.\d+)(?:[eE][+-]?\d+)?')
+_INT_RE = re.compile(r'\s*[+-]?\d+')
+
+
+def _f32(value):
+    """Round a Python float to IEEE single precision like the firmware's float variables."""
+    return struct.unpack('<f', struct.pack('<f', value))[0]
+
+
+def _strtof(text):
+    """C strtof(): parse the longest valid numeric prefix, 0.0 if there is none."""
+    match = _FLOAT_RE.match(text)
+    return _f32(float(match.group(0))) if match else 0.0
+
+
+def _strtol(text):
+    """C strtol(..., 10): parse the longest valid integer prefix, 0 if there is none."""
+    match = _INT_RE.match(text)
+    return int(match.group(0)) if match else 0
+
+
+def _percentile(samples, pct):
+    if not samples:
+        return 0.0
+    ordered = sorted(samples)
+    idx = min(len(ordered) - 1, int(round((pct / 100.0) * (len(ordered) - 1))))
+    return ordered[idx]
+
+
+class VirtualSynth:
+    """Firmware state machine for one synth: bytes in, bytes out."""
+
+    def __init__(self, clock=time.monotonic):
+        self._clock = clock
+        self.boot_time = clock()
+        self.freq = [50.0, 50.0]
+        self.phase = [0.0, 0.0]        # radians, as stored by the firmware
+        self.target_ampl = [0.0, 0.0]  # 0.0-1.0
+        self._ampl = [0.0, 0.0]
+        self._ampl_at = [self.boot_time, self.boot_time]
+        self.enabled = [False, False]
+        self.harmonics = [[{'order': 0, 'percent': 0.0, 'phase': 0.0} for _ in range(MAX_HARMONICS)]
+                          for _ in range(2)]
+        self.staged_freq = {}   # ch -> Hz, held until a commit
+        self.staged_phase = {}  # ch -> radians
+        self.commit_version = 0
+        self.armed_version = None
+        self.armed_at = None    # clock time of the sync edge the armed commit applies at
+        self.commit_applied_at = None
+        self._buf = bytearray()
+        self.on_line = None  # optional callback(line) for benchmarks
+        self.commands = 0
+        self.reads = 0
+        self.writes = 0
+        self.warnings = 0
+
+    def uptime_ms(self):
+        return int((self._clock() - self.boot_time) * 1000)
+
+    def current_ampl(self, ch):
+        """Amplitude as seen by the DDS ISR: ramps by AMPL_RAMP_STEP every PERIOD_US tick."""
+        now = self._clock()
+        ticks = (now - self._ampl_at[ch]) * 1e6 / PERIOD_US
+        delta = self.target_ampl[ch] - self._ampl[ch]
+        step = ticks * AMPL_RAMP_STEP
+        if abs(delta) <= step or abs(delta) <= AMPL_RAMP_STEP:
+            self._ampl[ch] = self.target_ampl[ch]
+        else:
+            self._ampl[ch] += step if delta > 0 else -step
+        self._ampl_at[ch] = now
+        return self._ampl[ch]
+
+    def _set_target_ampl(self, ch, value):
+        self.current_ampl(ch)  # settle the ramp up to now before changing the target
+        self.target_ampl[ch] = _f32(value)
+
+    def next_sync_edge(self, now):
+        period = 1.0 / self.freq[0]
+        return (int(now / period) + 1) * period
+
+    def _settle_commit(self):
+        """Apply an armed commit once its sync edge has passed (lazily, like current_ampl)."""
+        if self.armed_version is None or self._clock() < self.armed_at:
+            return
+        for ch, freq in self.staged_freq.items():
+            self.freq[ch] = freq
+        for ch, phase in self.staged_phase.items():
+            self.phase[ch] = phase
+        self.staged_freq.clear()
+        self.staged_phase.clear()
+        self.commit_version = self.armed_version
+        self.commit_applied_at = self.armed_at
+        self.armed_version = self.armed_at = None
+
+    def log_line(self, level, message, tag=LOG_TAG):
+        return f"{level} ({self.uptime_ms()}) {tag}: {message}\r\n"
+
+    def _warn(self, message):
+        self.warnings += 1
+        return self.log_line('W', message)
+
+    def feed(self, data):
+        """Consume received bytes and return the list of output strings they produced."""
+        out = []
+        for byte in data:
+            if byte in (0x0D, 0x0A):
+                line = self._buf.decode('latin-1')
+                self._buf.clear()
+                if self.on_line:
+                    self.on_line(line)
+                response = self.handle_line(line)
+                if response:
+                    out.append(response)
+            elif len(self._buf) < CMD_BUF_SIZE - 1:
+                self._buf.append(byte)
+        return out
+
+    def handle_line(self, cmd):
+        """Execute one command exactly like uart_cmd_task; returns UART output or ''."""
+        c2 = cmd[2] if len(cmd) > 2 else ''
+        c3 = cmd[3] if len(cmd) > 3 else ''
+        c4 = cmd[4] if len(cmd) > 4 else ''
+        if cmd:
+            self.commands += 1
+        self._settle_commit()
+
+        if cmd.startswith('rf') and c2 in ('a', 'b'):
+            ch = 0 if c2 == 'a' else 1
+            self.reads += 1
+            return f"rf{c2}{self.freq[ch]:.1f}\r\n"
+        if cmd.startswith('wf') and c2 in ('a', 'b'):
+            ch = 0 if c2 == 'a' else 1
+            self.writes += 1
+            freq = _strtof(cmd[3:])
+            if MIN_FREQ <= freq <= MAX_FREQ:
+                self.freq[ch] = freq
+                return ''
+            return self._warn(f"UART: Invalid channel {c2.upper()} frequency: {freq:.1f} "
+                              f"(Allowed: {MIN_FREQ}-{MAX_FREQ})")
+        if cmd.startswith('rp') and c2 in ('a', 'b'):
+            ch = 0 if c2 == 'a' else 1
+            self.reads += 1
+            return f"rp{c2}{_f32(self.phase[ch] * 180.0) / M_PI:.1f}\r\n"
+        if cmd.startswith('wp') and c2 in ('a', 'b'):
+            ch = 0 if c2 == 'a' else 1
+            self.writes += 1
+            phase = _strtof(cmd[3:])
+            out = ''
+            if phase < -360.0 or phase > 360.0:
+                out = self._warn(f"UART: Invalid channel {c2.upper()} phase: {phase:f} "
+                                 f"(Allowed: -360 to +360)")
+            phase = max(-360.0, min(360.0, phase))
+            self.phase[ch] = _f32(phase * M_PI_180)
+            return out
+        if cmd.startswith('ra') and c2 in ('a', 'b'):
+            ch = 0 if c2 == 'a' else 1
+            self.reads += 1
+            return f"ra{c2}{_f32(self.current_ampl(ch) * 100.0):.1f}\r\n"
+        if cmd.startswith('wa') and c2 in ('a', 'b'):
+            ch = 0 if c2 == 'a' else 1
+            self.writes += 1
+            ampl = max(0.0, min(100.0, _strtof(cmd[3:])))
+            self._set_target_ampl(ch, ampl / 100.0)
+            return ''
+        if cmd.startswith('ren') and c3 in ('a', 'b'):
+            ch = 0 if c3 == 'a' else 1
+            self.reads += 1
+            return f"ren{c3}{1 if self.enabled[ch] else 0}\r\n"
+        if cmd.startswith('wen') and c3 in ('a', 'b'):
+            ch = 0 if c3 == 'a' else 1
+            self.writes += 1
+            self.enabled[ch] = _strtol(cmd[4:]) != 0
+            return ''
+        if cmd.startswith('ws') and c2 in ('f', 'p') and c3 in ('a', 'b'):
+            ch = 0 if c3 == 'a' else 1
+            self.writes += 1
+            value = _strtof(cmd[4:])
+            if self.armed_version is not None:
+                return self._warn(f"UART: Commit {self.armed_version} pending, staged write rejected")
+            if c2 == 'f':
+                if MIN_FREQ <= value <= MAX_FREQ:
+                    self.staged_freq[ch] = value
+                    return ''
+                return self._warn(f"UART: Invalid channel {c3.upper()} frequency: {value:.1f} "
+                                  f"(Allowed: {MIN_FREQ}-{MAX_FREQ})")
+            out = ''
+            if value < -360.0 or value > 360.0:
+                out = self._warn(f"UART: Invalid channel {c3.upper()} phase: {value:f} "
+                                 f"(Allowed: -360 to +360)")
+            self.staged_phase[ch] = _f32(max(-360.0, min(360.0, value)) * M_PI_180)
+            return out
+        if cmd.startswith('wc') and c2 in ('s', 'n', 'x'):
+            self.writes += 1
+            if c2 == 'x':
+                self.staged_freq.clear()
+                self.staged_phase.clear()
+                self.armed_version = self.armed_at = None
+            else:
+                now = self._clock()
+                self.armed_version = _strtol(cmd[3:]) & 0xFFFFFFFF
+                self.armed_at = self.next_sync_edge(now) if c2 == 's' else now
+                self._settle_commit()
+            return ''
+        if cmd == 'rc':
+            self.reads += 1
+            state = 2 if self.armed_version is not None else (1 if self.staged_freq or self.staged_phase else 0)
+            return f"rc{self.commit_version},{state}\r\n"
+        if cmd.startswith('whcl') and c4 in ('a', 'b'):
+            ch = 0 if c4 == 'a' else 1
+            self.writes += 1
+            for slot in self.harmonics[ch]:
+                slot.update(order=0, percent=0.0, phase=0.0)
+            return ''
+        if cmd.startswith('whm'):
+            self.writes += 1
+            return self._write_harmonics_multi(cmd[3:])
+        if cmd.startswith('rh') and c2 in ('a', 'b'):
+            ch = 0 if c2 == 'a' else 1
+            self.reads += 1
+            parts = [f"{h['order']},{_f32(h['percent'] * 100.0):.1f},{_f32(h['phase'] * 180.0) / M_PI:.1f};"
+                     for h in self.harmonics[ch] if h['order'] >= 3 and h['percent'] > 0.0]
+            return f"rh{c2}{''.join(parts)}"[:253] + "\r\n"
+        if cmd.startswith('wh') and c2 in ('a', 'b'):
+            self.writes += 1
+            return self._write_harmonic(0 if c2 == 'a' else 1, cmd[3:])
+        if cmd == 'help':
+            return HELP_MSG
+        if cmd:
+            return self._warn(f"UART: Unknown command: '{cmd}'")
+        return ''
+
+    def _write_harmonic(self, ch, args):
+        if ',' not in args:
+            return self._warn("UART: Invalid harmonic command format. Use e.g. wha3,10 or wha3,10,-90")
+        order = _strtol(args)
+        rest = args.split(',', 1)[1]
+        percent = _strtof(rest)
+        phase_deg = _strtof(rest.split(',', 1)[1]) if ',' in rest else 0.0
+        if order < 3 or order % 2 == 0:
+            return self._warn("UART: Harmonic order must be odd and >= 3")
+        if percent < 0.0 or percent > 100.0:
+            return self._warn("UART: Harmonic percent must be 0-100")
+
+        in_use = sum(1 for c in range(2) for h in self.harmonics[c] if h['order'] >= 3 and h['percent'] > 0.0)
+        values = {'percent': _f32(percent / 100.0), 'phase': _f32(phase_deg * M_PI_180)}
+        for slot in self.harmonics[ch]:
+            if slot['order'] == order:
+                slot.update(values)
+                return ''
+        if percent > 0.0:
+            if in_use >= MAX_HARMONICS:
+                return self._warn("UART: Max harmonics reached globally")
+            for slot in self.harmonics[ch]:
+                if slot['order'] == 0 or slot['percent'] == 0.0:
+                    slot.update(values, order=order)
+                    break
+        return ''
+
+    def _write_harmonics_multi(self, args):
+        rejected = f"UART: whm rejected (invalid entry or more than {MAX_HARMONICS} harmonics)"
+        staged = {}
+        for seg in args.split(';'):
+            if not seg:
+                continue
+            if seg[0] not in ('a', 'b'):
+                return self._warn(f"UART: Invalid whm channel in '{seg}'") + self._warn(rejected)
+            entries = staged.setdefault(0 if seg[0] == 'a' else 1, [])
+            if len(seg) == 1:
+                continue
+            order = _strtol(seg[1:])
+            percent = _strtof(seg.split(',', 1)[1]) if ',' in seg else -1.0
+            rest = seg.split(',', 2)
+            phase_deg = _strtof(rest[2]) if len(rest) > 2 else 0.0
+            if ',' not in seg or order < 3 or order % 2 == 0 or percent < 0.0 or percent > 100.0:
+                return self._warn(f"UART: Invalid whm entry '{seg}'") + self._warn(rejected)
+            if any(entry['order'] == order for entry in entries):
+                return self._warn(f"UART: Duplicate whm order {order} for channel {seg[0]}") + self._warn(rejected)
+            if len(entries) >= MAX_HARMONICS:
+                return self._warn(rejected)
+            entries.append({'order': order, 'percent': _f32(percent / 100.0), 'phase': _f32(phase_deg * M_PI_180)})
+
+        total = sum(1 for entries in staged.values() for entry in entries if entry['percent'] > 0.0)
+        total += sum(1 for c in range(2) if c not in staged
+                     for h in self.harmonics[c] if h['order'] >= 3 and h['percent'] > 0.0)
+        if total > MAX_HARMONICS:
+            return self._warn(rejected)
+        for ch, entries in staged.items():
+            for i, slot in enumerate(self.harmonics[ch]):
+                slot.update(entries[i] if i < len(entries) else {'order': 0, 'percent': 0.0, 'phase': 0.0})
+        return ''
+
+
+class EmulatedPort:
+    """One virtual synth attached to a pty, with a stable symlink and link impairments."""
+
+    def __init__(self, index, link_dir, baud=115200, latency_ms=0.0, jitter_ms=0.0, noise=0.0,
+                 boot=False, disconnect_every=0.0, downtime=3.0, seed=None, observer=None):
+        self.index = index
+        self.link_path = os.path.join(link_dir, f"emu-usb-synth-{index:02d}")
+        self.observer = observer  # optional callback(index, line, monotonic_time)
+        self.synth = self._new_synth()
+        self.char_time = 10.0 / baud if baud > 0 else 0.0
+        self.latency = latency_ms / 1000.0
+        self.jitter = jitter_ms / 1000.0
+        self.noise = noise
+        self.boot = boot
+        self.disconnect_every = disconnect_every
+        self.downtime = downtime
+        self._rng = random.Random(seed)
+        self._master = None
+        self._slave = None
+        self._stop = threading.Event()
+        self._thread = None
+        self.bytes_in = 0
+        self.bytes_out = 0
+        self.disconnects = 0
+        self.noise_lines = 0
+        self.response_times = []
+
+    def _new_synth(self):
+        synth = VirtualSynth()
+        if self.observer:
+            synth.on_line = lambda line: self.observer(self.index, line, time.monotonic())
+        return synth
+
+    def _open_pty(self):
+        master, slave = os.openpty()
+        tty.setraw(slave)
+        # Keep our own handle on the slave so reads on the master don't fail while the host is away.
+        self._master, self._slave = master, slave
+        tmp_link = self.link_path + '.tmp'
+        if os.path.lexists(tmp_link):
+            os.unlink(tmp_link)
+        os.symlink(os.ttyname(slave), tmp_link)
+        os.replace(tmp_link, self.link_path)
+        if self.boot:
+            self.synth = self._new_synth()
+            self._write(BOOT_BANNER)
+
+    def _close_pty(self):
+        if os.path.lexists(self.link_path):
+            os.unlink(self.link_path)
+        for fd in (self._master, self._slave):
+            if fd is not None:
+                try:
+                    os.close(fd)
+                except OSError:
+                    pass
+        self._master = self._slave = None
+
+    def _write(self, text):
+        data = text.encode('latin-1')
+        view = memoryview(data)
+        while view:
+            try:
+                written = os.write(self._master, view)
+            except BlockingIOError:
+                time.sleep(0.001)
+                continue
+            view = view[written:]
+        self.bytes_out += len(data)
+        if self.char_time:
+            time.sleep(len(data) * self.char_time)
+
+    def _next_disconnect(self):
+        if self.disconnect_every <= 0:
+            return None
+        return time.monotonic() + self._rng.expovariate(1.0 / self.disconnect_every)
+
+    def start(self):
+        self._open_pty()
+        self._thread = threading.Thread(target=self._serve, name=f"emu-synth-{self.index}", daemon=True)
+        self._thread.start()
+
+    def stop(self):
+        self._stop.set()
+        if self._thread:
+            self._thread.join(timeout=2)
+        self._close_pty()
+
+    def _serve(self):
+        unplug_at = self._next_disconnect()
+        while not self._stop.is_set():
+            if unplug_at is not None and time.monotonic() >= unplug_at:
+                self.disconnects += 1
+                self._close_pty()
+                if self._stop.wait(self.downtime):
+                    return
+                self._open_pty()
+                unplug_at = self._next_disconnect()
+                continue
+            readable, _, _ = select.select([self._master], [], [], 0.05)
+            if not readable:
+                continue
+            try:
+                data = os.read(self._master, 256)
+            except OSError:
+                continue
+            received_at = time.monotonic()
+            self.bytes_in += len(data)
+            for response in self.synth.feed(data):
+                delay = self.latency + (self._rng.uniform(0.0, self.jitter) if self.jitter else 0.0)
+                if delay:
+                    time.sleep(delay)
+                if self.noise and self._rng.random() < self.noise:
+                    self.noise_lines += 1
+                    noise = self._rng.choice(NOISE_LINES).format(ms=self.synth.uptime_ms(), tag=LOG_TAG)
+                    self._write(noise + "\r\n")
+                self._write(response)
+                self.response_times.append(time.monotonic() - received_at)
+                if len(self.response_times) > 100000:
+                    del self.response_times[:50000]
+
+    def stats(self):
+        s = self.synth
+        return {
+            'link': self.link_path,
+            'commands': s.commands,
+            'reads': s.reads,
+            'writes': s.writes,
+            'warnings': s.warnings,
+            'bytes_in': self.bytes_in,
+            'bytes_out': self.bytes_out,
+            'noise_lines': self.noise_lines,
+            'disconnects': self.disconnects,
+            'response_ms_p50': round(_percentile(self.response_times, 50) * 1000, 3),
+            'response_ms_p99': round(_percentile(self.response_times, 99) * 1000, 3),
+        }
+
+
+class SynthEmulator:
+    """A rig of EmulatedPorts sharing one link directory."""
+
+    def __init__(self, num_synths, link_dir, **port_options):
+        os.makedirs(link_dir, exist_ok=True)
+        seed = port_options.pop('seed', None)
+        self.link_dir = link_dir
+        self.ports = [EmulatedPort(i, link_dir, seed=None if seed is None else seed + i, **port_options)
+                      for i in range(num_synths)]
+
+    @property
+    def device_glob(self):
+        return os.path.join(self.link_dir, '*')
+
+    @property
+    def paths(self):
+        return [port.link_path for port in self.ports]
+
+    def start(self):
+        for port in self.ports:
+            port.start()
+        return self
+
+    def stop(self):
+        for port in self.ports:
+            port.stop()
+
+    def __enter__(self):
+        return self.start()
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.stop()
+
+    def stats(self):
+        per_port = [port.stats() for port in self.ports]
+        totals = {key: sum(p[key] for p in per_port)
+                  for key in ('commands', 'reads', 'writes', 'warnings', 'bytes_in', 'bytes_out',
+                              'noise_lines', 'disconnects')}
+        return {'totals': totals, 'synths': per_port}
+
+
+def _raw_selftest(emulator, duration):
+    """Drive every port with a request/response loop over plain file descriptors."""
+    results = {'rtt': [], 'errors': 0, 'requests': 0, 'skipped_lines': 0}
+    lock = threading.Lock()
+    deadline = time.monotonic() + duration
+
+    def client(path):
+        fd = None
+        buf = b''
+        rtts, errors, requests, skipped = [], 0, 0, 0
+        while time.monotonic() < deadline:
+            try:
+                if fd is None:
+                    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+                    tty.setraw(fd)
+                cmd = random.choice(('rfa', 'raa', 'rpb', 'rena', 'rhb'))
+                start = time.monotonic()
+                os.write(fd, (cmd + '\r').encode())
+                requests += 1
+                # Unsolicited log lines ahead of the response are skipped, as the host would have to.
+                while True:
+                    while b'\n' not in buf:
+                        readable, _, _ = select.select([fd], [], [], 1.0)
+                        if not readable:
+                            raise TimeoutError(cmd)
+                        chunk = os.read(fd, 512)
+                        if not chunk:
+                            raise OSError('port closed')
+                        buf += chunk
+                    line, buf = buf.split(b'\n', 1)
+                    if line.decode('latin-1').strip().startswith(cmd):
+                        break
+                    skipped += 1
+                rtts.append(time.monotonic() - start)
+                os.write(fd, f"waa{random.uniform(0, 100):.1f}\r".encode())
+                requests += 1
+            except (OSError, TimeoutError):
+                errors += 1
+                buf = b''
+                if fd is not None:
+                    try:
+                        os.close(fd)
+                    except OSError:
+                        pass
+                    fd = None
+                time.sleep(0.2)
+        if fd is not None:
+            os.close(fd)
+        with lock:
+            results['rtt'].extend(rtts)
+            results['errors'] += errors
+            results['requests'] += requests
+            results['skipped_lines'] += skipped
+
+    threads = [threading.Thread(target=client, args=(path,), daemon=True) for path in emulator.paths]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return {
+        'client': 'raw',
+        'requests': results['requests'],
+        'requests_per_s': round(results['requests'] / duration, 1),
+        'errors': results['errors'],
+        'skipped_lines': results['skipped_lines'],
+        'rtt_ms_p50': round(_percentile(results['rtt'], 50) * 1000, 3),
+        'rtt_ms_p99': round(_percentile(results['rtt'], 99) * 1000, 3),
+    }
+
+
+def _host_selftest(emulator, duration, commands_per_cycle):
+    """Run the real host command queue and poller against the emulated rig."""
+    import queue
+    import tempfile
+    sys.path.insert(0, HOST_DIR)
+    from synth_control.synth_interface import SynthInterface
+    from synth_control.synth_state import SynthStateManager
+    from utils.command_queue import process_command_queue
+    from utils.synth_poller import poll_synth_states
+
+    n = len(emulator.ports)
+    tmp = tempfile.mkdtemp(prefix='nhp_emu_state_')
+    state = SynthStateManager(os.path.join(tmp, 'state.json'), os.path.join(tmp, 'defaults.json'))
+    template = state.synths[0] if state.synths else {}
+    state.synths = [json.loads(json.dumps(template)) for _ in range(n)]
+    state.num_synths = n
+
+    synths = []
+    targets = [os.path.realpath(path) for path in emulator.paths]
+    for i, path in enumerate(emulator.paths):
+        synth = SynthInterface(port=path, id=i)
+        synth.connect()
+        synth.silent = True
+        synths.append(synth)
+
+    cmd_queue = queue.Queue()
+    dispatch_times, poll_times = [], []
+    commands = polls = failed_reads = reconnects = 0
+    deadline = time.monotonic() + duration
+    while time.monotonic() < deadline:
+        for _ in range(commands_per_cycle):
+            synth_id = random.randrange(n)
+            kind = random.choice(('set_amplitude', 'set_frequency', 'set_phase'))
+            value = {'set_amplitude': lambda: round(random.uniform(0, 100), 1),
+                     'set_frequency': lambda: round(random.uniform(45, 65), 1),
+                     'set_phase': lambda: round(random.uniform(-180, 180), 1)}[kind]()
+            cmd_queue.put({'command': kind, 'synth_id': synth_id, 'channel': random.choice('ab'), 'value': value})
+        start = time.monotonic()
+        process_command_queue(cmd_queue, synths, state)
+        dispatch_times.append(time.monotonic() - start)
+        commands += commands_per_cycle
+
+        start = time.monotonic()
+        try:
+            failed_reads += poll_synth_states(synths, state).get('failed_count', 0)
+        except Exception:
+            failed_reads += 1
+        poll_times.append(time.monotonic() - start)
+        polls += 1
+
+        # Synths whose link was re-created by a simulated unplug get reopened once it is back.
+        for i, synth in enumerate(synths):
+            target = os.path.realpath(synth.port) if os.path.lexists(synth.port) else None
+            if target is not None and target != targets[i]:
+                synth.disconnect()
+                if synth.connect():
+                    synth.silent = True
+                    targets[i] = target
+                    reconnects += 1
+
+    for synth in synths:
+        synth.disconnect()
+    # Each poll reads enabled/amplitude/frequency/phase for both channels.
+    reads = polls * n * 8
+    return {
+        'client': 'host',
+        'commands': commands,
+        'commands_per_s': round(commands / duration, 1),
+        'poll_cycles': polls,
+        'poll_reads_per_s': round(reads / duration, 1),
+        'failed_reads': failed_reads,
+        'reconnects': reconnects,
+        'dispatch_ms_p50': round(_percentile(dispatch_times, 50) * 1000, 3),
+        'dispatch_ms_p99': round(_percentile(dispatch_times, 99) * 1000, 3),
+        'poll_ms_p50': round(_percentile(poll_times, 50) * 1000, 3),
+        'poll_ms_p99': round(_percentile(poll_times, 99) * 1000, 3),
+        'read_rtt_ms_p50': round(_percentile(poll_times, 50) * 1000 / max(1, n * 8), 3),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Emulate NHP_Synth ESP32 synths on pseudo-terminals")
+    parser.add_argument('--synths', type=int, default=3, help="number of virtual synths (default 3)")
+    parser.add_argument('--link-dir', default='/tmp/nhp_emu', help="directory for the device symlinks")
+    parser.add_argument('--baud', type=int, default=115200, help="pace output at this baud rate (0 = unpaced)")
+    parser.add_argument('--latency', type=float, default=0.2, help="per-command firmware latency in ms")
+    parser.add_argument('--jitter', type=float, default=0.0, help="random extra latency up to this many ms")
+    parser.add_argument('--noise', type=float, default=0.0, help="probability of a log line before a response")
+    parser.add_argument('--boot', action='store_true', help="emit an ESP32 boot banner when a port appears")
+    parser.add_argument('--disconnect', type=float, default=0.0, help="mean seconds between simulated unplugs")
+    parser.add_argument('--downtime', type=float, default=3.0, help="seconds a port stays unplugged")
+    parser.add_argument('--seed', type=int, default=None, help="random seed for repeatable runs")
+    parser.add_argument('--selftest', type=float, metavar='SECONDS', default=0.0,
+                        help="run a load test for SECONDS, print JSON results and exit")
+    parser.add_argument('--client', choices=('host', 'raw'), default='host',
+                        help="selftest client: the host stack (needs pyserial) or raw fds")
+    parser.add_argument('--commands-per-cycle', type=int, default=6,
+                        help="commands queued between polls in the host selftest")
+    args = parser.parse_args()
+
+    emulator = SynthEmulator(args.synths, args.link_dir, baud=args.baud, latency_ms=args.latency,
+                             jitter_ms=args.jitter, noise=args.noise, boot=args.boot,
+                             disconnect_every=args.disconnect, downtime=args.downtime, seed=args.seed)
+    if args.seed is not None:
+        random.seed(args.seed)
+
+    with emulator:
+        if args.selftest > 0:
+            if args.client == 'host':
+                try:
+                    report = _host_selftest(emulator, args.selftest, args.commands_per_cycle)
+                except ImportError as e:
+                    print(f"Host stack unavailable ({e}), falling back to raw client", file=sys.stderr)
+                    report = _raw_selftest(emulator, args.selftest)
+            else:
+                report = _raw_selftest(emulator, args.selftest)
+            report.update({'synths': args.synths, 'duration_s': args.selftest, 'emulator': emulator.stats()['totals']})
+            print(json.dumps(report, indent=2))
+            return
+
+        print(f"Emulating {args.synths} synth(s) in {args.link_dir}")
+        print(f"Run the host with: NHP_SYNTH_DEVICE_GLOB='{emulator.device_glob}'")
+        try:
+            while True:
+                time.sleep(10)
+                totals = emulator.stats()['totals']
+                print(f"commands={totals['commands']} bytes_in={totals['bytes_in']} "
+                      f"bytes_out={totals['bytes_out']} disconnects={totals['disconnects']}")
+        except KeyboardInterrupt:
+            pass
+
+
+if __name__ == "__main__":
+    main()